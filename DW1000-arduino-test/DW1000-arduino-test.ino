@@ -22,6 +22,11 @@ boolean toggle = true;
 void setup() {
   // for debugging
   Serial.begin(9600);
+  // load LDE and OTP calibration, bring up the SPI clock and report the transaction times (ns)
+  Serial.print("Initialized: "); Serial.println(dw.initialize() ? "yes" : "no");
+  Serial.print("Fast SPI clock: "); Serial.println(dw.getSpiClock() == DW1000::SPI_CLOCK_FAST ? "yes" : "no");
+  Serial.print("SPI read slow: "); Serial.print(dw.getSlowTransactionTime());
+  Serial.print(" fast: "); Serial.println(dw.getFastTransactionTime());
   // print chip info
   Serial.print("Device ID: "); Serial.println(dw.readDeviceIdentifier());
   Serial.print("Chip Select: "); Serial.println(dw.getChipSelect());
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Property based / fuzz test of the register encoding of the configuration
+ * entry points (setDefaultMode, tuneReceiver, setRFChannel, setData,
+ * transmitFrameLength, and a long frame: setData() of 128 to 1021 bytes
+ * after a 1023 byte setDefaultMode() mode). Each case runs a short random sequence of entry
+ * points with mostly valid, sometimes arbitrary arguments on a fresh
+ * device, records the SPI writes with the transfer hook and compares
+ * them with a reference encoder written independently from the register
+ * tables of the user manual. Meant to run under AddressSanitizer and
+ * UndefinedBehaviorSanitizer, also builds as a libFuzzer target.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <string>
+#include <sstream>
+#include "DW1000.h"
+
+struct Transfer {
+	std::vector<byte> header;
+	std::vector<byte> data;
+
+	bool operator==(const Transfer& other) const {
+		return header == other.header && data == other.data;
+	}
+};
+
+typedef std::vector<Transfer> Traffic;
+
+// SPI writes of the device under test
+static void record(void* context, boolean write, byte header[], int headerLen, byte data[], int n) {
+	Transfer transfer;
+
+	if(!write) {
+		return;
+	}
+	transfer.header.assign(header, header + headerLen);
+	transfer.data.assign(data, data + n);
+	((Traffic*)context)->push_back(transfer);
+}
+
+/* ###########################################################################
+ * #### Reference encoder ####################################################
+ * ######################################################################### */
+
+// device state the encoding depends on, power-up defaults
+struct Model {
+	int channel;
+	int prf;		// 1 = 16MHz, 2 = 64MHz
+	int code;
+	byte syscfg2;	// SYS_CFG bits 16-23
+	int txRate;		// TXBR (TX_FCTRL bits 13-14) of the TX settings, none set up yet
+
+	Model() : channel(5), prf(1), code(4), syscfg2(0), txRate(0) {
+	}
+
+	// PHR_MODE extended (3): frames up to 1023 bytes
+	bool extended() const {
+		return (syscfg2 & 0x03) == 0x03;
+	}
+};
+
+/*
+ * Write transaction (user manual 2.2.1.2): bit 7 write, bit 6 sub-index
+ * present, register id; sub-index of 7 bits or 15 bits (extended, bit 7 of
+ * the second byte set). A value is sent LSB first.
+ */
+static void write(Traffic& traffic, int reg, int sub, unsigned long value, int n) {
+	Transfer transfer;
+	int i;
+
+	if(sub == 0) {
+		transfer.header.push_back((byte)(0x80 | reg));
+	} else if(sub < 0x80) {
+		transfer.header.push_back((byte)(0xC0 | reg));
+		transfer.header.push_back((byte)sub);
+	} else {
+		transfer.header.push_back((byte)(0xC0 | reg));
+		transfer.header.push_back((byte)(0x80 | (sub & 0x7F)));
+		transfer.header.push_back((byte)(sub >> 7));
+	}
+	for(i = 0; i < n; i++) {
+		transfer.data.push_back((byte)((value >> (8 * i)) & 0xFF));
+	}
+	traffic.push_back(transfer);
+}
+
+/*
+ * PHR_MODE (SYS_CFG bits 16-17, extended frames above 127 bytes) and
+ * TFLEN/TFLE (TX_FCTRL bits 0-9, written along with TXBR in bits 13-14).
+ */
+static void refTransmitFrameLength(Model& m, int len, Traffic& t) {
+	len &= 0xFFFF;
+	m.syscfg2 = (byte)((m.syscfg2 & ~0x03) | (len > 127 ? 0x03 : 0x00));
+	write(t, 0x04, 2, m.syscfg2, 1);
+	write(t, 0x08, 0, (len & 0x3FF) | (m.txRate << 13), 2);
+}
+
+/*
+ * DRX_TUNE0b (SFD), DRX_TUNE1b (rate), DRX_TUNE1a (PRF), DRX_TUNE2 (PAC,
+ * PRF), LDE_CFG2 (PRF) and DRX_TUNE4H (preamble), tables 30 to 36. Rate
+ * codes 0x0A (110kbps) and 0x01 (850kbps/6.8Mbps), PRF codes 0x87 (16MHz)
+ * and 0x8D (64MHz), preamble code 0x01 is 64 symbols. PAC 0 is taken from
+ * the preamble length (table 6).
+ */
+static void refTuneReceiver(int rate, int prf, int preamble, int pac, Traffic& t) {
+	static const unsigned long TUNE2[4][2] = {
+		{0x311A002D, 0x313B006B}, {0x331A0052, 0x333B00BE},
+		{0x351A009A, 0x353B015E}, {0x371A011D, 0x373B0296}
+	};
+	int p, pacIndex;
+
+	if(rate != 0x0A && rate != 0x01) {
+		return;
+	}
+	if(prf == 0x87) {
+		p = 0;
+	} else if(prf == 0x8D) {
+		p = 1;
+	} else {
+		return;
+	}
+	switch(preamble & 0xFF) {
+		case 0x09: case 0x0D: pacIndex = 1; break;
+		case 0x02: pacIndex = 2; break;
+		case 0x06: case 0x0A: case 0x03: pacIndex = 3; break;
+		default: pacIndex = 0; break;
+	}
+	switch(pac & 0xFF) {
+		case 0: break;
+		case 8: pacIndex = 0; break;
+		case 16: pacIndex = 1; break;
+		case 32: pacIndex = 2; break;
+		case 64: pacIndex = 3; break;
+		default: return;
+	}
+	write(t, 0x27, 0x02, rate == 0x0A ? 0x000A : 0x0001, 2);
+	write(t, 0x27, 0x06, rate == 0x0A ? 0x0064 : (preamble == 0x01 ? 0x0010 : 0x0020), 2);
+	write(t, 0x27, 0x04, prf, 2);
+	write(t, 0x27, 0x08, TUNE2[pacIndex][p], 4);
+	write(t, 0x2E, 0x1806, p == 0 ? 0x1607 : 0x0607, 2);
+	write(t, 0x27, 0x26, preamble == 0x01 ? 0x0010 : 0x0028, 2);
+}
+
+/*
+ * RF_RXCTRLH, RF_TXCTRL, TC_PGDELAY, FS_PLLCFG, FS_PLLTUNE (tables 37 to
+ * 41), smart TX power (table 20) and CHAN_CTRL.
+ */
+static void refSetRFChannel(Model& m, int channel, Traffic& t) {
+	static const int CHANNELS[6] = {1, 2, 3, 4, 5, 7};
+	static const byte RXCTRLH[6] = {0xD8, 0xD8, 0xD8, 0xBC, 0xD8, 0xBC};
+	static const unsigned long TXCTRL[6] = {0x00005C40, 0x00045CA0, 0x00086CC0, 0x00045C80, 0x001E3FE0, 0x001E7DE0};
+	static const byte PGDELAY[6] = {0xC9, 0xC2, 0xC5, 0x95, 0xC0, 0x93};
+	static const unsigned long PLLCFG[6] = {0x09000407, 0x08400508, 0x08401009, 0x08400508, 0x0800041D, 0x0800041D};
+	static const byte PLLTUNE[6] = {0x1E, 0x26, 0x56, 0x26, 0xBE, 0xBE};
+	static const unsigned long POWER[6][2] = {
+		{0x15355575, 0x07274767}, {0x15355575, 0x07274767}, {0x0F2F4F6F, 0x2B4B6B8B},
+		{0x1F1F3F5F, 0x3A5A7A9A}, {0x0E082848, 0x25456585}, {0x32527292, 0x5171B1D1}
+	};
+	unsigned long chanctrl;
+	int i;
+
+	for(i = 0; i < 6 && CHANNELS[i] != channel; i++) {
+	}
+	if(i == 6) {
+		return;
+	}
+	m.channel = channel;
+	write(t, 0x28, 0x0B, RXCTRLH[i], 1);
+	write(t, 0x28, 0x0C, TXCTRL[i], 4);
+	write(t, 0x2A, 0x0B, PGDELAY[i], 1);
+	write(t, 0x2B, 0x07, PLLCFG[i], 4);
+	write(t, 0x2B, 0x0B, PLLTUNE[i], 1);
+	write(t, 0x1E, 0, POWER[i][m.prf == 2 ? 1 : 0], 4);
+	chanctrl = (unsigned long)channel | ((unsigned long)channel << 4) | ((unsigned long)m.prf << 18)
+		| ((unsigned long)m.code << 22) | ((unsigned long)m.code << 27);
+	write(t, 0x1F, 0, chanctrl, 4);
+}
+
+/*
+ * Payload into TX_BUFFER (1024 bytes), the device appends the CRC-16;
+ * frames are at most 127 bytes in standard and 1023 bytes in extended PHR
+ * mode (user manual 3.4, SYS_CFG).
+ */
+static void refSetData(const Model& m, const std::vector<byte>& data, Traffic& t) {
+	Transfer transfer;
+
+	if(data.size() + 2 > (m.extended() ? 1023u : 127u)) {
+		return;
+	}
+	transfer.header.push_back(0x80 | 0x09);
+	transfer.data = data;
+	t.push_back(transfer);
+}
+
+/*
+ * setDefaultMode() modes as in the datasheet (v2.04 p. 28): data rate
+ * (kbps), PRF (MHz), preamble symbols and frame length. Transmitter and
+ * receiver use the same data rate, PRF and preamble; the PAC size is the
+ * one recommended for the preamble length (user manual, table 6).
+ */
+static void refSetDefaultMode(Model& m, int mode, Traffic& t) {
+	static const int MODES[16][4] = {
+		{110, 16, 1024, 12}, {6800, 16, 128, 12}, {110, 16, 1024, 30}, {6800, 16, 128, 30},
+		{6800, 16, 1024, 1023}, {6800, 16, 128, 127}, {110, 16, 1024, 1023}, {110, 16, 1024, 127},
+		{110, 64, 1024, 12}, {6800, 64, 128, 12}, {110, 64, 1024, 30}, {6800, 64, 128, 30},
+		{6800, 64, 1024, 1023}, {6800, 64, 128, 127}, {110, 64, 1024, 1023}, {110, 64, 1024, 127}
+	};
+	// TXPSR/PE codes of 64 ... 4096 symbols (table 16)
+	static const int SYMBOLS[8] = {64, 128, 256, 512, 1024, 1536, 2048, 4096};
+	static const int PREAMBLE[8] = {0x01, 0x05, 0x09, 0x0D, 0x02, 0x06, 0x0A, 0x03};
+	const int* p;
+	int preamble, pac, i;
+
+	if(mode < 1 || mode > 16) {
+		return;
+	}
+	p = MODES[mode - 1];
+	for(i = 0; SYMBOLS[i] != p[2]; i++) {
+	}
+	preamble = PREAMBLE[i];
+	pac = p[2] <= 128 ? 8 : p[2] <= 512 ? 16 : p[2] <= 1024 ? 32 : 64;
+	m.prf = p[1] == 64 ? 2 : 1;
+	m.txRate = p[0] == 110 ? 0 : p[0] == 850 ? 1 : 2;
+	refTransmitFrameLength(m, p[3], t);
+	refTuneReceiver(p[0] == 110 ? 0x0A : 0x01, p[1] == 64 ? 0x8D : 0x87, preamble, pac, t);
+}
+
+/* ###########################################################################
+ * #### Test cases ###########################################################
+ * ######################################################################### */
+
+// argument source: random generator or fuzzer input
+class Input {
+public:
+	Input(std::mt19937* rng) : _rng(rng), _data(NULL), _size(0) {
+	}
+	Input(const byte* data, size_t size) : _rng(NULL), _data(data), _size(size) {
+	}
+
+	bool empty() {
+		return _rng == NULL && _size == 0;
+	}
+
+	unsigned long next() {
+		unsigned long value = 0;
+		int i;
+
+		if(_rng != NULL) {
+			return (*_rng)();
+		}
+		for(i = 0; i < 4 && _size > 0; i++, _data++, _size--) {
+			value |= (unsigned long)*_data << (8 * i);
+		}
+		return value;
+	}
+
+	// a valid value (3 out of 4 times) or an arbitrary one
+	int pick(const int* valid, int count, unsigned long any) {
+		unsigned long r = next();
+		if((r & 0x03) != 0) {
+			return valid[(r >> 2) % count];
+		}
+		return (int)((r >> 2) % any);
+	}
+
+private:
+	std::mt19937* _rng;
+	const byte* _data;
+	size_t _size;
+};
+
+#define OPS 6
+
+static const char* NAMES[OPS] = {"setDefaultMode", "tuneReceiver", "setRFChannel", "setData",
+	"transmitFrameLength", "longFrame"};
+static long counts[OPS];
+
+static std::string hex(const Transfer& transfer) {
+	std::ostringstream out;
+	size_t i;
+
+	out << std::hex << std::setfill('0');
+	for(i = 0; i < transfer.header.size(); i++) {
+		out << std::setw(2) << (int)transfer.header[i];
+	}
+	out << " |";
+	for(i = 0; i < transfer.data.size() && i < 16; i++) {
+		out << " " << std::setw(2) << (int)transfer.data[i];
+	}
+	if(transfer.data.size() > 16) {
+		out << " ... (" << std::dec << transfer.data.size() << " bytes)";
+	}
+	return out.str();
+}
+
+static void report(const std::string& calls, const Traffic& actual, const Traffic& expected) {
+	size_t i;
+
+	std::cerr << "MISMATCH in " << calls << std::endl;
+	for(i = 0; i < actual.size() || i < expected.size(); i++) {
+		std::cerr << (i < actual.size() && i < expected.size() && actual[i] == expected[i] ? "   " : " ! ")
+			<< std::setw(3) << i
+			<< "  got " << std::setw(40) << std::left << (i < actual.size() ? hex(actual[i]) : "-")
+			<< "  expected " << (i < expected.size() ? hex(expected[i]) : "-") << std::right << std::endl;
+	}
+}
+
+/*
+ * Run up to four random entry points on a fresh device, comparing the
+ * traffic after each one. Returns false on the first mismatch.
+ */
+static bool runCase(Input& in) {
+	static const int MODES[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+	static const int RATES[2] = {DW1000::RX_RATE_110KBPS, DW1000::RX_RATE_6800KBPS};
+	static const int PRFS[2] = {DW1000::RX_PULSE_FREQ_16MHz, DW1000::RX_PULSE_FREQ_64MHz};
+	static const int PREAMBLES[8] = {
+		DW1000::TX_PREAMBLE_LEN_64, DW1000::TX_PREAMBLE_LEN_128, DW1000::TX_PREAMBLE_LEN_256,
+		DW1000::TX_PREAMBLE_LEN_512, DW1000::TX_PREAMBLE_LEN_1024, DW1000::TX_PREAMBLE_LEN_1536,
+		DW1000::TX_PREAMBLE_LEN_2048, DW1000::TX_PREAMBLE_LEN_4096
+	};
+	static const int PACS[4] = {8, 16, 32, 64};
+	static const int CHANNELS[6] = {1, 2, 3, 4, 5, 7};
+	static const int LENGTHS[9] = {0, 12, 125, 127, 128, 200, 1021, 1022, 1023};
+	static const int LONG_MODES[4] = {5, 7, 13, 15};
+	DW1000 dw(1);
+	Model model;
+	Traffic actual, expected;
+	std::ostringstream call;
+	int steps, i, op;
+
+	dw.setTransferHandler(record, &actual);
+	steps = 1 + (int)(in.next() % 4);
+	for(i = 0; i < steps && !in.empty(); i++) {
+		op = (int)(in.next() % OPS);
+		counts[op]++;
+		actual.clear();
+		expected.clear();
+		call << (i > 0 ? ", " : "") << NAMES[op] << "(";
+		if(op == 0) {
+			int mode = in.pick(MODES, 16, 32);
+			call << mode;
+			dw.setDefaultMode(mode);
+			refSetDefaultMode(model, mode, expected);
+		} else if(op == 1) {
+			int rate = in.pick(RATES, 2, 256);
+			int prf = in.pick(PRFS, 2, 256);
+			int preamble = in.pick(PREAMBLES, 8, 256);
+			int pac = in.pick(PACS, 4, 256);
+			call << rate << ", " << prf << ", " << preamble << ", " << pac;
+			dw.tuneReceiver((byte)rate, (byte)prf, (byte)preamble, (byte)pac);
+			refTuneReceiver(rate, prf, preamble, pac, expected);
+		} else if(op == 2) {
+			int channel = in.pick(CHANNELS, 6, 65536) - 32768 * ((in.next() & 0x0F) == 0);
+			call << channel;
+			dw.setRFChannel((short)channel);
+			refSetRFChannel(model, channel, expected);
+		} else if(op == 3) {
+			// exactly sized, the sanitizer catches reads beyond the payload
+			std::vector<byte> data(in.pick(LENGTHS, 9, 1100));
+			for(size_t k = 0; k < data.size(); k++) {
+				data[k] = (byte)in.next();
+			}
+			call << data.size() << " bytes";
+			dw.newTransmit();
+			model.txRate = 0;
+			dw.setData(data.empty() ? NULL : &data[0], (int)data.size());
+			refSetData(model, data, expected);
+		} else if(op == 4) {
+			int len = in.pick(LENGTHS, 9, 65536);
+			call << len;
+			dw.transmitFrameLength((word)len);
+			refTransmitFrameLength(model, len, expected);
+		} else {
+			int mode = LONG_MODES[in.next() % 4];
+			std::vector<byte> data(128 + in.next() % 894);
+			for(size_t k = 0; k < data.size(); k++) {
+				data[k] = (byte)in.next();
+			}
+			call << mode << ", " << data.size() << " bytes";
+			dw.setDefaultMode(mode);
+			refSetDefaultMode(model, mode, expected);
+			dw.newTransmit();
+			model.txRate = 0;
+			dw.setData(&data[0], (int)data.size());
+			refSetData(model, data, expected);
+		}
+		call << ")";
+		if(!(actual == expected)) {
+			report(call.str(), actual, expected);
+			return false;
+		}
+	}
+	dw.setTransferHandler(NULL, NULL);
+	return true;
+}
+
+#ifdef DW1000_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+	Input in(data, size);
+
+	if(!runCase(in)) {
+		abort();
+	}
+	return 0;
+}
+#else
+int main(int argc, char** argv) {
+	long cases = argc > 1 ? atol(argv[1]) : 100000;
+	unsigned long seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 1;
+	std::mt19937 rng(seed);
+	Input in(&rng);
+	long c;
+	int i;
+
+	for(c = 0; c < cases; c++) {
+		if(!runCase(in)) {
+			std::cerr << "FAILED in case " << c << " (seed " << seed << ")" << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "OK, " << cases << " cases (seed " << seed << "):";
+	for(i = 0; i < OPS; i++) {
+		std::cout << " " << NAMES[i] << " " << counts[i];
+	}
+	std::cout << std::endl;
+	return 0;
+}
+#endif
+
+/*
+ * Using something like
+ *
+
+g++ -g -O1 -DDEBUG -fsanitize=address,undefined -fno-sanitize-recover=all -I../DW1000 ../DW1000/DW1000*.cpp DW1000-fuzz-test.cpp -o /tmp/DW1000-fuzz.o; /tmp/DW1000-fuzz.o 100000 1
+
+ *
+ * to compile and run it (number of cases and seed as arguments). With clang,
+ * -DDW1000_LIBFUZZER -fsanitize=fuzzer,address,undefined builds a libFuzzer
+ * target instead.
+ */
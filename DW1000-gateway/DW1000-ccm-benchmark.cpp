@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * Cost of authenticated frames (DW1000Ccm) on a single core: time per AES
+ * block of the compact rounds (the AVR variant) and of the T-tables, seal
+ * and open of the three frames of a two way ranging exchange (poll,
+ * response, final), and the resulting ranges per second with the MIC on
+ * the air and the CCM* time on both ends (blocks and times are seal plus
+ * open, summed over the exchange). On a microcontroller the cost of
+ * a frame is its block count times the measured time of one block there.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "DW1000.h"
+#include "DW1000Aes.h"
+#include "DW1000Ccm.h"
+
+static const long BLOCKS = 4L * 1024 * 1024;
+static const long FRAMES = 256L * 1024;
+
+// airtime model, 6.8Mbps, 16MHz PRF, 128 preamble symbols (as in
+// DW1000-simulation/DW1000-tdoa-simulation.cpp)
+static const double PREAMBLE_SYMBOL = 993.59e-9;
+static const double PHR_BIT = 1.0 / 850e3;
+static const double DATA_BIT = 1.0 / 6.8e6;
+static const double TURNAROUND = 500e-6;		// RX to TX on the host MCU
+
+// MAC header (frame control, sequence number, PAN, short addresses) and
+// payloads of poll, response and final (message type, three timestamps)
+static const int HEADER = 9;
+static const int PAYLOADS[] = {1, 1, 16};
+static const int EXCHANGE = 3;
+
+// keeps the encrypted blocks alive
+static volatile byte sink;
+
+static double frameDuration(int payload) {
+	int bits = (payload + 2) * 8;
+	int blocks = (bits + 329) / 330;	// Reed-Solomon, 48 parity bits per block
+
+	return (128 + 8) * PREAMBLE_SYMBOL + 21 * PHR_BIT + (bits + 48 * blocks) * DATA_BIT;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double blockTime(DW1000Aes* aes, boolean compact) {
+	byte block[LEN_AES_BLOCK] = {0};
+	long i;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(i = 0; i < BLOCKS; i++) {
+		if(compact) {
+			aes->encryptCompact(block);
+		} else {
+			aes->encrypt(block);
+		}
+	}
+	sink = block[0];
+	return seconds(start) / BLOCKS;
+}
+
+// seal and open of one frame (s), blocks of both
+static double frameTime(DW1000Ccm* ccm, int payload, byte level, unsigned long* blocks, boolean* ok) {
+	byte frame[HEADER + 16 + LEN_CCM_MAX_MIC] = {0x41, 0x88};
+	byte source[LEN_CCM_SOURCE] = {0xAC, 0xDE, 0x48, 0x00, 0x00, 0x00, 0x00, 0x01};
+	byte nonce[LEN_CCM_NONCE];
+	int len;
+	long i;
+
+	ccm->resetBlockCount();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(i = 0; i < FRAMES; i++) {
+		DW1000Ccm::nonce(nonce, source, (unsigned long)i, level);
+		len = ccm->seal(frame, HEADER, payload, nonce, level);
+		if(ccm->open(frame, HEADER, len, nonce, level) != payload) {
+			*ok = false;
+		}
+	}
+	double t = seconds(start) / FRAMES;
+	*blocks = ccm->getBlockCount() / FRAMES;
+	return t;
+}
+
+int main() {
+	byte key[LEN_AES_KEY] = {0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7,
+		0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF};
+	byte levels[] = {0, 4, 5, 6, 7};
+	DW1000Aes aes;
+	DW1000Ccm ccm;
+	unsigned long blocks;
+	boolean ok = true;
+	size_t l;
+	int f;
+
+	aes.setKey(key);
+	ccm.setKey(key);
+	std::cout << std::fixed << std::setprecision(1)
+		<< "AES block: compact " << blockTime(&aes, true) * 1e9 << " ns, tables "
+		<< blockTime(&aes, false) * 1e9 << " ns" << std::endl << std::endl;
+
+	std::cout << "level  MIC [B]  blocks/exchange  compact [us]  tables [us]  airtime [us]"
+		<< "  ranges/s compact  ranges/s tables" << std::endl;
+	for(l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+		byte mic = DW1000Ccm::micLength(levels[l]);
+		double compact = 0, tables = 0, air = 0;
+		unsigned long total = 0;
+
+		for(f = 0; f < EXCHANGE; f++) {
+			ccm.setCompact(true);
+			compact += frameTime(&ccm, PAYLOADS[f], levels[l], &blocks, &ok);
+			ccm.setCompact(false);
+			tables += frameTime(&ccm, PAYLOADS[f], levels[l], &blocks, &ok);
+			total += blocks;
+			air += frameDuration(HEADER + PAYLOADS[f] + mic);
+		}
+		// both ends turn around twice, CCM* on the critical path of each frame
+		double exchange = air + 2 * TURNAROUND;
+		std::cout << std::setw(5) << (int)levels[l] << std::setw(9) << (int)mic
+			<< std::setw(17) << total << std::setw(14) << compact * 1e6
+			<< std::setw(13) << tables * 1e6 << std::setw(14) << air * 1e6
+			<< std::setw(18) << 1.0 / (exchange + compact)
+			<< std::setw(17) << 1.0 / (exchange + tables) << std::endl;
+	}
+	if(!ok) {
+		std::cout << "mismatch" << std::endl;
+	}
+	return ok ? 0 : 1;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O2 -DDEBUG -I../DW1000 ../DW1000/DW1000*.cpp DW1000-ccm-benchmark.cpp -o /tmp/DW1000-ccm-bench.o; /tmp/DW1000-ccm-bench.o
+
+ *
+ * to compile and run it.
+ */
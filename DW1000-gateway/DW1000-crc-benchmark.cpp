@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * Throughput of the IEEE 802.15.4 CRC-16 variants (DW1000Crc) on a single
+ * core: bitwise reference, 4 bit table (the AVR variant) and slice-by-8,
+ * over frames of different lengths.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include "DW1000.h"
+#include "DW1000Crc.h"
+
+static const long BYTES = 64L * 1024 * 1024;
+
+typedef word (*CrcFunction)(word crc, const byte data[], int n);
+
+static double run(CrcFunction f, const std::vector<byte>& data, int length, word* result) {
+	word crc = 0;
+	long frames = BYTES / length;
+	long i;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(i = 0; i < frames; i++) {
+		crc ^= f(0, &data[(i * 7) % (data.size() - length)], length);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	*result = crc;
+	return frames * (double)length / seconds / 1e6;
+}
+
+int main() {
+	int lengths[] = {12, 127, 1023};
+	std::vector<byte> data(4096);
+	word a, b, c;
+	size_t i;
+
+	for(i = 0; i < data.size(); i++) {
+		data[i] = (byte)(i * 131 + 7);
+	}
+	std::cout << "frame [B]  bitwise [MB/s]  nibble [MB/s]  slice-by-8 [MB/s]" << std::endl;
+	for(i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+		double bitwise = run(&DW1000Crc::updateBitwise, data, lengths[i], &a);
+		double nibble = run(&DW1000Crc::updateNibble, data, lengths[i], &b);
+		double slice = run(&DW1000Crc::updateSlice8, data, lengths[i], &c);
+		std::cout << std::setw(9) << lengths[i] << std::fixed << std::setprecision(0)
+			<< std::setw(16) << bitwise << std::setw(15) << nibble << std::setw(19) << slice
+			<< (a == b && b == c ? "" : "  mismatch") << std::endl;
+	}
+	return 0;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O2 -DDEBUG -I../DW1000 ../DW1000/DW1000*.cpp DW1000-crc-benchmark.cpp -o /tmp/DW1000-crc-bench.o; /tmp/DW1000-crc-bench.o
+
+ *
+ * to compile and run it.
+ */
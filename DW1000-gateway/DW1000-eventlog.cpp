@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * Gateway side of the binary RX event log (DW1000EventLog).
+ *
+ * With a serial device (e.g. /dev/ttyUSB0) or file: decodes the stream of
+ * an anchor and prints one line per event (log sequence number, RX
+ * timestamp, source, frame sequence number, received and first path power
+ * in dBm), and the loss and error counts at the end.
+ *
+ * Without arguments: encodes a simulated stream of RX events, compares the
+ * bytes per event with text output and the event rates a serial link
+ * carries, and measures the decoder throughput.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "DW1000.h"
+#include "DW1000EventLog.h"
+
+// scenario of the benchmark
+static const int EVENTS = 1000000;
+static const int SOURCES = 20;
+static const double LINK_BAUD = 115200.0;		// 8N1, 10 bits per byte
+static const double TICKS_PER_SECOND = 499.2e6 * 128.0;
+
+static void printEvent(void* /* context */, const DW1000Event* event) {
+	std::cout << (int)event->seq << " " << (long long)event->time << " 0x" << std::hex
+		<< std::setw(4) << std::setfill('0') << event->source << std::dec << std::setfill(' ') << " "
+		<< (int)event->frameSeq << " " << std::fixed << std::setprecision(1)
+		<< DW1000EventLog::fromLevel(event->rxLevel) << " " << DW1000EventLog::fromLevel(event->fpLevel) << std::endl;
+}
+
+static void countEvent(void* context, const DW1000Event* /* event */) {
+	(*(unsigned long*)context)++;
+}
+
+static int decodeStream(const char* path) {
+	DW1000EventDecoder decoder(&printEvent, NULL);
+	byte buffer[4096];
+	struct termios tty;
+	ssize_t n;
+	int fd;
+
+	fd = (path[0] == '-' && path[1] == 0) ? 0 : open(path, O_RDONLY | O_NOCTTY);
+	if(fd < 0) {
+		std::cerr << "cannot open " << path << std::endl;
+		return 1;
+	}
+	// serial port: raw bytes at the link speed
+	if(isatty(fd) && tcgetattr(fd, &tty) == 0) {
+		cfmakeraw(&tty);
+		cfsetispeed(&tty, B115200);
+		cfsetospeed(&tty, B115200);
+		tty.c_cc[VMIN] = 1;
+		tty.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &tty);
+	}
+	while((n = read(fd, buffer, sizeof(buffer))) > 0) {
+		decoder.feed(buffer, (int)n);
+	}
+	std::cerr << decoder.getEventCount() << " events, " << decoder.getLostCount() << " lost, "
+		<< decoder.getErrorCount() << " corrupted, " << decoder.getSkippedCount() << " skipped" << std::endl;
+	if(fd != 0) {
+		close(fd);
+	}
+	return 0;
+}
+
+/*
+ * Line of the text output an anchor would print per event instead.
+ */
+static int textLength(const DW1000Event* event) {
+	char line[96];
+
+	return snprintf(line, sizeof(line), "RX %lld 0x%04X %d %.1f %.1f\r\n", (long long)event->time,
+		(unsigned int)event->source, (int)event->frameSeq,
+		DW1000EventLog::fromLevel(event->rxLevel), DW1000EventLog::fromLevel(event->fpLevel));
+}
+
+static void benchmark(double rate) {
+	std::mt19937 rng(1000);
+	std::uniform_int_distribution<int> source(0, SOURCES - 1);
+	std::exponential_distribution<double> gap(rate);
+	std::uniform_int_distribution<int> level(150, 200);
+	std::vector<byte> stream;
+	std::vector<byte> ring(4096);
+	DW1000EventLog log(&ring[0], (unsigned int)ring.size());
+	unsigned long decoded = 0;
+	DW1000EventDecoder decoder(&countEvent, &decoded);
+	DW1000Event event;
+	byte chunk[256];
+	double t = 0, textBytes = 0;
+	byte seqs[SOURCES] = {0};
+	int i, n;
+
+	for(i = 0; i < EVENTS; i++) {
+		t += gap(rng);
+		event.time = (int64_t)(t * TICKS_PER_SECOND) % DW1000::TIME_OVERFLOW;
+		event.source = (word)(0x100 + source(rng));
+		event.frameSeq = seqs[event.source - 0x100]++;
+		event.rxLevel = (byte)level(rng);
+		event.fpLevel = (byte)(event.rxLevel + 6);
+		log.log(&event);
+		textBytes += textLength(&event);
+		while((n = log.read(chunk, sizeof(chunk))) > 0) {
+			stream.insert(stream.end(), chunk, chunk + n);
+		}
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t k = 0; k < stream.size(); k += sizeof(chunk)) {
+		decoder.feed(&stream[k], (int)std::min(sizeof(chunk), stream.size() - k));
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double binary = (double)stream.size() / EVENTS;
+	double text = textBytes / EVENTS;
+	std::cout << std::setw(10) << (int)rate
+		<< std::setw(10) << std::fixed << std::setprecision(2) << binary
+		<< std::setw(9) << text
+		<< std::setw(13) << std::setprecision(0) << LINK_BAUD / 10 / binary
+		<< std::setw(11) << LINK_BAUD / 10 / text
+		<< std::setw(15) << std::setprecision(1) << decoded / seconds / 1e6
+		<< (decoded == (unsigned long)EVENTS ? "" : "  decode mismatch") << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+	double rates[] = {10, 100, 1000, 10000};
+	size_t i;
+
+	if(argc > 1) {
+		return decodeStream(argv[1]);
+	}
+	std::cout << EVENTS << " events from " << SOURCES << " sources, link " << (int)LINK_BAUD << " baud" << std::endl;
+	std::cout << "rate [1/s]  binary    text  binary [1/s]  text [1/s]  decode [M/s]" << std::endl;
+	for(i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+		benchmark(rates[i]);
+	}
+	return 0;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O2 -DDEBUG -I../DW1000 ../DW1000/DW1000*.cpp DW1000-eventlog.cpp -o /tmp/DW1000-eventlog.o; /tmp/DW1000-eventlog.o
+
+ *
+ * to compile and run the benchmark, and /tmp/DW1000-eventlog.o /dev/ttyUSB0
+ * (or - for stdin) to decode the stream of an anchor.
+ */
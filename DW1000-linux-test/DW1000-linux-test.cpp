@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Test cases for the Linux backend (spidev batches, IRQ event loop).
+ * Compile DW1000 with the DW1000_LINUX preprocessor flag. The spidev ioctl
+ * is replaced by a mock device that keeps a register file (reads return
+ * what was written) and records each ioctl as a batch of transactions.
+ */
+
+#include "QUnit.hpp"
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <linux/gpio.h>
+#include "DW1000.h"
+#include "DW1000Radios.h"
+#include "DW1000Hopping.h"
+#include "DW1000IrqLoop.h"
+
+struct Transaction {
+	boolean write;
+	byte reg;
+	word sub;
+	std::vector<byte> data;
+	unsigned int delay;
+	unsigned long clock;
+};
+
+typedef std::vector<Transaction> Batch;
+
+class MockDevice {
+public:
+	std::vector<Batch> batches;
+	byte mode;
+	byte bits;
+	byte regs[64][0x3000];
+
+	MockDevice() {
+		mode = 0xFF;
+		bits = 0;
+		memset(regs, 0, sizeof(regs));
+	}
+
+	static int ioctl(void* context, int /* fd */, unsigned long request, void* arg) {
+		return ((MockDevice*)context)->handle(request, arg);
+	}
+
+	int handle(unsigned long request, void* arg) {
+		if(request == SPI_IOC_WR_MODE) {
+			mode = *(byte*)arg;
+			return 0;
+		}
+		if(request == SPI_IOC_WR_BITS_PER_WORD) {
+			bits = *(byte*)arg;
+			return 0;
+		}
+		if(_IOC_TYPE(request) != SPI_IOC_MAGIC || _IOC_NR(request) != 0) {
+			return -1;
+		}
+		struct spi_ioc_transfer* t = (struct spi_ioc_transfer*)arg;
+		int count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+		Batch batch;
+		int i = 0;
+		while(i < count) {
+			Transaction x;
+			const byte* header = (const byte*)t[i].tx_buf;
+			x.delay = t[i].delay_usecs;
+			x.clock = t[i].speed_hz;
+			x.write = false;
+			x.reg = 0xFF;
+			x.sub = 0;
+			if(t[i].len > 0) {
+				x.write = (header[0] & 0x80) != 0;
+				x.reg = header[0] & 0x3F;
+				if(t[i].len > 1) {
+					x.sub = header[1] & 0x7F;
+					if(t[i].len > 2) {
+						x.sub |= (word)header[2] << 7;
+					}
+				}
+			}
+			// payload in the same chip select period
+			if(t[i].len > 0 && t[i].cs_change == 0 && i + 1 < count) {
+				i++;
+				if(x.write) {
+					x.data.assign((const byte*)t[i].tx_buf, (const byte*)t[i].tx_buf + t[i].len);
+					memcpy(&regs[x.reg][x.sub], &x.data[0], t[i].len);
+				} else {
+					memcpy((byte*)t[i].rx_buf, &regs[x.reg][x.sub], t[i].len);
+					x.data.assign(&regs[x.reg][x.sub], &regs[x.reg][x.sub] + t[i].len);
+				}
+			}
+			batch.push_back(x);
+			i++;
+		}
+		batches.push_back(batch);
+		return count;
+	}
+};
+
+static int failingIoctl(void* /* context */, int /* fd */, unsigned long request, void* /* arg */) {
+	return request == SPI_IOC_WR_MODE || request == SPI_IOC_WR_BITS_PER_WORD ? 0 : -1;
+}
+
+static void countIrq(void* context, int line, uint64_t /* timestamp */) {
+	((DW1000Radios*)context)->setInterruptPending(line);
+}
+
+class DW1000LinuxTest {
+private:
+	QUnit::UnitTest qunit;
+	MockDevice* mock;
+	DW1000* dw;
+
+	void testOpen() {
+		QUNIT_IS_TRUE(dw->getSpidev()->isOpen());
+		QUNIT_IS_EQUAL(SPI_MODE_0, mock->mode & 0xFF);
+		QUNIT_IS_EQUAL(8, mock->bits & 0xFF);
+	}
+
+	void testTransaction() {
+		mock->batches.clear();
+		// DEV_ID of the register file: header and payload in one ioctl
+		mock->regs[DEV_ID][0] = 0x30;
+		mock->regs[DEV_ID][1] = 0x01;
+		mock->regs[DEV_ID][2] = 0xCA;
+		mock->regs[DEV_ID][3] = 0xDE;
+		QUNIT_IS_TRUE(dw->checkDeviceIdentifier());
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(1, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(DEV_ID, mock->batches[0][0].reg & 0xFF);
+		QUNIT_IS_EQUAL(LEN_DEV_ID, (int)mock->batches[0][0].data.size());
+		QUNIT_IS_EQUAL(dw->getSpiClock(), mock->batches[0][0].clock);
+
+		// extended sub-address written and read back
+		mock->batches.clear();
+		dw->setAntennaDelay(0x4034, 0x4035);
+		QUNIT_IS_EQUAL(2, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(0x1804, mock->batches[1][0].sub);
+		QUNIT_IS_EQUAL(0x35, mock->regs[LDE_IF][0x1804] & 0xFF);
+	}
+
+	void testBatch() {
+		unsigned long ioctls = dw->getSpidev()->getIoctlCount();
+
+		// all channel registers in one ioctl, one transaction each
+		mock->batches.clear();
+		dw->setRFChannel(5);
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(7, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(RF_CONF, mock->batches[0][0].reg & 0xFF);
+		QUNIT_IS_EQUAL(CHAN_CTRL, mock->batches[0][6].reg & 0xFF);
+		QUNIT_IS_EQUAL(ioctls + 1, dw->getSpidev()->getIoctlCount());
+
+		// frame control, system control in one
+		mock->batches.clear();
+		dw->newTransmit();
+		dw->startTransmit();
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(2, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(SYS_CTRL, mock->batches[0][1].reg & 0xFF);
+
+		// payload and host CRC-16 in one
+		byte payload[16] = {0};
+		mock->batches.clear();
+		dw->setDataWithFrameCheck(payload, sizeof(payload));
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(2, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(16, mock->batches[0][1].sub);
+
+		// a read goes down with the queued writes, in order
+		mock->batches.clear();
+		dw->beginBatch();
+		dw->setAntennaDelay(0x1111, 0x2222);
+		QUNIT_IS_EQUAL(0, (int)mock->batches.size());
+		dw->isTransmitDone();
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(3, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(0, mock->batches[0][2].write & 0xFF);
+		dw->endBatch();
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+
+		// more transactions than fit into one message
+		mock->batches.clear();
+		dw->beginBatch();
+		for(int i = 0; i < DW1000_SPIDEV_MAX_TRANSFERS; i++) {
+			dw->setFrameFilter(i % 2 == 0);
+		}
+		dw->endBatch();
+		QUNIT_IS_EQUAL(2, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(DW1000_SPIDEV_MAX_TRANSFERS / 2, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(DW1000_SPIDEV_MAX_TRANSFERS / 2, (int)mock->batches[1].size());
+	}
+
+	// channel registers of the register file, in image order
+	std::vector<byte> channelRegisters() {
+		std::vector<byte> r;
+		r.insert(r.end(), &mock->regs[RF_CONF][RF_RXCTRLH_SUB], &mock->regs[RF_CONF][RF_RXCTRLH_SUB] + LEN_CHAN_RF);
+		r.push_back(mock->regs[TX_CAL][TC_PGDELAY_SUB]);
+		r.insert(r.end(), &mock->regs[FS_CTRL][FS_PLLCFG_SUB], &mock->regs[FS_CTRL][FS_PLLCFG_SUB] + LEN_CHAN_PLL);
+		r.insert(r.end(), &mock->regs[TX_POWER][0], &mock->regs[TX_POWER][0] + LEN_TX_POWER);
+		r.insert(r.end(), &mock->regs[CHAN_CTRL][0], &mock->regs[CHAN_CTRL][0] + LEN_CHAN_CTRL);
+		r.insert(r.end(), &mock->regs[LDE_IF][SUB_2804], &mock->regs[LDE_IF][SUB_2804] + LEN_LDE_REPC);
+		return r;
+	}
+
+	void testHopping() {
+		DW1000Hopping hopping(dw);
+		std::vector<byte> hopped;
+
+		// whole image, idle and CPLOCK clear in one ioctl
+		mock->batches.clear();
+		QUNIT_IS_TRUE(hopping.retune(5));
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(8, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(SYS_CTRL, mock->batches[0][0].reg & 0xFF);
+
+		// only the differing bytes, same registers as the slow way
+		mock->batches.clear();
+		QUNIT_IS_TRUE(hopping.retune(7));
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(hopping.getRetuneWrites(), (int)mock->batches[0].size());
+		hopped = channelRegisters();
+		memset(mock->regs[FS_CTRL], 0, LEN_CHAN_PLL + FS_PLLCFG_SUB);
+		dw->setRFChannel(7);
+		dw->setPreambleCode(hopping.getImage(7)->preambleCode);
+		QUNIT_IS_TRUE(hopped == channelRegisters());
+	}
+
+	// bytes on the bus (headers and payloads) of the recorded batches
+	int busBytes() {
+		int n = 0;
+		for(size_t b = 0; b < mock->batches.size(); b++) {
+			for(size_t i = 0; i < mock->batches[b].size(); i++) {
+				const Transaction& x = mock->batches[b][i];
+				n += (x.sub == 0 ? 1 : x.sub < 0x80 ? 2 : 3) + (int)x.data.size();
+			}
+		}
+		return n;
+	}
+
+	void testFrameTemplate() {
+		byte frame[12] = {0x41, 0x88, 0x00, 0xCA, 0xDE, 0x02, 0x00, 0x01, 0x00, 0x21, 0x00, 0x00};
+		byte txfctrl[LEN_TX_FCTRL];
+		byte buffer[12];
+		DW1000FrameTemplate poll;
+		int classic;
+
+		// the usual way, each message built up again
+		mock->batches.clear();
+		dw->newTransmit();
+		dw->transmitRate(DW1000::TX_RATE_6800KBPS);
+		dw->pulseFrequency(DW1000::TX_PULSE_FREQ_16MHZ);
+		dw->preambleLength(DW1000::TX_PREAMBLE_LEN_128);
+		dw->setData(frame, sizeof(frame));
+		dw->startTransmit();
+		QUNIT_IS_EQUAL(2, (int)mock->batches.size());
+		classic = busBytes();
+		memcpy(txfctrl, mock->regs[TX_FCTRL], LEN_TX_FCTRL);
+		memcpy(buffer, mock->regs[TX_BUFFER], sizeof(buffer));
+
+		// same registers from the template, TX_FCTRL already in place
+		DW1000::prepareTemplate(&poll, DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, frame, sizeof(frame), 0);
+		memset(mock->regs[TX_BUFFER], 0, sizeof(buffer));
+		mock->batches.clear();
+		QUNIT_IS_EQUAL(2, dw->transmitTemplate(&poll));
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(0, memcmp(txfctrl, mock->regs[TX_FCTRL], LEN_TX_FCTRL));
+		QUNIT_IS_EQUAL(0, memcmp(buffer, mock->regs[TX_BUFFER], sizeof(buffer)));
+		QUNIT_IS_EQUAL(1 << TXSTRT_BIT, mock->regs[SYS_CTRL][0] & 0xFF);
+
+		// next message: sequence number and SYS_CTRL, 5 bytes on the bus
+		frame[2] = 1;
+		DW1000::patchTemplate(&poll, 2, &frame[2], 1);
+		mock->batches.clear();
+		dw->transmitTemplate(&poll);
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(2, (int)mock->batches[0].size());
+		QUNIT_IS_EQUAL(5, busBytes());
+		QUNIT_IS_TRUE(busBytes() * 4 < classic);
+		QUNIT_IS_EQUAL(1, mock->regs[TX_BUFFER][2] & 0xFF);
+	}
+
+	void testWakeUp() {
+		mock->batches.clear();
+		dw->configureSleep(0);
+		dw->enterSleep();
+		mock->batches.clear();
+		QUNIT_IS_TRUE(dw->wakeUp());
+		// chip select held without a transaction, then the device id
+		QUNIT_IS_EQUAL(DW1000::WAKE_CS_HOLD, mock->batches[0][0].delay);
+		QUNIT_IS_EQUAL(0xFF, mock->batches[0][0].reg & 0xFF);
+		QUNIT_IS_EQUAL(DEV_ID, mock->batches[1][0].reg & 0xFF);
+	}
+
+	void testErrors() {
+		DW1000 other(9);
+		byte status[LEN_SYS_STATUS];
+
+		// no such device, reads return zeros
+		QUNIT_IS_FALSE(other.getSpidev()->isOpen());
+		memset(status, 0xFF, sizeof(status));
+		other.readSystemEventStatus(status);
+		QUNIT_IS_EQUAL(0, status[0] & 0xFF);
+		QUNIT_IS_FALSE(other.checkDeviceIdentifier());
+
+		other.getSpidev()->setIoctl(&failingIoctl, NULL);
+		QUNIT_IS_TRUE(other.getSpidev()->open("/dev/null"));
+		other.getSpidev()->beginBatch();
+		other.setFrameFilter(true);
+		QUNIT_IS_FALSE(other.getSpidev()->endBatch());
+		QUNIT_IS_TRUE(other.getSpidev()->endBatch());
+	}
+
+	void testIrqLoop() {
+		DW1000IrqLoop loop;
+		DW1000Radios radios;
+		struct gpio_v2_line_event events[3];
+		int pipes[2][2];
+
+		QUNIT_IS_EQUAL(0, radios.addRadio(dw));
+		QUNIT_IS_EQUAL(1, radios.addRadio(dw));
+		radios.useInterrupts(true);
+		QUNIT_IS_EQUAL(0, pipe(pipes[0]));
+		QUNIT_IS_EQUAL(0, pipe(pipes[1]));
+		QUNIT_IS_EQUAL(0, loop.addLineFd(pipes[0][0], &countIrq, &radios));
+		QUNIT_IS_EQUAL(1, loop.addLineFd(pipes[1][0], &countIrq, &radios));
+		QUNIT_IS_EQUAL(DW1000IrqLoop::NO_LINE, loop.addLine("/dev/nonexistent", 0, &countIrq, &radios));
+
+		// nothing pending
+		QUNIT_IS_EQUAL(0, loop.run(0));
+
+		// two edges of the second radio, one lost in between
+		memset(events, 0, sizeof(events));
+		events[0].line_seqno = 1;
+		events[1].line_seqno = 3;
+		QUNIT_IS_EQUAL((int)(2 * sizeof(events[0])), (int)write(pipes[1][1], events, 2 * sizeof(events[0])));
+		QUNIT_IS_EQUAL(2, loop.run(100));
+		QUNIT_IS_EQUAL(2, (int)loop.getEdgeCount());
+		QUNIT_IS_EQUAL(1, (int)loop.getLostCount());
+
+		// only the flagged radio is serviced
+		mock->batches.clear();
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+		QUNIT_IS_EQUAL(1, (int)mock->batches.size());
+		QUNIT_IS_EQUAL(SYS_STATUS, mock->batches[0][0].reg & 0xFF);
+
+		loop.close();
+		::close(pipes[0][1]);
+		::close(pipes[1][1]);
+	}
+
+public:
+	DW1000LinuxTest(std::ostream &out, int verboseLevel = QUnit::verbose) :
+		qunit(out, verboseLevel) {}
+
+	int run() {
+		mock = new MockDevice();
+		dw = new DW1000(0);
+		dw->getSpidev()->setIoctl(&MockDevice::ioctl, mock);
+		dw->getSpidev()->open("/dev/null");
+		// test methods
+		testOpen();
+		testTransaction();
+		testBatch();
+		testHopping();
+		testFrameTemplate();
+		testWakeUp();
+		testErrors();
+		testIrqLoop();
+		// cleanup and summary
+		delete dw;
+		delete mock;
+		return qunit.errors();
+	}
+};
+
+int main() {
+	return DW1000LinuxTest(std::cerr).run();
+}
+
+/*
+ * Using something like
+ *
+
+g++ -g -DDW1000_LINUX -I../DW1000 -I../DW1000-unit-test ../DW1000/DW1000*.cpp DW1000-linux-test.cpp -o /tmp/DW1000-linux.o; /tmp/DW1000-linux.o
+
+ *
+ * to compile and run it.
+ */
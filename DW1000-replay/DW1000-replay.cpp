@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * Offline replay of recorded SPI traces (DW1000Trace, DW1000Replay).
+ *
+ * Without arguments: records hours of a simulated tag session (a frame
+ * sent and a response awaited every 100ms, the chip simulated behind the
+ * transfer hook), replays it against the same application code, prints
+ * the replay speed and shows the report of a deliberate change.
+ *
+ * With a trace file (as dumped from DW1000Trace::getBuffer() on a device):
+ * prints a summary of the trace, transfers per register and its duration.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include "DW1000.h"
+#include "DW1000Trace.h"
+#include "DW1000Replay.h"
+
+// scenario
+static const double HOURS = 4.0;
+static const unsigned long CYCLE = 100000;		// us between frames
+static const unsigned long POLL = 100;			// us between status reads
+static const unsigned long SPI_BYTE = 1;		// us per byte on the bus
+
+/*
+ * Chip behind the transfer hook while recording: sets the TX and RX events
+ * after some status polls, serves received frames, feeds the trace.
+ */
+struct Chip {
+	DW1000Trace* trace;
+	unsigned long now;
+	unsigned long seed;
+	int txPolls;
+	int rxPolls;
+	boolean rxGood;
+	int rxLength;
+
+	int random(int n) {
+		seed = seed * 1103515245UL + 12345UL;
+		return (int)((seed >> 16) % n);
+	}
+};
+
+static void simulate(void* context, boolean write, byte header[], int headerLen, byte data[], int n) {
+	Chip* chip = (Chip*)context;
+	byte reg = header[0] & 0x3F;
+	int i;
+
+	if(write && reg == SYS_CTRL) {
+		if(DW1000Reg::TXSTRT::get(data)) {
+			chip->txPolls = 1 + chip->random(4);
+		}
+		if(DW1000Reg::RXENAB::get(data)) {
+			chip->rxPolls = 5 + chip->random(40);
+			chip->rxGood = chip->random(10) != 0;
+			chip->rxLength = 8 + chip->random(24);
+		}
+	} else if(!write && reg == SYS_STATUS) {
+		memset(data, 0, n);
+		if(chip->txPolls > 0 && --chip->txPolls == 0) {
+			DW1000Reg::TXFRS::set(data, true);
+		}
+		if(chip->rxPolls > 0 && --chip->rxPolls == 0) {
+			if(chip->rxGood) {
+				DW1000Reg::LDEDONE::set(data, true);
+				DW1000Reg::RXDFR::set(data, true);
+				DW1000Reg::RXFCG::set(data, true);
+			} else {
+				DW1000Reg::RXRFTO::set(data, true);
+			}
+			chip->rxPolls = -1;
+		} else if(chip->rxPolls < 0) {
+			// events stay latched until cleared
+			DW1000Reg::LDEDONE::set(data, chip->rxGood);
+			DW1000Reg::RXDFR::set(data, chip->rxGood);
+			DW1000Reg::RXFCG::set(data, chip->rxGood);
+			DW1000Reg::RXRFTO::set(data, !chip->rxGood);
+		}
+		chip->now += POLL;
+	} else if(!write && reg == RX_FINFO) {
+		memset(data, 0, n);
+		data[0] = (byte)(chip->rxLength + 2);
+	} else if(!write && reg == RX_BUFFER) {
+		for(i = 0; i < n; i++) {
+			data[i] = (byte)chip->random(256);
+		}
+	} else if(write && reg == SYS_STATUS) {
+		chip->rxPolls = 0;
+	}
+	chip->now += (headerLen + n) * SPI_BYTE;
+	chip->trace->setTime(chip->now);
+	chip->trace->record(header, headerLen, data, n);
+}
+
+/*
+ * Application code, one cycle of a tag: send a frame, wait for it to be
+ * sent, wait for a response. Runs the same way while recording and while
+ * replaying, control flow only depends on what is read from the chip.
+ */
+static int cycle(DW1000& dw, unsigned long seq, int variant) {
+	byte frame[16];
+	byte response[32];
+	int i, received = 0;
+
+	for(i = 0; i < (int)sizeof(frame); i++) {
+		frame[i] = (byte)(seq + i);
+	}
+	frame[0] += (byte)variant;
+	dw.newTransmit();
+	dw.setDefaults();
+	dw.setData(frame, sizeof(frame));
+	dw.startTransmit();
+	while(!dw.isTransmitDone());
+	dw.clearTransmitStatus();
+
+	dw.newReceive();
+	dw.startReceive();
+	while(!dw.isReceiveDone() && !dw.isReceiveTimeout());
+	if(dw.isReceiveSuccess()) {
+		received = dw.getData(response, sizeof(response));
+	}
+	dw.clearReceiveStatus();
+	return received;
+}
+
+static void benchmark() {
+	unsigned long cycles = (unsigned long)(HOURS * 3600e6 / CYCLE);
+	std::vector<byte> buffer(48 * cycles * 8);
+	DW1000Trace trace(&buffer[0], (unsigned int)buffer.size());
+	Chip chip = {&trace, 0, 1000, 0, 0, false, 0};
+	DW1000 dw(0);
+	unsigned long seq;
+	long received = 0, replayed = 0;
+
+	// record
+	trace.attach(&dw);
+	dw.setTransferHandler(&simulate, &chip);
+	for(seq = 0; seq < cycles; seq++) {
+		received += cycle(dw, seq, 0);
+		chip.now = (seq + 1) * CYCLE;
+	}
+	dw.setTransferHandler(NULL, NULL);
+	std::cout << "recorded " << std::fixed << std::setprecision(1) << chip.now / 3600e6 << "h, "
+		<< trace.getRecordCount() << " transfers, " << trace.getLength() / 1000 << "kB ("
+		<< std::setprecision(2) << (double)trace.getLength() / trace.getRecordCount() << " B/transfer), "
+		<< received << " bytes received, " << trace.getDroppedCount() << " dropped" << std::endl;
+
+	// replay the same code
+	DW1000Replay replay(trace.getBuffer(), trace.getLength());
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	replay.attach(&dw);
+	for(seq = 0; seq < cycles; seq++) {
+		replayed += cycle(dw, seq, 0);
+	}
+	replay.detach();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "replayed " << replay.getTransferCount() << " transfers ("
+		<< replay.getReadCount() << " reads, " << replay.getWriteCount() << " writes) in "
+		<< std::setprecision(3) << seconds << "s, " << std::setprecision(0)
+		<< replay.getTime() / 1e6 / seconds << "x real time, "
+		<< (replay.isDone() ? "complete" : "incomplete") << ", "
+		<< replay.getMismatchCount() << " mismatches, "
+		<< (replayed == received ? "same" : "different") << " data received" << std::endl;
+
+	// replay a changed payload in one cycle
+	replay.rewind();
+	replay.attach(&dw);
+	for(seq = 0; seq < cycles; seq++) {
+		cycle(dw, seq, seq == cycles / 2 ? 1 : 0);
+	}
+	replay.detach();
+	std::cout << "changed payload: " << replay.getMismatchCount() << " mismatch(es), first at transfer "
+		<< replay.getFirstMismatch() << std::endl;
+	for(size_t i = 0; i < replay.getMismatches().size(); i++) {
+		std::cout << "  " << replay.getMismatches()[i] << std::endl;
+	}
+}
+
+static int summarize(const char* file) {
+	std::ifstream in(file, std::ios::binary);
+	std::vector<byte> buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::map<int, unsigned long> transfers;
+	DW1000TraceRecord record;
+	unsigned int offset = 0, next;
+	unsigned long reads = 0, writes = 0;
+	uint64_t time = 0;
+
+	if(!in && buffer.empty()) {
+		std::cerr << "cannot read " << file << std::endl;
+		return 1;
+	}
+	while((next = DW1000Trace::decode(buffer.empty() ? NULL : &buffer[0], (unsigned int)buffer.size(), offset, &record)) != 0) {
+		offset = next;
+		time += record.time;
+		transfers[record.header[0] & 0x3F]++;
+		if(record.write) {
+			writes++;
+		} else {
+			reads++;
+		}
+	}
+	std::cout << reads + writes << " transfers (" << reads << " reads, " << writes << " writes), "
+		<< std::fixed << std::setprecision(3) << time / 1e6 << "s";
+	if(offset < buffer.size()) {
+		std::cout << ", " << buffer.size() - offset << " bytes truncated";
+	}
+	std::cout << std::endl << "register  transfers" << std::endl;
+	for(std::map<int, unsigned long>::iterator it = transfers.begin(); it != transfers.end(); ++it) {
+		std::cout << "    0x" << std::hex << std::setw(2) << std::setfill('0') << it->first
+			<< std::dec << std::setfill(' ') << std::setw(11) << it->second << std::endl;
+	}
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	if(argc > 1) {
+		return summarize(argv[1]);
+	}
+	benchmark();
+	return 0;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O2 -DDEBUG -I../DW1000 -I. ../DW1000/DW1000*.cpp DW1000Replay.cpp DW1000-replay.cpp -o /tmp/DW1000-replay.o; /tmp/DW1000-replay.o
+
+ *
+ * to compile and run it.
+ */
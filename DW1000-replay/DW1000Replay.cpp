@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Host side replay of a recorded SPI trace (see DW1000Replay.h).
+ */
+
+#include <sstream>
+#include <iomanip>
+#include "DW1000Replay.h"
+
+DW1000Replay::DW1000Replay(const byte trace[], unsigned int length) {
+	_dw = NULL;
+	_trace = trace;
+	_length = length;
+	rewind();
+}
+
+void DW1000Replay::attach(DW1000* dw) {
+	detach();
+	_dw = dw;
+	_dw->setTransferHandler(&DW1000Replay::handleTransfer, this);
+}
+
+void DW1000Replay::detach() {
+	if(_dw != NULL) {
+		_dw->setTransferHandler(NULL, NULL);
+		_dw = NULL;
+	}
+}
+
+void DW1000Replay::rewind() {
+	_offset = 0;
+	_transfers = 0;
+	_reads = 0;
+	_writes = 0;
+	_mismatchCount = 0;
+	_firstMismatch = -1;
+	_mismatches.clear();
+	_time = 0;
+}
+
+boolean DW1000Replay::isDone() {
+	return _offset >= _length;
+}
+
+unsigned long DW1000Replay::getTransferCount() {
+	return _transfers;
+}
+
+unsigned long DW1000Replay::getReadCount() {
+	return _reads;
+}
+
+unsigned long DW1000Replay::getWriteCount() {
+	return _writes;
+}
+
+unsigned long DW1000Replay::getMismatchCount() {
+	return _mismatchCount;
+}
+
+long DW1000Replay::getFirstMismatch() {
+	return _firstMismatch;
+}
+
+const std::vector<std::string>& DW1000Replay::getMismatches() {
+	return _mismatches;
+}
+
+uint64_t DW1000Replay::getTime() {
+	return _time;
+}
+
+void DW1000Replay::handleTransfer(void* context, boolean write, byte header[], int headerLen, byte data[], int n) {
+	((DW1000Replay*)context)->replay(write, header, headerLen, data, n);
+}
+
+/*
+ * Matches one transfer against the next record. The records are consumed
+ * in lockstep, a differing transfer still consumes its record, so a single
+ * difference does not shift the rest of the replay.
+ */
+void DW1000Replay::replay(boolean write, byte header[], int headerLen, byte data[], int n) {
+	DW1000TraceRecord record;
+	unsigned int next;
+	int i;
+
+	if(write) {
+		_writes++;
+	} else {
+		_reads++;
+	}
+	next = DW1000Trace::decode(_trace, _length, _offset, &record);
+	if(next == 0) {
+		mismatch(describe(header, headerLen) + " after the end of the trace");
+		_offset = _length;
+		_transfers++;
+		return;
+	}
+	_offset = next;
+	_time += record.time;
+
+	if(record.headerLen != headerLen || memcmp(record.header, header, headerLen) != 0) {
+		mismatch(describe(header, headerLen) + ", recorded " + describe(record.header, record.headerLen));
+	} else if(record.length != n) {
+		std::ostringstream what;
+		what << describe(header, headerLen) << ", " << n << " bytes, recorded " << record.length;
+		mismatch(what.str());
+	} else if(write && memcmp(record.data, data, n) != 0) {
+		std::ostringstream what;
+		for(i = 0; record.data[i] == data[i]; i++);
+		what << describe(header, headerLen) << ", byte " << i << std::hex << std::setfill('0')
+			<< " 0x" << std::setw(2) << (int)data[i] << ", recorded 0x" << std::setw(2) << (int)record.data[i];
+		mismatch(what.str());
+	}
+	// serve the recorded data, as far as there is
+	if(!write && !record.write) {
+		memcpy(data, record.data, record.length < n ? record.length : n);
+	}
+	_transfers++;
+}
+
+void DW1000Replay::mismatch(const std::string& what) {
+	if(_firstMismatch < 0) {
+		_firstMismatch = (long)_transfers;
+	}
+	_mismatchCount++;
+	if(_mismatches.size() < REPLAY_MAX_MISMATCHES) {
+		std::ostringstream line;
+		line << "transfer " << _transfers << " at " << _time << "us: " << what;
+		_mismatches.push_back(line.str());
+	}
+}
+
+/*
+ * Direction, register and sub-address of a SPI header, e.g. "write 0x0D" or
+ * "read 0x2E:0x1806".
+ */
+std::string DW1000Replay::describe(const byte header[], int headerLen) {
+	std::ostringstream text;
+	word sub = 0;
+
+	text << ((header[0] & 0x80) != 0 ? "write" : "read") << " 0x" << std::hex << std::setfill('0')
+		<< std::setw(2) << (int)(header[0] & 0x3F);
+	if(headerLen > 1) {
+		sub = header[1] & 0x7F;
+		if(headerLen > 2) {
+			sub |= (word)header[2] << 7;
+		}
+		text << ":0x" << std::setw(2) << sub;
+	}
+	return text.str();
+}
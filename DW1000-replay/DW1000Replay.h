@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Host side replay of a recorded SPI trace (DW1000Trace). Attached to a
+ * DW1000 in DEBUG mode, it takes the place of the chip: each transfer of
+ * the library is matched against the next record, reads are served with
+ * the recorded data, writes are compared to the recorded data. Running the
+ * same application code as on the device then reproduces the session
+ * offline, and every difference in the SPI traffic (e.g. after a change of
+ * the library) is reported with its transfer number and recorded time.
+ */
+
+#ifndef _DW1000REPLAY_H_INCLUDED
+#define _DW1000REPLAY_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include "DW1000.h"
+#include "DW1000Trace.h"
+
+// mismatches kept with a description
+#define REPLAY_MAX_MISMATCHES 16
+
+class DW1000Replay {
+public:
+	// replay of the given trace (not copied)
+	DW1000Replay(const byte trace[], unsigned int length);
+
+	// replay all following transfers of a device, takes over its hook
+	void attach(DW1000* dw);
+	void detach();
+	void rewind();
+
+	// all records replayed
+	boolean isDone();
+
+	// replayed transfers, of them reads and writes, and the transfers that
+	// differed from the trace (direction, register, length or written data)
+	unsigned long getTransferCount();
+	unsigned long getReadCount();
+	unsigned long getWriteCount();
+	unsigned long getMismatchCount();
+	// number of the first differing transfer (from 0), -1 if none
+	long getFirstMismatch();
+	const std::vector<std::string>& getMismatches();
+
+	// recorded time of the current transfer in us, since recording started
+	uint64_t getTime();
+
+private:
+	DW1000* _dw;
+	const byte* _trace;
+	unsigned int _length;
+	unsigned int _offset;
+	unsigned long _transfers;
+	unsigned long _reads;
+	unsigned long _writes;
+	unsigned long _mismatchCount;
+	long _firstMismatch;
+	std::vector<std::string> _mismatches;
+	uint64_t _time;
+
+	void replay(boolean write, byte header[], int headerLen, byte data[], int n);
+	void mismatch(const std::string& what);
+	static void handleTransfer(void* context, boolean write, byte header[], int headerLen, byte data[], int n);
+	static std::string describe(const byte header[], int headerLen);
+};
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Multi-node simulation of network discovery (DW1000Discovery). Nodes
+ * power up at random times within the first half second, follow the
+ * coordinator's beacons, contend for the contention slots and switch
+ * their device to the assigned operating profile. Frames are lost
+ * independently per receiver, blinks in the same slot collide. Prints how
+ * the join time grows with the number of nodes.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include "DW1000.h"
+#include "DW1000Discovery.h"
+
+// scenario
+static const double SUPERFRAME = 0.1;			// seconds
+static const double POWER_UP = 0.5;				// nodes power up within, seconds
+static const double LOSS = 0.02;				// frame loss per receiver
+static const int MAX_SUPERFRAMES = 2000;
+// operating profile handed out
+static const word NETWORK = 0xDECA;
+static const byte MODE = 4;
+static const byte CHANNEL = 2;
+
+// airtime model, 6.8Mbps, 16MHz PRF, 128 preamble symbols
+static const double PREAMBLE_SYMBOL = 993.59e-9;
+static const double PHR_BIT = 1.0 / 850e3;
+static const double DATA_BIT = 1.0 / 6.8e6;
+static const double GUARD = 100e-6;				// between frames
+static const double TURNAROUND = 500e-6;		// RX to TX on the host MCU
+
+struct Node {
+	DW1000* dw;
+	DW1000DiscoveryNode* discovery;
+	byte eui[LEN_DISC_EUI];
+	double powerUp;
+	double joined;
+};
+
+static std::mt19937 rng(1000);
+
+/*
+ * Duration of a frame with the given payload (plus CRC-16) on air.
+ */
+static double frameDuration(int payload) {
+	int bits = (payload + 2) * 8;
+	int blocks = (bits + 329) / 330;	// Reed-Solomon, 48 parity bits per block
+
+	return (128 + 8) * PREAMBLE_SYMBOL + 21 * PHR_BIT + (bits + 48 * blocks) * DATA_BIT;
+}
+
+static boolean received() {
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	return uniform(rng) >= LOSS;
+}
+
+static boolean simulate(int numNodes) {
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	DW1000 coordinatorDevice(0);
+	DW1000DiscoveryCoordinator coordinator(&coordinatorDevice, NETWORK, MODE, CHANNEL, 0);
+	std::vector<Node> nodes(numNodes);
+	std::vector<std::vector<int> > slots;
+	std::vector<double> times;
+	byte frame[LEN_DISC_FRAME];
+	byte eui[LEN_DISC_EUI] = {0x01, 0x00, 0x00, 0x00, 0x00, 0x48, 0xDE, 0xAC};
+	long collisions = 0;
+	int joined = 0;
+	int i, k, n, s, superframe;
+	double t, offset;
+
+	for(i = 0; i < numNodes; i++) {
+		eui[0] = (byte)(i & 0xFF);
+		eui[1] = (byte)((i >> 8) & 0xFF);
+		memcpy(nodes[i].eui, eui, LEN_DISC_EUI);
+		nodes[i].dw = new DW1000(i + 1);
+		nodes[i].discovery = new DW1000DiscoveryNode(nodes[i].dw, eui, (unsigned long)rng());
+		nodes[i].discovery->applyDiscoveryProfile();
+		nodes[i].powerUp = uniform(rng) * POWER_UP;
+		nodes[i].joined = -1;
+	}
+
+	for(superframe = 0; superframe < MAX_SUPERFRAMES
+			&& (joined < numNodes || coordinator.getConfirmedCount() < numNodes); superframe++) {
+		t = superframe * SUPERFRAME;
+		n = coordinator.buildBeacon(frame);
+		for(i = 0; i < numNodes; i++) {
+			if(nodes[i].powerUp <= t && received()) {
+				nodes[i].discovery->handleFrame(frame, n);
+			}
+		}
+		offset = frameDuration(LEN_DISC_BEACON) + TURNAROUND;
+
+		// contention, one blink per slot gets through
+		slots.assign(coordinator.getWindow(), std::vector<int>());
+		for(i = 0; i < numNodes; i++) {
+			s = nodes[i].powerUp <= t ? nodes[i].discovery->getBlinkSlot() : -1;
+			if(s >= 0 && s < (int)slots.size()) {
+				slots[s].push_back(i);
+			}
+		}
+		for(s = 0; s < (int)slots.size(); s++) {
+			for(k = 0; k < (int)slots[s].size(); k++) {
+				n = nodes[slots[s][k]].discovery->buildBlink(frame);
+			}
+			if(slots[s].size() == 1 && received()) {
+				coordinator.handleFrame(frame, n);
+			} else if(slots[s].size() > 1) {
+				coordinator.noteCollision();
+				collisions++;
+			}
+		}
+		offset += slots.size() * (frameDuration(LEN_DISC_BLINK) + GUARD);
+
+		// assignments, each confirmed right away; repeated ones (lost
+		// assignment or confirmation) reach listening and joined nodes too
+		while(coordinator.hasAssignment()) {
+			n = coordinator.getAssignment(frame);
+			offset += frameDuration(LEN_DISC_ASSIGN) + GUARD;
+			for(i = 0; i < numNodes; i++) {
+				DW1000DiscoveryNode* d = nodes[i].discovery;
+				if(nodes[i].powerUp > t || !received()) {
+					continue;
+				}
+				d->handleFrame(frame, n);
+				if(!d->hasConfirm()) {
+					continue;
+				}
+				if(nodes[i].joined < 0) {
+					nodes[i].joined = t + offset;
+					joined++;
+					d->applyProfile();
+				}
+				byte confirm[LEN_DISC_CONFIRM];
+				int m = d->buildConfirm(confirm);
+				if(received()) {
+					coordinator.handleFrame(confirm, m);
+				}
+			}
+			offset += TURNAROUND + frameDuration(LEN_DISC_CONFIRM) + GUARD;
+		}
+	}
+
+	// joined nodes on the operating channel with the address of their
+	// table entry
+	long attempts = 0;
+	int consistent = 0;
+	for(i = 0; i < numNodes; i++) {
+		DW1000DiscoveryNode* d = nodes[i].discovery;
+		if(nodes[i].joined >= 0) {
+			times.push_back(nodes[i].joined - nodes[i].powerUp);
+			if(nodes[i].dw->getChannel() == CHANNEL
+					&& d->getAddress() == coordinator.getNodeAddress(coordinator.findNode(nodes[i].eui))) {
+				consistent++;
+			}
+		}
+		attempts += d->getAttempts();
+		delete d;
+		delete nodes[i].dw;
+	}
+
+	std::sort(times.begin(), times.end());
+	double sum = 0;
+	for(size_t j = 0; j < times.size(); j++) {
+		sum += times[j];
+	}
+	double mean = times.empty() ? 0 : sum / times.size();
+	double p95 = times.empty() ? 0 : times[(times.size() * 95) / 100];
+	double last = times.empty() ? 0 : times.back();
+
+	std::cout << std::setw(5) << numNodes
+		<< std::setw(8) << joined
+		<< std::setw(11) << coordinator.getConfirmedCount()
+		<< std::setw(13) << superframe
+		<< std::setw(11) << std::fixed << std::setprecision(0) << mean * 1000
+		<< std::setw(10) << p95 * 1000
+		<< std::setw(10) << last * 1000
+		<< std::setw(13) << std::setprecision(2) << (double)attempts / numNodes
+		<< std::setw(12) << collisions
+		<< std::setw(9) << consistent << std::endl;
+	// coordinator and nodes agree on every node
+	return joined == numNodes && coordinator.getConfirmedCount() == joined && consistent == joined;
+}
+
+int main() {
+	int counts[] = {4, 8, 16, 32, 64, 128};
+	size_t i;
+
+	std::cout << "nodes  joined  confirmed  superframes  mean [ms]  p95 [ms]  max [ms]"
+		<< "  blinks/node  collisions  profile" << std::endl;
+	boolean ok = true;
+
+	for(i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		if(!simulate(counts[i])) {
+			ok = false;
+		}
+	}
+	if(!ok) {
+		std::cout << "mismatch: not all nodes joined and confirmed" << std::endl;
+	}
+	return ok ? 0 : 1;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O2 -DDEBUG -DDW1000_DISCOVERY_NODES=128 -I../DW1000 ../DW1000/DW1000*.cpp DW1000-discovery-simulation.cpp -o /tmp/DW1000-discovery-sim.o; /tmp/DW1000-discovery-sim.o
+
+ *
+ * to compile and run it. Join times are from power-up to the assignment;
+ * profile counts the joined nodes that switched to the operating channel
+ * with the address the coordinator keeps for them. Fails unless all nodes
+ * joined and the coordinator has a confirmation from each of them.
+ */
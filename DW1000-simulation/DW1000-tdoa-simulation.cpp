@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Multi-node simulation of the TDoA anchor pipeline (DW1000TDoA). Anchors
+ * with drifting, noisy clocks follow a reference anchor's sync beacons and
+ * report tag blinks; a gateway solves the tag positions from the reports.
+ * Prints the position error and the channel capacity (TDoA vs. two-way
+ * ranging) for a growing number of anchors.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include "DW1000.h"
+#include "DW1000TDoA.h"
+#include "DW1000Solver.h"
+
+// timestamp units per second and meters per timestamp unit
+static const double TICKS_PER_SECOND = 499.2e6 * 128.0;
+static const double METERS_PER_TICK = 299792458.0 / TICKS_PER_SECOND;
+
+// scenario
+static const double AREA = 30.0;				// square area, meters
+static const int TAGS = 20;
+static const double DURATION = 3.0;				// seconds
+static const double SYNC_INTERVAL = 0.1;		// seconds, also blink interval
+static const double WARMUP = 0.35;				// no fixes until synchronized
+static const double CLOCK_SKEW_PPM = 20.0;		// max. crystal offset
+static const double STAMP_NOISE = 10.0;			// timestamp noise, std.dev. units
+
+// airtime model, 6.8Mbps, 16MHz PRF, 128 preamble symbols
+static const double PREAMBLE_SYMBOL = 993.59e-9;
+static const double PHR_BIT = 1.0 / 850e3;
+static const double DATA_BIT = 1.0 / 6.8e6;
+static const double GUARD = 100e-6;				// between frames
+static const double TURNAROUND = 500e-6;		// RX to TX on the host MCU
+
+struct Point {
+	double x, y;
+};
+
+struct Anchor {
+	Point pos;
+	DW1000* dw;
+	DW1000TDoA* tdoa;
+	double start;	// clock value at t=0
+	double skew;	// relative rate offset
+};
+
+static std::mt19937 rng(1000);
+
+static double distance(Point a, Point b) {
+	return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+static int64_t localTime(Anchor& a, double t) {
+	std::normal_distribution<double> noise(0.0, STAMP_NOISE);
+	double ticks = a.start + t * TICKS_PER_SECOND * (1.0 + a.skew) + noise(rng);
+	return (int64_t)std::fmod(std::floor(ticks), (double)DW1000::TIME_OVERFLOW);
+}
+
+/*
+ * Duration of a frame with the given payload (plus CRC-16) on air.
+ */
+static double frameDuration(int payload) {
+	int bits = (payload + 2) * 8;
+	int blocks = (bits + 329) / 330;	// Reed-Solomon, 48 parity bits per block
+
+	return (128 + 8) * PREAMBLE_SYMBOL + 21 * PHR_BIT + (bits + 48 * blocks) * DATA_BIT;
+}
+
+static void simulate(int numAnchors) {
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::vector<Anchor> anchors(numAnchors);
+	std::vector<Point> tags(TAGS);
+	// (tag, seq) -> reference time per anchor
+	std::map<std::pair<word, int>, std::map<int, int64_t> > arrivals;
+	std::map<std::pair<word, int>, Point> truth;
+	DW1000Solver solver((int)(TAGS * (DURATION / SYNC_INTERVAL) + 1));
+	std::vector<double> errors;
+	byte frame[LEN_TDOA_SYNC];
+	byte report[LEN_TDOA_REPORT];
+	long reportBytes = 0;
+	word dropped = 0;
+	int64_t lastSyncTx = 0;
+	double t, slot;
+	int i, k, n, round, syncSeq = 0;
+
+	// anchors around the perimeter, anchor 0 is the reference
+	for(i = 0; i < numAnchors; i++) {
+		double s = 4.0 * AREA * i / numAnchors;
+		Anchor& a = anchors[i];
+		if(s < AREA) {
+			a.pos.x = s; a.pos.y = 0;
+		} else if(s < 2 * AREA) {
+			a.pos.x = AREA; a.pos.y = s - AREA;
+		} else if(s < 3 * AREA) {
+			a.pos.x = 3 * AREA - s; a.pos.y = AREA;
+		} else {
+			a.pos.x = 0; a.pos.y = 4 * AREA - s;
+		}
+		a.dw = new DW1000(i);
+		a.tdoa = new DW1000TDoA(a.dw, (word)(i + 1), 1);
+		a.tdoa->setReferenceTimeOfFlight((int64_t)std::llround(
+			distance(a.pos, anchors[0].pos) / METERS_PER_TICK));
+		solver.addAnchor((word)(i + 1), (float)a.pos.x, (float)a.pos.y, 0.0f);
+		a.start = uniform(rng) * DW1000::TIME_OVERFLOW;
+		a.skew = (2.0 * uniform(rng) - 1.0) * CLOCK_SKEW_PPM * 1e-6;
+	}
+	for(k = 0; k < TAGS; k++) {
+		tags[k].x = 2.0 + uniform(rng) * (AREA - 4.0);
+		tags[k].y = 2.0 + uniform(rng) * (AREA - 4.0);
+	}
+
+	// one sync beacon followed by one blink per tag in each round
+	slot = SYNC_INTERVAL / (TAGS + 1);
+	for(round = 0; round * SYNC_INTERVAL < DURATION; round++) {
+		t = round * SYNC_INTERVAL;
+		n = DW1000TDoA::buildSync(frame, 1, (byte)syncSeq++, lastSyncTx);
+		for(i = 1; i < numAnchors; i++) {
+			anchors[i].tdoa->handleFrame(frame, n,
+				localTime(anchors[i], t + distance(anchors[i].pos, anchors[0].pos) / 299792458.0));
+		}
+		lastSyncTx = localTime(anchors[0], t);
+
+		for(k = 0; k < TAGS; k++) {
+			double tx = t + (k + 1) * slot;
+			word tag = (word)(0x100 + k);
+			n = DW1000TDoA::buildBlink(frame, tag, (byte)round);
+			truth[std::make_pair(tag, round)] = tags[k];
+			for(i = 0; i < numAnchors; i++) {
+				Anchor& a = anchors[i];
+				a.tdoa->handleFrame(frame, n, localTime(a, tx + distance(a.pos, tags[k]) / 299792458.0));
+				if(a.tdoa->hasReport()) {
+					reportBytes += a.tdoa->getReport(report);
+					// gateway side: decode the report
+					for(int r = 0; r < DW1000TDoA::getReportCount(report); r++) {
+						word rtag;
+						byte rseq;
+						int64_t rtime;
+						DW1000TDoA::getReportRecord(report, r, &rtag, &rseq, &rtime);
+						arrivals[std::make_pair(rtag, (int)rseq)][DW1000TDoA::getReportAnchor(report) - 1] = rtime;
+					}
+				}
+			}
+		}
+	}
+	for(i = 0; i < numAnchors; i++) {
+		int m = anchors[i].tdoa->getReport(report);
+		reportBytes += m;
+		for(int r = 0; m > 0 && r < DW1000TDoA::getReportCount(report); r++) {
+			word rtag;
+			byte rseq;
+			int64_t rtime;
+			DW1000TDoA::getReportRecord(report, r, &rtag, &rseq, &rtime);
+			arrivals[std::make_pair(rtag, (int)rseq)][i] = rtime;
+		}
+	}
+
+	// solve every blink seen by all anchors after the warm-up, as one batch
+	for(std::map<std::pair<word, int>, std::map<int, int64_t> >::iterator it = arrivals.begin();
+			it != arrivals.end(); ++it) {
+		if((int)it->second.size() < numAnchors || it->first.second * SYNC_INTERVAL < WARMUP) {
+			continue;
+		}
+		for(i = 0; i < numAnchors; i++) {
+			solver.addArrival(DW1000Solver::reportFix(it->first.first, (byte)it->first.second),
+				(word)(i + 1), it->second[i]);
+		}
+	}
+	solver.solveTDoA(10);
+	for(k = 0; k < solver.getCount(); k++) {
+		unsigned long fix = solver.getFix(k);
+		Point p = {solver.getX(k), solver.getY(k)};
+		Point q = truth[std::make_pair((word)(fix >> 8), (int)(fix & 0xFF))];
+		errors.push_back(distance(p, q));
+	}
+
+	for(i = 0; i < numAnchors; i++) {
+		dropped += anchors[i].tdoa->getDroppedCount();
+		delete anchors[i].tdoa;
+		delete anchors[i].dw;
+	}
+
+	// error statistics
+	double sum = 0;
+	std::sort(errors.begin(), errors.end());
+	for(size_t e = 0; e < errors.size(); e++) {
+		sum += errors[e] * errors[e];
+	}
+	double rmse = errors.empty() ? 0 : std::sqrt(sum / errors.size());
+	double p95 = errors.empty() ? 0 : errors[(errors.size() * 95) / 100];
+	// channel capacity: a blink per fix vs. three messages per anchor
+	double tdoaRate = 1.0 / (frameDuration(LEN_TDOA_BLINK) + GUARD);
+	double twrRate = 1.0 / (numAnchors * (3 * frameDuration(12) + 2 * TURNAROUND + GUARD));
+	double fixes = (double)TAGS * (DURATION / SYNC_INTERVAL);
+
+	std::cout << std::setw(7) << numAnchors
+		<< std::setw(7) << errors.size()
+		<< std::setw(11) << std::fixed << std::setprecision(1) << rmse * 100
+		<< std::setw(10) << p95 * 100
+		<< std::setw(12) << std::setprecision(0) << tdoaRate
+		<< std::setw(11) << twrRate
+		<< std::setw(16) << std::setprecision(1) << reportBytes / fixes
+		<< std::setw(9) << dropped << std::endl;
+}
+
+int main() {
+	int counts[] = {4, 6, 8, 12, 16};
+	size_t i;
+
+	std::cout << "anchors  fixes  rmse [cm]  p95 [cm]  tdoa [1/s]  twr [1/s]  report [B/fix]  dropped" << std::endl;
+	for(i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		simulate(counts[i]);
+	}
+	return 0;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O2 -DDEBUG -I../DW1000 -I../DW1000-solver ../DW1000/DW1000*.cpp ../DW1000-solver/DW1000Solver.cpp DW1000-tdoa-simulation.cpp -o /tmp/DW1000-tdoa-sim.o; /tmp/DW1000-tdoa-sim.o
+
+ *
+ * to compile and run it. Dropped blinks are those received before an anchor
+ * synchronized to the reference.
+ */
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A typical small application for the footprint report of size-check.sh:
+ * initialization, a fixed mode on channel 5, one frame out and one frame
+ * in. SIZE_SOLVER sets the receiver up with configureReceiver() instead of
+ * setDefaultMode(), SIZE_HOPPING adds channel hopping. Built without
+ * hardware (DEBUG), the device is a global as in a sketch so that its RAM
+ * shows up in bss.
+ */
+
+#include "DW1000.h"
+#ifdef SIZE_HOPPING
+#include "DW1000Hopping.h"
+#endif
+
+DW1000 dw(10);
+
+int main() {
+	byte frame[16] = {0x41, 0x88, 0x00, 0xCA, 0xDE, 0x02, 0x00, 0x01, 0x00};
+	int n;
+
+	dw.initialize();
+#ifdef SIZE_SOLVER
+	dw.configureReceiver(DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+		DW1000::TX_PREAMBLE_LEN_128, 5, 0);
+#else
+	dw.setDefaultMode(2);
+	dw.setRFChannel(5);
+#endif
+#ifdef SIZE_HOPPING
+	DW1000Hopping hopping(&dw);
+	hopping.retune(5);
+#endif
+
+	dw.newTransmit();
+	dw.setDefaults();
+	dw.setData(frame, 12);
+	dw.startTransmit();
+
+	dw.newReceive();
+	dw.setDefaults();
+	dw.startReceive();
+	n = dw.isReceiveSuccess() ? dw.getData(frame, sizeof(frame)) : 0;
+	dw.clearReceiveStatus();
+	return n;
+}
+
+/*
+ * Using something like
+ *
+
+sh size-check.sh
+
+ *
+ * (see there) to build it in several configurations and report the sizes.
+ */
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+# Decawave DW1000 library for Arduino.
+#
+# This file is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License version 2 as
+# published by the Free Software Foundation.
+#
+# Flash and RAM of DW1000-size.cpp with the library in several feature
+# configurations (see DW1000/DW1000Config.h), built without hardware
+# (DEBUG) and with unused sections dropped like the Arduino IDE does.
+# flash is text plus data, RAM data plus bss. The host compiler by
+# default; for the numbers of an ATmega328 use something like
+#
+#   CXX=avr-g++ SIZE=avr-size TARGET="-mmcu=atmega328p" sh size-check.sh
+#
+
+CXX=${CXX:-g++}
+SIZE=${SIZE:-size}
+TARGET=${TARGET:-}
+OUT=${OUT:-/tmp/DW1000-size}
+DIR=$(dirname "$0")
+LIB="$DIR/../DW1000"
+
+MINIMAL='-DDW1000_CHANNELS=DW1000_CHANNEL(5) -DDW1000_PRFS=DW1000_PRF_16MHZ'
+
+# name, then compiler flags
+check() {
+	name=$1
+	shift
+	if ! $CXX $TARGET -Os -DDEBUG -ffunction-sections -fdata-sections -Wl,--gc-sections \
+			"$@" -I"$LIB" "$LIB"/DW1000*.cpp "$DIR/DW1000-size.cpp" -o "$OUT" 2> "$OUT.log"; then
+		echo "$name: build failed, see $OUT.log"
+		status=1
+		return
+	fi
+	$SIZE "$OUT" | awk -v name="$name" 'NR == 2 {
+		printf "%-28s %8d %8d %8d %8d %8d\n", name, $1, $2, $3, $1 + $2, $2 + $3 }'
+}
+
+status=0
+printf "%-28s %8s %8s %8s %8s %8s\n" configuration text data bss flash RAM
+check "all (default)"
+check "all, 128 byte debugBuffer" -DDW1000_DEBUG_BUFFER=128
+check "ch 5, 16MHz, mode 2" $MINIMAL '-DDW1000_MODES=DW1000_MODE(2)'
+check "ch 5, 16MHz, solver" $MINIMAL -DDW1000_MODES=0 -DSIZE_SOLVER
+check "ch 5, 16MHz, solver, 128 B" $MINIMAL -DDW1000_MODES=0 -DSIZE_SOLVER -DDW1000_DEBUG_BUFFER=128
+check "all, hopping" -DSIZE_HOPPING
+check "ch 5 and 7, 16MHz, hopping" '-DDW1000_CHANNELS=DW1000_CHANNEL(5)|DW1000_CHANNEL(7)' \
+	-DDW1000_PRFS=DW1000_PRF_16MHZ '-DDW1000_MODES=DW1000_MODE(2)' -DSIZE_HOPPING
+rm -f "$OUT" "$OUT.log"
+exit $status
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Throughput benchmark of the batched position solver (DW1000Solver) on a
+ * single core, for two-way ranging and TDoA inputs and different batch
+ * sizes. Batch size 1 corresponds to solving tag by tag.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include "DW1000.h"
+#include "DW1000Solver.h"
+
+static const int ANCHORS = 8;
+static const int FIXES = 20000;
+static const int ITERATIONS = 8;
+static const float AREA = 30.0f;
+static const float RANGE_NOISE = 0.05f;		// meters, std.dev.
+
+static float ax[ANCHORS], ay[ANCHORS], az[ANCHORS];
+static std::vector<float> tagX(FIXES), tagY(FIXES);
+// measurements per fix and anchor: distance (ranging), arrival (TDoA)
+static std::vector<int64_t> tofs(FIXES * ANCHORS), arrivals(FIXES * ANCHORS);
+
+static void generate() {
+	std::mt19937 rng(1000);
+	std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+	std::normal_distribution<float> noise(0.0f, RANGE_NOISE);
+	int i, j;
+
+	for(j = 0; j < ANCHORS; j++) {
+		float angle = 2.0f * 3.14159265f * j / ANCHORS;
+		ax[j] = AREA / 2 + AREA / 2 * std::cos(angle);
+		ay[j] = AREA / 2 + AREA / 2 * std::sin(angle);
+		az[j] = (j % 2) ? 2.5f : 3.0f;
+	}
+	for(i = 0; i < FIXES; i++) {
+		// blink emission time, arbitrary in the reference time base
+		int64_t emitted = (int64_t)(uniform(rng) * DW1000::TIME_OVERFLOW);
+		tagX[i] = 2.0f + uniform(rng) * (AREA - 4.0f);
+		tagY[i] = 2.0f + uniform(rng) * (AREA - 4.0f);
+		for(j = 0; j < ANCHORS; j++) {
+			float dx = tagX[i] - ax[j], dy = tagY[i] - ay[j], dz = 1.0f - az[j];
+			float d = std::sqrt(dx * dx + dy * dy + dz * dz) + noise(rng);
+			int64_t tof = (int64_t)(d / DW1000Solver::METERS_PER_TICK);
+			tofs[i * ANCHORS + j] = tof;
+			arrivals[i * ANCHORS + j] = (emitted + tof) % DW1000::TIME_OVERFLOW;
+		}
+	}
+}
+
+static void run(int batch, boolean tdoa) {
+	DW1000Solver solver(batch);
+	std::chrono::steady_clock::time_point start, end;
+	double seconds, sum = 0;
+	int i, j, k, base;
+
+	for(j = 0; j < ANCHORS; j++) {
+		solver.addAnchor((word)(j + 1), ax[j], ay[j], az[j]);
+	}
+	solver.setTagHeight(1.0f);
+
+	start = std::chrono::steady_clock::now();
+	for(base = 0; base < FIXES; base += batch) {
+		solver.clear();
+		for(i = base; i < base + batch && i < FIXES; i++) {
+			for(j = 0; j < ANCHORS; j++) {
+				if(tdoa) {
+					solver.addArrival(i, (word)(j + 1), arrivals[i * ANCHORS + j]);
+				} else {
+					solver.addRange(i, (word)(j + 1), tofs[i * ANCHORS + j]);
+				}
+			}
+		}
+		if(tdoa) {
+			solver.solveTDoA(ITERATIONS);
+		} else {
+			solver.solveRanges(ITERATIONS);
+		}
+		for(k = 0; k < solver.getCount(); k++) {
+			float dx = solver.getX(k) - tagX[solver.getFix(k)];
+			float dy = solver.getY(k) - tagY[solver.getFix(k)];
+			sum += dx * dx + dy * dy;
+		}
+	}
+	end = std::chrono::steady_clock::now();
+	seconds = std::chrono::duration<double>(end - start).count();
+
+	std::cout << std::setw(6) << (tdoa ? "tdoa" : "twr")
+		<< std::setw(8) << batch
+		<< std::setw(14) << std::fixed << std::setprecision(0) << FIXES / seconds
+		<< std::setw(12) << std::setprecision(1) << std::sqrt(sum / FIXES) * 100 << std::endl;
+}
+
+int main() {
+	int batches[] = {1, 64, 1024, 8192};
+	size_t b;
+
+	generate();
+	std::cout << ANCHORS << " anchors, " << FIXES << " fixes, " << ITERATIONS << " iterations" << std::endl;
+	std::cout << "  mode   batch  fixes/second   rmse [cm]" << std::endl;
+	for(b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+		run(batches[b], false);
+	}
+	for(b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+		run(batches[b], true);
+	}
+	return 0;
+}
+
+/*
+ * Using something like
+ *
+
+g++ -O3 -march=native -fno-math-errno -DDEBUG -I../DW1000 -I. ../DW1000/DW1000*.cpp DW1000Solver.cpp DW1000-solver-benchmark.cpp -o /tmp/DW1000-solver-bench.o; /tmp/DW1000-solver-bench.o
+
+ *
+ * to compile and run it. -fno-math-errno lets the compiler vectorize sqrt.
+ */
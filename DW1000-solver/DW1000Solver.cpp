@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <cmath>
+#include "DW1000Solver.h"
+
+const float DW1000Solver::METERS_PER_TICK = 299792458.0f / (499.2e6f * 128.0f);
+
+/* ###########################################################################
+ * #### Construction and init ################################################
+ * ######################################################################### */
+
+DW1000Solver::DW1000Solver(int capacity) :
+		_fix(capacity), _measurements(capacity), _firstArrival(capacity),
+		_x(capacity), _y(capacity),
+		_mx(SOLVER_MAX_ANCHORS * capacity), _my(SOLVER_MAX_ANCHORS * capacity),
+		_mz(SOLVER_MAX_ANCHORS * capacity), _value(SOLVER_MAX_ANCHORS * capacity),
+		_weight(SOLVER_MAX_ANCHORS * capacity),
+		_a11(capacity), _a12(capacity), _a22(capacity), _b1(capacity), _b2(capacity) {
+	_capacity = capacity;
+	_count = 0;
+	_slots = 0;
+	_height = 0;
+}
+
+void DW1000Solver::addAnchor(word address, float x, float y, float z) {
+	int idx = findAnchor(address);
+
+	if(idx < 0) {
+		_anchorAddress.push_back(address);
+		_anchorX.push_back(x);
+		_anchorY.push_back(y);
+		_anchorZ.push_back(z);
+	} else {
+		_anchorX[idx] = x;
+		_anchorY[idx] = y;
+		_anchorZ[idx] = z;
+	}
+}
+
+void DW1000Solver::setTagHeight(float z) {
+	_height = z;
+}
+
+/* ###########################################################################
+ * #### Batch input ##########################################################
+ * ######################################################################### */
+
+void DW1000Solver::clear() {
+	int j, i;
+
+	for(j = 0; j < _slots; j++) {
+		for(i = 0; i < _count; i++) {
+			_weight[j * _capacity + i] = 0;
+		}
+	}
+	_index.clear();
+	_count = 0;
+	_slots = 0;
+}
+
+int DW1000Solver::getCount() {
+	return _count;
+}
+
+/*
+ * Add a two-way ranging result.
+ * @param fix
+ *		The fix (e.g. tag address) the measurement belongs to.
+ * @param anchor
+ *		The anchor address.
+ * @param tof
+ *		The time of flight in timestamp units.
+ */
+boolean DW1000Solver::addRange(unsigned long fix, word anchor, int64_t tof) {
+	return addMeasurement(fix, anchor, tof * METERS_PER_TICK, false, 0);
+}
+
+boolean DW1000Solver::addDistance(unsigned long fix, word anchor, float distance) {
+	return addMeasurement(fix, anchor, distance, false, 0);
+}
+
+/*
+ * Add the arrival time of a blink at an anchor, in the time base of the
+ * TDoA reference anchor. The first arrival of a fix is its reference.
+ */
+boolean DW1000Solver::addArrival(unsigned long fix, word anchor, int64_t time) {
+	return addMeasurement(fix, anchor, 0, true, time);
+}
+
+/*
+ * Add all records of a DW1000TDoA report, see reportFix() for the fixes.
+ * Returns the number of records added.
+ */
+int DW1000Solver::addReport(byte report[]) {
+	word anchor = DW1000TDoA::getReportAnchor(report);
+	int count = DW1000TDoA::getReportCount(report);
+	int added = 0;
+	int i;
+	word tag;
+	byte seq;
+	int64_t time;
+
+	for(i = 0; i < count; i++) {
+		DW1000TDoA::getReportRecord(report, i, &tag, &seq, &time);
+		if(addArrival(reportFix(tag, seq), anchor, time)) {
+			added++;
+		}
+	}
+	return added;
+}
+
+unsigned long DW1000Solver::reportFix(word tag, byte seq) {
+	return ((unsigned long)tag << 8) | seq;
+}
+
+/* ###########################################################################
+ * #### Solving ##############################################################
+ * ######################################################################### */
+
+/*
+ * Accumulate the normal equations of one range measurement slot, for all
+ * fixes. Kept free of member access so the loop vectorizes.
+ */
+static void accumulateRanges(int n, float h, const float* __restrict x, const float* __restrict y,
+		const float* __restrict mx, const float* __restrict my, const float* __restrict mz,
+		const float* __restrict v, const float* __restrict w,
+		float* __restrict a11, float* __restrict a12, float* __restrict a22,
+		float* __restrict b1, float* __restrict b2) {
+	int i;
+
+	for(i = 0; i < n; i++) {
+		float dx = x[i] - mx[i];
+		float dy = y[i] - my[i];
+		float dz = h - mz[i];
+		float d = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+		float gx = w[i] * dx / d;
+		float gy = w[i] * dy / d;
+		float r = w[i] * (d - v[i]);
+		a11[i] += gx * gx;
+		a12[i] += gx * gy;
+		a22[i] += gy * gy;
+		b1[i] += gx * r;
+		b2[i] += gy * r;
+	}
+}
+
+/*
+ * Same for one range difference slot, relative to the reference slot
+ * (distance d0 and unit vector g0x, g0y).
+ */
+static void accumulateDifferences(int n, float h, const float* __restrict x, const float* __restrict y,
+		const float* __restrict mx, const float* __restrict my, const float* __restrict mz,
+		const float* __restrict v, const float* __restrict w,
+		const float* __restrict d0, const float* __restrict g0x, const float* __restrict g0y,
+		float* __restrict a11, float* __restrict a12, float* __restrict a22,
+		float* __restrict b1, float* __restrict b2) {
+	int i;
+
+	for(i = 0; i < n; i++) {
+		float dx = x[i] - mx[i];
+		float dy = y[i] - my[i];
+		float dz = h - mz[i];
+		float d = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+		float gx = w[i] * (dx / d - g0x[i]);
+		float gy = w[i] * (dy / d - g0y[i]);
+		float r = w[i] * ((d - d0[i]) - v[i]);
+		a11[i] += gx * gx;
+		a12[i] += gx * gy;
+		a22[i] += gy * gy;
+		b1[i] += gx * r;
+		b2[i] += gy * r;
+	}
+}
+
+/*
+ * Multilateration: minimize the squared range residuals of every fix.
+ */
+void DW1000Solver::solveRanges(int iterations) {
+	int it, j, k;
+
+	initialGuess();
+	for(it = 0; it < iterations; it++) {
+		clearNormals();
+		for(j = 0; j < _slots; j++) {
+			k = j * _capacity;
+			accumulateRanges(_count, _height, &_x[0], &_y[0],
+				&_mx[k], &_my[k], &_mz[k], &_value[k], &_weight[k],
+				&_a11[0], &_a12[0], &_a22[0], &_b1[0], &_b2[0]);
+		}
+		update();
+	}
+}
+
+/*
+ * Hyperbolic positioning: minimize the squared residuals of the range
+ * differences to the first (reference) arrival of every fix.
+ */
+void DW1000Solver::solveTDoA(int iterations) {
+	int it, j, k, i;
+	int n = _count;
+	std::vector<float> d0(n + 1), g0x(n + 1), g0y(n + 1);
+
+	initialGuess();
+	for(it = 0; it < iterations; it++) {
+		clearNormals();
+		// reference slot
+		for(i = 0; i < n; i++) {
+			float dx = _x[i] - _mx[i];
+			float dy = _y[i] - _my[i];
+			float dz = _height - _mz[i];
+			d0[i] = std::sqrt(dx * dx + dy * dy + dz * dz) + 1e-6f;
+			g0x[i] = dx / d0[i];
+			g0y[i] = dy / d0[i];
+		}
+		for(j = 1; j < _slots; j++) {
+			k = j * _capacity;
+			accumulateDifferences(n, _height, &_x[0], &_y[0],
+				&_mx[k], &_my[k], &_mz[k], &_value[k], &_weight[k],
+				&d0[0], &g0x[0], &g0y[0],
+				&_a11[0], &_a12[0], &_a22[0], &_b1[0], &_b2[0]);
+		}
+		update();
+	}
+}
+
+/* ###########################################################################
+ * #### Results ##############################################################
+ * ######################################################################### */
+
+unsigned long DW1000Solver::getFix(int i) {
+	return _fix[i];
+}
+
+int DW1000Solver::getMeasurementCount(int i) {
+	return _measurements[i];
+}
+
+/*
+ * 2D positions need three ranges, or three arrivals (two differences).
+ */
+boolean DW1000Solver::isValid(int i) {
+	return i >= 0 && i < _count && _measurements[i] >= 3;
+}
+
+float DW1000Solver::getX(int i) {
+	return _x[i];
+}
+
+float DW1000Solver::getY(int i) {
+	return _y[i];
+}
+
+/* ###########################################################################
+ * #### Helper functions #####################################################
+ * ######################################################################### */
+
+int DW1000Solver::findAnchor(word address) {
+	size_t i;
+
+	for(i = 0; i < _anchorAddress.size(); i++) {
+		if(_anchorAddress[i] == address) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+int DW1000Solver::findOrAddFix(unsigned long fix) {
+	std::map<unsigned long, int>::iterator it;
+	int i;
+
+	// measurements of a fix usually arrive together
+	if(_count > 0 && _fix[_count - 1] == fix) {
+		return _count - 1;
+	}
+	it = _index.find(fix);
+	if(it != _index.end()) {
+		return it->second;
+	}
+	if(_count >= _capacity) {
+		return -1;
+	}
+	i = _count++;
+	_fix[i] = fix;
+	_measurements[i] = 0;
+	_index[fix] = i;
+	return i;
+}
+
+/*
+ * Store a measurement in the next free slot of the fix.
+ * @param value
+ *		The distance in meters (ranging).
+ * @param isArrival
+ *		Whether this is a TDoA arrival, stored relative to the first one.
+ * @param arrival
+ *		The arrival time (TDoA).
+ */
+boolean DW1000Solver::addMeasurement(unsigned long fix, word anchor, float value, boolean isArrival, int64_t arrival) {
+	int a = findAnchor(anchor);
+	int i, slot;
+	int64_t diff;
+
+	if(a < 0) {
+		return false;
+	}
+	i = findOrAddFix(fix);
+	if(i < 0 || _measurements[i] >= SOLVER_MAX_ANCHORS) {
+		return false;
+	}
+	slot = _measurements[i]++;
+	if(slot >= _slots) {
+		_slots = slot + 1;
+	}
+	if(isArrival && slot == 0) {
+		_firstArrival[i] = arrival;
+	} else if(isArrival) {
+		// arrival relative to the reference, taking the wrap-around into account
+		diff = arrival - _firstArrival[i];
+		if(diff > DW1000::TIME_OVERFLOW / 2) {
+			diff -= DW1000::TIME_OVERFLOW;
+		} else if(diff < -DW1000::TIME_OVERFLOW / 2) {
+			diff += DW1000::TIME_OVERFLOW;
+		}
+		value = diff * METERS_PER_TICK;
+	}
+	_mx[slot * _capacity + i] = _anchorX[a];
+	_my[slot * _capacity + i] = _anchorY[a];
+	_mz[slot * _capacity + i] = _anchorZ[a];
+	_value[slot * _capacity + i] = value;
+	_weight[slot * _capacity + i] = 1.0f;
+	return true;
+}
+
+/*
+ * Start at the centroid of the anchors involved in each fix.
+ */
+void DW1000Solver::initialGuess() {
+	int j, i;
+	int n = _count;
+
+	for(i = 0; i < n; i++) {
+		_x[i] = 0;
+		_y[i] = 0;
+	}
+	for(j = 0; j < _slots; j++) {
+		const float* mx = &_mx[j * _capacity];
+		const float* my = &_my[j * _capacity];
+		const float* w = &_weight[j * _capacity];
+		for(i = 0; i < n; i++) {
+			_x[i] += w[i] * mx[i];
+			_y[i] += w[i] * my[i];
+		}
+	}
+	for(i = 0; i < n; i++) {
+		float m = _measurements[i] > 0 ? (float)_measurements[i] : 1.0f;
+		_x[i] /= m;
+		_y[i] /= m;
+	}
+}
+
+void DW1000Solver::clearNormals() {
+	int i;
+
+	for(i = 0; i < _count; i++) {
+		_a11[i] = 0;
+		_a12[i] = 0;
+		_a22[i] = 0;
+		_b1[i] = 0;
+		_b2[i] = 0;
+	}
+}
+
+/*
+ * Gauss-Newton step from the 2x2 normal equations, skipped (branch-free)
+ * where they are singular.
+ */
+void DW1000Solver::update() {
+	int i;
+	int n = _count;
+
+	for(i = 0; i < n; i++) {
+		float det = _a11[i] * _a22[i] - _a12[i] * _a12[i];
+		float ok = std::fabs(det) > 1e-9f ? 1.0f : 0.0f;
+		float inv = ok / (det + (1.0f - ok));
+		_x[i] -= inv * (_a22[i] * _b1[i] - _a12[i] * _b2[i]);
+		_y[i] -= inv * (_a11[i] * _b2[i] - _a12[i] * _b1[i]);
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for Arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Host side (gateway) position solver. Collects two-way ranging results
+ * or TDoA reports of many tags into a batch and solves all of them with
+ * Gauss-Newton iterations at once. The batch is stored as structure of
+ * arrays (one array per measurement slot and quantity), so the loops run
+ * over the fixes of the batch and can be vectorized by the compiler.
+ * Positions are 2D at a known tag height, in meters.
+ */
+
+#ifndef _DW1000SOLVER_H_INCLUDED
+#define _DW1000SOLVER_H_INCLUDED
+
+#include <vector>
+#include <map>
+#include "DW1000.h"
+#include "DW1000TDoA.h"
+
+// measurements per fix
+#define SOLVER_MAX_ANCHORS 16
+
+class DW1000Solver {
+public:
+	// batch of at most capacity fixes
+	DW1000Solver(int capacity);
+
+	// anchors (known positions) and tag height
+	void addAnchor(word address, float x, float y, float z);
+	void setTagHeight(float z);
+
+	// batch input, returns false if the batch or fix is full
+	void clear();
+	int getCount();
+	boolean addRange(unsigned long fix, word anchor, int64_t tof);
+	boolean addDistance(unsigned long fix, word anchor, float distance);
+	boolean addArrival(unsigned long fix, word anchor, int64_t time);
+	int addReport(byte report[]);
+
+	// solve all fixes of the batch
+	void solveRanges(int iterations);
+	void solveTDoA(int iterations);
+
+	// results
+	unsigned long getFix(int i);
+	int getMeasurementCount(int i);
+	boolean isValid(int i);
+	float getX(int i);
+	float getY(int i);
+
+	// fix of a DW1000TDoA report record
+	static unsigned long reportFix(word tag, byte seq);
+
+	// meters per timestamp unit
+	static const float METERS_PER_TICK;
+
+private:
+	int _capacity;
+	int _count;
+	int _slots;
+	float _height;
+
+	// anchors
+	std::vector<word> _anchorAddress;
+	std::vector<float> _anchorX, _anchorY, _anchorZ;
+
+	// per fix
+	std::vector<unsigned long> _fix;
+	std::map<unsigned long, int> _index;
+	std::vector<int> _measurements;
+	std::vector<int64_t> _firstArrival;
+	std::vector<float> _x, _y;
+
+	// per slot and fix (index slot * capacity + fix): anchor position,
+	// measured value (distance or arrival offset) and weight (0 if unused)
+	std::vector<float> _mx, _my, _mz, _value, _weight;
+
+	// normal equations, per fix
+	std::vector<float> _a11, _a12, _a22, _b1, _b2;
+
+	int findAnchor(word address);
+	int findOrAddFix(unsigned long fix);
+	boolean addMeasurement(unsigned long fix, word anchor, float value, boolean isArrival, int64_t arrival);
+	void initialGuess();
+	void clearNormals();
+	void update();
+};
+
+#endif
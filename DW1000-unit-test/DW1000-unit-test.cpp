@@ -12,7 +12,25 @@
 
 #include "QUnit.hpp"
 #include <iostream>
+#include <cmath>
 #include "DW1000.h"
+#include "DW1000Calibration.h"
+#include "DW1000ClockOffset.h"
+#include "DW1000TDoA.h"
+#include "DW1000Radios.h"
+#include "DW1000Operation.h"
+#include "DW1000FrameCounter.h"
+#include "DW1000Trace.h"
+#include "DW1000EventLog.h"
+#include "DW1000Crc.h"
+#include "DW1000Hopping.h"
+#include "DW1000Stats.h"
+#include "DW1000ReceiverConfig.h"
+#include "DW1000Aes.h"
+#include "DW1000Ccm.h"
+#include "DW1000Discovery.h"
+#include "DW1000Coroutine.h"
+#include "DW1000Solver.h"
 
 // std::cout << (static_cast<unsigned int>(dw->debugBuffer[1]) & 0xFF) << std::endl;
 
@@ -27,18 +45,1323 @@ private:
 		QUNIT_IS_EQUAL(0x01, dw->debugBuffer[0] & 0xFF);
 	}
 
+	// TX_FCTRL as last written
+	static void txfctrlTransfer(void* context, boolean write, byte header[], int headerLen, byte data[], int n) {
+		if(write && (header[0] & 0x3F) == TX_FCTRL && headerLen == 1 && n == LEN_TX_FCTRL) {
+			memcpy(context, data, LEN_TX_FCTRL);
+		}
+	}
+
 	void testSetTransmitRate() {
+		byte txfctrl[LEN_TX_FCTRL];
+
+		// SYS_CTRL is written after TX_FCTRL, take TX_FCTRL from the hook
+		dw->setTransferHandler(txfctrlTransfer, txfctrl);
 		dw->clearDebugBuffer();
 		dw->newTransmit();
 		dw->transmitRate(DW1000::TX_RATE_850KBPS);
 		dw->startTransmit();
-		QUNIT_IS_EQUAL(0x01 << 5, dw->debugBuffer[1] & 0xFF);
+		QUNIT_IS_EQUAL(0x01 << 5, txfctrl[1] & 0xFF);
 
 		dw->clearDebugBuffer();
 		dw->newTransmit();
 		dw->transmitRate(0x03);
 		dw->startTransmit();
-		QUNIT_IS_EQUAL(DW1000::TX_RATE_6800KBPS << 5, dw->debugBuffer[1] & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::TX_RATE_6800KBPS << 5, txfctrl[1] & 0xFF);
+		dw->setTransferHandler(NULL, NULL);
+	}
+
+	void testAntennaDelay() {
+		dw->clearDebugBuffer();
+		dw->setAntennaDelay(0x4034, 0x4035);
+		// RX antenna delay is written last
+		QUNIT_IS_EQUAL(0x35, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x40, dw->debugBuffer[1] & 0xFF);
+	}
+
+	void testRegisters() {
+		byte data[LEN_TX_FCTRL] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+		byte frame[200];
+
+		// fields only touch their own bits, also across a byte boundary
+		DW1000Reg::TFLEN::set(data, 0x1F5);
+		QUNIT_IS_EQUAL(0xF5, data[0] & 0xFF);
+		QUNIT_IS_EQUAL(0xFD, data[1] & 0xFF);
+		QUNIT_IS_EQUAL(0x1F5, DW1000Reg::TFLEN::get(data));
+		DW1000Reg::TXBR::set(data, DW1000::TX_RATE_110KBPS);
+		QUNIT_IS_EQUAL(0x9D, data[1] & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::TX_RATE_110KBPS & 0xFF, DW1000Reg::TXBR::get(data) & 0xFF);
+		// merged fields cover the bytes in between
+		QUNIT_IS_EQUAL(1, DW1000Reg::RX_EVENTS::index);
+		QUNIT_IS_EQUAL(3, DW1000Reg::RX_EVENTS::span);
+
+		// repeated settings replace instead of accumulating bits
+		dw->newTransmit();
+		dw->transmitRate(DW1000::TX_RATE_6800KBPS);
+		dw->transmitRate(DW1000::TX_RATE_850KBPS);
+		dw->clearDebugBuffer();
+		dw->transmitFrameLength(300);
+		QUNIT_IS_EQUAL(300 & 0xFF, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL((DW1000::TX_RATE_850KBPS << 5) | 0x01, dw->debugBuffer[1] & 0xFF);
+
+		// extended PHR mode takes frames above 127 bytes, standard mode not
+		memset(frame, 0x5A, sizeof(frame));
+		dw->clearDebugBuffer();
+		dw->setData(frame, sizeof(frame));
+		QUNIT_IS_EQUAL(0x5A, dw->debugBuffer[sizeof(frame) - 1] & 0xFF);
+		dw->transmitFrameLength(127);
+		dw->clearDebugBuffer();
+		dw->setData(frame, sizeof(frame));
+		QUNIT_IS_EQUAL(0x00, dw->debugBuffer[0] & 0xFF);
+
+		// only the bytes of the latched RX events are written
+		dw->clearDebugBuffer();
+		dw->clearReceiveStatus();
+		QUNIT_IS_EQUAL(0xF4, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x27, dw->debugBuffer[1] & 0xFF);
+		QUNIT_IS_EQUAL(0x04, dw->debugBuffer[2] & 0xFF);
+		QUNIT_IS_EQUAL(0x00, dw->debugBuffer[3] & 0xFF);
+	}
+
+	void testTimestamps() {
+		byte stamp[LEN_STAMP] = {0x01, 0x02, 0x03, 0x04, 0xFF};
+		QUNIT_IS_EQUAL(0xFF04030201LL, DW1000::toTimestamp(stamp));
+		QUNIT_IS_EQUAL(0x20, DW1000::timestampDiff(0x10, DW1000::TIME_OVERFLOW - 0x10));
+	}
+
+	void testSpiClock() {
+		QUNIT_IS_EQUAL(DW1000::SPI_CLOCK_SLOW, dw->getSpiClock());
+		// no device answering, stay slow
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(0, dw->initSpiClock() & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::SPI_CLOCK_SLOW, dw->getSpiClock());
+		dw->debugBuffer[0] = 0x30;
+		dw->debugBuffer[1] = 0x01;
+		dw->debugBuffer[2] = 0xCA;
+		dw->debugBuffer[3] = 0xDE;
+		QUNIT_IS_EQUAL(1, dw->initSpiClock() & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::SPI_CLOCK_FAST, dw->getSpiClock());
+	}
+
+	void testInitialize() {
+		QUNIT_IS_EQUAL(0x428E, DW1000::ldeReplicaCoefficient(4, DW1000::TX_RATE_6800KBPS));
+		QUNIT_IS_EQUAL(0x428E >> 3, DW1000::ldeReplicaCoefficient(4, DW1000::TX_RATE_110KBPS));
+		QUNIT_IS_EQUAL(0, DW1000::ldeReplicaCoefficient(25, DW1000::TX_RATE_6800KBPS));
+		// no device answering
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(0, dw->initialize() & 0xFF);
+		dw->debugBuffer[0] = 0x30;
+		dw->debugBuffer[1] = 0x01;
+		dw->debugBuffer[2] = 0xCA;
+		dw->debugBuffer[3] = 0xDE;
+		QUNIT_IS_EQUAL(1, dw->initialize() & 0xFF);
+		// OTP not programmed
+		QUNIT_IS_EQUAL(DW1000::XTAL_TRIM_DEFAULT, dw->getCrystalTrim());
+		// replica coefficient of the preamble code is written last
+		dw->setPreambleCode(9);
+		QUNIT_IS_EQUAL(9, dw->getPreambleCode() & 0xFF);
+		QUNIT_IS_EQUAL(0xF4, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x28, dw->debugBuffer[1] & 0xFF);
+		dw->setPreambleCode(0);
+		QUNIT_IS_EQUAL(9, dw->getPreambleCode() & 0xFF);
+	}
+
+	void testReceiveTimeout() {
+		DW1000Operation op(dw);
+		byte buffer[8];
+
+		// 1ms is 975 units of ~1.026us, written after SYS_CFG
+		dw->setReceiveTimeout(1000);
+		QUNIT_IS_EQUAL(0xCF, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x03, dw->debugBuffer[1] & 0xFF);
+		dw->setReceiveTimeout(100000);
+		QUNIT_IS_EQUAL(0xFF, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(0xFF, dw->debugBuffer[1] & 0xFF);
+		dw->setPreambleDetectTimeout(17);
+		QUNIT_IS_EQUAL(17, dw->debugBuffer[0] & 0xFF);
+
+		// RXRFTO, RXPTO and RXSFDTO
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(0, dw->isReceiveTimeout() & 0xFF);
+		dw->debugBuffer[2] = 0x02;
+		QUNIT_IS_EQUAL(1, dw->isReceiveTimeout() & 0xFF);
+		dw->debugBuffer[2] = 0x20;
+		QUNIT_IS_EQUAL(1, dw->isReceiveTimeout() & 0xFF);
+		dw->debugBuffer[2] = 0x00;
+		dw->debugBuffer[3] = 0x04;
+		QUNIT_IS_EQUAL(1, dw->isReceiveTimeout() & 0xFF);
+
+		// device timeout ends a non-blocking receive before its own timeout
+		op.startReceive(buffer, 8, 5000);
+		op.step(0);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[2] = 0x02;
+		QUNIT_IS_EQUAL(DW1000Operation::OP_TIMEOUT, op.step(10));
+	}
+
+	void testSleep() {
+		dw->setSpiClock(DW1000::SPI_CLOCK_FAST);
+		dw->setAntennaDelay(0x4034, 0x4035);
+		dw->clearDebugBuffer();
+		dw->configureSleep(0);
+		// deep sleep: woken by SPI/WAKEUP pin only
+		QUNIT_IS_EQUAL(0x07, dw->debugBuffer[0] & 0xFF);
+		dw->configureSleep(100);
+		QUNIT_IS_EQUAL(0x0F, dw->debugBuffer[0] & 0xFF);
+		dw->enterSleep();
+		QUNIT_IS_EQUAL(0x02, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(1, dw->isSleeping() & 0xFF);
+		// no device id yet
+		QUNIT_IS_EQUAL(0, dw->wakeUp() & 0xFF);
+		QUNIT_IS_EQUAL(1, dw->isSleeping() & 0xFF);
+		dw->debugBuffer[0] = 0x30;
+		dw->debugBuffer[1] = 0x01;
+		dw->debugBuffer[2] = 0xCA;
+		dw->debugBuffer[3] = 0xDE;
+		QUNIT_IS_EQUAL(1, dw->wakeUp() & 0xFF);
+		QUNIT_IS_EQUAL(0, dw->isSleeping() & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::SPI_CLOCK_FAST, dw->getSpiClock());
+		// antenna delays restored, RX last
+		QUNIT_IS_EQUAL(0x35, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x40, dw->debugBuffer[1] & 0xFF);
+	}
+
+	void testRadios() {
+		int users = DW1000::getSpiUsers();
+		DW1000* second = new DW1000(2);
+		DW1000* third = new DW1000(3);
+		DW1000Radios radios;
+
+		QUNIT_IS_EQUAL(users + 2, DW1000::getSpiUsers());
+		QUNIT_IS_EQUAL(0, radios.addRadio(dw));
+		QUNIT_IS_EQUAL(1, radios.addRadio(second));
+		dw->clearDebugBuffer();
+		second->clearDebugBuffer();
+		// frame received (RXDFR, RXFCG) on the second radio
+		second->debugBuffer[1] = 0x60;
+
+		// polling: one radio per call, round robin
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+		QUNIT_IS_EQUAL(1, radios.poll());
+		QUNIT_IS_EQUAL(DW1000Radios::EVENT_RX_DONE, radios.getEvents(1));
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+		QUNIT_IS_EQUAL(1, radios.poll());
+
+		// IRQ mode: only flagged radios are read
+		radios.useInterrupts(true);
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+		radios.setInterruptPending(1);
+		QUNIT_IS_EQUAL(1, radios.poll());
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+
+		// no service while another radio holds the bus
+		QUNIT_IS_EQUAL(1, radios.lock(0) & 0xFF);
+		QUNIT_IS_EQUAL(0, radios.lock(1) & 0xFF);
+		radios.setInterruptPending(1);
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+		radios.unlock(0);
+		QUNIT_IS_EQUAL(1, radios.poll());
+
+		// frame wait timeout (RXRFTO)
+		second->debugBuffer[1] = 0x00;
+		second->debugBuffer[2] = 0x02;
+		radios.setInterruptPending(1);
+		QUNIT_IS_EQUAL(1, radios.poll());
+		QUNIT_IS_EQUAL(DW1000Radios::EVENT_RX_TIMEOUT, radios.getEvents(1));
+
+		// flags of radios not added (yet) are ignored
+		radios.setInterruptPending(-1);
+		radios.setInterruptPending(2);
+		QUNIT_IS_EQUAL(2, radios.addRadio(third));
+		third->clearDebugBuffer();
+		third->debugBuffer[1] = 0x60;
+		QUNIT_IS_EQUAL(DW1000Radios::NO_RADIO, radios.poll());
+
+		delete third;
+		delete second;
+		QUNIT_IS_EQUAL(users, DW1000::getSpiUsers());
+	}
+
+	void testTransmitPower() {
+		QUNIT_IS_EQUAL(DW1000::SMART_TX_CH_5_PRF_64MHz,
+			DW1000::transmitPowerFor(5, DW1000::TX_PULSE_FREQ_64MHZ, true));
+		QUNIT_IS_EQUAL(DW1000::MANUAL_TX_CH_7_PRF_16MHz,
+			DW1000::transmitPowerFor(7, DW1000::TX_PULSE_FREQ_16MHZ, false));
+		QUNIT_IS_EQUAL(0, DW1000::transmitPowerFor(6, DW1000::TX_PULSE_FREQ_16MHZ, false));
+
+		// manual power: table value of the current channel and PRF written
+		dw->setSmartTransmitPower(false);
+		QUNIT_IS_EQUAL(0, dw->isSmartTransmitPower() & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::transmitPowerFor(dw->getChannel(), dw->getPulseFrequency(), false),
+			dw->getTransmitPower());
+		QUNIT_IS_EQUAL(dw->getTransmitPower() & 0xFF, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL((dw->getTransmitPower() >> 24) & 0xFF, dw->debugBuffer[3] & 0xFF);
+		dw->setSmartTransmitPower(true);
+		QUNIT_IS_EQUAL(dw->getTransmitPower() & 0xFF, dw->debugBuffer[0] & 0xFF);
+	}
+
+	void testTestModes() {
+		DW1000FrameCounter counter(dw);
+
+		// CW: pulse generator test written last
+		dw->startContinuousWave();
+		QUNIT_IS_EQUAL(TC_PGTEST_CW, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL(1, dw->isTestMode() & 0xFF);
+		dw->exitTestMode();
+		QUNIT_IS_EQUAL(0, dw->isTestMode() & 0xFF);
+		QUNIT_IS_EQUAL(0x40, dw->debugBuffer[0] & 0xFF);
+
+		// continuous frames of the setData() frame, started with TXSTRT
+		dw->newTransmit();
+		dw->startContinuousFrame(100);
+		QUNIT_IS_EQUAL(0x02, dw->debugBuffer[0] & 0xFF);
+		dw->exitTestMode();
+
+		// counter: good frame, bad frame, timeout
+		counter.start();
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0x60;
+		QUNIT_IS_EQUAL(1, counter.poll(1000) & 0xFF);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0x80;
+		QUNIT_IS_EQUAL(1, counter.poll(1500) & 0xFF);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0x60;
+		QUNIT_IS_EQUAL(1, counter.poll(2000) & 0xFF);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[2] = 0x02;
+		QUNIT_IS_EQUAL(0, counter.poll(2500) & 0xFF);
+		QUNIT_IS_EQUAL(2, counter.getGoodCount());
+		QUNIT_IS_EQUAL(1, counter.getBadCount());
+		QUNIT_IS_EQUAL(1, counter.getTimeoutCount());
+		QUNIT_IS_TRUE(std::fabs(counter.getErrorRate() - 1.0f / 3.0f) < 1e-6f);
+		QUNIT_IS_TRUE(std::fabs(counter.getErrorRate(4) - 0.5f) < 1e-6f);
+		QUNIT_IS_TRUE(std::fabs(counter.getFrameRate() - 1000.0f) < 1e-3f);
+		// PHY header error: a bad frame too, cleared with the other RX events
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0x10;
+		QUNIT_IS_EQUAL(1, counter.poll(2600) & 0xFF);
+		QUNIT_IS_EQUAL(0x10, dw->debugBuffer[0] & 0x10);
+		QUNIT_IS_EQUAL(2, counter.getBadCount());
+		QUNIT_IS_TRUE(std::fabs(counter.getErrorRate() - 0.5f) < 1e-6f);
+		counter.stop();
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0x60;
+		QUNIT_IS_EQUAL(0, counter.poll(3000) & 0xFF);
+	}
+
+	void testTrace() {
+		byte buffer[32];
+		byte data[2] = {0x12, 0x34};
+		DW1000Trace trace(buffer, sizeof(buffer));
+		DW1000TraceRecord record;
+		unsigned int next;
+
+		// writes without and with extended sub-address, a read
+		trace.attach(dw);
+		trace.setTime(100);
+		dw->setAntennaDelay(0x0100, 0x3412);
+		dw->isTransmitDone();
+		trace.detach();
+		QUNIT_IS_EQUAL(3, (int)trace.getRecordCount());
+		QUNIT_IS_EQUAL(5 + 7 + 3 + LEN_SYS_STATUS, (int)trace.getLength());
+
+		next = DW1000Trace::decode(buffer, trace.getLength(), 0, &record);
+		QUNIT_IS_EQUAL(5, (int)next);
+		QUNIT_IS_EQUAL(1, record.headerLen);
+		QUNIT_IS_EQUAL(100, (int)record.time);
+		next = DW1000Trace::decode(buffer, trace.getLength(), next, &record);
+		QUNIT_IS_EQUAL(12, (int)next);
+		QUNIT_IS_EQUAL(1, record.write & 0xFF);
+		QUNIT_IS_EQUAL(3, record.headerLen);
+		QUNIT_IS_EQUAL(0, (int)record.time);
+		QUNIT_IS_EQUAL(2, record.length);
+		QUNIT_IS_EQUAL(0, memcmp(data, record.data, 2));
+		next = DW1000Trace::decode(buffer, trace.getLength(), next, &record);
+		QUNIT_IS_EQUAL((int)trace.getLength(), (int)next);
+		QUNIT_IS_EQUAL(0, record.write & 0xFF);
+		QUNIT_IS_EQUAL(SYS_STATUS, record.header[0] & 0xFF);
+		QUNIT_IS_EQUAL(LEN_SYS_STATUS, record.length);
+		QUNIT_IS_EQUAL(0, (int)DW1000Trace::decode(buffer, trace.getLength(), next, &record));
+		// truncated record
+		QUNIT_IS_EQUAL(0, (int)DW1000Trace::decode(buffer, trace.getLength() - 1, 12, &record));
+
+		// full buffer: the record and all following ones dropped
+		trace.attach(dw);
+		dw->isTransmitDone();
+		dw->setData(data, 2);
+		trace.detach();
+		QUNIT_IS_EQUAL(4, (int)trace.getRecordCount());
+		QUNIT_IS_EQUAL(1, (int)trace.getDroppedCount());
+	}
+
+	static void collectEvent(void* context, const DW1000Event* event) {
+		std::vector<DW1000Event>* events = (std::vector<DW1000Event>*)context;
+		events->push_back(*event);
+	}
+
+	void testEventLog() {
+		byte ring[64];
+		byte link[64];
+		DW1000EventLog log(ring, sizeof(ring));
+		std::vector<DW1000Event> events;
+		DW1000EventDecoder decoder(&collectEvent, &events);
+		DW1000Event event = {0, DW1000::TIME_OVERFLOW - 100, 0x1234, 7, 180, 190};
+		int n;
+
+		// KEY record, then a delta over the 40 bit overflow from the same source
+		QUNIT_IS_EQUAL(1, log.log(&event) & 0xFF);
+		n = (int)log.available();
+		QUNIT_IS_TRUE(n >= 12 && n <= LEN_EVENTLOG_ENCODED);
+		event.time = 200;
+		event.frameSeq = 0;
+		QUNIT_IS_EQUAL(1, log.log(&event) & 0xFF);
+		QUNIT_IS_EQUAL(2 + 2 + 1 + 2 + 1 + 2, (int)log.available() - n);
+		// fed in odd chunks
+		n = log.read(link, 5);
+		decoder.feed(link, n);
+		n = log.read(link, sizeof(link));
+		decoder.feed(link, n);
+		QUNIT_IS_EQUAL(0, (int)log.available());
+		QUNIT_IS_EQUAL(2, (int)events.size());
+		QUNIT_IS_EQUAL(DW1000::TIME_OVERFLOW - 100, events[0].time);
+		QUNIT_IS_EQUAL(200, events[1].time);
+		QUNIT_IS_EQUAL(0x1234, events[1].source);
+		QUNIT_IS_EQUAL(1, events[1].seq & 0xFF);
+		QUNIT_IS_EQUAL(180, events[1].rxLevel & 0xFF);
+
+		// full ring: records dropped, the decoder skips to the next KEY record
+		events.clear();
+		while(log.log(&event)) {
+		}
+		QUNIT_IS_EQUAL(1, (int)log.getDroppedCount());
+		n = log.read(link, sizeof(link));
+		decoder.feed(link, n);
+		QUNIT_IS_EQUAL((int)log.getLoggedCount() - 2, (int)events.size());
+		event.source = 0x5678;
+		QUNIT_IS_EQUAL(1, log.log(&event) & 0xFF);
+		n = log.read(link, sizeof(link));
+		decoder.feed(link, n);
+		QUNIT_IS_EQUAL(1, (int)decoder.getLostCount());
+		QUNIT_IS_EQUAL(0x5678, events.back().source);
+
+		// corrupted byte: record rejected, the next delta record skipped
+		events.clear();
+		event.time = 1000;
+		log.log(&event);
+		event.time = 2000;
+		log.log(&event);
+		n = log.read(link, sizeof(link));
+		link[3] ^= 0x10;
+		decoder.feed(link, n);
+		QUNIT_IS_EQUAL(0, (int)events.size());
+		QUNIT_IS_EQUAL(1, (int)decoder.getErrorCount());
+		QUNIT_IS_EQUAL(1, (int)decoder.getSkippedCount());
+
+		// power levels
+		QUNIT_IS_EQUAL(190, DW1000EventLog::toLevel(-95.0f) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000EventLog::toLevel(3.0f) & 0xFF);
+		QUNIT_IS_TRUE(std::fabs(DW1000EventLog::receivePower(1000, 1000, DW1000::TX_PULSE_FREQ_64MHZ) + 100.6f) < 0.1f);
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(1, log.logReceive(dw, 0x0001, 1) & 0xFF);
+	}
+
+	void testFrameCheck() {
+		const byte check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+		byte frame[64];
+		DW1000Crc crc;
+		int i, n;
+
+		QUNIT_IS_EQUAL(0x2189, (int)DW1000Crc::compute(check, sizeof(check)));
+		QUNIT_IS_EQUAL(0x2189, (int)DW1000Crc::updateNibble(0, check, sizeof(check)));
+		QUNIT_IS_EQUAL(0x2189, (int)DW1000Crc::updateBitwise(0, check, sizeof(check)));
+
+		// all lengths around the 8 byte blocks, in pieces, against the reference
+		for(i = 0; i < (int)sizeof(frame); i++) {
+			frame[i] = (byte)(i * 37 + 11);
+		}
+		for(n = 0; n < 40; n++) {
+			crc.reset();
+			crc.update(frame, n / 3);
+			crc.update(&frame[n / 3], n - n / 3);
+			QUNIT_IS_EQUAL((int)DW1000Crc::updateBitwise(0, frame, n), (int)crc.get());
+		}
+		DW1000Crc::append(frame, 20);
+		QUNIT_IS_EQUAL(1, DW1000Crc::check(frame, 22) & 0xFF);
+		frame[5] ^= 0x01;
+		QUNIT_IS_EQUAL(0, DW1000Crc::check(frame, 22) & 0xFF);
+
+		// host CRC written after the payload, device CRC suppressed
+		dw->newTransmit();
+		dw->setDataWithFrameCheck(frame, 20);
+		QUNIT_IS_EQUAL((int)(DW1000Crc::compute(frame, 20) & 0xFF), dw->debugBuffer[0] & 0xFF);
+		dw->startTransmit();
+		QUNIT_IS_EQUAL((1 << SFCST_BIT) | (1 << TXSTRT_BIT), dw->debugBuffer[0] & 0xFF);
+
+		// whole frame read back and checked (RX_FINFO and RX_BUFFER both
+		// read from the debug buffer)
+		dw->clearDebugBuffer();
+		dw->debugBuffer[0] = 4;
+		DW1000Crc::append(dw->debugBuffer, 2);
+		QUNIT_IS_EQUAL(4, dw->getFrame(frame, sizeof(frame)));
+		QUNIT_IS_EQUAL(1, DW1000Crc::check(frame, 4) & 0xFF);
+		QUNIT_IS_EQUAL(2, dw->getData(frame, sizeof(frame)));
+	}
+
+	// counts writes and answers status reads: PLL locked, a good frame on
+	// the active channel
+	struct HopBus {
+		DW1000* dw;
+		int writes;
+		int pllWrites;
+		byte activeChannel;
+	};
+
+	static void hopTransfer(void* context, boolean write, byte header[], int /* headerLen */, byte data[], int n) {
+		HopBus* bus = (HopBus*)context;
+
+		if(write) {
+			bus->writes++;
+			if((header[0] & 0x3F) == FS_CTRL) {
+				bus->pllWrites++;
+			}
+		} else if((header[0] & 0x3F) == SYS_STATUS) {
+			memset(data, 0, n);
+			data[0] = 1 << CPLOCK_BIT;
+			if(bus->dw->getChannel() == bus->activeChannel) {
+				data[1] = (1 << (RXPRD_BIT - 8)) | (1 << (RXDFR_BIT - 8)) | (1 << (RXFCG_BIT - 8));
+			}
+		}
+	}
+
+	void testHopping() {
+		HopBus bus = {dw, 0, 0, 0};
+		byte sequence[3] = {1, 5, 7};
+		byte invalid[2] = {1, 6};
+		DW1000ChannelImage image;
+		int i;
+
+		QUNIT_IS_EQUAL(3, DW1000::defaultPreambleCode(5, DW1000::TX_PULSE_FREQ_16MHZ) & 0xFF);
+		QUNIT_IS_EQUAL(17, DW1000::defaultPreambleCode(7, DW1000::TX_PULSE_FREQ_64MHZ) & 0xFF);
+		QUNIT_IS_EQUAL(0, dw->getChannelImage(6, 0, &image) & 0xFF);
+		QUNIT_IS_EQUAL(1, dw->getChannelImage(5, 0, &image) & 0xFF);
+		QUNIT_IS_EQUAL(0xD8, image.rf[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x1D, image.pll[0] & 0xFF);
+		QUNIT_IS_EQUAL(0xBE, image.pll[4] & 0xFF);
+		QUNIT_IS_EQUAL(0x55, image.chanctrl[0] & 0xFF);
+
+		// first retune writes all, then only what differs from the last channel
+		DW1000Hopping hopping(dw);
+		dw->setTransferHandler(hopTransfer, &bus);
+		QUNIT_IS_EQUAL(1, hopping.retune(5) & 0xFF);
+		QUNIT_IS_EQUAL(8, hopping.getRetuneWrites());
+		QUNIT_IS_EQUAL(8, bus.writes);
+		QUNIT_IS_EQUAL(1, hopping.retune(5) & 0xFF);
+		QUNIT_IS_EQUAL(2, hopping.getRetuneWrites());
+		// channels 5 and 7 share the PLL set-up
+		bus.pllWrites = 0;
+		QUNIT_IS_EQUAL(1, hopping.retune(7) & 0xFF);
+		QUNIT_IS_EQUAL(7, hopping.getRetuneWrites());
+		QUNIT_IS_EQUAL(0, bus.pllWrites);
+		QUNIT_IS_EQUAL(7, dw->getChannel() & 0xFF);
+		QUNIT_IS_EQUAL(hopping.getImage(7)->preambleCode & 0xFF, dw->getPreambleCode() & 0xFF);
+		QUNIT_IS_EQUAL(1, hopping.isSettled() & 0xFF);
+		QUNIT_IS_EQUAL(0, hopping.retune(6) & 0xFF);
+
+		// hop sequence
+		QUNIT_IS_EQUAL(0, hopping.setSequence(invalid, 2) & 0xFF);
+		QUNIT_IS_EQUAL(1, hopping.setSequence(sequence, 3) & 0xFF);
+		QUNIT_IS_EQUAL(1, hopping.hop() & 0xFF);
+		QUNIT_IS_EQUAL(5, hopping.hop() & 0xFF);
+		QUNIT_IS_EQUAL(7, hopping.hop() & 0xFF);
+		QUNIT_IS_EQUAL(1, hopping.hop() & 0xFF);
+
+		// scan with 1ms per channel, frames on channel 5 only
+		bus.activeChannel = 5;
+		hopping.startScan(1000, 0);
+		for(i = 0; i < 100 && hopping.poll(i * 100UL); i++) {
+		}
+		QUNIT_IS_EQUAL(0, hopping.isScanning() & 0xFF);
+		QUNIT_IS_TRUE(hopping.getFrameCount(5) > 0);
+		QUNIT_IS_EQUAL((int)hopping.getFrameCount(5), (int)hopping.getPreambleCount(5));
+		QUNIT_IS_EQUAL(0, (int)hopping.getFrameCount(1));
+		QUNIT_IS_EQUAL(0, hopping.isActive(7) & 0xFF);
+		QUNIT_IS_EQUAL(5, hopping.getBusiestChannel() & 0xFF);
+		dw->setTransferHandler(NULL, NULL);
+	}
+
+	void testStats() {
+		DW1000Stats stats;
+		DW1000StatsSnapshot snapshot;
+
+		QUNIT_IS_EQUAL(0, DW1000Stats::bucketOf(0) & 0xFF);
+		QUNIT_IS_EQUAL(1, DW1000Stats::bucketOf(1) & 0xFF);
+		QUNIT_IS_EQUAL(9, DW1000Stats::bucketOf(300) & 0xFF);
+		QUNIT_IS_EQUAL(STATS_BUCKETS - 1, DW1000Stats::bucketOf(0xFFFFFFFFUL) & 0xFF);
+
+		// receiver on at 0, good frame seen at 300 (counted once while latched)
+		stats.attach(dw);
+		stats.setTime(0);
+		dw->newReceive();
+		dw->startReceive();
+		stats.setTime(300);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0x60; // RXDFR, RXFCG
+		dw->isReceiveDone();
+		dw->isReceiveDone();
+		QUNIT_IS_EQUAL(1, (int)stats.getFrameCount());
+		QUNIT_IS_EQUAL(1, (int)stats.getEventCount(RXDFR_BIT));
+		QUNIT_IS_EQUAL(1, (int)stats.getLatencyBucket(DW1000Stats::RX_WAIT, 9));
+		dw->clearReceiveStatus();
+		dw->clearDebugBuffer();
+
+		// response started at 1000, sent at 1200
+		stats.setTime(1000);
+		dw->newTransmit();
+		dw->startTransmit();
+		QUNIT_IS_EQUAL(1, (int)stats.getLatencyBucket(DW1000Stats::RX_TO_TX, 10));
+		stats.setTime(1200);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[0] = 0x80; // TXFRS
+		dw->isTransmitDone();
+		QUNIT_IS_EQUAL(1, (int)stats.getLatencyCount(DW1000Stats::TX_DONE));
+		QUNIT_IS_EQUAL(255, (int)stats.getLatencyPercentile(DW1000Stats::TX_DONE, 50));
+
+		// bad frame
+		dw->clearDebugBuffer();
+		dw->debugBuffer[1] = 0xA0; // RXDFR, RXFCE
+		dw->isReceiveDone();
+		QUNIT_IS_EQUAL(1, (int)stats.getReceiveErrorCount());
+		QUNIT_IS_EQUAL(2, (int)stats.getEventCount(RXDFR_BIT));
+
+		// snapshot with reset
+		stats.setTime(2000);
+		stats.snapshot(&snapshot, true);
+		QUNIT_IS_EQUAL(2000, (int)snapshot.time);
+		QUNIT_IS_EQUAL(1, (int)snapshot.events[TXFRS_BIT]);
+		QUNIT_IS_EQUAL(1, (int)snapshot.latency[DW1000Stats::TX_DONE][8]);
+		QUNIT_IS_TRUE(snapshot.transfers > 0);
+		QUNIT_IS_EQUAL(0, (int)stats.getEventCount(TXFRS_BIT));
+		QUNIT_IS_EQUAL(0, (int)stats.getLatencyCount(DW1000Stats::TX_DONE));
+		QUNIT_IS_EQUAL(0, (int)stats.getLatencyPercentile(DW1000Stats::TX_DONE, 50));
+
+		// a latency below 1us is bucket 0, its percentile 0 as well
+		stats.setTime(2100);
+		dw->newTransmit();
+		dw->startTransmit();
+		dw->clearDebugBuffer();
+		dw->debugBuffer[0] = 0x80; // TXFRS
+		dw->isTransmitDone();
+		QUNIT_IS_EQUAL(1, (int)stats.getLatencyBucket(DW1000Stats::TX_DONE, 0));
+		QUNIT_IS_EQUAL(1, (int)stats.getLatencyCount(DW1000Stats::TX_DONE));
+		QUNIT_IS_EQUAL(0, (int)stats.getLatencyPercentile(DW1000Stats::TX_DONE, 50));
+		stats.detach();
+		dw->clearDebugBuffer();
+	}
+
+	void testReceiverConfig() {
+		typedef DW1000ReceiverConfig<DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, 5> Fast;
+		typedef DW1000ReceiverConfig<DW1000::TX_RATE_110KBPS, DW1000::TX_PULSE_FREQ_64MHZ,
+			DW1000::TX_PREAMBLE_LEN_2048, 7> Long;
+		// DW1000ReceiverConfig<DW1000::TX_RATE_110KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+		//	DW1000::TX_PREAMBLE_LEN_128, 5>::apply(dw) does not compile
+		HopBus bus = {dw, 0, 0, 0};
+		DW1000ReceiverSetup setup;
+
+		QUNIT_IS_EQUAL(8, Fast::pac & 0xFF);
+		QUNIT_IS_EQUAL(3, Fast::code & 0xFF);
+		QUNIT_IS_EQUAL(64, Long::pac & 0xFF);
+		QUNIT_IS_EQUAL(17, Long::code & 0xFF);
+
+		// invalid at run time: short preamble at 110kbps, 64MHz code at 16MHz
+		QUNIT_IS_EQUAL(0, DW1000::solveReceiver(DW1000::TX_RATE_110KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, 5, 0, &setup) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000::solveReceiver(DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_64, 5, 9, &setup) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000::solveReceiver(DW1000::TX_RATE_850KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_64, 5, 0, &setup) & 0xFF);
+
+		// PAC 16 at 512 symbols, DRX_TUNE2 and replica coefficient of code 12
+		QUNIT_IS_EQUAL(1, DW1000::solveReceiver(DW1000::TX_RATE_850KBPS, DW1000::TX_PULSE_FREQ_64MHZ,
+			DW1000::TX_PREAMBLE_LEN_512, 2, 12, &setup) & 0xFF);
+		QUNIT_IS_EQUAL(16, setup.pac & 0xFF);
+		QUNIT_IS_EQUAL(0xBE, setup.drxTune[6] & 0xFF);
+		QUNIT_IS_EQUAL(0x33, setup.drxTune[9] & 0xFF);
+		QUNIT_IS_EQUAL(0x70, setup.repc[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x9B, setup.agcTune1[0] & 0xFF);
+		// divided by 8 at 110kbps
+		Long::solve(&setup);
+		QUNIT_IS_EQUAL(0x3332 >> 3, setup.repc[0] | (setup.repc[1] << 8));
+
+		// same channel and PRF: six writes in one batch
+		Fast::apply(dw);
+		QUNIT_IS_EQUAL(5, dw->getChannel() & 0xFF);
+		QUNIT_IS_EQUAL(3, dw->getPreambleCode() & 0xFF);
+		QUNIT_IS_EQUAL((int)DW1000::TX_RATE_6800KBPS, dw->getDataRate() & 0xFF);
+		dw->setTransferHandler(hopTransfer, &bus);
+		QUNIT_IS_EQUAL(1, dw->configureReceiver(DW1000::TX_RATE_850KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_256, 5, 4) & 0xFF);
+		QUNIT_IS_EQUAL(6, bus.writes);
+		QUNIT_IS_EQUAL(4, dw->getPreambleCode() & 0xFF);
+		QUNIT_IS_EQUAL(0, dw->configureReceiver(DW1000::TX_RATE_850KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_256, 6, 0) & 0xFF);
+		QUNIT_IS_EQUAL(6, bus.writes);
+		dw->setTransferHandler(NULL, NULL);
+	}
+
+	void testCcm() {
+		byte key[LEN_AES_KEY];
+		byte block[LEN_AES_BLOCK];
+		byte source[LEN_CCM_SOURCE] = {0xAC, 0xDE, 0x48, 0x00, 0x00, 0x00, 0x00, 0x01};
+		byte header[9] = {0x41, 0x88, 0x2A, 0xCA, 0xDE, 0x02, 0x00, 0x01, 0x00};
+		byte sealed[16] = {0x06, 0xB8, 0x75, 0xA7, 0x1B, 0xEC, 0x64, 0xC9,
+			0xA9, 0xD2, 0x5C, 0xFC, 0x15, 0xE0, 0xF5, 0xE0};
+		byte mic[8] = {0x60, 0xDC, 0x23, 0xC9, 0x15, 0xBA, 0x46, 0x6E};
+		byte micOnly[8] = {0xE3, 0x54, 0x55, 0x6D, 0xA0, 0x01, 0x99, 0x94};
+		byte short5[9] = {0x44, 0x15, 0xCC, 0x05, 0xC0, 0x9B, 0x85, 0xB9, 0x82};
+		byte frame[9 + 16 + LEN_CCM_MAX_MIC];
+		byte nonce[LEN_CCM_NONCE];
+		DW1000Aes aes;
+		DW1000Ccm ccm;
+		int i;
+
+		// FIPS-197 appendix C.1, both implementations
+		for(i = 0; i < LEN_AES_KEY; i++) {
+			key[i] = i;
+			block[i] = (i << 4) | i;
+		}
+		aes.setKey(key);
+		aes.encryptCompact(block);
+		QUNIT_IS_EQUAL(0x69, block[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x5A, block[15] & 0xFF);
+		for(i = 0; i < LEN_AES_BLOCK; i++) {
+			block[i] = (i << 4) | i;
+		}
+		aes.encrypt(block);
+		QUNIT_IS_EQUAL(0x69, block[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x5A, block[15] & 0xFF);
+
+		// security levels
+		QUNIT_IS_EQUAL(0, DW1000Ccm::micLength(4) & 0xFF);
+		QUNIT_IS_EQUAL(4, DW1000Ccm::micLength(5) & 0xFF);
+		QUNIT_IS_EQUAL(16, DW1000Ccm::micLength(7) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000Ccm::isEncrypted(3) & 0xFF);
+
+		// level 6 (ENC-MIC-64), reference from another CCM implementation
+		for(i = 0; i < LEN_AES_KEY; i++) {
+			key[i] = 0xC0 + i;
+		}
+		ccm.setKey(key);
+		DW1000Ccm::nonce(nonce, source, 5, 6);
+		QUNIT_IS_EQUAL(5, nonce[11] & 0xFF);
+		memcpy(frame, header, 9);
+		for(i = 0; i < 16; i++) {
+			frame[9 + i] = 0x10 + i;
+		}
+		QUNIT_IS_EQUAL(33, ccm.seal(frame, 9, 16, nonce, 6));
+		QUNIT_IS_EQUAL(0, memcmp(frame, header, 9));
+		QUNIT_IS_EQUAL(0, memcmp(&frame[9], sealed, 16));
+		QUNIT_IS_EQUAL(0, memcmp(&frame[25], mic, 8));
+		// B0, 1 header block, 1 payload block, S0 and A1
+		QUNIT_IS_EQUAL(5, (int)ccm.getBlockCount());
+		QUNIT_IS_EQUAL(16, ccm.open(frame, 9, 33, nonce, 6));
+		QUNIT_IS_EQUAL(0x10, frame[9] & 0xFF);
+		QUNIT_IS_EQUAL(0x1F, frame[24] & 0xFF);
+
+		// compact rounds give the same frame
+		ccm.setCompact(true);
+		QUNIT_IS_EQUAL(33, ccm.seal(frame, 9, 16, nonce, 6));
+		QUNIT_IS_EQUAL(0, memcmp(&frame[25], mic, 8));
+		ccm.setCompact(false);
+
+		// a changed header or payload byte is rejected, the payload cleared
+		frame[2] ^= 0x01;
+		QUNIT_IS_EQUAL(-1, ccm.open(frame, 9, 33, nonce, 6));
+		QUNIT_IS_EQUAL(0, frame[9] & 0xFF);
+		frame[2] ^= 0x01;
+		QUNIT_IS_EQUAL(-1, ccm.open(frame, 9, 8, nonce, 6));
+
+		// level 2 (MIC-64), payload in clear and authenticated
+		DW1000Ccm::nonce(nonce, source, 5, 2);
+		for(i = 0; i < 16; i++) {
+			frame[9 + i] = 0x10 + i;
+		}
+		QUNIT_IS_EQUAL(33, ccm.seal(frame, 9, 16, nonce, 2));
+		QUNIT_IS_EQUAL(0x10, frame[9] & 0xFF);
+		QUNIT_IS_EQUAL(0, memcmp(&frame[25], micOnly, 8));
+		QUNIT_IS_EQUAL(16, ccm.open(frame, 9, 33, nonce, 2));
+
+		// level 5 (ENC-MIC-32), partial block, sealed into the transmit buffer
+		DW1000Ccm::nonce(nonce, source, 5, 5);
+		memcpy(frame, header, 9);
+		for(i = 0; i < 5; i++) {
+			frame[9 + i] = 0x10 + i;
+		}
+		QUNIT_IS_EQUAL(18, ccm.send(dw, frame, 9, 5, nonce, 5));
+		QUNIT_IS_EQUAL(0, memcmp(&dw->debugBuffer[9], short5, 9));
+		QUNIT_IS_EQUAL(5, ccm.open(dw->debugBuffer, 9, 18, nonce, 5));
+		QUNIT_IS_EQUAL(0x14, dw->debugBuffer[13] & 0xFF);
+		dw->clearDebugBuffer();
+	}
+
+	void testDiscovery() {
+		DW1000 other(2);
+		DW1000DiscoveryCoordinator coordinator(dw, 0xDECA, 4, 2, 0);
+		byte euiA[LEN_DISC_EUI] = {1, 0, 0, 0, 0, 0x48, 0xDE, 0xAC};
+		byte euiB[LEN_DISC_EUI] = {2, 0, 0, 0, 0, 0x48, 0xDE, 0xAC};
+		DW1000DiscoveryNode a(dw, euiA, 1);
+		DW1000DiscoveryNode b(&other, euiB, 2);
+		byte frame[LEN_DISC_FRAME];
+		byte beacon[LEN_DISC_BEACON];
+		int i, n;
+
+		// beacon: network, sequence number, window, free slots
+		QUNIT_IS_EQUAL(LEN_DISC_BEACON, coordinator.buildBeacon(beacon));
+		QUNIT_IS_EQUAL(0xCA, beacon[1] & 0xFF);
+		QUNIT_IS_EQUAL(DISC_MIN_WINDOW, beacon[4] & 0xFF);
+		QUNIT_IS_EQUAL(DW1000_DISCOVERY_NODES, beacon[5] & 0xFF);
+
+		// without backoff the first blink falls into the first superframe
+		a.handleFrame(beacon, LEN_DISC_BEACON);
+		QUNIT_IS_TRUE(a.getBlinkSlot() >= 0 && a.getBlinkSlot() < DISC_MIN_WINDOW);
+		n = a.buildBlink(frame);
+		QUNIT_IS_EQUAL(LEN_DISC_BLINK, n);
+		QUNIT_IS_EQUAL(-1, a.getBlinkSlot());
+		coordinator.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(1, coordinator.getNodeCount());
+		QUNIT_IS_EQUAL(1, coordinator.hasAssignment() & 0xFF);
+
+		// assignment ignored by other nodes, applied and confirmed by its node
+		QUNIT_IS_EQUAL(LEN_DISC_ASSIGN, coordinator.getAssignment(frame));
+		QUNIT_IS_EQUAL(0, coordinator.hasAssignment() & 0xFF);
+		b.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(0, b.isJoined() & 0xFF);
+		a.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(1, a.isJoined() & 0xFF);
+		QUNIT_IS_EQUAL(DISC_FIRST_ADDRESS, a.getAddress());
+		QUNIT_IS_EQUAL(0xDECA, a.getNetwork());
+		QUNIT_IS_EQUAL(0, a.getSlot() & 0xFF);
+		QUNIT_IS_EQUAL(1, a.hasConfirm() & 0xFF);
+		n = a.buildConfirm(frame);
+		coordinator.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(1, coordinator.getConfirmedCount());
+		QUNIT_IS_EQUAL(1, a.applyProfile() & 0xFF);
+		QUNIT_IS_EQUAL(2, dw->getChannel() & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::defaultPreambleCode(2, dw->getPulseFrequency()), dw->getPreambleCode());
+		// joined nodes stay quiet
+		coordinator.buildBeacon(beacon);
+		a.handleFrame(beacon, LEN_DISC_BEACON);
+		QUNIT_IS_EQUAL(-1, a.getBlinkSlot());
+		QUNIT_IS_EQUAL(0, coordinator.hasAssignment() & 0xFF);
+
+		// a collision widens the window, a node without assignment backs off
+		coordinator.noteCollision();
+		coordinator.buildBeacon(beacon);
+		QUNIT_IS_EQUAL(2 * DISC_MIN_WINDOW, coordinator.getWindow() & 0xFF);
+		for(i = 0; i < 32 && b.getAttempts() < 3; i++) {
+			b.handleFrame(beacon, LEN_DISC_BEACON);
+			if(b.getBlinkSlot() >= 0) {
+				b.buildBlink(frame);
+			}
+		}
+		QUNIT_IS_EQUAL(3, b.getAttempts() & 0xFF);
+		QUNIT_IS_EQUAL(DW1000DiscoveryNode::NODE_WAIT_ASSIGN, b.getState());
+		// idle superframes narrow the window again
+		coordinator.buildBeacon(beacon);
+		coordinator.buildBeacon(beacon);
+		QUNIT_IS_EQUAL(DISC_MIN_WINDOW, coordinator.getWindow() & 0xFF);
+
+		// a repeated blink gets the same address
+		coordinator.handleFrame(frame, LEN_DISC_BLINK);
+		QUNIT_IS_EQUAL(2, coordinator.getNodeCount());
+		coordinator.getAssignment(frame);
+		b.handleFrame(frame, LEN_DISC_ASSIGN);
+		b.buildBlink(frame);
+		coordinator.handleFrame(frame, LEN_DISC_BLINK);
+		QUNIT_IS_EQUAL(2, coordinator.getNodeCount());
+		coordinator.getAssignment(frame);
+		QUNIT_IS_EQUAL(DISC_FIRST_ADDRESS + 1, frame[9] | (frame[10] << 8));
+		QUNIT_IS_EQUAL(1, coordinator.findNode(euiB));
+
+		// a lost confirmation: the assignment is repeated in the next
+		// superframe and confirmed by the joined node
+		b.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(1, b.isJoined() & 0xFF);
+		b.buildConfirm(frame);
+		QUNIT_IS_EQUAL(0, coordinator.hasAssignment() & 0xFF);
+		coordinator.buildBeacon(beacon);
+		b.handleFrame(beacon, LEN_DISC_BEACON);
+		QUNIT_IS_EQUAL(-1, b.getBlinkSlot());
+		QUNIT_IS_EQUAL(1, coordinator.hasAssignment() & 0xFF);
+		QUNIT_IS_EQUAL(LEN_DISC_ASSIGN, coordinator.getAssignment(frame));
+		b.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(1, b.hasConfirm() & 0xFF);
+		n = b.buildConfirm(frame);
+		coordinator.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(2, coordinator.getConfirmedCount());
+		QUNIT_IS_EQUAL(1, coordinator.isConfirmed(1) & 0xFF);
+		coordinator.buildBeacon(beacon);
+		QUNIT_IS_EQUAL(0, coordinator.hasAssignment() & 0xFF);
+
+		// two networks in range: the node follows the first beacon, frames
+		// of the other network are ignored on both sides
+		DW1000DiscoveryCoordinator second(dw, 0xBEEF, 4, 2, 0);
+		DW1000DiscoveryCoordinator twin(dw, 0x1234, 4, 2, 0);
+		a.restart();
+		QUNIT_IS_EQUAL(DISC_NO_NETWORK, a.getNetwork());
+		second.buildBeacon(beacon);
+		a.handleFrame(beacon, LEN_DISC_BEACON);
+		QUNIT_IS_EQUAL(0xBEEF, a.getNetwork());
+		coordinator.buildBeacon(beacon);
+		a.handleFrame(beacon, LEN_DISC_BEACON);
+		QUNIT_IS_EQUAL(0xBEEF, a.getNetwork());
+		n = a.buildBlink(frame);
+		QUNIT_IS_EQUAL(LEN_DISC_BLINK, n);
+		coordinator.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(0, coordinator.hasAssignment() & 0xFF);
+		second.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(1, second.getNodeCount());
+		frame[10] = 0x34;
+		frame[11] = 0x12;
+		twin.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(LEN_DISC_ASSIGN, twin.getAssignment(frame));
+		a.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(0, a.isJoined() & 0xFF);
+		second.getAssignment(frame);
+		a.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(1, a.isJoined() & 0xFF);
+		n = a.buildConfirm(frame);
+		QUNIT_IS_EQUAL(LEN_DISC_CONFIRM, n);
+		twin.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(0, twin.getConfirmedCount());
+		second.handleFrame(frame, n);
+		QUNIT_IS_EQUAL(1, second.getConfirmedCount());
+
+		// invalid profile not applied
+		DW1000DiscoveryCoordinator bad(dw, 1, 4, 6, 0);
+		a.restart();
+		bad.buildBeacon(beacon);
+		a.handleFrame(beacon, LEN_DISC_BEACON);
+		bad.handleFrame(frame, a.buildBlink(frame));
+		bad.getAssignment(frame);
+		a.handleFrame(frame, LEN_DISC_ASSIGN);
+		QUNIT_IS_EQUAL(1, a.isJoined() & 0xFF);
+		QUNIT_IS_EQUAL(0, a.applyProfile() & 0xFF);
+		QUNIT_IS_EQUAL(1, a.applyDiscoveryProfile() & 0xFF);
+		QUNIT_IS_EQUAL(DISC_DEFAULT_CHANNEL, dw->getChannel() & 0xFF);
+		dw->clearDebugBuffer();
+	}
+
+	struct TemplateBus {
+		int writes;
+		int bufferWrites;
+		int bufferOffset;
+		int bufferBytes;
+		byte txfctrl0;
+	};
+
+	static void templateTransfer(void* context, boolean write, byte header[], int headerLen, byte data[], int n) {
+		TemplateBus* bus = (TemplateBus*)context;
+
+		if(!write) {
+			return;
+		}
+		bus->writes++;
+		if((header[0] & 0x3F) == TX_BUFFER) {
+			bus->bufferWrites++;
+			bus->bufferOffset = headerLen > 1 ? (header[1] & 0x7F) : 0;
+			bus->bufferBytes = n;
+		} else if((header[0] & 0x3F) == TX_FCTRL) {
+			bus->txfctrl0 = data[0];
+		}
+	}
+
+	void testFrameTemplate() {
+		TemplateBus bus = {0, 0, 0, 0, 0};
+		DW1000FrameTemplate poll, final;
+		byte header[12] = {0x41, 0x88, 0x00, 0xCA, 0xDE, 0x02, 0x00, 0x01, 0x00, 0x21};
+		byte big[LEN_FRAME_TEMPLATE + 1] = {0};
+		byte seq = 7;
+
+		// invalid length, rate or preamble
+		QUNIT_IS_EQUAL(0, DW1000::prepareTemplate(&poll, DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, big, sizeof(big), 0) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000::prepareTemplate(&poll, 3, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, header, 10, 0) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000::prepareTemplate(&poll, DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			0x04, header, 10, 0) & 0xFF);
+
+		// TX_FCTRL: length with CRC, rate, PRF, preamble, ranging bit
+		QUNIT_IS_EQUAL(1, DW1000::prepareTemplate(&poll, DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, header, 10, DW1000::TEMPLATE_RANGING | DW1000::TEMPLATE_WAIT_RESPONSE) & 0xFF);
+		QUNIT_IS_EQUAL(12, poll.txfctrl[0] & 0xFF);
+		QUNIT_IS_EQUAL((DW1000::TX_RATE_6800KBPS << 5) | 0x80, poll.txfctrl[1] & 0xFF);
+		QUNIT_IS_EQUAL(DW1000::TX_PULSE_FREQ_16MHZ | (DW1000::TX_PREAMBLE_LEN_128 << 2), poll.txfctrl[2] & 0xFF);
+		QUNIT_IS_EQUAL((1 << TXSTRT_BIT) | (1 << WAIT4RESP_BIT), poll.sysctrl & 0xFF);
+		QUNIT_IS_EQUAL(1, DW1000::prepareTemplate(&final, DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+			DW1000::TX_PREAMBLE_LEN_128, header, 12, DW1000::TEMPLATE_RANGING) & 0xFF);
+
+		// first transmit after TX_FCTRL changed elsewhere: frame, TX_FCTRL, SYS_CTRL
+		dw->transmitFrameLength(20);
+		dw->setTransferHandler(templateTransfer, &bus);
+		QUNIT_IS_EQUAL(3, dw->transmitTemplate(&poll));
+		QUNIT_IS_EQUAL(3, bus.writes);
+		QUNIT_IS_EQUAL(10, bus.bufferBytes);
+		QUNIT_IS_EQUAL((1 << TXSTRT_BIT) | (1 << WAIT4RESP_BIT), dw->debugBuffer[0] & 0xFF);
+
+		// again with a new sequence number: that byte and SYS_CTRL
+		QUNIT_IS_EQUAL(1, DW1000::patchTemplate(&poll, 2, &seq, 1) & 0xFF);
+		QUNIT_IS_EQUAL(0, DW1000::patchTemplate(&poll, 9, header, 2) & 0xFF);
+		QUNIT_IS_EQUAL(2, dw->transmitTemplate(&poll));
+		QUNIT_IS_EQUAL(2, bus.bufferOffset);
+		QUNIT_IS_EQUAL(1, bus.bufferBytes);
+		// unchanged: SYS_CTRL only
+		QUNIT_IS_EQUAL(1, dw->transmitTemplate(&poll));
+
+		// another template: whole frame, the changed TX_FCTRL byte
+		bus.writes = 0;
+		QUNIT_IS_EQUAL(3, dw->transmitTemplate(&final));
+		QUNIT_IS_EQUAL(14, bus.txfctrl0 & 0xFF);
+		QUNIT_IS_EQUAL(12, bus.bufferBytes);
+		QUNIT_IS_EQUAL(3, dw->transmitTemplate(&poll));
+		QUNIT_IS_EQUAL(10, bus.bufferBytes);
+
+		// setData() replaces the frame in the TX buffer
+		dw->newTransmit();
+		dw->setData(header, 10);
+		QUNIT_IS_EQUAL(2, dw->transmitTemplate(&poll));
+		QUNIT_IS_EQUAL(0, bus.bufferOffset);
+		QUNIT_IS_EQUAL(10, bus.bufferBytes);
+		dw->setTransferHandler(NULL, NULL);
+		dw->clearDebugBuffer();
+	}
+
+	void testFeatureSelection() {
+		HopBus bus = {dw, 0, 0, 0};
+		byte rate = dw->getDataRate();
+		byte prf = dw->getPulseFrequency();
+
+		// everything compiled in by default (DW1000Config.h)
+		QUNIT_IS_TRUE(DW1000_HAS_CHANNEL(1) && DW1000_HAS_CHANNEL(5) && DW1000_HAS_CHANNEL(7));
+		QUNIT_IS_FALSE(DW1000_HAS_CHANNEL(0) || DW1000_HAS_CHANNEL(6) || DW1000_HAS_CHANNEL(8));
+		QUNIT_IS_TRUE(DW1000_HAS_PRF(DW1000::TX_PULSE_FREQ_16MHZ) && DW1000_HAS_PRF(DW1000::TX_PULSE_FREQ_64MHZ));
+		QUNIT_IS_TRUE(DW1000_HAS_MODE(1) && DW1000_HAS_MODE(16));
+		QUNIT_IS_FALSE(DW1000_HAS_MODE(0) || DW1000_HAS_MODE(17));
+
+		// modes from the table, invalid ones write nothing
+		dw->setTransferHandler(hopTransfer, &bus);
+		dw->setDefaultMode(0);
+		dw->setDefaultMode(17);
+		QUNIT_IS_EQUAL(0, bus.writes);
+		dw->setDefaultMode(13);
+		QUNIT_IS_EQUAL(8, bus.writes);
+		QUNIT_IS_EQUAL((int)DW1000::TX_PULSE_FREQ_64MHZ, dw->getPulseFrequency() & 0xFF);
+		QUNIT_IS_EQUAL((int)DW1000::TX_RATE_6800KBPS, dw->getDataRate() & 0xFF);
+		dw->setDefaultMode(1);
+		QUNIT_IS_EQUAL((int)DW1000::TX_PULSE_FREQ_16MHZ, dw->getPulseFrequency() & 0xFF);
+		QUNIT_IS_EQUAL((int)DW1000::TX_RATE_110KBPS, dw->getDataRate() & 0xFF);
+		dw->setTransferHandler(NULL, NULL);
+
+		// an invalid PRF falls back to 64MHz when compiled in
+		dw->pulseFrequency(0);
+		QUNIT_IS_EQUAL((int)DW1000::TX_PULSE_FREQ_64MHZ, dw->getPulseFrequency() & 0xFF);
+		dw->transmitRate(rate);
+		dw->pulseFrequency(prf);
+	}
+
+	void testOperation() {
+		DW1000Operation op(dw);
+		byte frame[4] = {1, 2, 3, 4};
+		byte buffer[8];
+		byte classic[LEN_TX_FCTRL];
+		byte txfctrl[LEN_TX_FCTRL];
+		byte rate = dw->getDataRate();
+		byte prf = dw->getPulseFrequency();
+		byte preamble = dw->getPreambleLength();
+
+		// frames go out with the mode set up before, like with the classic
+		// newTransmit() path: 6 bytes, 6.8Mbps, 16MHz PRF, 128 symbols
+		dw->setDefaultMode(2);
+		dw->setTransferHandler(txfctrlTransfer, classic);
+		dw->newTransmit();
+		dw->transmitRate(DW1000::TX_RATE_6800KBPS);
+		dw->pulseFrequency(DW1000::TX_PULSE_FREQ_16MHZ);
+		dw->preambleLength(DW1000::TX_PREAMBLE_LEN_128);
+		dw->setData(frame, 4);
+		dw->startTransmit();
+		dw->setTransferHandler(txfctrlTransfer, txfctrl);
+		op.startTransmit(frame, 4);
+		op.step(0);
+		dw->setTransferHandler(NULL, NULL);
+		op.cancel();
+		QUNIT_IS_EQUAL(0x06, txfctrl[0] & 0xFF);
+		QUNIT_IS_EQUAL(0x40, txfctrl[1] & 0xFF);
+		QUNIT_IS_EQUAL(0x15, txfctrl[2] & 0xFF);
+		QUNIT_IS_EQUAL(0, memcmp(classic, txfctrl, LEN_TX_FCTRL));
+		dw->transmitRate(rate);
+		dw->pulseFrequency(prf);
+		dw->preambleLength(preamble);
+
+		// transmit: commands on the first step, then one status read per step
+		QUNIT_IS_EQUAL(1, op.startTransmit(frame, 4) & 0xFF);
+		QUNIT_IS_EQUAL(0, op.startReceive(buffer, 8, 0) & 0xFF);
+		QUNIT_IS_EQUAL(DW1000Operation::OP_BUSY, op.step(0));
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(DW1000Operation::OP_BUSY, op.step(10));
+		dw->debugBuffer[0] = 0x80; // TXFRS
+		QUNIT_IS_EQUAL(DW1000Operation::OP_DONE, op.step(20));
+		QUNIT_IS_EQUAL(0x80, op.getTransmitTimestamp());
+
+		// receive with timeout
+		QUNIT_IS_EQUAL(1, op.startReceive(buffer, 8, 1000) & 0xFF);
+		op.step(0);
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(DW1000Operation::OP_BUSY, op.step(999));
+		QUNIT_IS_EQUAL(DW1000Operation::OP_TIMEOUT, op.step(1000));
+
+		// good frame (RXDFR, RXFCG), RX_FINFO length 6 includes the CRC
+		op.startReceive(buffer, 8, 1000);
+		op.step(0);
+		dw->clearDebugBuffer();
+		dw->debugBuffer[0] = 6;
+		dw->debugBuffer[1] = 0x60;
+		QUNIT_IS_EQUAL(DW1000Operation::OP_DONE, op.step(10));
+		QUNIT_IS_EQUAL(4, op.getLength());
+
+		// cancel, device put to idle
+		op.startReceive(buffer, 8, 0);
+		op.step(0);
+		op.cancel();
+		QUNIT_IS_EQUAL(DW1000Operation::OP_IDLE, op.getState());
+
+		// initialization fails if the device does not start up
+		dw->clearDebugBuffer();
+		op.startInitialize();
+		QUNIT_IS_EQUAL(DW1000Operation::OP_BUSY, op.step(0));
+		QUNIT_IS_EQUAL(DW1000Operation::OP_BUSY, op.step(10));
+		QUNIT_IS_EQUAL(DW1000Operation::OP_FAILED, op.step(DW1000::WAKE_TIMEOUT));
+		dw->setSpiClock(DW1000::SPI_CLOCK_FAST);
+	}
+
+#ifdef __cpp_impl_coroutine
+	static DW1000Loop::Task receiveTwice(DW1000Loop& loop, DW1000Operation& op, byte buffer[], int* result) {
+		op.startReceive(buffer, 8, 1000);
+		*result = co_await loop.wait(op);
+		op.startReceive(buffer, 8, 1000);
+		*result += 10 * co_await loop.wait(op);
+	}
+
+	void testCoroutine() {
+		DW1000Loop loop;
+		DW1000Operation op(dw);
+		byte buffer[8];
+		int result = -1;
+
+		receiveTwice(loop, op, buffer, &result);
+		QUNIT_IS_EQUAL(1, loop.poll(0));
+		dw->clearDebugBuffer();
+		QUNIT_IS_EQUAL(1, loop.poll(100));
+		// first receive times out, the coroutine starts the second one
+		QUNIT_IS_EQUAL(1, loop.poll(1000));
+		QUNIT_IS_EQUAL(1, loop.poll(1000));
+		dw->clearDebugBuffer();
+		dw->debugBuffer[0] = 6;
+		dw->debugBuffer[1] = 0x60;
+		QUNIT_IS_EQUAL(0, loop.poll(1100));
+		QUNIT_IS_EQUAL(DW1000Operation::OP_TIMEOUT + 10 * DW1000Operation::OP_DONE, result);
+	}
+#endif
+
+	void testCalibration() {
+		DW1000Calibration cal(dw);
+		int64_t tof, bias, reply1, reply2;
+		int i;
+
+		dw->setRFChannel(5);
+		dw->newTransmit();
+		dw->pulseFrequency(DW1000::TX_PULSE_FREQ_64MHZ);
+		QUNIT_IS_EQUAL(213, DW1000Calibration::distanceToTime(1000));
+		// peer at 5m, true delay of each node is 32900 (TX plus RX)
+		cal.beginCalibration(5000);
+		bias = 32900 - 2 * DW1000::ANTENNA_DELAY_DEFAULT;
+		tof = DW1000Calibration::distanceToTime(5000) + bias;
+		for(i = 0; i < 8; i++) {
+			reply1 = 300000 + i * 1000;
+			reply2 = 500000 - i * 2000;
+			cal.addSample(2 * tof + reply1, reply1, 2 * tof + reply2, reply2);
+		}
+		QUNIT_IS_EQUAL(8, cal.getSampleCount());
+		QUNIT_IS_EQUAL(1, cal.finishCalibration() & 0xFF);
+		QUNIT_IS_EQUAL(32900, cal.getAntennaDelay(5, DW1000::TX_PULSE_FREQ_64MHZ));
+		// other entries remain at default
+		QUNIT_IS_EQUAL(2 * DW1000::ANTENNA_DELAY_DEFAULT, cal.getAntennaDelay(5, DW1000::TX_PULSE_FREQ_16MHZ));
+		QUNIT_IS_EQUAL(0, cal.finishCalibration() & 0xFF);
+
+		// compensation relative to the reference temperature (Q8 coefficient)
+		cal.setAntennaDelay(5, DW1000::TX_PULSE_FREQ_64MHZ, 32900, 0x80);
+		cal.setTempCoefficient(256);
+		dw->clearDebugBuffer();
+		cal.applyTemperature(0x8A);
+		// RX half of 32910
+		QUNIT_IS_EQUAL((32910 - 32910 / 2) & 0xFF, dw->debugBuffer[0] & 0xFF);
+		QUNIT_IS_EQUAL((32910 - 32910 / 2) >> 8, dw->debugBuffer[1] & 0xFF);
+		cal.applyTemperature(0x80);
+		QUNIT_IS_EQUAL(16450 & 0xFF, dw->debugBuffer[0] & 0xFF);
+	}
+
+	void testCarrierIntegrator() {
+		// 21 bit sign extension
+		dw->debugBuffer[0] = 0x00;
+		dw->debugBuffer[1] = 0x00;
+		dw->debugBuffer[2] = 0x10;
+		QUNIT_IS_EQUAL(-0x100000L, dw->readCarrierIntegrator());
+		dw->debugBuffer[2] = 0xEF;
+		QUNIT_IS_EQUAL(0x0F0000L, dw->readCarrierIntegrator());
+		// channel 5 at 6.8Mbps, ~0.5731ppb per LSB, remote clock slower
+		QUNIT_IS_EQUAL(-5731, DW1000ClockOffset::carrierIntegratorToPpb(10000, 5, DW1000::TX_RATE_6800KBPS));
+		QUNIT_IS_EQUAL(10643, DW1000ClockOffset::carrierIntegratorToPpb(-10000, 1, DW1000::TX_RATE_850KBPS));
+		QUNIT_IS_EQUAL(-716, DW1000ClockOffset::carrierIntegratorToPpb(10000, 7, DW1000::TX_RATE_110KBPS));
+	}
+
+	void testClockOffset() {
+		DW1000ClockOffset clk(dw);
+		int64_t tof = 1000, reply = 32000000; // 500us reply
+		int64_t round, remoteTx, localRx;
+		long offset = 10000; // remote 10ppm fast
+		int i;
+
+		QUNIT_IS_EQUAL(0, clk.hasClockOffset(0x0001) & 0xFF);
+		// consecutive timestamps of a peer, 100ms apart and across the wrap-around
+		remoteTx = DW1000::TIME_OVERFLOW - 3000000000LL;
+		localRx = 5000000000LL;
+		for(i = 0; i < 4; i++) {
+			clk.addTimestampPair(0x0001, remoteTx, localRx);
+			remoteTx = (remoteTx + 6389760000LL + 63898LL) % DW1000::TIME_OVERFLOW;
+			localRx = (localRx + 6389760000LL) % DW1000::TIME_OVERFLOW;
+		}
+		QUNIT_IS_EQUAL(1, clk.hasClockOffset(0x0001) & 0xFF);
+		QUNIT_IS_EQUAL(offset, clk.getClockOffset(0x0001));
+		// a corrupt remote timestamp is no sample, neither is the next pair
+		clk.addTimestampPair(0x0001, (remoteTx + 0x8000000000LL) % DW1000::TIME_OVERFLOW, localRx);
+		remoteTx = (remoteTx + 6389760000LL + 63898LL) % DW1000::TIME_OVERFLOW;
+		localRx = (localRx + 6389760000LL) % DW1000::TIME_OVERFLOW;
+		clk.addTimestampPair(0x0001, remoteTx, localRx);
+		QUNIT_IS_EQUAL(offset, clk.getClockOffset(0x0001));
+
+		// single-sided ranging: uncorrected error is ~reply*offset/2
+		round = 2 * tof + reply * 1000000000LL / (1000000000LL + offset);
+		QUNIT_IS_EQUAL(tof, clk.computeTimeOfFlight(0x0001, round, reply));
+		QUNIT_IS_TRUE(DW1000ClockOffset::correctSingleSided(round, reply, 0) < tof - 150);
+
+		// filter converges, unknown peers report no offset
+		clk.addCarrierIntegrator(0x0002, -17450);
+		QUNIT_IS_EQUAL(10000, clk.getClockOffset(0x0002));
+		QUNIT_IS_EQUAL(0, clk.getClockOffset(0x0003));
+
+		// least recently used peer is replaced once the table is full
+		for(i = 0; i < DW1000_CLOCK_PEERS; i++) {
+			clk.addCarrierIntegrator(0x0010 + i, 0);
+		}
+		QUNIT_IS_EQUAL(0, clk.hasClockOffset(0x0001) & 0xFF);
+		clk.forget(0x0010);
+		QUNIT_IS_EQUAL(0, clk.hasClockOffset(0x0010) & 0xFF);
+	}
+
+	void testTDoA() {
+		DW1000TDoA anchor(dw, 0x0002, 0x0001);
+		byte frame[LEN_TDOA_SYNC];
+		byte report[LEN_TDOA_REPORT];
+		// reference anchor is 20ppm slow, local clock started later
+		int64_t interval = 6389760000LL, start = 123456789LL, tof = 2131;
+		int64_t refTx = DW1000::TIME_OVERFLOW - interval, lastTx = 0;
+		int64_t local, time;
+		word tag;
+		byte seq;
+		int i, n;
+
+		anchor.setReferenceTimeOfFlight(tof);
+		n = DW1000TDoA::buildBlink(frame, 0x0A0B, 7);
+		anchor.handleFrame(frame, n, start);
+		QUNIT_IS_EQUAL(0, anchor.isSynchronized() & 0xFF);
+		QUNIT_IS_EQUAL(1, anchor.getDroppedCount());
+		// three beacons, 100ms apart (first one is paired by the second one)
+		for(i = 0; i < 3; i++) {
+			local = start + (int64_t)i * (interval + 127795LL);
+			n = DW1000TDoA::buildSync(frame, 0x0001, 40 + i, lastTx);
+			anchor.handleFrame(frame, n, local);
+			lastTx = refTx;
+			refTx = (refTx + interval) % DW1000::TIME_OVERFLOW;
+		}
+		QUNIT_IS_EQUAL(1, anchor.isSynchronized() & 0xFF);
+		QUNIT_IS_EQUAL(-19999, anchor.getClockOffset());
+		// blink 50ms after the last beacon reached the anchor
+		local = start + 2 * (interval + 127795LL) + (interval + 127795LL) / 2;
+		n = DW1000TDoA::buildBlink(frame, 0x0A0B, 8);
+		anchor.handleFrame(frame, n, local);
+		QUNIT_IS_EQUAL(0, anchor.hasReport() & 0xFF);
+		n = anchor.getReport(report);
+		QUNIT_IS_EQUAL(LEN_TDOA_REPORT_HEADER + LEN_TDOA_RECORD, n);
+		QUNIT_IS_EQUAL(0x0002, DW1000TDoA::getReportAnchor(report));
+		QUNIT_IS_EQUAL(1, DW1000TDoA::getReportCount(report));
+		DW1000TDoA::getReportRecord(report, 0, &tag, &seq, &time);
+		QUNIT_IS_EQUAL(0x0A0B, tag);
+		QUNIT_IS_EQUAL(8, seq & 0xFF);
+		time = DW1000::timestampDiff(time, (lastTx + interval / 2 + tof) % DW1000::TIME_OVERFLOW);
+		QUNIT_IS_TRUE(time < 2 || time > DW1000::TIME_OVERFLOW - 2);
+		QUNIT_IS_EQUAL(0, anchor.getReport(report));
+		// blink 10s after the last beacon (lost sync frames)
+		local = start + 102 * (interval + 127795LL);
+		n = DW1000TDoA::buildBlink(frame, 0x0A0B, 9);
+		anchor.handleFrame(frame, n, local % DW1000::TIME_OVERFLOW);
+		QUNIT_IS_EQUAL(LEN_TDOA_REPORT_HEADER + LEN_TDOA_RECORD, anchor.getReport(report));
+		DW1000TDoA::getReportRecord(report, 0, &tag, &seq, &time);
+		time = DW1000::timestampDiff(time, (lastTx + 100 * interval + tof) % DW1000::TIME_OVERFLOW);
+		QUNIT_IS_TRUE(time < 2 || time > DW1000::TIME_OVERFLOW - 2);
+	}
+
+	void testSolver() {
+		DW1000Solver solver(4);
+		float ax[] = {0, 10, 10, 0}, ay[] = {0, 0, 10, 10};
+		byte report[LEN_TDOA_REPORT];
+		int64_t emitted = DW1000::TIME_OVERFLOW - 1000;
+		int i;
+
+		for(i = 0; i < 4; i++) {
+			solver.addAnchor(i + 1, ax[i], ay[i], 0);
+		}
+		// ranges of a tag at (3, 4), arrivals of a tag at (6, 2) in reports
+		for(i = 0; i < 4; i++) {
+			float dx = 3 - ax[i], dy = 4 - ay[i];
+			QUNIT_IS_EQUAL(1, solver.addDistance(0x0101, i + 1, std::sqrt(dx * dx + dy * dy)) & 0xFF);
+		}
+		for(i = 0; i < 4; i++) {
+			float dx = 6 - ax[i], dy = 2 - ay[i];
+			int64_t tof = (int64_t)(std::sqrt(dx * dx + dy * dy) / DW1000Solver::METERS_PER_TICK + 0.5f);
+			report[0] = TDOA_REPORT;
+			report[1] = i + 1;
+			report[2] = 0;
+			report[3] = 1;
+			report[4] = 0x02;
+			report[5] = 0x01;
+			report[6] = 9;
+			DW1000::timestampToBytes((emitted + tof) % DW1000::TIME_OVERFLOW, &report[7]);
+			QUNIT_IS_EQUAL(1, solver.addReport(report));
+		}
+		QUNIT_IS_EQUAL(0, solver.addDistance(0x0101, 5, 1.0f) & 0xFF);
+		QUNIT_IS_EQUAL(2, solver.getCount());
+		QUNIT_IS_EQUAL(DW1000Solver::reportFix(0x0102, 9), solver.getFix(1));
+		QUNIT_IS_EQUAL(4, solver.getMeasurementCount(1));
+
+		solver.solveRanges(8);
+		QUNIT_IS_EQUAL(1, solver.isValid(0) & 0xFF);
+		QUNIT_IS_TRUE(std::fabs(solver.getX(0) - 3) < 0.01f && std::fabs(solver.getY(0) - 4) < 0.01f);
+		solver.solveTDoA(8);
+		QUNIT_IS_TRUE(std::fabs(solver.getX(1) - 6) < 0.01f && std::fabs(solver.getY(1) - 2) < 0.01f);
+
+		solver.clear();
+		QUNIT_IS_EQUAL(0, solver.getCount());
+		QUNIT_IS_EQUAL(0, solver.isValid(0) & 0xFF);
 	}
 
 public:
@@ -51,6 +1374,35 @@ public:
 		// test methods
 		testSetFrameFilter();
 		testSetTransmitRate();
+		testAntennaDelay();
+		testRegisters();
+		testTimestamps();
+		testSpiClock();
+		testInitialize();
+		testSleep();
+		testRadios();
+		testReceiveTimeout();
+		testTransmitPower();
+		testTestModes();
+		testTrace();
+		testEventLog();
+		testFrameCheck();
+		testHopping();
+		testStats();
+		testReceiverConfig();
+		testCcm();
+		testDiscovery();
+		testFrameTemplate();
+		testFeatureSelection();
+		testOperation();
+#ifdef __cpp_impl_coroutine
+		testCoroutine();
+#endif
+		testCalibration();
+		testCarrierIntegrator();
+		testClockOffset();
+		testTDoA();
+		testSolver();
 		// cleanup and summary
 		delete dw;
 		return qunit.errors();
@@ -65,8 +1417,9 @@ int main() {
  * Using something like
  *
 
-g++ -g -Os -DDEBUG -I../DW1000 -I. ../DW1000/DW1000.cpp DW1000-unit-test.cpp -o /tmp/DW1000-unit.o; chmod +x /tmp/DW1000-unit.o; /tmp/DW1000-unit.o
+g++ -g -Os -std=c++20 -DDEBUG -I../DW1000 -I../DW1000-solver -I. ../DW1000/DW1000*.cpp ../DW1000-solver/DW1000Solver.cpp DW1000-unit-test.cpp -o /tmp/DW1000-unit.o; chmod +x /tmp/DW1000-unit.o; /tmp/DW1000-unit.o
  
  *
  * to compile and run it. DEBUG flag fakes some Arduino datatypes and excludes SPI usage.
+ * C++20 for the coroutine adapter test, older standards leave it out.
  */
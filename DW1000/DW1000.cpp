@@ -8,218 +8,263 @@
  * published by the Free Software Foundation.
  */
 
-#ifndef DEBUG
+#if !defined(DEBUG) && !defined(DW1000_LINUX)
 #include "pins_arduino.h"
 #endif
 #include "DW1000.h"
+#include "DW1000Crc.h"
+#include "DW1000ReceiverConfig.h"
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#endif
+
+using namespace DW1000Reg;
 
 /* ###########################################################################
  * #### Construction and init ################################################
  * ######################################################################### */
 
+int DW1000::_spiUsers = 0;
+volatile boolean DW1000::_spiBusy = false;
+
+/*
+ * Several devices may share the SPI bus (one chip select each), the bus
+ * is set up with the first and released with the last of them.
+ */
 DW1000::DW1000(int ss) {
 	_ss = ss;
 	_deviceMode = IDLE_MODE;
 
 	_frameCheckSuppressed = false;
 	_extendedFrameLength = false;
+	memset(_syscfg, 0, LEN_SYS_CFG);
+	memset(_sysctrl, 0, LEN_SYS_CTRL);
+	memset(_txfctrl, 0, LEN_TX_FCTRL);
+	_txfctrlKnown = false;
+	_txTemplate = NULL;
 
-#ifndef DEBUG
+	// chip defaults after power-up
+	_channel = 5;
+	_pulseFrequency = TX_PULSE_FREQ_16MHZ;
+	_dataRate = TX_RATE_6800KBPS;
+	_preambleLength = TX_PREAMBLE_LEN_64;
+	_preambleCode = 4;
+	_xtalTrim = XTAL_TRIM_DEFAULT;
+	_testMode = false;
+	_transferHandler = NULL;
+	_transferContext = NULL;
+	_smartPower = true;
+	_powerOverride = false;
+	_overridePower = 0;
+	_powerOverridden = false;
+	_otpAntennaDelay[0] = 0;
+	_otpAntennaDelay[1] = 0;
+	_txAntennaDelay = 0;
+	_rxAntennaDelay = 0;
+
+	_sleeping = false;
+	_wakeUpTime = 0;
+
+	_spiTimeSlow = 0;
+	_spiTimeFast = 0;
+	setSpiClock(SPI_CLOCK_SLOW);
+	_awakeSpiClock = SPI_CLOCK_SLOW;
+
+#if defined(DW1000_LINUX)
+	char device[32];
+
+	// chip select of the default bus, see getSpidev() for others
+	snprintf(device, sizeof(device), "/dev/spidev%d.%d", DW1000_SPIDEV_BUS, ss);
+	_spidev.open(device);
+#elif !defined(DEBUG)
 	pinMode(_ss, OUTPUT);
-	SPI.begin();
+	digitalWrite(_ss, HIGH);
+	if(_spiUsers == 0) {
+		SPI.begin();
+	}
 #endif
+	_spiUsers++;
 }
 
 DW1000::~DW1000() {
+	_spiUsers--;
+#if !defined(DEBUG) && !defined(DW1000_LINUX)
+	if(_spiUsers == 0) {
+		SPI.end();
+	}
+#endif
+}
+
+/*
+ * Bring the device up after power-on or reset, at the slow SPI clock: read
+ * the OTP calibration, load the LDE microcode, write the preamble code and
+ * its LDE replica coefficient and switch to the fast SPI clock.
+ * Returns false if the device does not answer.
+ */
+boolean DW1000::initialize() {
+	setSpiClock(SPI_CLOCK_SLOW);
+	if(!checkDeviceIdentifier()) {
+		return false;
+	}
+	_txfctrlKnown = false;
+	_txTemplate = NULL;
+	loadOTPCalibration();
+	loadLDE();
+	setPreambleCode(_preambleCode);
+	initSpiClock();
+	return true;
+}
+
+/*
+ * Load the LDE microcode from ROM to RAM (see user manual, sec. 2.5.5.10),
+ * needed for RX timestamps (LDEDONE). The system clock must run from the
+ * crystal meanwhile, so this is done at the slow SPI clock.
+ */
+void DW1000::loadLDE() {
+	startLDELoad();
 #ifndef DEBUG
-	SPI.end();
+	delayMicroseconds(LDE_LOAD_TIME);
 #endif
+	finishLDELoad();
+}
+
+/*
+ * First half of loadLDE(), finishLDELoad() must follow after LDE_LOAD_TIME.
+ */
+void DW1000::startLDELoad() {
+	byte data[LEN_PMSC_CTRL0];
+
+	data[0] = 0x01;
+	data[1] = 0x03;
+	writeBytes(PMSC, PMSC_CTRL0_SUB, data, LEN_PMSC_CTRL0);
+	data[0] = 0x00;
+	data[1] = 0x00;
+	bitSet(data[LDELOAD_BIT / 8], LDELOAD_BIT % 8);
+	writeBytes(OTP_IF, OTP_CTRL_SUB, data, 2);
+}
+
+void DW1000::finishLDELoad() {
+	byte data[LEN_PMSC_CTRL0];
+
+	data[0] = 0x00;
+	data[1] = 0x02;
+	writeBytes(PMSC, PMSC_CTRL0_SUB, data, LEN_PMSC_CTRL0);
+	data[0] = LDE_CFG1_DEFAULT;
+	writeBytes(LDE_IF, LDE_CFG1_SUB, data, 1);
+}
+
+/*
+ * Read crystal trim and antenna delays from the OTP memory and apply them.
+ * Unprogrammed values (0) leave the defaults in place. The OTP antenna
+ * delay is the sum of TX and RX delay, as in DW1000Calibration.
+ */
+void DW1000::loadOTPCalibration() {
+	unsigned long value;
+	word delay;
+	byte data[1];
+
+	value = readOTP(OTP_XTRIM_ADDR);
+	_xtalTrim = (byte)(value & 0x1F);
+	if(_xtalTrim == 0) {
+		_xtalTrim = XTAL_TRIM_DEFAULT;
+	}
+	data[0] = FS_XTALT_FIXED | _xtalTrim;
+	writeBytes(FS_CTRL, FS_XTALT_SUB, data, 1);
+
+	value = readOTP(OTP_ANTDLY_ADDR);
+	_otpAntennaDelay[0] = (word)(value & 0xFFFF);
+	_otpAntennaDelay[1] = (word)((value >> 16) & 0xFFFF);
+	delay = getOTPAntennaDelay(_pulseFrequency);
+	if(delay != 0) {
+		setAntennaDelay(delay / 2, delay - delay / 2);
+	}
+}
+
+byte DW1000::getCrystalTrim() {
+	return _xtalTrim;
+}
+
+/*
+ * OTP antenna delay (TX plus RX) for the given PRF, 0 if not programmed.
+ */
+word DW1000::getOTPAntennaDelay(byte prf) {
+	if(prf == TX_PULSE_FREQ_64MHZ) {
+		return _otpAntennaDelay[1];
+	}
+	return _otpAntennaDelay[0];
 }
 
 void DW1000::loadSystemConfiguration() {
 	readSystemConfiguration(_syscfg);
 }
 
-// Defines Operational Modes as shown on DW1000-datasheet-v2.04.pdf p. 28
+#if (DW1000_MODES) != 0
+/*
+ * Operational modes as shown on DW1000-datasheet-v2.04.pdf p. 28: TX data
+ * rate, RX data rate, preamble length, PAC size and frame length, modes 1-8
+ * at 16MHz PRF, 9-16 at 64MHz.
+ */
+struct DW1000DefaultMode {
+	byte txRate;
+	byte rxRate;
+	byte preamble;
+	byte pac;
+	word length;
+};
+
+#ifdef __AVR__
+static const DW1000DefaultMode DEFAULT_MODES[16] PROGMEM = {
+#else
+static const DW1000DefaultMode DEFAULT_MODES[16] = {
+#endif
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 12},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_128, 8, 12},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 30},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_128, 8, 30},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 1023},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_128, 8, 127},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 1023},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 127},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 12},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_128, 8, 12},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 30},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_128, 8, 30},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 1023},
+	{DW1000::TX_RATE_6800KBPS, DW1000::RX_RATE_6800KBPS, DW1000::TX_PREAMBLE_LEN_128, 8, 127},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 1023},
+	{DW1000::TX_RATE_110KBPS, DW1000::RX_RATE_110KBPS, DW1000::TX_PREAMBLE_LEN_1024, 32, 127}
+};
+#endif
+
+/*
+ * Transmit and receive settings of an operational mode (1-16), modes not
+ * compiled in (DW1000_MODES, DW1000_PRFS) are ignored.
+ */
 void DW1000::setDefaultMode(short MODE)	{
-	switch (MODE){
-		case 1:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(12);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 2:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_128);
-			transmitFrameLength(12);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_128, 8);
-			break;
-		case 3:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(30);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 4:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_128);
-			transmitFrameLength(30);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_128, 8);
-			break;
-		case 5:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(1023);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 6:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_128);
-			transmitFrameLength(127);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_128, 8);
-			break;
-		case 7:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(1023);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 8:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(127);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_16MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 9:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(12);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 10:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_128);
-			transmitFrameLength(12);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_128, 8);
-			break;
-		case 11:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(30);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 12:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_128);
-			transmitFrameLength(30);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_128, 8);
-			break;
-		case 13:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_16MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(1023);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 14:
-			// Transmit Settings
-			transmitRate(TX_RATE_6800KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_128);
-			transmitFrameLength(127);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_6800KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_128, 8);
-			break;
-		case 15:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(1023);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
-		case 16:
-			// Transmit Settings
-			transmitRate(TX_RATE_110KBPS);
-			pulseFrequency(TX_PULSE_FREQ_64MHZ);
-			preambleLength(TX_PREAMBLE_LEN_1024);
-			transmitFrameLength(127);
-			
-			// Receive Settings
-			
-			tuneReceiver(RX_RATE_110KBPS, RX_PULSE_FREQ_64MHz, TX_PREAMBLE_LEN_1024, 32);
-			break;
+#if (DW1000_MODES) != 0
+	DW1000DefaultMode mode;
+	boolean prf16 = DW1000_IS_16MHZ(MODE <= 8);
+
+	if(!DW1000_HAS_MODE(MODE)) {
+		return; // TODO proper error handling: invalid mode
 	}
+#ifdef __AVR__
+	memcpy_P(&mode, &DEFAULT_MODES[MODE - 1], sizeof(mode));
+#else
+	mode = DEFAULT_MODES[MODE - 1];
+#endif
+	// frame length and receiver tuning writes in one bus access
+	beginBatch();
+	// Transmit Settings
+	transmitRate(mode.txRate);
+	pulseFrequency(prf16 ? TX_PULSE_FREQ_16MHZ : TX_PULSE_FREQ_64MHZ);
+	preambleLength(mode.preamble);
+	transmitFrameLength(mode.length);
+
+	// Receive Settings
+	tuneReceiver(mode.rxRate, prf16 ? RX_PULSE_FREQ_16MHz : RX_PULSE_FREQ_64MHz, mode.preamble, mode.pac);
+	endBatch();
+#endif
 }
 
 /* ###########################################################################
@@ -234,6 +279,154 @@ int DW1000::getChipSelect() {
 	return _ss;
 }
 
+/*
+ * Bring the SPI clock up: verify the device id at the slow clock, wait for
+ * the PLL and switch to the fast clock. Falls back to the slow clock if
+ * reads fail verification at the fast one (e.g. long wires). Transaction
+ * times at both clocks are measured (see getSlowTransactionTime()).
+ * Returns whether the fast clock is in use.
+ */
+boolean DW1000::initSpiClock() {
+	int i;
+#ifndef DEBUG
+	byte status[LEN_SYS_STATUS];
+	unsigned long start;
+#endif
+
+	setSpiClock(SPI_CLOCK_SLOW);
+	if(!checkDeviceIdentifier()) {
+		return false;
+	}
+	_spiTimeSlow = measureTransactionTime();
+	_spiTimeFast = _spiTimeSlow;
+#ifndef DEBUG
+	start = micros();
+	do {
+		readSystemEventStatus(status);
+	} while(!CPLOCK::get(status) && micros() - start < PLL_LOCK_TIMEOUT);
+#endif
+	setSpiClock(SPI_CLOCK_FAST);
+	for(i = 0; i < SPI_VERIFY_READS; i++) {
+		if(!checkDeviceIdentifier()) {
+			setSpiClock(SPI_CLOCK_SLOW);
+			return false;
+		}
+	}
+	_spiTimeFast = measureTransactionTime();
+	return true;
+}
+
+void DW1000::setSpiClock(unsigned long clock) {
+	_spiClock = clock;
+#if defined(DW1000_LINUX)
+	_spidev.setClock(clock);
+#elif !defined(DEBUG)
+	_spiSettings = SPISettings(clock, MSBFIRST, SPI_MODE0);
+#endif
+}
+
+unsigned long DW1000::getSpiClock() {
+	return _spiClock;
+}
+
+/*
+ * Writes between beginBatch() and endBatch() are queued and go down in one
+ * bus access with the next read or at the end of the (outermost) batch. On
+ * Linux that is one spidev ioctl instead of one per write, on Arduino each
+ * transaction is sent at once anyway.
+ */
+void DW1000::beginBatch() {
+#ifdef DW1000_LINUX
+	_spidev.beginBatch();
+#endif
+}
+
+void DW1000::endBatch() {
+#ifdef DW1000_LINUX
+	_spidev.endBatch();
+#endif
+}
+
+#ifdef DW1000_LINUX
+/*
+ * The spidev access of this device, e.g. to open another bus than
+ * DW1000_SPIDEV_BUS.
+ */
+DW1000Spidev* DW1000::getSpidev() {
+	return &_spidev;
+}
+#endif
+
+/*
+ * Average duration of a DEV_ID read (5 bytes on the bus, chip select
+ * included) at the current clock, in nanoseconds. Always 0 in DEBUG mode.
+ */
+unsigned long DW1000::measureTransactionTime() {
+#ifndef DEBUG
+	byte data[LEN_DEV_ID];
+	unsigned long start;
+	int i;
+
+	start = micros();
+	for(i = 0; i < SPI_TIMING_READS; i++) {
+		readBytes(DEV_ID, NO_SUB, data, LEN_DEV_ID);
+	}
+	return (micros() - start) * 1000 / SPI_TIMING_READS;
+#else
+	return 0;
+#endif
+}
+
+unsigned long DW1000::getSlowTransactionTime() {
+	return _spiTimeSlow;
+}
+
+unsigned long DW1000::getFastTransactionTime() {
+	return _spiTimeFast;
+}
+
+/*
+ * Hook on every transfer, called at its end (while the bus is still marked
+ * busy) with the SPI header and data, e.g. to record the traffic. For reads
+ * the data is already filled in and the handler may replace it (replay).
+ * @param handler
+ *		The handler, or NULL to remove it.
+ * @param context
+ *		Passed to the handler.
+ */
+void DW1000::setTransferHandler(TransferHandler handler, void* context) {
+	_transferHandler = handler;
+	_transferContext = context;
+}
+
+int DW1000::getSpiUsers() {
+	return _spiUsers;
+}
+
+/*
+ * Whether a device is in the middle of an SPI transaction, e.g. for
+ * interrupt handlers that must not access the bus then.
+ */
+boolean DW1000::isSpiBusy() {
+	return _spiBusy;
+}
+
+byte DW1000::getChannel() {
+	return _channel;
+}
+
+byte DW1000::getPulseFrequency() {
+	return _pulseFrequency;
+}
+
+byte DW1000::getDataRate() {
+	return _dataRate;
+}
+
+byte DW1000::getPreambleLength() {
+	return _preambleLength;
+}
+
 /* ###########################################################################
  * #### DW1000 operation functions ###########################################
  * ######################################################################### */
@@ -242,53 +435,103 @@ char* DW1000::readDeviceIdentifier() {
 	char* infoString = (char*)malloc(128);
 	byte data[LEN_DEV_ID];
 
-	readBytes(DEV_ID, data, LEN_DEV_ID);
+	readBytes(DEV_ID, NO_SUB, data, LEN_DEV_ID);
 
 	sprintf(infoString, "DECA - model: %d, version: %d, revision: %d", 
 		data[1], data[0] >> 4, data[0] & 0x0F);
 	return infoString;
 }
 
+/*
+ * Whether DEV_ID reads as a DW1000 (tag 0xDECA, model 0x01), i.e. the SPI
+ * transfer works at the current clock.
+ */
+boolean DW1000::checkDeviceIdentifier() {
+	byte data[LEN_DEV_ID];
+
+	readBytes(DEV_ID, NO_SUB, data, LEN_DEV_ID);
+	return data[3] == 0xDE && data[2] == 0xCA && data[1] == 0x01;
+}
+
 void DW1000::readSystemConfiguration(byte data[]) {
-	readBytes(SYS_CFG, data, LEN_SYS_CFG);
+	readBytes(SYS_CFG, NO_SUB, data, LEN_SYS_CFG);
 }
 
 void DW1000::setFrameFilter(boolean val) {
-	setBit(_syscfg, LEN_SYS_CFG, FFEN_BIT, val);
-	writeBytes(SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG);
+	FFEN::set(_syscfg, val);
+	writeFields<FFEN>(_syscfg);
 }
 
 void DW1000::setDoubleBuffering(boolean val) {
-	setBit(_syscfg, LEN_SYS_CFG, RXAUTR_BIT, !val);
-	writeBytes(SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG);
+	DIS_DRXB::set(_syscfg, !val);
+	writeFields<DIS_DRXB>(_syscfg);
 }
 
+/*
+ * Re-enable the receiver after frame errors. Timeouts (see
+ * setReceiveTimeout()) still end reception, so the RX window stays bounded.
+ */
 void DW1000::setReceiverAutoReenable(boolean val) {
-	setBit(_syscfg, LEN_SYS_CFG, DIS_DRXB_BIT, val);
-	writeBytes(SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG);
+	RXAUTR::set(_syscfg, val);
+	writeFields<RXAUTR>(_syscfg);
 }
 
 void DW1000::idle() {
 	memset(_sysctrl, 0, LEN_SYS_CTRL);
-	bitSet(_sysctrl[0], TRXOFF_BIT);
+	TRXOFF::set(_sysctrl, true);
 	_deviceMode = IDLE_MODE;
-	writeBytes(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
+	writeRegister<SysCtrl>(_sysctrl);
 }
 
 void DW1000::waitForResponse(boolean val) {
-	setBit(_sysctrl, LEN_SYS_CTRL, WAIT4RESP_BIT, val);
+	WAIT4RESP::set(_sysctrl, val);
+}
+
+/*
+ * Frame wait timeout: reception ends (RXRFTO) if no frame was received
+ * this long after the receiver was enabled.
+ * @param timeout
+ *		The timeout in us (at most ~67ms), or 0 to disable it.
+ */
+void DW1000::setReceiveTimeout(unsigned long timeout) {
+	byte data[LEN_RX_FWTO];
+	unsigned long units;
+
+	// 499.2MHz / 512 = 0.975 units per us
+	units = timeout * 39 / 40;
+	if(units > 0xFFFF) {
+		units = 0xFFFF;
+	}
+	RXWTOE::set(_syscfg, units > 0);
+	writeFields<RXWTOE>(_syscfg);
+	data[0] = (byte)(units & 0xFF);
+	data[1] = (byte)((units >> 8) & 0xFF);
+	writeBytes(RX_FWTO, NO_SUB, data, LEN_RX_FWTO);
+}
+
+/*
+ * Preamble detection timeout: reception ends (RXPTO) if no preamble was
+ * detected in this many PAC sized chunks of preamble symbols (~1us each),
+ * e.g. to give up on an idle channel early. 0 disables it.
+ */
+void DW1000::setPreambleDetectTimeout(word pacs) {
+	byte data[LEN_DRX_PRETOC];
+
+	data[0] = (byte)(pacs & 0xFF);
+	data[1] = (byte)((pacs >> 8) & 0xFF);
+	writeBytes(DRX_TUNE, DRX_PRETOC_SUB, data, LEN_DRX_PRETOC);
 }
 
 void DW1000::suppressFrameCheck() {
-	bitSet(_sysctrl[0], SFCST_BIT);
+	SFCST::set(_sysctrl, true);
 	_frameCheckSuppressed = true;
 }
 
 void DW1000::delayedTransceive(unsigned int delayNanos) {
 	if(_deviceMode == TX_MODE) {
-		setBit(_sysctrl, LEN_SYS_CTRL, TXDLYS_BIT, true);
+		TXDLYS::set(_sysctrl, true);
 	} else if(_deviceMode == RX_MODE) {
-		setBit(_sysctrl, LEN_SYS_CTRL, RXDLYS_BIT, true);
+		RXDLYS::set(_sysctrl, true);
 	} else {
 		// in idle, ignore
 		return;
@@ -301,165 +544,569 @@ void DW1000::transmitRate(byte rate) {
 	if(rate >= 0x03) {
 		rate = TX_RATE_6800KBPS;
 	}
-	_txfctrl[1] |= (byte)((rate << 5) & 0xFF);
+	_dataRate = rate;
+	TXBR::set(_txfctrl, rate);
 }
 
 void DW1000::pulseFrequency(byte freq) {
 	freq &= 0x03;
-	if(freq == 0x00 || freq >= 0x03) {
-		freq = TX_PULSE_FREQ_64MHZ;
+	if(!DW1000_HAS_PRF(freq)) {
+		freq = DW1000_HAS_PRF(TX_PULSE_FREQ_64MHZ) ? TX_PULSE_FREQ_64MHZ : TX_PULSE_FREQ_16MHZ;
 	}
-	_txfctrl[2] |= (byte)(freq & 0xFF);
+	_pulseFrequency = freq;
+	TXPRF::set(_txfctrl, freq);
 }
 
 void DW1000::preambleLength(byte prealen) {
 	prealen &= 0x0F;
-	_txfctrl[2] |= (byte)((prealen << 2) & 0xFF);
-	// TODO set PAC size accordingly for RX (see table 6, page 31)
+	_preambleLength = prealen;
+	TXPSR_PE::set(_txfctrl, prealen);
+	// PAC size for RX: tuneReceiver() with pac 0, or solveReceiver()
 }
 
-void DW1000::transmitFrameLength(byte dataLength)	{
-	if (dataLength <= 127)	{
-		setBit(_syscfg, LEN_SYS_CFG, PHR_MODE_LSB, 0);
-		setBit(_syscfg, LEN_SYS_CFG, PHR_MODE_MSB, 0);
-		}
-	else	{
-		setBit(_syscfg, LEN_SYS_CFG, PHR_MODE_LSB, 1);
-		setBit(_syscfg, LEN_SYS_CFG, PHR_MODE_MSB, 1);
-		dataLength &= 0xFF;
-	}
-	writeBytes(SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG);
-	writeBytes(TX_FCTRL, NO_SUB, &dataLength, 2);
+void DW1000::transmitFrameLength(word dataLength)	{
+	// standard (0) or extended (3) PHR mode, setData() accepts frames up
+	// to the length of the mode
+	_extendedFrameLength = dataLength > LEN_UWB_FRAMES;
+	PHR_MODE::set(_syscfg, _extendedFrameLength ? 0x03 : 0x00);
+	writeFields<PHR_MODE>(_syscfg);
+	TFLEN::set(_txfctrl, dataLength);
+	writeFields<TFLEN>(_txfctrl);
+	_txfctrlKnown = false;
 }
 
 //------------------------------------------------------------------------------------------------------
-void DW1000::tuneReceiver(byte rate, byte PRF, byte preamble, byte pac)	{	
-	byte _rfTune[11];	// 
-	word _temp;		// 
-	pac = pac & 0x78;	// Aid in eliminating erroneous PAC values (8, 16, 32, 64)
-	
+void DW1000::tuneReceiver(byte rate, byte PRF, byte preamble, byte pac)	{
+	word sfd, tune1b, lde;
+	unsigned long tune2;
+	boolean prf16 = DW1000_IS_16MHZ(PRF == RX_PULSE_FREQ_16MHz);
+
 	switch (rate)	{
 		case RX_RATE_110KBPS:
-			_rfTune[0] = (word)(SFD_STD_RATE_110KBPS & 0x00FF);
-			_rfTune[2] = (word)(DRX_TUNE_RATE_110KBPS & 0x00FF);
+			sfd = SFD_STD_RATE_110KBPS;
+			tune1b = DRX_TUNE_RATE_110KBPS;
 			break;
-		case RX_RATE_850KBPS:
-			_temp = (word)(SFD_STD_RATE_850KBPS & 0x00FF);
-// Error in dw1000_user_manual_2_02.pdf ?? -> Uncomment changes if remedied
-//			_rfTune[2] = (word)(DRX_TUNE_RATE_850_6800KBPS & 0x00FF);
-//			break;
-//		case RX_RATE_6800KBPS:
-//			_temp = (word)(SFD_STD_RATE_6800KBPS & 0x00FF);
+		case RX_RATE_850KBPS:	// same value as RX_RATE_6800KBPS
+			sfd = SFD_STD_RATE_850KBPS;
 			if (preamble == TX_PREAMBLE_LEN_64)
-				_rfTune[2] = (word)(DRX_TUNE_RATE_6800KBPS & 0x00FF);
+				tune1b = DRX_TUNE_RATE_6800KBPS;
 			else
-				_rfTune[2] = (word)(DRX_TUNE_RATE_850_6800KBPS & 0x00FF);
+				tune1b = DRX_TUNE_RATE_850_6800KBPS;
 			break;
+		default:
+			return; // TODO proper error handling: invalid data rate
 	}
-	writeBytes(DRX_TUNE, SUB_2, &_rfTune[0], 2);
-	writeBytes(DRX_TUNE, SUB_6, &_rfTune[2], 2);
-	
-	switch (PRF) {
+	switch (PRF)	{
+#if DW1000_HAS_PRF(1)
 		case RX_PULSE_FREQ_16MHz:
-			_rfTune[4] = (word)(RX_PULSE_FREQ_16MHz & 0x00FF);
-			_rfTune[10] = (word)(LDE_PRF_16MHz);
-			switch (pac)	{
-				case 8:
-					_rfTune[6] = (long)(PAC_8_PRF_16MHz);
-					break;
-				case 16:
-					_rfTune[6] = (long)(PAC_16_PRF_16MHz);
-					break;
-				case 32:
-					_rfTune[6] = (long)(PAC_32_PRF_16MHz);
-					break;
-				case 64:
-					_rfTune[6] = (long)(PAC_64_PRF_16MHz);
-					break;
-			}
+			lde = LDE_PRF_16MHz;
 			break;
+#endif
+#if DW1000_HAS_PRF(2)
 		case RX_PULSE_FREQ_64MHz:
-			_rfTune[4] = (word)(RX_PULSE_FREQ_64MHz & 0xFF);
-			_rfTune[10] = (word)(LDE_PRF_64MHz);
-			switch (pac)	{
-				case 8:
-					_rfTune[6] = (long)(PAC_8_PRF_64MHz);
-					break;
-				case 16:
-					_rfTune[6] = (long)(PAC_16_PRF_64MHz);
-					break;
-				case 32:
-					_rfTune[6] = (long)(PAC_32_PRF_64MHz);
-					break;
-				case 64:
-					_rfTune[6] = (long)(PAC_64_PRF_64MHz);
-					break;
+			lde = LDE_PRF_64MHz;
+			break;
+#endif
+		default:
+			return; // TODO proper error handling: invalid PRF
+	}
+	if (pac == 0)	// from the preamble length, see DW1000ReceiverConfig.h
+		pac = DW1000_PAC_SIZE(DW1000_PREAMBLE_SYMBOLS(preamble));
+	switch (pac)	{
+		case 8:
+			tune2 = prf16 ? PAC_8_PRF_16MHz : PAC_8_PRF_64MHz;
+			break;
+		case 16:
+			tune2 = prf16 ? PAC_16_PRF_16MHz : PAC_16_PRF_64MHz;
+			break;
+		case 32:
+			tune2 = prf16 ? PAC_32_PRF_16MHz : PAC_32_PRF_64MHz;
+			break;
+		case 64:
+			tune2 = prf16 ? PAC_64_PRF_16MHz : PAC_64_PRF_64MHz;
+			break;
+		default:
+			return; // TODO proper error handling: invalid PAC size
+	}
+	beginBatch();
+	writeValue(DRX_TUNE, SUB_2, sfd, 2);		// DRX_TUNE0b, SFD
+	writeValue(DRX_TUNE, SUB_6, tune1b, 2);		// DRX_TUNE1b, data rate
+	writeValue(DRX_TUNE, SUB_4, PRF, 2);		// DRX_TUNE1a, PRF
+	writeValue(DRX_TUNE, SUB_8, tune2, 4);		// DRX_TUNE2, PAC and PRF
+	writeValue(LDE_IF, SUB_1806, lde, 2);		// LDE_CFG2, PRF
+	if (preamble == TX_PREAMBLE_LEN_64)
+		writeValue(DRX_TUNE, SUB_26, DRX_TUNE4H_PREAMBLE_SHORT, 2);
+	else
+		writeValue(DRX_TUNE, SUB_26, DRX_TUNE4H_PREAMBLE_LONG, 2);
+	endBatch();
+}
+
+/*
+ * Derive the receiver set-up: PAC size from the preamble length, SFD and
+ * DRX_TUNE values from data rate, PRF and PAC, AGC and LDE tuning from the
+ * PRF and the LDE replica coefficient of the preamble code (see
+ * DW1000ReceiverConfig.h for the rules).
+ * @param rate
+ *		TX_RATE_110KBPS, TX_RATE_850KBPS or TX_RATE_6800KBPS.
+ * @param prf
+ *		TX_PULSE_FREQ_16MHZ or TX_PULSE_FREQ_64MHZ.
+ * @param preamble
+ *		One of the TX_PREAMBLE_LEN_* values.
+ * @param code
+ *		Preamble code valid on the channel at the PRF, or 0 for
+ *		defaultPreambleCode().
+ * Returns false for an invalid combination.
+ */
+boolean DW1000::solveReceiver(byte rate, byte prf, byte preamble, byte channel, byte code, DW1000ReceiverSetup* setup) {
+	int symbols = DW1000_PREAMBLE_SYMBOLS(preamble);
+	boolean prf16 = DW1000_IS_16MHZ(prf == TX_PULSE_FREQ_16MHZ);
+	word sfd, tune1a, tune1b, tune4h, agc, lde, repc;
+	unsigned long tune2;
+	int i;
+
+	if(code == 0 && DW1000_VALID_CHANNEL(channel)) {
+		code = DW1000_FIRST_CODE(channel, prf);
+	}
+	if(!DW1000_VALID_RATE(rate) || !DW1000_VALID_PRF(prf) || !DW1000_VALID_PREAMBLE(rate, symbols)
+			|| !DW1000_VALID_CHANNEL(channel) || !DW1000_VALID_CODE(channel, prf, code)) {
+		return false;
+	}
+	setup->rate = rate;
+	setup->prf = prf;
+	setup->preamble = preamble;
+	setup->channel = channel;
+	setup->preambleCode = code;
+	setup->pac = DW1000_PAC_SIZE(symbols);
+
+	// standard SFD (the Decawave SFD needs USR_SFD set up as well)
+	if(rate == TX_RATE_110KBPS) {
+		sfd = SFD_STD_RATE_110KBPS;
+		tune1b = DRX_TUNE_RATE_110KBPS;
+	} else {
+		sfd = (rate == TX_RATE_850KBPS) ? SFD_STD_RATE_850KBPS : SFD_STD_RATE_6800KBPS;
+		tune1b = (symbols == 64) ? DRX_TUNE_RATE_6800KBPS : DRX_TUNE_RATE_850_6800KBPS;
+	}
+	tune1a = prf16 ? RX_PULSE_FREQ_16MHz : RX_PULSE_FREQ_64MHz;
+	switch(setup->pac) {
+		case 8:
+			tune2 = prf16 ? PAC_8_PRF_16MHz : PAC_8_PRF_64MHz;
+			break;
+		case 16:
+			tune2 = prf16 ? PAC_16_PRF_16MHz : PAC_16_PRF_64MHz;
+			break;
+		case 32:
+			tune2 = prf16 ? PAC_32_PRF_16MHz : PAC_32_PRF_64MHz;
 			break;
-			}
-		writeBytes(DRX_TUNE, SUB_4, &_rfTune[4], 2);
-		writeBytes(DRX_TUNE, SUB_8, &_rfTune[6], 4);
-		writeBytes(LDE_IF, SUB_1806, &_rfTune[10], 2);
-		
-		if (preamble == TX_PREAMBLE_LEN_64)
-			_rfTune[12] = (word)(DRX_TUNE4H_PREAMBLE_SHORT & 0x00FF);
-		else
-			_rfTune[12] = (word)(DRX_TUNE4H_PREAMBLE_LONG & 0x00FF);
-		writeBytes(DRX_TUNE, SUB_26, &_rfTune[12], 2);
+		default:
+			tune2 = prf16 ? PAC_64_PRF_16MHz : PAC_64_PRF_64MHz;
+			break;
+	}
+	tune4h = (symbols == 64) ? DRX_TUNE4H_PREAMBLE_SHORT : DRX_TUNE4H_PREAMBLE_LONG;
+	agc = prf16 ? RX_AGC_TUNE_PRF_16MHz : RX_AGC_TUNE_PRF_64MHz;
+	lde = prf16 ? LDE_PRF_16MHz : LDE_PRF_64MHz;
+	repc = ldeReplicaCoefficient(code, rate);
+
+	// DRX_TUNE0b, 1a, 1b at SUB_2, SUB_4, SUB_6, DRX_TUNE2 at SUB_8
+	setup->drxTune[0] = (byte)(sfd & 0xFF);
+	setup->drxTune[1] = (byte)(sfd >> 8);
+	setup->drxTune[2] = (byte)(tune1a & 0xFF);
+	setup->drxTune[3] = (byte)(tune1a >> 8);
+	setup->drxTune[4] = (byte)(tune1b & 0xFF);
+	setup->drxTune[5] = (byte)(tune1b >> 8);
+	for(i = 0; i < 4; i++) {
+		setup->drxTune[6 + i] = (byte)((tune2 >> (i * 8)) & 0xFF);
+		setup->chanctrl[i] = (byte)((channelControl(channel, prf, code) >> (i * 8)) & 0xFF);
 	}
+	setup->drxTune4h[0] = (byte)(tune4h & 0xFF);
+	setup->drxTune4h[1] = (byte)(tune4h >> 8);
+	setup->agcTune1[0] = (byte)(agc & 0xFF);
+	setup->agcTune1[1] = (byte)(agc >> 8);
+	setup->ldeCfg2[0] = (byte)(lde & 0xFF);
+	setup->ldeCfg2[1] = (byte)(lde >> 8);
+	setup->repc[0] = (byte)(repc & 0xFF);
+	setup->repc[1] = (byte)(repc >> 8);
+	return true;
+}
+
+/*
+ * Write a solved receiver set-up in one batch, six writes instead of the
+ * eight of tuneReceiver() and setPreambleCode(). Data rate, PRF and
+ * preamble length are taken over for TX as well (TX_FCTRL goes with the
+ * next transmission). A new channel or PRF also sets up the channel (RF,
+ * PLL and TX power, see setRFChannel()).
+ */
+void DW1000::writeReceiverSetup(DW1000ReceiverSetup* setup) {
+	DW1000ChannelImage image;
+	boolean retune = (setup->channel != _channel || setup->prf != _pulseFrequency);
+
+	transmitRate(setup->rate);
+	pulseFrequency(setup->prf);
+	preambleLength(setup->preamble);
+	beginBatch();
+	writeBytes(DRX_TUNE, SUB_2, setup->drxTune, LEN_DRX_TUNE_SETUP);
+	writeBytes(DRX_TUNE, SUB_26, setup->drxTune4h, LEN_DRX_TUNE4H);
+	writeBytes(AGC_CTRL, AGC_TUNE1_SUB, setup->agcTune1, LEN_AGC_TUNE1);
+	writeBytes(LDE_IF, SUB_1806, setup->ldeCfg2, LEN_LDE_CFG2);
+	if(retune && getChannelImage(setup->channel, setup->preambleCode, &image)) {
+		writeChannelImage(&image, NULL);
+	} else {
+		writeBytes(CHAN_CTRL, NO_SUB, setup->chanctrl, LEN_CHAN_CTRL);
+		writeBytes(LDE_IF, SUB_2804, setup->repc, LEN_LDE_REPC);
+		_preambleCode = setup->preambleCode;
+	}
+	endBatch();
+}
+
+/*
+ * solveReceiver() and writeReceiverSetup(), returns false (and writes
+ * nothing) for an invalid combination.
+ */
+boolean DW1000::configureReceiver(byte rate, byte prf, byte preamble, byte channel, byte code) {
+	DW1000ReceiverSetup setup;
+
+	if(!solveReceiver(rate, prf, preamble, channel, code, &setup)) {
+		return false;
+	}
+	writeReceiverSetup(&setup);
+	return true;
 }
 
 void DW1000::setRFChannel(short channel)	{
-	byte _chSettings[12];
-	
-	switch (channel)	{
+	byte rxctrl, pgdelay, plltune;
+	unsigned long txctrl, pllcfg;
+
+	if(!channelSettings(channel, &rxctrl, &txctrl, &pgdelay, &pllcfg, &plltune)) {
+		return; // TODO proper error handling: invalid channel
+	}
+	_channel = channel;
+	beginBatch();
+	writeValue(RF_CONF, SUB_B, rxctrl, 1);		// Receive settings (RF_RXCTRLH)
+	writeValue(RF_CONF, SUB_C, txctrl, 4);		// Transmit settings (RF_TXCTRL)
+	writeValue(TX_CAL, SUB_B, pgdelay, 1);		// Transmit settings (TC_PGDELAY)
+	writeValue(FS_CTRL, SUB_7, pllcfg, 4);		// Frequency PLL settings (FS_PLLCFG)
+	writeValue(FS_CTRL, SUB_B, plltune, 1);		// Frequency PLL Settings (FS_PLLTUNE)
+	writeTransmitPower(getTransmitPower());		// Transmit power for channel and PRF
+	writeChannelControl();						// Channel number for TX and RX
+	endBatch();
+}
+
+/*
+ * RF, TX calibration and PLL values of a channel, false for an invalid
+ * channel.
+ */
+boolean DW1000::channelSettings(short channel, byte* rxctrl, unsigned long* txctrl,
+		byte* pgdelay, unsigned long* pllcfg, byte* plltune) {
+	switch(channel) {
+#if DW1000_HAS_CHANNEL(1)
 		case 1:
-			_chSettings[0] = (byte)(RX_ANALOG_STD);
-			_chSettings[1] = (long)(TX_CHANNEL_1);
-			_chSettings[5] = (byte)(PGD_CH_1);
-			_chSettings[7] = (long)(PLL_CONFIG_CH_1);
-			_chSettings[11] = (byte)(PLL_TUNE_CH_1);
+			*rxctrl = RX_ANALOG_STD;
+			*txctrl = TX_CHANNEL_1;
+			*pgdelay = PGD_CH_1;
+			*pllcfg = PLL_CONFIG_CH_1;
+			*plltune = PLL_TUNE_CH_1;
 			break;
+#endif
+#if DW1000_HAS_CHANNEL(2)
 		case 2:
-			_chSettings[0] = (byte)(RX_ANALOG_STD);
-			_chSettings[1] = (long)(TX_CHANNEL_2);
-			_chSettings[5] = (byte)(PGD_CH_2);
-			_chSettings[7] = (long)(PLL_CONFIG_CH_2);
-			_chSettings[11] = (byte)(PLL_TUNE_CH_2);
+			*rxctrl = RX_ANALOG_STD;
+			*txctrl = TX_CHANNEL_2;
+			*pgdelay = PGD_CH_2;
+			*pllcfg = PLL_CONFIG_CH_2;
+			*plltune = PLL_TUNE_CH_2;
 			break;
+#endif
+#if DW1000_HAS_CHANNEL(3)
 		case 3:
-			_chSettings[0] = (byte)(RX_ANALOG_STD);
-			_chSettings[1] = (long)(TX_CHANNEL_3);
-			_chSettings[5] = (byte)(PGD_CH_3);
-			_chSettings[7] = (long)(PLL_CONFIG_CH_3);
-			_chSettings[11] = (byte)(PLL_TUNE_CH_3);
+			*rxctrl = RX_ANALOG_STD;
+			*txctrl = TX_CHANNEL_3;
+			*pgdelay = PGD_CH_3;
+			*pllcfg = PLL_CONFIG_CH_3;
+			*plltune = PLL_TUNE_CH_3;
 			break;
+#endif
+#if DW1000_HAS_CHANNEL(4)
 		case 4:
-			_chSettings[0] = (byte)(RX_ANALOG_NSTD);
-			_chSettings[1] = (long)(TX_CHANNEL_4);
-			_chSettings[5] = (byte)(PGD_CH_4);
-			_chSettings[7] = (long)(PLL_CONFIG_CH_4);
-			_chSettings[11] = (byte)(PLL_TUNE_CH_4);
+			*rxctrl = RX_ANALOG_NSTD;
+			*txctrl = TX_CHANNEL_4;
+			*pgdelay = PGD_CH_4;
+			*pllcfg = PLL_CONFIG_CH_4;
+			*plltune = PLL_TUNE_CH_4;
 			break;
+#endif
+#if DW1000_HAS_CHANNEL(5)
 		case 5:
-			_chSettings[0] = (byte)(RX_ANALOG_STD);
-			_chSettings[1] = (long)(TX_CHANNEL_5);
-			_chSettings[5] = (byte)(PGD_CH_5);
-			_chSettings[7] = (long)(PLL_CONFIG_CH_5);
-			_chSettings[11] = (byte)(PLL_TUNE_CH_5);
+			*rxctrl = RX_ANALOG_STD;
+			*txctrl = TX_CHANNEL_5;
+			*pgdelay = PGD_CH_5;
+			*pllcfg = PLL_CONFIG_CH_5;
+			*plltune = PLL_TUNE_CH_5;
 			break;
+#endif
+#if DW1000_HAS_CHANNEL(7)
 		case 7:
-			_chSettings[0] = (byte)(RX_ANALOG_NSTD);
-			_chSettings[1] = (long)(TX_CHANNEL_7);
-			_chSettings[5] = (byte)(PGD_CH_7);
-			_chSettings[7] = (long)(PLL_CONFIG_CH_7);
-			_chSettings[11] = (byte)(PLL_TUNE_CH_7);
+			*rxctrl = RX_ANALOG_NSTD;
+			*txctrl = TX_CHANNEL_7;
+			*pgdelay = PGD_CH_7;
+			*pllcfg = PLL_CONFIG_CH_7;
+			*plltune = PLL_TUNE_CH_7;
 			break;
+#endif
+		default:
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Register image of a channel for the current PRF, data rate and power
+ * mode (see setRFChannel() and setPreambleCode()), to be built once and
+ * written with writeChannelImage() when hopping. Rebuild the images after
+ * changing the PRF, the data rate or the power mode.
+ * @param code
+ *		Preamble code, or 0 for defaultPreambleCode().
+ * Returns false for an invalid channel or preamble code.
+ */
+boolean DW1000::getChannelImage(byte channel, byte code, DW1000ChannelImage* image) {
+	byte rxctrl, pgdelay, plltune;
+	unsigned long txctrl, pllcfg, power, chanctrl;
+	word repc;
+	int i;
+
+	if(!channelSettings(channel, &rxctrl, &txctrl, &pgdelay, &pllcfg, &plltune)) {
+		return false;
+	}
+	if(code == 0) {
+		code = defaultPreambleCode(channel, _pulseFrequency);
+	}
+	if(code < 1 || code > 24) {
+		return false;
+	}
+	power = transmitPowerFor(channel, _pulseFrequency, _smartPower);
+	chanctrl = channelControl(channel, _pulseFrequency, code);
+	repc = ldeReplicaCoefficient(code, _dataRate);
+
+	image->channel = channel;
+	image->preambleCode = code;
+	image->rf[0] = rxctrl;
+	image->pgdelay[0] = pgdelay;
+	image->pll[4] = plltune;
+	for(i = 0; i < 4; i++) {
+		image->rf[i + 1] = (byte)((txctrl >> (i * 8)) & 0xFF);
+		image->pll[i] = (byte)((pllcfg >> (i * 8)) & 0xFF);
+		image->power[i] = (byte)((power >> (i * 8)) & 0xFF);
+		image->chanctrl[i] = (byte)((chanctrl >> (i * 8)) & 0xFF);
+	}
+	image->repc[0] = (byte)(repc & 0xFF);
+	image->repc[1] = (byte)((repc >> 8) & 0xFF);
+	return true;
+}
+
+/*
+ * Switch to the channel (and preamble code) of an image, in one batch. Of
+ * each register group only the bytes from the first to the last one that
+ * differ from the last written image are sent, e.g. channels 5 and 7 share
+ * the PLL set-up and it is not written at all. Same as setRFChannel()
+ * followed by setPreambleCode(), which take nine writes. The device should
+ * be idle.
+ * @param last
+ *		The image written before, or NULL if unknown (all groups written).
+ * Returns the number of SPI transactions.
+ */
+int DW1000::writeChannelImage(DW1000ChannelImage* image, DW1000ChannelImage* last) {
+	int writes = 0;
+
+	beginBatch();
+	if(last == NULL) {
+		writeBytes(RF_CONF, RF_RXCTRLH_SUB, image->rf, LEN_CHAN_RF);
+		writeBytes(TX_CAL, TC_PGDELAY_SUB, image->pgdelay, 1);
+		writeBytes(FS_CTRL, FS_PLLCFG_SUB, image->pll, LEN_CHAN_PLL);
+		writeBytes(TX_POWER, NO_SUB, image->power, LEN_TX_POWER);
+		writeBytes(CHAN_CTRL, NO_SUB, image->chanctrl, LEN_CHAN_CTRL);
+		writeBytes(LDE_IF, SUB_2804, image->repc, LEN_LDE_REPC);
+		writes = 6;
+	} else {
+		writes += writeChanged(RF_CONF, RF_RXCTRLH_SUB, image->rf, last->rf, LEN_CHAN_RF);
+		writes += writeChanged(TX_CAL, TC_PGDELAY_SUB, image->pgdelay, last->pgdelay, 1);
+		writes += writeChanged(FS_CTRL, FS_PLLCFG_SUB, image->pll, last->pll, LEN_CHAN_PLL);
+		if(_powerOverridden) {
+			// TX_POWER holds an override, not the table value of the last image
+			writeBytes(TX_POWER, NO_SUB, image->power, LEN_TX_POWER);
+			writes++;
+		} else {
+			writes += writeChanged(TX_POWER, NO_SUB, image->power, last->power, LEN_TX_POWER);
+		}
+		writes += writeChanged(CHAN_CTRL, NO_SUB, image->chanctrl, last->chanctrl, LEN_CHAN_CTRL);
+		writes += writeChanged(LDE_IF, SUB_2804, image->repc, last->repc, LEN_LDE_REPC);
+	}
+	endBatch();
+	_channel = image->channel;
+	_preambleCode = image->preambleCode;
+	_powerOverridden = false;
+	return writes;
+}
+
+/*
+ * Write the bytes of a register group from the first to the last one that
+ * differ from the last value, returns the number of writes (0 or 1).
+ */
+int DW1000::writeChanged(byte cmd, word offset, byte data[], byte last[], int n) {
+	int first, end;
+
+	for(first = 0; first < n && data[first] == last[first]; first++);
+	if(first == n) {
+		return 0;
+	}
+	for(end = n; data[end - 1] == last[end - 1]; end--);
+	// NO_SUB is sub-address 0
+	writeBytes(cmd, offset + first, &data[first], end - first);
+	return 1;
+}
+
+/*
+ * Smart TX power: the device raises the power of short frames (less than
+ * 0.5 or 0.25ms on air, e.g. short 6.8Mbps frames) within the regulatory
+ * limit per millisecond, for more range at the fast data rate. Manual
+ * power uses one setting for all frames. Writes the table value for the
+ * current channel and PRF (like setRFChannel(), which should follow a PRF
+ * change).
+ */
+void DW1000::setSmartTransmitPower(boolean val) {
+	_smartPower = val;
+	DIS_STXP::set(_syscfg, !val);
+	writeFields<DIS_STXP>(_syscfg);
+	writeTransmitPower(getTransmitPower());
+}
+
+boolean DW1000::isSmartTransmitPower() {
+	return _smartPower;
+}
+
+/*
+ * TX_POWER value of the current channel, PRF and power mode.
+ */
+unsigned long DW1000::getTransmitPower() {
+	return transmitPowerFor(_channel, _pulseFrequency, _smartPower);
+}
+
+/*
+ * Send the next frame (until the next newTransmit()) with the given power
+ * instead of the table value, in both power modes.
+ * @param power
+ *		Gain setting, bits 7-5 coarse DA gain (0 is 15dB, 3dB less per step,
+ *		7 is off), bits 4-0 mixer gain in 0.5dB steps.
+ */
+void DW1000::setTransmitPowerOverride(byte power) {
+	_powerOverride = true;
+	_overridePower = power;
+}
+
+/*
+ * TX power table value (TX_POWER) for a channel and PRF, 0 for an invalid
+ * channel. Smart values are four gain settings: normal frames, frames
+ * shorter than 0.5ms, shorter than 0.25ms and the SHR/PHR part; manual
+ * values repeat one setting.
+ */
+unsigned long DW1000::transmitPowerFor(byte channel, byte prf, boolean smart) {
+	boolean prf64 = !DW1000_IS_16MHZ(prf != TX_PULSE_FREQ_64MHZ);
+
+	switch(channel) {
+#if DW1000_HAS_CHANNEL(1)
+		case 1:
+			return smart ? (prf64 ? SMART_TX_CH_1_PRF_64MHz : SMART_TX_CH_1_PRF_16MHz)
+				: (prf64 ? MANUAL_TX_CH_1_PRF_64MHz : MANUAL_TX_CH_1_PRF_16MHz);
+#endif
+#if DW1000_HAS_CHANNEL(2)
+		case 2:
+			return smart ? (prf64 ? SMART_TX_CH_2_PRF_64MHz : SMART_TX_CH_2_PRF_16MHz)
+				: (prf64 ? MANUAL_TX_CH_2_PRF_64MHz : MANUAL_TX_CH_2_PRF_16MHz);
+#endif
+#if DW1000_HAS_CHANNEL(3)
+		case 3:
+			return smart ? (prf64 ? SMART_TX_CH_3_PRF_64MHz : SMART_TX_CH_3_PRF_16MHz)
+				: (prf64 ? MANUAL_TX_CH_3_PRF_64MHz : MANUAL_TX_CH_3_PRF_16MHz);
+#endif
+#if DW1000_HAS_CHANNEL(4)
+		case 4:
+			return smart ? (prf64 ? SMART_TX_CH_4_PRF_64MHz : SMART_TX_CH_4_PRF_16MHz)
+				: (prf64 ? MANUAL_TX_CH_4_PRF_64MHz : MANUAL_TX_CH_4_PRF_16MHz);
+#endif
+#if DW1000_HAS_CHANNEL(5)
+		case 5:
+			return smart ? (prf64 ? SMART_TX_CH_5_PRF_64MHz : SMART_TX_CH_5_PRF_16MHz)
+				: (prf64 ? MANUAL_TX_CH_5_PRF_64MHz : MANUAL_TX_CH_5_PRF_16MHz);
+#endif
+#if DW1000_HAS_CHANNEL(7)
+		case 7:
+			return smart ? (prf64 ? SMART_TX_CH_7_PRF_64MHz : SMART_TX_CH_7_PRF_16MHz)
+				: (prf64 ? MANUAL_TX_CH_7_PRF_64MHz : MANUAL_TX_CH_7_PRF_16MHz);
+#endif
+		default:
+			return 0;
+	}
+}
+
+/*
+ * Set the preamble code for TX and RX (CHAN_CTRL, along with the channel
+ * and PRF) and the matching LDE replica coefficient. Valid codes depend on
+ * channel and PRF (see user manual, table 61), e.g. 3 or 4 on channel 5 at
+ * 16MHz PRF.
+ */
+void DW1000::setPreambleCode(byte code) {
+	if(code < 1 || code > 24) {
+		return; // TODO proper error handling: invalid preamble code
+	}
+	_preambleCode = code;
+	writeChannelControl();
+	writeValue(LDE_IF, SUB_2804, ldeReplicaCoefficient(code, _dataRate), LEN_LDE_REPC);
+}
+
+byte DW1000::getPreambleCode() {
+	return _preambleCode;
+}
+
+/*
+ * Lowest preamble code of a channel and PRF (see user manual, table 61),
+ * 0 for an invalid channel.
+ */
+byte DW1000::defaultPreambleCode(byte channel, byte prf) {
+	if(!DW1000_VALID_CHANNEL(channel) || !DW1000_VALID_PRF(prf)) {
+		return 0;
+	}
+	return DW1000_FIRST_CODE(channel, prf);
+}
+
+#ifdef __AVR__
+const word DW1000::LDE_REPC[24] PROGMEM = {
+#else
+const word DW1000::LDE_REPC[24] = {
+#endif
+	LDE_REPC_RX_PCODE_1,  LDE_REPC_RX_PCODE_2,  LDE_REPC_RX_PCODE_3,  LDE_REPC_RX_PCODE_4,
+	LDE_REPC_RX_PCODE_5,  LDE_REPC_RX_PCODE_6,  LDE_REPC_RX_PCODE_7,  LDE_REPC_RX_PCODE_8,
+	LDE_REPC_RX_PCODE_9,  LDE_REPC_RX_PCODE_10, LDE_REPC_RX_PCODE_11, LDE_REPC_RX_PCODE_12,
+	LDE_REPC_RX_PCODE_13, LDE_REPC_RX_PCODE_14, LDE_REPC_RX_PCODE_15, LDE_REPC_RX_PCODE_16,
+	LDE_REPC_RX_PCODE_17, LDE_REPC_RX_PCODE_18, LDE_REPC_RX_PCODE_19, LDE_REPC_RX_PCODE_20,
+	LDE_REPC_RX_PCODE_21, LDE_REPC_RX_PCODE_22, LDE_REPC_RX_PCODE_23, LDE_REPC_RX_PCODE_24
+};
+
+/*
+ * LDE replica coefficient for a preamble code, divided by 8 at 110kbps
+ * (see user manual, sec. 7.2.47.7).
+ */
+word DW1000::ldeReplicaCoefficient(byte code, byte rate) {
+	word repc;
+
+	if(code < 1 || code > 24) {
+		return 0;
 	}
-	writeBytes(RF_CONF, SUB_B, &_chSettings[0], 1);	// Receive settings
-	writeBytes(RF_CONF, SUB_C, &_chSettings[1], 4);	// Transmit settings
-	writeBytes(TX_CAL, SUB_B, &_chSettings[5], 2);	// Transmit settings
-	writeBytes(FS_CTRL, SUB_7, &_chSettings[7], 4);	// Frequency PLL settings
-	writeBytes(FS_CTRL, SUB_B, &_chSettings[11], 2);// Frequency PLL Settings
+#ifdef __AVR__
+	repc = pgm_read_word(&LDE_REPC[code - 1]);
+#else
+	repc = LDE_REPC[code - 1];
+#endif
+	if(rate == TX_RATE_110KBPS) {
+		repc >>= 3;
+	}
+	return repc;
 }
 
 void DW1000::newReceive() {
@@ -469,8 +1116,8 @@ void DW1000::newReceive() {
 }
 
 void DW1000::startReceive() {
-	setBit(_sysctrl, LEN_SYS_CTRL, RXENAB_BIT, true);
-	writeBytes(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
+	RXENAB::set(_sysctrl, true);
+	writeRegister<SysCtrl>(_sysctrl);
 }
 
 void DW1000::cancelReceive() {
@@ -484,6 +1131,7 @@ void DW1000::newTransmit() {
 	// clear out SYS_CTRL for a new transmit operation
 	memset(_sysctrl, 0, LEN_SYS_CTRL);
 	memset(_txfctrl, 0, LEN_TX_FCTRL);
+	_powerOverride = false;
 	_deviceMode = TX_MODE;
 	_frameCheckSuppressed = false;
 }
@@ -505,52 +1153,265 @@ void DW1000::cancelTransmit() {
 
 void DW1000::startTransmit() {
 	// set transmit flag
-	bitSet(_sysctrl[0], TXSTRT_BIT);
+	TXSTRT::set(_sysctrl, true);
+	beginBatch();
+	// per-frame power, or back to the table value after an overridden frame
+	if(_powerOverride) {
+		writeTransmitPower(0x01010101UL * _overridePower);
+		_powerOverridden = true;
+	} else if(_powerOverridden) {
+		writeTransmitPower(getTransmitPower());
+	}
 	// TODO ... write to device (_sysctrl, _txfctrl)
-	writeBytes(TX_FCTRL, NO_SUB, _txfctrl, LEN_TX_FCTRL);
-	writeBytes(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
+	writeRegister<TxFctrl>(_txfctrl);
+	writeRegister<SysCtrl>(_sysctrl);
+	endBatch();
+	memcpy(_txfctrlWritten, _txfctrl, LEN_TX_FCTRL);
+	_txfctrlKnown = true;
 	
 	// reset to idel
 	_deviceMode = IDLE_MODE;
 }
 
+/*
+ * Build a transmit template: the TX_FCTRL image (data rate, PRF, preamble
+ * length and the frame length with the CRC-16 appended by the device), the
+ * SYS_CTRL byte that starts the transmission and the frame.
+ * @param rate
+ *		The data rate (TX_RATE_*).
+ * @param prf
+ *		The pulse repetition frequency (TX_PULSE_FREQ_*).
+ * @param preamble
+ *		The preamble length (TX_PREAMBLE_LEN_*).
+ * @param data
+ *		The frame without CRC-16, variable fields are patched before each
+ *		transmit (see patchTemplate()).
+ * @param n
+ *		The frame length, at most LEN_FRAME_TEMPLATE.
+ * @param options
+ *		TEMPLATE_RANGING and TEMPLATE_WAIT_RESPONSE, or 0.
+ * Returns false for invalid arguments.
+ */
+boolean DW1000::prepareTemplate(DW1000FrameTemplate* frame, byte rate, byte prf, byte preamble,
+		const byte data[], int n, byte options) {
+	if(n < 0 || n > LEN_FRAME_TEMPLATE || !DW1000_VALID_RATE(rate) || !DW1000_VALID_PRF(prf)
+			|| DW1000_PREAMBLE_SYMBOLS(preamble) == 0) {
+		return false;
+	}
+	memset(frame->txfctrl, 0, LEN_TX_FCTRL);
+	TFLEN::set(frame->txfctrl, n + 2); // two bytes CRC-16, appended by the device
+	TXBR::set(frame->txfctrl, rate);
+	TXPRF::set(frame->txfctrl, prf);
+	TXPSR_PE::set(frame->txfctrl, preamble);
+	TR::set(frame->txfctrl, (options & TEMPLATE_RANGING) != 0);
+	// the other SYS_CTRL bits only act when set
+	frame->sysctrl = 0;
+	bitSet(frame->sysctrl, TXSTRT_BIT);
+	if(options & TEMPLATE_WAIT_RESPONSE) {
+		bitSet(frame->sysctrl, WAIT4RESP_BIT);
+	}
+	memcpy(frame->data, data, n);
+	frame->length = (byte)n;
+	frame->dirtyStart = 0;
+	frame->dirtyEnd = (byte)n;
+	return true;
+}
+
+/*
+ * Change bytes of a template frame, e.g. the sequence number, destination
+ * or timestamps. Returns false if they are not within the frame.
+ */
+boolean DW1000::patchTemplate(DW1000FrameTemplate* frame, int offset, const byte data[], int n) {
+	if(offset < 0 || n < 0 || offset + n > frame->length) {
+		return false;
+	}
+	if(n == 0) {
+		return true;
+	}
+	memcpy(&frame->data[offset], data, n);
+	if(frame->dirtyStart >= frame->dirtyEnd) {
+		frame->dirtyStart = (byte)offset;
+		frame->dirtyEnd = (byte)(offset + n);
+	} else {
+		if(offset < frame->dirtyStart) {
+			frame->dirtyStart = (byte)offset;
+		}
+		if(offset + n > frame->dirtyEnd) {
+			frame->dirtyEnd = (byte)(offset + n);
+		}
+	}
+	return true;
+}
+
+/*
+ * Transmit a template in one batch: the patched bytes (the whole frame if
+ * another frame was written since), the bytes of TX_FCTRL that differ from
+ * the last value written and the SYS_CTRL byte. Replaces newTransmit(),
+ * the rate setters, setData() and startTransmit(); the frame check and the
+ * table TX power are used.
+ * Returns the number of writes.
+ */
+int DW1000::transmitTemplate(DW1000FrameTemplate* frame) {
+	int writes = 1;
+
+	beginBatch();
+	if(_powerOverridden) {
+		writeTransmitPower(getTransmitPower());
+		_powerOverridden = false;
+		writes++;
+	}
+	if(_txTemplate != frame) {
+		writeBytes(TX_BUFFER, NO_SUB, frame->data, frame->length);
+		writes++;
+	} else if(frame->dirtyStart < frame->dirtyEnd) {
+		// NO_SUB is sub-address 0
+		writeBytes(TX_BUFFER, frame->dirtyStart, &frame->data[frame->dirtyStart],
+			frame->dirtyEnd - frame->dirtyStart);
+		writes++;
+	}
+	if(_txfctrlKnown) {
+		writes += writeChanged(TX_FCTRL, NO_SUB, frame->txfctrl, _txfctrlWritten, LEN_TX_FCTRL);
+	} else {
+		writeBytes(TX_FCTRL, NO_SUB, frame->txfctrl, LEN_TX_FCTRL);
+		writes++;
+	}
+	writeBytes(SYS_CTRL, NO_SUB, &frame->sysctrl, 1);
+	endBatch();
+	memcpy(_txfctrlWritten, frame->txfctrl, LEN_TX_FCTRL);
+	_txfctrlKnown = true;
+	_txTemplate = frame;
+	frame->dirtyStart = 0;
+	frame->dirtyEnd = 0;
+	_powerOverride = false;
+	_deviceMode = IDLE_MODE;
+	return writes;
+}
+
 void DW1000::setData(byte data[], int n) {
+	int len = n;
+
 	if(!_frameCheckSuppressed) {
-		n+=2; // two bytes CRC-16
+		len+=2; // two bytes CRC-16, appended by the device
 	}
-	if(n > LEN_TX_BUFFER) {
+	if(n < 0 || !isFrameLengthValid(len)) {
 		return; // TODO proper error handling: frame/buffer size
 	}
-	if(!_extendedFrameLength && n > LEN_UWB_FRAMES ||
-		_extendedFrameLength && n > LEN_EXT_UWB_FRAMES) {
+	// transmit data (payload only) and frame length
+	writeBytes(TX_BUFFER, NO_SUB, data, n);
+	_txTemplate = NULL;
+	TFLEN::set(_txfctrl, len);
+}
+
+/*
+ * Write the payload followed by a CRC-16 computed on the host, the device
+ * does not append its own (frame check suppressed, SFCST). The payload is
+ * not copied, payload and CRC are two writes of one batch.
+ * @param data
+ *		The payload (without CRC-16).
+ * @param n
+ *		The length of the payload.
+ */
+void DW1000::setDataWithFrameCheck(byte data[], int n) {
+	byte fcs[LEN_FCS];
+	word crc;
+
+	if(n < 0 || !isFrameLengthValid(n + LEN_FCS)) {
 		return; // TODO proper error handling: frame/buffer size
 	}
-	// transmit data and length
+	suppressFrameCheck();
+	crc = DW1000Crc::compute(data, n);
+	fcs[0] = (byte)(crc & 0xFF);
+	fcs[1] = (byte)((crc >> 8) & 0xFF);
+	beginBatch();
 	writeBytes(TX_BUFFER, NO_SUB, data, n);
-	_txfctrl[0] = (byte)(n & 0xFF); // 1 byte regular length
-	_txfctrl[1] |= (byte)((n >> 8) & 0x07);	// 3 added bits if extended length
+	writeBytes(TX_BUFFER, n, fcs, LEN_FCS);
+	endBatch();
+	_txTemplate = NULL;
+	TFLEN::set(_txfctrl, n + LEN_FCS);
+}
+
+boolean DW1000::isFrameLengthValid(int len) {
+	if(len > LEN_TX_BUFFER) {
+		return false;
+	}
+	if(len > (_extendedFrameLength ? LEN_EXT_UWB_FRAMES : LEN_UWB_FRAMES)) {
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Read the payload of the last received frame (without the CRC-16).
+ * @param data
+ *		The array to read the payload into.
+ * @param n
+ *		The size of the array, longer frames are truncated.
+ * Returns the number of bytes read.
+ */
+int DW1000::getData(byte data[], int n) {
+	byte rxfinfo[LEN_RX_FINFO];
+	int len;
+
+	readBytes(RX_FINFO, NO_SUB, rxfinfo, LEN_RX_FINFO);
+	// RXFLEN and RXFLE (extended length) bits
+	len = rxfinfo[0] | ((rxfinfo[1] & 0x03) << 8);
+	len -= 2; // two bytes CRC-16
+	if(len < 0) {
+		len = 0;
+	} else if(len > n) {
+		len = n;
+	}
+	readBytes(RX_BUFFER, NO_SUB, data, len);
+	return len;
+}
+
+/*
+ * Read the last received frame including its CRC-16, e.g. to relay it
+ * unchanged (suppressFrameCheck() and setData() with the whole frame) or
+ * to check it on the host (DW1000Crc::check()).
+ * @param data
+ *		The array to read the frame into.
+ * @param n
+ *		The size of the array, longer frames are truncated.
+ * Returns the number of bytes read.
+ */
+int DW1000::getFrame(byte data[], int n) {
+	byte rxfinfo[LEN_RX_FINFO];
+	int len;
+
+	readBytes(RX_FINFO, NO_SUB, rxfinfo, LEN_RX_FINFO);
+	len = rxfinfo[0] | ((rxfinfo[1] & 0x03) << 8);
+	if(len > n) {
+		len = n;
+	}
+	readBytes(RX_BUFFER, NO_SUB, data, len);
+	return len;
 }
 
 // system event register
+void DW1000::readSystemEventStatus(byte status[]) {
+	readBytes(SYS_STATUS, NO_SUB, status, LEN_SYS_STATUS);
+}
+
 boolean DW1000::isTransmitDone() {
 	byte data[LEN_SYS_STATUS];
 	// read whole register and check bit
-	readBytes(SYS_STATUS, data, LEN_SYS_STATUS);
-	return getBit(data, LEN_SYS_STATUS, TXFRS_BIT);
+	readRegister<SysStatus>(data);
+	return TXFRS::get(data);
 }
 
 boolean DW1000::isLDEDone() {
 	byte data[LEN_SYS_STATUS];
 	// read whole register and check bit
-	readBytes(SYS_STATUS, data, LEN_SYS_STATUS);
-	return getBit(data, LEN_SYS_STATUS, LDEDONE_BIT);
+	readRegister<SysStatus>(data);
+	return LDEDONE::get(data);
 }
 
 boolean DW1000::isReceiveDone() {
 	byte data[LEN_SYS_STATUS];
 	// read whole register and check bit
-	readBytes(SYS_STATUS, data, LEN_SYS_STATUS);
-	return getBit(data, LEN_SYS_STATUS, RXDFR_BIT);
+	readRegister<SysStatus>(data);
+	return RXDFR::get(data);
 }
 
 boolean DW1000::isReceiveSuccess() {
@@ -558,17 +1419,17 @@ boolean DW1000::isReceiveSuccess() {
 	boolean ldeDone, ldeErr, rxGood, rxErr, rxDecodeErr;
 	
 	// read whole register and check bits
-	readBytes(SYS_STATUS, data, LEN_SYS_STATUS);
+	readRegister<SysStatus>(data);
 	// first check for errors
-	ldeErr = getBit(data, LEN_SYS_STATUS, LDEERR_BIT);
-	rxErr = getBit(data, LEN_SYS_STATUS, RXFCE_BIT);
-	rxDecodeErr = getBit(data, LEN_SYS_STATUS, RXRFSL_BIT);
+	ldeErr = LDEERR::get(data);
+	rxErr = RXFCE::get(data);
+	rxDecodeErr = RXRFSL::get(data);
 	if(ldeErr || rxErr || rxDecodeErr) {
 		return false; 
 	}
 	// no errors, check for success indications
-	rxGood = getBit(data, LEN_SYS_STATUS, RXFCG_BIT);
-	ldeDone = getBit(data, LEN_SYS_STATUS, LDEDONE_BIT);
+	rxGood = RXFCG::get(data);
+	ldeDone = LDEDONE::get(data);
 	if(rxGood && ldeDone) {
 		return true;
 	}
@@ -576,24 +1437,358 @@ boolean DW1000::isReceiveSuccess() {
 	return false;
 }
 
+/*
+ * Whether reception ended without a frame: frame wait, preamble detection
+ * or SFD timeout.
+ */
+boolean DW1000::isReceiveTimeout() {
+	byte data[LEN_SYS_STATUS];
+
+	readRegister<SysStatus>(data);
+	return RXRFTO::get(data) || RXPTO::get(data) || RXSFDTO::get(data);
+}
+
 void DW1000::clearReceiveStatus() {
 	byte data[LEN_SYS_STATUS];
-	
-	// read whole register
-	readBytes(SYS_STATUS, data, LEN_SYS_STATUS);
-	// clear latched RX bits (i.e. write 1 to clear)
-	setBit(data, LEN_SYS_STATUS, RXDFR_BIT, true);
-	setBit(data, LEN_SYS_STATUS, LDEDONE_BIT, true);
-	setBit(data, LEN_SYS_STATUS, LDEERR_BIT, true);
-	setBit(data, LEN_SYS_STATUS, RXFCE_BIT, true);
-	setBit(data, LEN_SYS_STATUS, RXFCG_BIT, true);
-	setBit(data, LEN_SYS_STATUS, RXRFSL_BIT, true);
-	writeBytes(SYS_STATUS, NO_SUB, data, LEN_SYS_STATUS);
+
+	// only the latched RX bits (i.e. write 1 to clear), other events
+	// stay pending, one write of the bytes they cover
+	memset(data, 0, LEN_SYS_STATUS);
+	RXDFR::set(data, true);
+	LDEDONE::set(data, true);
+	LDEERR::set(data, true);
+	RXPHE::set(data, true);
+	RXFCE::set(data, true);
+	RXFCG::set(data, true);
+	RXRFSL::set(data, true);
+	RXRFTO::set(data, true);
+	RXPTO::set(data, true);
+	RXSFDTO::set(data, true);
+	writeFields<RX_EVENTS>(data);
 }
 
 void DW1000::clearTransmitStatus() {
-	// FIXME impl
-	// setBit(data, LEN_SYS_STATUS, TXFRS_BIT, true);
+	byte data[LEN_SYS_STATUS];
+
+	// only the latched TX bits (i.e. write 1 to clear)
+	memset(data, 0, LEN_SYS_STATUS);
+	TX_EVENTS::set(data, 0x0F);
+	writeFields<TX_EVENTS>(data);
+}
+
+// timestamps
+void DW1000::readReceiveTimestamp(byte timestamp[]) {
+	readBytes(RX_TIME, RX_STAMP_SUB, timestamp, LEN_RX_STAMP_SUB);
+}
+
+void DW1000::readTransmitTimestamp(byte timestamp[]) {
+	readBytes(TX_TIME, TX_STAMP_SUB, timestamp, LEN_TX_STAMP_SUB);
+}
+
+/*
+ * Convert a 40 bit timestamp as read from the chip (LSB first) to a number.
+ * @param timestamp
+ *		The LEN_STAMP bytes of the timestamp.
+ */
+int64_t DW1000::toTimestamp(byte timestamp[]) {
+	int64_t value = 0;
+	int i;
+
+	for(i = LEN_STAMP - 1; i >= 0; i--) {
+		value = (value << 8) | timestamp[i];
+	}
+	return value;
+}
+
+/*
+ * Convert a number to a 40 bit timestamp (LSB first), e.g. for sending it.
+ * @param value
+ *		The timestamp, higher bits are ignored.
+ * @param timestamp
+ *		The LEN_STAMP bytes to write to.
+ */
+void DW1000::timestampToBytes(int64_t value, byte timestamp[]) {
+	int i;
+
+	for(i = 0; i < LEN_STAMP; i++) {
+		timestamp[i] = (byte)(value & 0xFF);
+		value >>= 8;
+	}
+}
+
+/*
+ * Difference of two 40 bit timestamps, taking a single wrap-around of the
+ * device time counter into account.
+ * @param to
+ *		The later timestamp.
+ * @param from
+ *		The earlier timestamp.
+ */
+int64_t DW1000::timestampDiff(int64_t to, int64_t from) {
+	int64_t diff = to - from;
+
+	if(diff < 0) {
+		diff += TIME_OVERFLOW;
+	}
+	return diff;
+}
+
+/*
+ * Read the 21 bit signed carrier integrator of the last received frame. It
+ * reflects the carrier frequency offset between remote transmitter and the
+ * local receiver (see user manual, sec. 7.2.40.11).
+ */
+long DW1000::readCarrierIntegrator() {
+	byte data[LEN_DRX_CAR_INT];
+	long value;
+
+	readBytes(DRX_TUNE, DRX_CAR_INT_SUB, data, LEN_DRX_CAR_INT);
+	value = ((long)(data[2] & 0x1F) << 16) | ((long)data[1] << 8) | data[0];
+	// sign extend from bit 20
+	if(value & 0x100000L) {
+		value -= 0x200000L;
+	}
+	return value;
+}
+
+// antenna delays
+void DW1000::setAntennaDelay(word txDelay, word rxDelay) {
+	byte data[LEN_TX_ANTD];
+
+	_txAntennaDelay = txDelay;
+	_rxAntennaDelay = rxDelay;
+	data[0] = (byte)(txDelay & 0xFF);
+	data[1] = (byte)((txDelay >> 8) & 0xFF);
+	writeBytes(TX_ANTD, NO_SUB, data, LEN_TX_ANTD);
+	data[0] = (byte)(rxDelay & 0xFF);
+	data[1] = (byte)((rxDelay >> 8) & 0xFF);
+	writeBytes(LDE_IF, SUB_1804, data, LEN_LDE_RXANTD);
+}
+
+/*
+ * Sample the on-chip SAR converter (see user manual, sec. 6.4). Values are
+ * raw: one temperature LSB is about 1.14 degree C, one voltage LSB is
+ * about 1/173 V. Absolute values need the OTP references; deltas do not.
+ * @param temp
+ *		The raw temperature reading.
+ * @param vbat
+ *		The raw battery voltage reading.
+ */
+void DW1000::readTempAndVoltage(byte* temp, byte* vbat) {
+	byte data[LEN_TC_SARL];
+
+	// enable the SAR and start a single conversion
+	data[0] = 0x80;
+	writeBytes(RF_CONF, RF_SAR_SUB, data, 1);
+	data[0] = 0x0A;
+	writeBytes(RF_CONF, RF_SAR_CTRL_SUB, data, 1);
+	data[0] = 0x0F;
+	writeBytes(RF_CONF, RF_SAR_CTRL_SUB, data, 1);
+	data[0] = 0x00;
+	writeBytes(TX_CAL, TC_SARC_SUB, data, 1);
+	data[0] = 0x01;
+	writeBytes(TX_CAL, TC_SARC_SUB, data, 1);
+	// conversion is done well within one SPI transaction, read both values
+	readBytes(TX_CAL, TC_SARL_SUB, data, LEN_TC_SARL);
+	*vbat = data[0];
+	*temp = data[1];
+	// stop the SAR again
+	data[0] = 0x00;
+	writeBytes(TX_CAL, TC_SARC_SUB, data, 1);
+}
+
+/*
+ * Configure sleep and wake-up (see user manual, sec. 7.2.44). On wake-up the
+ * AON array restores the configuration saved by enterSleep() (ONW_LDC) and
+ * the LDE microcode and LDO tuning are reloaded (ONW_LLDE, ONW_LLDO), so
+ * there is no need to run setDefaultMode()/setRFChannel() again. The device
+ * always wakes on SPI activity (CS low) and on the WAKEUP pin.
+ * @param sleepTime
+ *		Wake-up after this many sleep counter units (upper 16 bits of the 28
+ *		bit low-power oscillator counter, ~0.3s each at 13kHz), or 0 for
+ *		deep sleep without the oscillator running.
+ */
+void DW1000::configureSleep(word sleepTime) {
+	word wcfg = 0;
+	byte data[LEN_AON_WCFG];
+
+	bitSet(wcfg, ONW_LDC_BIT);
+	bitSet(wcfg, ONW_LLDE_BIT);
+	bitSet(wcfg, ONW_LLDO_BIT);
+	// re-arm sleep on wake-up, the next enterSleep() is a single save
+	bitSet(wcfg, PRES_SLEEP_BIT);
+	data[0] = (byte)(wcfg & 0xFF);
+	data[1] = (byte)((wcfg >> 8) & 0xFF);
+	writeBytes(AON, AON_WCFG_SUB, data, LEN_AON_WCFG);
+
+	if(sleepTime > 0) {
+		// stop the counter, upload the new count and restart it
+		data[0] = 0x00;
+		writeBytes(AON, AON_CFG1_SUB, data, 1);
+		uploadAonConfiguration();
+		data[0] = (byte)(sleepTime & 0xFF);
+		data[1] = (byte)((sleepTime >> 8) & 0xFF);
+		writeBytes(AON, AON_SLEEP_TIM_SUB, data, LEN_AON_SLEEP_TIM);
+		data[0] = 0x00;
+		bitSet(data[0], SLEEP_CE_BIT);
+		bitSet(data[0], LPOSC_C_BIT);
+		writeBytes(AON, AON_CFG1_SUB, data, 1);
+		uploadAonConfiguration();
+	}
+
+	data[0] = 0x00;
+	bitSet(data[0], SLEEP_EN_BIT);
+	bitSet(data[0], WAKE_PIN_BIT);
+	bitSet(data[0], WAKE_SPI_BIT);
+	if(sleepTime > 0) {
+		bitSet(data[0], WAKE_CNT_BIT);
+	}
+	writeBytes(AON, AON_CFG0_SUB, data, 1);
+}
+
+/*
+ * Save the configuration to the AON array and go to (deep) sleep as set
+ * up with configureSleep(). Any SPI access wakes the device up again, use
+ * wakeUp() for that.
+ */
+void DW1000::enterSleep() {
+	byte data[1];
+
+	data[0] = 0x00;
+	writeBytes(AON, AON_CTRL_SUB, data, 1);
+	bitSet(data[0], SAVE_BIT);
+	writeBytes(AON, AON_CTRL_SUB, data, 1);
+	_deviceMode = IDLE_MODE;
+	_sleeping = true;
+	// the TX buffer is not kept
+	_txfctrlKnown = false;
+	_txTemplate = NULL;
+	// the PLL is off until the device is ready again
+	_awakeSpiClock = _spiClock;
+	setSpiClock(SPI_CLOCK_SLOW);
+}
+
+/*
+ * Wake the device up by holding CS low, wait (at the slow SPI clock) until
+ * it answers with its device id and restore what the AON array does not
+ * keep (antenna delays, one write each). Wake-up from sleep and deep sleep
+ * takes ~3ms, mostly crystal start-up (see getWakeUpTime()).
+ * Returns false if the device did not become ready in WAKE_TIMEOUT.
+ */
+boolean DW1000::wakeUp() {
+	boolean ready = false;
+#ifndef DEBUG
+	unsigned long start = micros();
+
+#ifdef DW1000_LINUX
+	_spidev.select(WAKE_CS_HOLD);
+#else
+	digitalWrite(_ss, LOW);
+	delayMicroseconds(WAKE_CS_HOLD);
+	digitalWrite(_ss, HIGH);
+#endif
+	do {
+		ready = checkDeviceIdentifier();
+	} while(!ready && micros() - start < WAKE_TIMEOUT);
+	_wakeUpTime = micros() - start;
+#else
+	ready = checkDeviceIdentifier();
+#endif
+	if(!ready) {
+		return false;
+	}
+	setSpiClock(_awakeSpiClock);
+	_sleeping = false;
+	setAntennaDelay(_txAntennaDelay, _rxAntennaDelay);
+	return true;
+}
+
+boolean DW1000::isSleeping() {
+	return _sleeping;
+}
+
+/*
+ * Duration of the last wakeUp() in microseconds, CS pulse included.
+ */
+unsigned long DW1000::getWakeUpTime() {
+	return _wakeUpTime;
+}
+
+/*
+ * Continuous wave on the configured channel (setRFChannel()), e.g. for
+ * frequency and power measurements. The PLL is started from the crystal
+ * clock, then the TX blocks are enabled and the pulse generator is set to
+ * CW test. Ends with exitTestMode().
+ */
+void DW1000::startContinuousWave() {
+	byte data[1];
+
+	writeClocks(PMSC_SYSCLKS_XTI);
+	writeRfConfiguration(RF_CONF_TXPLLPOWEN);
+	writeRfConfiguration(RF_CONF_TXALLEN);
+	writeClocks(PMSC_CLKS_PLL);
+	data[0] = TC_PGTEST_CW;
+	writeBytes(TX_CAL, TC_PGTEST_SUB, data, 1);
+	_testMode = true;
+}
+
+/*
+ * Continuous frame mode: the frame set up with newTransmit(), the TX
+ * settings and setData() is sent over and over at a fixed repetition
+ * interval, until exitTestMode().
+ * @param interval
+ *		Start to start interval of the frames in us. Intervals shorter than
+ *		the frame itself send the frames back to back.
+ */
+void DW1000::startContinuousFrame(unsigned long interval) {
+	byte data[LEN_TEST_INTERVAL];
+	unsigned long units;
+	int i;
+
+	// TX blocks on without RX/TX sequencing, system and TX clocks from the PLL
+	writeRfConfiguration(RF_CONF_TXALLEN);
+	writeClocks(PMSC_CLKS_PLL);
+	// 124.8 units per us, at least 4 units, 32 bit
+	if(interval >= 0xFFFFFFFFUL / 125) {
+		units = 0xFFFFFFFFUL;
+	} else {
+		units = interval * 125 - interval / 5;
+	}
+	if(units < 4) {
+		units = 4;
+	}
+	for(i = 0; i < LEN_TEST_INTERVAL; i++) {
+		data[i] = (byte)((units >> (8 * i)) & 0xFF);
+	}
+	writeBytes(DX_TIME, NO_SUB, data, LEN_TEST_INTERVAL);
+	data[0] = 0x00;
+	data[1] = 0x00;
+	bitSet(data[0], TX_PSTM_BIT);
+	writeBytes(DIG_DIAG, DIAG_TMC_SUB, data, LEN_DIAG_TMC);
+	_testMode = true;
+	startTransmit();
+}
+
+/*
+ * Leave continuous wave or frame mode: test registers cleared, RF blocks
+ * and clocks back to automatic sequencing, transceiver off. The chip
+ * manual recommends a reset after continuous frames if anything else
+ * misbehaves afterwards.
+ */
+void DW1000::exitTestMode() {
+	byte data[LEN_DIAG_TMC];
+
+	memset(data, 0, LEN_DIAG_TMC);
+	writeBytes(TX_CAL, TC_PGTEST_SUB, data, 1);
+	writeBytes(DIG_DIAG, DIAG_TMC_SUB, data, LEN_DIAG_TMC);
+	writeRfConfiguration(0);
+	writeClocks(PMSC_CLKS_AUTO);
+	_testMode = false;
+	idle();
+}
+
+boolean DW1000::isTestMode() {
+	return _testMode;
 }
 
 /* ###########################################################################
@@ -601,84 +1796,155 @@ void DW1000::clearTransmitStatus() {
  * ######################################################################### */
 
 /*
- * Set the value of a bit in an array of bytes that are considered
- * consecutive and stored from MSB to LSB.
- * @param data
- * 		The number as byte array.
- * @param n
- * 		The number of bytes in the array.
- * @param bit
- * 		The position of the bit to be set.
- * @param val
- *		The boolean value to be set to the given bit position.
- */
-void DW1000::setBit(byte data[], int n, int bit, boolean val) {
-	int idx;
-	int shift;
-	byte mask;
-
-	idx = bit / 8;
-	if(idx >= n) {
-		return; // TODO proper error handling: out of bounds
-	}
-	byte* targetByte = &data[idx];
-	if(val) {
-		bitSet(*targetByte, shift);
-	} else {
-		bitClear(*targetByte, shift);
-	}
+ * Enable RF blocks (RF_CONF), 0 returns them to automatic RX/TX sequencing.
+ */
+void DW1000::writeRfConfiguration(unsigned long conf) {
+	writeValue(RF_CONF, RF_CONF_SUB, conf, LEN_RF_CONF);
 }
 
 /*
- * Check the value of a bit in an array of bytes that are considered
- * consecutive and stored from MSB to LSB.
- * @param data
- * 		The number as byte array.
+ * Write TX_POWER (also ends an override).
+ */
+void DW1000::writeTransmitPower(unsigned long power) {
+	writeValue(TX_POWER, NO_SUB, power, LEN_TX_POWER);
+	_powerOverridden = false;
+}
+
+/*
+ * Write channel, PRF and preamble code for TX and RX (CHAN_CTRL).
+ */
+void DW1000::writeChannelControl() {
+	writeValue(CHAN_CTRL, NO_SUB, channelControl(_channel, _pulseFrequency, _preambleCode), LEN_CHAN_CTRL);
+}
+
+/*
+ * CHAN_CTRL value: same channel and preamble code for TX and RX.
+ */
+unsigned long DW1000::channelControl(byte channel, byte prf, byte code) {
+	unsigned long chanctrl;
+
+	chanctrl = (unsigned long)channel | ((unsigned long)channel << 4);
+	chanctrl |= (unsigned long)prf << RXPRF_SHIFT;
+	chanctrl |= (unsigned long)code << TX_PCODE_SHIFT;
+	chanctrl |= (unsigned long)code << RX_PCODE_SHIFT;
+	return chanctrl;
+}
+
+/*
+ * Force the system and TX clock sources (PMSC_CTRL0 low byte).
+ */
+void DW1000::writeClocks(byte clocks) {
+	byte data[1];
+
+	data[0] = clocks;
+	writeBytes(PMSC, PMSC_CTRL0_SUB, data, 1);
+}
+
+/*
+ * Write a value of up to 4 bytes, LSB first.
  * @param n
- * 		The number of bytes in the array.
- * @param bit
- * 		The position of the bit to be checked.
+ *		The number of bytes (of the value) to be written.
  */
-boolean DW1000::getBit(byte data[], int n, int bit) {
-	int idx;
-	int shift;
+void DW1000::writeValue(byte cmd, word offset, unsigned long value, int n) {
+	byte data[4];
+	int i;
 
-	idx = bit / 8;
-	if(idx >= n) {
-		return false; // TODO proper error handling: out of bounds
+	for(i = 0; i < n && i < 4; i++) {
+		data[i] = (byte)((value >> (8 * i)) & 0xFF);
 	}
-	byte targetByte = data[idx];
-	shift = bit % 8;
-	
-	return bitRead(targetByte, shift);
+	writeBytes(cmd, offset, data, i);
+}
+
+/*
+ * Read a 32 bit word from the OTP memory: address and read command in one
+ * write, clear the command, read the data.
+ */
+unsigned long DW1000::readOTP(word address) {
+	byte data[LEN_OTP_RDAT];
+
+	data[0] = (byte)(address & 0xFF);
+	data[1] = (byte)((address >> 8) & 0xFF);
+	data[2] = 0x00;
+	bitSet(data[2], OTPRDEN_BIT);
+	bitSet(data[2], OTPREAD_BIT);
+	data[3] = 0x00;
+	writeBytes(OTP_IF, OTP_ADDR_SUB, data, 4);
+	data[0] = 0x00;
+	writeBytes(OTP_IF, OTP_CTRL_SUB, data, 1);
+	readBytes(OTP_IF, OTP_RDAT_SUB, data, LEN_OTP_RDAT);
+	return (unsigned long)data[0] | ((unsigned long)data[1] << 8) |
+		((unsigned long)data[2] << 16) | ((unsigned long)data[3] << 24);
+}
+
+/*
+ * Copy the AON configuration registers (AON_CFG0/1) to the AON block.
+ */
+void DW1000::uploadAonConfiguration() {
+	byte data[1];
+
+	data[0] = 0x00;
+	writeBytes(AON, AON_CTRL_SUB, data, 1);
+	bitSet(data[0], UPL_CFG_BIT);
+	writeBytes(AON, AON_CTRL_SUB, data, 1);
 }
 
 /*
  * Read bytes from the DW1000. Number of bytes depend on register length.
  * @param cmd 
  * 		The register address (see Chapter 7 in the DW1000 user manual).
+ * @param offset
+ *		The offset to select register sub-parts for reading, or 0x00 to disable 
+ * 		sub-adressing.
  * @param data 
  *		The data array to be read into.
  * @param n
  *		The number of bytes expected to be received.
  */
-void DW1000::readBytes(byte cmd, byte data[], int n) {
+void DW1000::readBytes(byte cmd, word offset, byte data[], int n) {
+	byte header[3];
+	int headerLen = 1;
+#ifndef DW1000_LINUX
 	int i;
+#endif
 
-#ifndef DEBUG
+	if(offset == NO_SUB) {
+		header[0] = READ | cmd;
+	} else {
+		header[0] = READ_SUB | cmd;
+		if(offset < 128) {
+			header[1] = (byte)offset;
+			headerLen++;
+		} else {
+			header[1] = RW_SUB_EXT | (byte)offset;
+			header[2] = (byte)(offset >> 7);
+			headerLen+=2;
+		}
+	}
+
+	_spiBusy = true;
+#if defined(DW1000_LINUX)
+	// header and payload (and queued writes) in one ioctl
+	_spidev.transfer(header, headerLen, NULL, data, n);
+#elif !defined(DEBUG)
+	SPI.beginTransaction(_spiSettings);
 	digitalWrite(_ss, LOW);
-	SPI.transfer(READ | cmd);
-#endif
+	for(i = 0; i < headerLen; i++) {
+		SPI.transfer(header[i]);
+	}
 	for(i = 0; i < n; i++) {
-#ifndef DEBUG
 		data[i] = SPI.transfer(JUNK);
-#else
-		data[i] = debugBuffer[i];
-#endif
 	}
-#ifndef DEBUG
 	digitalWrite(_ss,HIGH);
+	SPI.endTransaction();
+#else
+	for(i = 0; i < n; i++) {
+		data[i] = i < DW1000_DEBUG_BUFFER ? debugBuffer[i] : 0;
+	}
 #endif
+	if(_transferHandler != NULL) {
+		(*_transferHandler)(_transferContext, false, header, headerLen, data, n);
+	}
+	_spiBusy = false;
 }
 
 /*
@@ -697,7 +1963,9 @@ void DW1000::readBytes(byte cmd, byte data[], int n) {
 void DW1000::writeBytes(byte cmd, word offset, byte data[], int n) {
 	byte header[3];
 	int headerLen = 1;
+#ifndef DW1000_LINUX
 	int i;
+#endif
 	// TODO proper error handling: address out of bounds
 	// TODO integrate SUB options
 
@@ -709,28 +1977,34 @@ void DW1000::writeBytes(byte cmd, word offset, byte data[], int n) {
 			header[1] = (byte)offset;
 			headerLen++;
 		} else {
-			header[1] = WRITE | (byte)offset;
+			header[1] = RW_SUB_EXT | (byte)offset;
 			header[2] = (byte)(offset >> 7);
 			headerLen+=2;
 		}
 	}
 	
-#ifndef DEBUG
+	_spiBusy = true;
+#if defined(DW1000_LINUX)
+	// queued during a batch
+	_spidev.transfer(header, headerLen, data, NULL, n);
+#elif !defined(DEBUG)
+	SPI.beginTransaction(_spiSettings);
 	digitalWrite(_ss, LOW);
-#endif
 	for(i = 0; i < headerLen; i++) {
-#ifndef DEBUG		
 		SPI.transfer(header[i]);
-#endif
 	}
 	for(i = 0; i < n; i++) {
-#ifndef DEBUG
 		SPI.transfer(data[i]);
+	}
+	digitalWrite(_ss,HIGH);
+	SPI.endTransaction();
 #else
+	for(i = 0; i < n && i < DW1000_DEBUG_BUFFER; i++) {
 		debugBuffer[i] = data[i];
-#endif
 	}
-#ifndef DEBUG
-	digitalWrite(_ss,HIGH);
 #endif
+	if(_transferHandler != NULL) {
+		(*_transferHandler)(_transferContext, true, header, headerLen, data, n);
+	}
+	_spiBusy = false;
 }
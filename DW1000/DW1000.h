@@ -29,6 +29,7 @@
 #define SUB_B  0x0B
 #define SUB_C  0x0C
 #define SUB_26 0x26
+#define SUB_1804 0x1804
 #define SUB_1806 0x1806
 #define SUB_2804 0x2804
 
@@ -43,6 +44,8 @@
 #define DIS_DRXB_BIT 12
 #define PHR_MODE_LSB 16
 #define PHR_MODE_MSB 17
+#define DIS_STXP_BIT 18
+#define RXWTOE_BIT 28
 #define RXAUTR_BIT 29
 
 // device control register
@@ -60,19 +63,43 @@
 // system event status register
 #define SYS_STATUS 0x0F
 #define LEN_SYS_STATUS 5
+#define CPLOCK_BIT 1
+#define TXFRB_BIT 4
+#define TXPRS_BIT 5
+#define TXPHS_BIT 6
 #define TXFRS_BIT 7
+#define RXPRD_BIT 8
+#define RXSFDD_BIT 9
 #define LDEDONE_BIT 10
+#define RXPHE_BIT 12
 #define RXDFR_BIT 13
 #define RXFCG_BIT 14
 #define RXFCE_BIT 15
 #define RXRFSL_BIT 16
+#define RXRFTO_BIT 17
 #define LDEERR_BIT 18
+#define RXPTO_BIT 21
+#define RXSFDTO_BIT 26
 
 // RX timestamp register
 #define RX_TIME 0x15
 #define LEN_RX_TIME 14
 #define RX_STAMP_SUB 0x00
 #define LEN_RX_STAMP_SUB 5
+#define FP_AMPL1_SUB 0x07
+
+// TX timestamp register
+#define TX_TIME 0x17
+#define LEN_TX_TIME 10
+#define TX_STAMP_SUB 0x00
+#define LEN_TX_STAMP_SUB 5
+
+// timestamps are 40 bit, one unit is 1/(128*499.2MHz) ~ 15.65ps
+#define LEN_STAMP 5
+
+// receive frame wait timeout, one unit is 512/499.2MHz ~ 1.026us
+#define RX_FWTO 0x0C
+#define LEN_RX_FWTO 2
 
 // timing register (for delayed RX/TX)
 #define DX_TIME 0x0A
@@ -84,20 +111,147 @@
 #define LEN_UWB_FRAMES 127
 #define LEN_EXT_UWB_FRAMES 1023
 
+// receive frame information and data buffer
+#define RX_FINFO 0x10
+#define LEN_RX_FINFO 4
+#define RXPACC_SHIFT 20
+#define RX_BUFFER 0x11
+
+// receive frame quality: noise, first path amplitudes 2 and 3, CIR power
+#define RX_FQUAL 0x12
+#define LEN_RX_FQUAL 8
+
 // transmit control
 #define TX_FCTRL 0x08
 #define LEN_TX_FCTRL 5
+#define TR_BIT 15
+
+// frame bytes of a transmit template (see DW1000FrameTemplate)
+#ifndef LEN_FRAME_TEMPLATE
+#define LEN_FRAME_TEMPLATE 32
+#endif
 #define TX_CAL 0x2A
 
+// transmit power, four gain settings (see TX power control below)
+#define TX_POWER 0x1E
+#define LEN_TX_POWER 4
+
+// transmit antenna delay
+#define TX_ANTD 0x18
+#define LEN_TX_ANTD 2
+
+// SAR temperature and voltage monitoring (TX_CAL and RF_CONF sub-registers)
+#define TC_SARC_SUB 0x00
+#define TC_SARL_SUB 0x03
+#define LEN_TC_SARL 2
+#define RF_SAR_SUB 0x11
+#define RF_SAR_CTRL_SUB 0x12
+
 // receive control register
-#define DRX_TUNE 27
-#define RF_CONF 28
+#define DRX_TUNE 0x27
+#define DRX_CAR_INT_SUB 0x28
+#define LEN_DRX_CAR_INT 3
+#define DRX_PRETOC_SUB 0x24
+#define LEN_DRX_PRETOC 2
+#define RF_CONF 0x28
 #define LDE_IF 0x2E
+#define LEN_LDE_RXANTD 2
+#define LDE_CFG1_SUB 0x0806
+#define LEN_LDE_REPC 2
+
+// channel control register
+#define CHAN_CTRL 0x1F
+#define LEN_CHAN_CTRL 4
+#define RXPRF_SHIFT 18
+#define TX_PCODE_SHIFT 22
+#define RX_PCODE_SHIFT 27
+
+// channel register image: RF_RXCTRLH and RF_TXCTRL, FS_PLLCFG and FS_PLLTUNE
+#define RF_RXCTRLH_SUB 0x0B
+#define LEN_CHAN_RF 5
+#define FS_PLLCFG_SUB 0x07
+#define LEN_CHAN_PLL 5
+#define TC_PGDELAY_SUB 0x0B
+
+// receiver set-up: DRX_TUNE0b to DRX_TUNE2 (from SUB_2) in one write,
+// DRX_TUNE4H, AGC_TUNE1, LDE_CFG2
+#define LEN_DRX_TUNE_SETUP 10
+#define LEN_DRX_TUNE4H 2
+#define AGC_CTRL 0x23
+#define AGC_TUNE1_SUB 0x04
+#define LEN_AGC_TUNE1 2
+#define LEN_LDE_CFG2 2
+
+// crystal trim (FS_CTRL sub-register), 5 bit trim plus fixed upper bits
+#define FS_XTALT_SUB 0x0E
+#define FS_XTALT_FIXED 0x60
+
+// OTP memory interface
+#define OTP_IF 0x2D
+#define OTP_ADDR_SUB 0x04
+#define OTP_CTRL_SUB 0x06
+#define OTP_RDAT_SUB 0x0A
+#define LEN_OTP_RDAT 4
+#define OTPRDEN_BIT 0
+#define OTPREAD_BIT 1
+#define LDELOAD_BIT 15
+#define OTP_ANTDLY_ADDR 0x1C
+#define OTP_XTRIM_ADDR 0x1E
+
+// power management and system control
+#define PMSC 0x36
+#define PMSC_CTRL0_SUB 0x00
+#define LEN_PMSC_CTRL0 2
+#define PMSC_CLKS_AUTO 0x00
+#define PMSC_SYSCLKS_XTI 0x01
+#define PMSC_CLKS_PLL 0x22
+
+// RF test modes: TX block enables (RF_CONF), pulse generator test (TX_CAL),
+// continuous frame mode (DIAG_TMC), one interval unit is 1/124.8MHz ~ 8ns
+#define RF_CONF_SUB 0x00
+#define LEN_RF_CONF 4
+#define RF_CONF_TXPLLPOWEN 0x001FE000L
+#define RF_CONF_TXALLEN 0x005FFF00L
+#define TC_PGTEST_SUB 0x0C
+#define TC_PGTEST_CW 0x13
+#define DIG_DIAG 0x2F
+#define DIAG_TMC_SUB 0x24
+#define LEN_DIAG_TMC 2
+#define TX_PSTM_BIT 4
+#define LEN_TEST_INTERVAL 4
+
+// always-on (AON) system control, sleep and wake-up configuration
+#define AON 0x2C
+#define AON_WCFG_SUB 0x00
+#define LEN_AON_WCFG 2
+#define ONW_LDC_BIT 6
+#define ONW_L64P_BIT 7
+#define PRES_SLEEP_BIT 8
+#define ONW_LLDE_BIT 11
+#define ONW_LLDO_BIT 12
+#define AON_CTRL_SUB 0x02
+#define SAVE_BIT 1
+#define UPL_CFG_BIT 2
+#define AON_CFG0_SUB 0x06
+#define SLEEP_EN_BIT 0
+#define WAKE_PIN_BIT 1
+#define WAKE_SPI_BIT 2
+#define WAKE_CNT_BIT 3
+#define AON_SLEEP_TIM_SUB 0x08
+#define LEN_AON_SLEEP_TIM 2
+#define AON_CFG1_SUB 0x0A
+#define SLEEP_CE_BIT 0
+#define LPOSC_C_BIT 2
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#ifndef DEBUG
+#if defined(DEBUG) && defined(DW1000_LINUX)
+#error "DEBUG (no hardware) and DW1000_LINUX (spidev) exclude each other"
+#endif
+#if defined(DW1000_LINUX)
+#include "DW1000Linux.h"
+#elif !defined(DEBUG)
 #include <Arduino.h>
 #include "../SPI/SPI.h"
 #else
@@ -111,6 +265,61 @@
 #define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
 #endif
 
+#include "DW1000Config.h"
+#include "DW1000Registers.h"
+
+/*
+ * Register values of one channel (with its preamble code) in bus byte
+ * order, see DW1000::getChannelImage(). Groups of adjacent registers are
+ * one write each.
+ */
+struct DW1000ChannelImage {
+	byte channel;
+	byte preambleCode;
+	byte rf[LEN_CHAN_RF];			// RF_RXCTRLH, RF_TXCTRL
+	byte pgdelay[1];				// TC_PGDELAY
+	byte pll[LEN_CHAN_PLL];			// FS_PLLCFG, FS_PLLTUNE
+	byte power[LEN_TX_POWER];		// TX_POWER
+	byte chanctrl[LEN_CHAN_CTRL];	// CHAN_CTRL
+	byte repc[LEN_LDE_REPC];		// LDE_REPC
+};
+
+/*
+ * Receiver configuration solved from data rate, PRF, preamble length and
+ * channel (see DW1000::solveReceiver()), register values in bus byte
+ * order.
+ */
+struct DW1000ReceiverSetup {
+	byte rate;
+	byte prf;
+	byte preamble;
+	byte channel;
+	byte preambleCode;
+	byte pac;
+	byte drxTune[LEN_DRX_TUNE_SETUP];	// DRX_TUNE0b (SFD), 1a, 1b, 2 (PAC)
+	byte drxTune4h[LEN_DRX_TUNE4H];		// DRX_TUNE4H
+	byte agcTune1[LEN_AGC_TUNE1];		// AGC_TUNE1
+	byte ldeCfg2[LEN_LDE_CFG2];			// LDE_CFG2
+	byte repc[LEN_LDE_REPC];			// LDE_REPC
+	byte chanctrl[LEN_CHAN_CTRL];		// CHAN_CTRL
+};
+
+/*
+ * Transmit frame of a recurring message type (poll, response, final,
+ * blink), see DW1000::prepareTemplate(). The register images are built
+ * once; of the frame only the bytes patched since the last transmit are
+ * written again. A template belongs to one device.
+ */
+struct DW1000FrameTemplate {
+	byte txfctrl[LEN_TX_FCTRL];			// TX_FCTRL
+	byte sysctrl;						// SYS_CTRL, first byte (TXSTRT, WAIT4RESP)
+	byte data[LEN_FRAME_TEMPLATE];		// frame without CRC-16
+	byte length;
+	// bytes patched since the last transmit, [dirtyStart, dirtyEnd)
+	byte dirtyStart;
+	byte dirtyEnd;
+};
+
 class DW1000 {
 public:
 	/* TODO impl: later
@@ -125,12 +334,50 @@ public:
 	~DW1000();
 
 	int getChipSelect();
+	static int getSpiUsers();
+	static boolean isSpiBusy();
+
+	// SPI clock, slow until the PLL is locked, fast afterwards
+	boolean initSpiClock();
+	void setSpiClock(unsigned long clock);
+	unsigned long getSpiClock();
+	unsigned long measureTransactionTime();
+	unsigned long getSlowTransactionTime();
+	unsigned long getFastTransactionTime();
+
+	// queue the register writes that follow into one bus access (spidev
+	// batch on Linux, no effect on Arduino)
+	void beginBatch();
+	void endBatch();
+#ifdef DW1000_LINUX
+	DW1000Spidev* getSpidev();
+#endif
+
+	// hook on every SPI transfer, e.g. for tracing (see DW1000Trace.h)
+	typedef void (*TransferHandler)(void* context, boolean write, byte header[], int headerLen, byte data[], int n);
+	void setTransferHandler(TransferHandler handler, void* context);
+
+	byte getChannel();
+	byte getPulseFrequency();
+	byte getDataRate();
+	// TX_PREAMBLE_LEN_* value of the last preambleLength()
+	byte getPreambleLength();
 	
 	// Default Chip Setup Options
 	void setDefaultMode(short MODE);
 
+	// LDE microcode, OTP calibration, preamble code and SPI clock set-up
+	boolean initialize();
+	void loadLDE();
+	void startLDELoad();
+	void finishLDELoad();
+	void loadOTPCalibration();
+	byte getCrystalTrim();
+	word getOTPAntennaDelay(byte prf);
+
 	// DEV_ID, device identifier
 	char* readDeviceIdentifier();
+	boolean checkDeviceIdentifier();
 	
 	// SYS_CFG, general device configuration
 	byte* getSystemConfiguration();
@@ -148,26 +395,91 @@ public:
 	void preambleLength(byte prealen);
 	void transmitFrameLength(word dataLength);
 	void tuneReceiver(byte rate, byte PRF, byte preamble, byte pac);
+	// receiver set-up derived from TX_RATE_*, TX_PULSE_FREQ_*,
+	// TX_PREAMBLE_LEN_*, channel and preamble code (0 for the default),
+	// see DW1000ReceiverConfig.h for the compile-time checked variant
+	static boolean solveReceiver(byte rate, byte prf, byte preamble, byte channel, byte code, DW1000ReceiverSetup* setup);
+	void writeReceiverSetup(DW1000ReceiverSetup* setup);
+	boolean configureReceiver(byte rate, byte prf, byte preamble, byte channel, byte code);
 	void setRFChannel(short channel);
+	void setPreambleCode(byte code);
+	byte getPreambleCode();
+	static byte defaultPreambleCode(byte channel, byte prf);
+	// precomputed channel set-up (current PRF, data rate and power mode),
+	// written in one batch and only where it differs from the last image
+	boolean getChannelImage(byte channel, byte code, DW1000ChannelImage* image);
+	int writeChannelImage(DW1000ChannelImage* image, DW1000ChannelImage* last);
 	void waitForResponse(boolean val);
+	void setReceiveTimeout(unsigned long timeout);
+	void setPreambleDetectTimeout(word pacs);
 	void setData(byte data[], int n);
-	int getData(byte data[]);
+	void setDataWithFrameCheck(byte data[], int n);
+	int getData(byte data[], int n);
+	int getFrame(byte data[], int n);
 
 	// RX/TX default settings
 	void setDefaults();
 	void setNASA_RMC_2015();
 
 	// SYS_STATUS, device status flags
+	void readSystemEventStatus(byte status[]);
 	boolean isLDEDone();
 	boolean isTransmitDone();
 	boolean isReceiveDone();
 	boolean isReceiveSuccess();
+	boolean isReceiveTimeout();
 
 	void clearReceiveStatus();
-	void clearTransmitStatus(); // TODO impl
+	void clearTransmitStatus();
+
+	// register map access (see DW1000Registers.h), whole register images or
+	// only the bytes covered by a field or by merged fields of a register
+	template<class REGISTER> void readRegister(byte data[]) {
+		readBytes(REGISTER::address, REGISTER::sub, data, REGISTER::length);
+	}
+	template<class REGISTER> void writeRegister(byte data[]) {
+		writeBytes(REGISTER::address, REGISTER::sub, data, REGISTER::length);
+	}
+	template<class FIELDS> void writeFields(byte data[]) {
+		writeBytes(FIELDS::Register::address, FIELDS::Register::sub + FIELDS::index, &data[FIELDS::index], FIELDS::span);
+	}
 
-	// RX_TIME, ..., timing, timestamps, etc.
-	// TODO void readReceiveTimestamp(byte[] timestamp);
+	// RX_TIME, TX_TIME, ..., timing, timestamps, etc.
+	void readReceiveTimestamp(byte timestamp[]);
+	void readTransmitTimestamp(byte timestamp[]);
+	static int64_t toTimestamp(byte timestamp[]);
+	static void timestampToBytes(int64_t value, byte timestamp[]);
+	static int64_t timestampDiff(int64_t to, int64_t from);
+
+	// DRX_CAR_INT, carrier integrator of the last received frame
+	long readCarrierIntegrator();
+
+	// TX_ANTD, LDE_RXANTD, antenna delays (in timestamp units)
+	void setAntennaDelay(word txDelay, word rxDelay);
+
+	// SAR, raw temperature and battery voltage readings
+	void readTempAndVoltage(byte* temp, byte* vbat);
+
+	// AON, low-power sleep (timer wake-up) and deep sleep (CS/WAKEUP pin only)
+	void configureSleep(word sleepTime);
+	void enterSleep();
+	boolean wakeUp();
+	boolean isSleeping();
+	unsigned long getWakeUpTime();
+
+	// TX_POWER, smart (higher power for short frames) or manual power from
+	// the tables below for the channel and PRF, plus a per-frame override
+	void setSmartTransmitPower(boolean val);
+	boolean isSmartTransmitPower();
+	unsigned long getTransmitPower();
+	void setTransmitPowerOverride(byte power);
+	static unsigned long transmitPowerFor(byte channel, byte prf, boolean smart);
+
+	// RF test modes, continuous wave or continuous frames of the setData() payload
+	void startContinuousWave();
+	void startContinuousFrame(unsigned long interval);
+	void exitTestMode();
+	boolean isTestMode();
 
 	// idle
 	void idle();
@@ -181,14 +493,20 @@ public:
 	void newTransmit();	// ADD IFSDELAY
 	void startTransmit();
 	void cancelTransmit();
+	// transmit templates: TX_FCTRL, SYS_CTRL and frame built once, a
+	// transmit writes what changed since the last one and starts it
+	static boolean prepareTemplate(DW1000FrameTemplate* frame, byte rate, byte prf, byte preamble,
+		const byte data[], int n, byte options);
+	static boolean patchTemplate(DW1000FrameTemplate* frame, int offset, const byte data[], int n);
+	int transmitTemplate(DW1000FrameTemplate* frame);
 
 	// reception channel
-	static const long RX_CHANNEL_1 = 0x
-	static const long RX_CHANNEL_2 = 0x
-	static const long RX_CHANNEL_3 = 0x
-	static const long RX_CHANNEL_4 = 0x
-	static const long RX_CHANNEL_5 = 0x
-	static const long RX_CHANNEL_7 = 0x
+	static const long RX_CHANNEL_1 = 0xD8;
+	static const long RX_CHANNEL_2 = 0xD8;
+	static const long RX_CHANNEL_3 = 0xD8;
+	static const long RX_CHANNEL_4 = 0xBC;
+	static const long RX_CHANNEL_5 = 0xD8;
+	static const long RX_CHANNEL_7 = 0xBC;
 	
 	// transmission channel
 	static const long TX_CHANNEL_1 = 0x00005C40;
@@ -226,6 +544,11 @@ public:
 	static const byte TX_PREAMBLE_LEN_1536 = 0x06;
 	static const byte TX_PREAMBLE_LEN_2048 = 0x0A;
 	static const byte TX_PREAMBLE_LEN_4096 = 0x03;
+
+	// transmit template options: ranging frame (TR), receiver on after the
+	// frame (WAIT4RESP)
+	static const byte TEMPLATE_RANGING = 0x01;
+	static const byte TEMPLATE_WAIT_RESPONSE = 0x02;
 	
 	// transmit power control - smart
 	static const long SMART_TX_CH_1_PRF_16MHz = 0x15355575;
@@ -266,10 +589,10 @@ public:
 	// frequency synthesizer PLL tuning
 	static const byte PLL_TUNE_CH_1 = 0x1E;
 	static const byte PLL_TUNE_CH_2 = 0x26;
-	static const byte PLL_TUNE_CH_3 = 0x5E;
+	static const byte PLL_TUNE_CH_3 = 0x56;
 	static const byte PLL_TUNE_CH_4 = 0x26;
-	static const byte PLL_TUNE_CH_5 = 0xA6;
-	static const byte PLL_TUNE_CH_7 = 0xA6;
+	static const byte PLL_TUNE_CH_5 = 0xBE;
+	static const byte PLL_TUNE_CH_7 = 0xBE;
 	
 	// start frame delimiter selection
 	static const byte SFD_STD_RATE_110KBPS   = 0x0A;
@@ -334,8 +657,33 @@ public:
 	static const word LDE_REPC_RX_PCODE_22 = 0x3850;
 	static const word LDE_REPC_RX_PCODE_23 = 0x30A2;
 	static const word LDE_REPC_RX_PCODE_24 = 0x3850;
-	// ?TODO? implement selection procedure based on channel
-	// TODO implement writing to LDE_IF, SUB_2804 register
+	static word ldeReplicaCoefficient(byte code, byte rate);
+
+	// LDE configuration (noise threshold multiplier), time for LDE loading (us)
+	static const byte LDE_CFG1_DEFAULT = 0x6D;
+	static const unsigned int LDE_LOAD_TIME = 150;
+
+	// crystal trim if the OTP is not programmed (mid range)
+	static const byte XTAL_TRIM_DEFAULT = 0x10;
+
+	// default antenna delay (TX and RX each), in timestamp units
+	static const word ANTENNA_DELAY_DEFAULT = 16436;
+
+	// timestamps wrap around after 2^40 units (~17.2s)
+	static const int64_t TIME_OVERFLOW = 0x10000000000LL;
+
+	// SPI clock (Hz) before and after PLL lock, max. 3MHz and 20MHz
+	static const unsigned long SPI_CLOCK_SLOW = 2000000L;
+	static const unsigned long SPI_CLOCK_FAST = 20000000L;
+	// reads verifying the fast clock, reads per timing measurement
+	static const byte SPI_VERIFY_READS = 4;
+	static const byte SPI_TIMING_READS = 16;
+	// time until the PLL must be locked (us)
+	static const unsigned long PLL_LOCK_TIMEOUT = 1000;
+
+	// wake-up: CS held low (us), time until the device must be ready (us)
+	static const unsigned int WAKE_CS_HOLD = 500;
+	static const unsigned long WAKE_TIMEOUT = 5000;
 	
 	// transmitter pulse generator delay
 	static const byte PGD_CH_1 = 0xC9;
@@ -346,15 +694,30 @@ public:
 	static const byte PGD_CH_7 = 0x93;
 	
 #ifdef DEBUG
-	byte debugBuffer[1024];
+	// payload of the last write, read back by reads (see DW1000Config.h)
+	byte debugBuffer[DW1000_DEBUG_BUFFER];
 	inline void clearDebugBuffer() {
-		memset(debugBuffer, 0, 1024);
+		memset(debugBuffer, 0, DW1000_DEBUG_BUFFER);
 	}
 #endif
 
 private:
 	unsigned int _ss;
 
+	// devices sharing the SPI bus, and whether a transaction is in progress
+	static int _spiUsers;
+	static volatile boolean _spiBusy;
+
+	// SPI clock of this device and measured transaction times (ns)
+	unsigned long _spiClock;
+#if defined(DW1000_LINUX)
+	DW1000Spidev _spidev;
+#elif !defined(DEBUG)
+	SPISettings _spiSettings;
+#endif
+	unsigned long _spiTimeSlow;
+	unsigned long _spiTimeFast;
+
 	byte _syscfg[LEN_SYS_CFG];
 	byte _sysctrl[LEN_SYS_CTRL];
 
@@ -362,15 +725,67 @@ private:
 	boolean _extendedFrameLength;
 
 	byte _txfctrl[LEN_TX_FCTRL];
+	// TX_FCTRL as last written (if known) and the template whose frame is
+	// in the TX buffer, see transmitTemplate()
+	byte _txfctrlWritten[LEN_TX_FCTRL];
+	boolean _txfctrlKnown;
+	DW1000FrameTemplate* _txTemplate;
+
+	// active channel, pulse repetition frequency, data rate and preamble
+	byte _channel;
+	byte _pulseFrequency;
+	byte _dataRate;
+	byte _preambleLength;
+	byte _preambleCode;
+
+	// OTP calibration: crystal trim, antenna delays (16MHz, 64MHz PRF)
+	byte _xtalTrim;
+	word _otpAntennaDelay[2];
+
+	// LDE replica coefficients by preamble code (1 to 24), in flash on AVR
+	static const word LDE_REPC[24];
 
 	// whether RX or TX is active
 	int _deviceMode; 
 
-	void readBytes(byte cmd, byte data[], int n);
+	// antenna delays, not kept by the AON during sleep
+	word _txAntennaDelay;
+	word _rxAntennaDelay;
+
+	// sleep state, last measured wake-up time (us) and SPI clock when awake
+	boolean _sleeping;
+	unsigned long _wakeUpTime;
+	unsigned long _awakeSpiClock;
+
+	// continuous wave or continuous frame mode active
+	boolean _testMode;
+
+	// transfer hook
+	TransferHandler _transferHandler;
+	void* _transferContext;
+
+	// smart TX power, per-frame power override (after newTransmit()) and
+	// whether TX_POWER holds an override instead of the table value
+	boolean _smartPower;
+	boolean _powerOverride;
+	byte _overridePower;
+	boolean _powerOverridden;
+
+	void readBytes(byte cmd, word offset, byte data[], int n);
 	void writeBytes(byte cmd, word offset, byte data[], int n);
 
-	boolean getBit(byte data[], int n, int bit);
-	void setBit(byte data[], int n, int bit, boolean val);
+	void uploadAonConfiguration();
+	void writeRfConfiguration(unsigned long conf);
+	void writeClocks(byte clocks);
+	void writeTransmitPower(unsigned long power);
+	void writeChannelControl();
+	static unsigned long channelControl(byte channel, byte prf, byte code);
+	void writeValue(byte cmd, word offset, unsigned long value, int n);
+	int writeChanged(byte cmd, word offset, byte data[], byte last[], int n);
+	static boolean channelSettings(short channel, byte* rxctrl, unsigned long* txctrl,
+		byte* pgdelay, unsigned long* pllcfg, byte* plltune);
+	boolean isFrameLengthValid(int len);
+	unsigned long readOTP(word address);
 	
 	/* Register is 6 bit, 7 = write, 6 = sub-adressing, 5-0 = register value
 	 * Total header with sub-adressing can be 15 bit
@@ -378,6 +793,8 @@ private:
 	static const byte WRITE = 0x80; // regular write
 	static const byte WRITE_SUB = 0xC0; // write with sub address
 	static const byte READ = 0x00; // regular read
+	static const byte READ_SUB = 0x40; // read with sub address
+	static const byte RW_SUB_EXT = 0x80; // extended (15 bit) sub address
 };
 
 #endif
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * AES-128 block encryption (see DW1000Aes.h), FIPS-197.
+ */
+
+#include "DW1000Aes.h"
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#endif
+
+#ifdef __AVR__
+static const byte SBOX[256] PROGMEM = {
+#else
+static const byte SBOX[256] = {
+#endif
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+#ifdef __AVR__
+#define SUB(x) pgm_read_byte(&SBOX[x])
+#else
+#define SUB(x) SBOX[x]
+#endif
+
+// multiplication by x in GF(2^8)
+static inline byte xtime(byte x) {
+	return (byte)((x << 1) ^ ((x & 0x80) ? 0x1B : 0x00));
+}
+
+DW1000Aes::DW1000Aes() {
+	memset(_roundKeys, 0, sizeof(_roundKeys));
+#ifndef __AVR__
+	memset(_roundWords, 0, sizeof(_roundWords));
+#endif
+}
+
+void DW1000Aes::setKey(const byte key[]) {
+	byte rcon = 0x01;
+	byte* k;
+	int i;
+
+	memcpy(_roundKeys, key, LEN_AES_KEY);
+	for(i = LEN_AES_KEY; i < (int)sizeof(_roundKeys); i += 4) {
+		k = &_roundKeys[i];
+		if(i % LEN_AES_KEY == 0) {
+			// RotWord, SubWord, round constant
+			k[0] = (byte)(k[-16] ^ SUB(k[-3]) ^ rcon);
+			k[1] = (byte)(k[-15] ^ SUB(k[-2]));
+			k[2] = (byte)(k[-14] ^ SUB(k[-1]));
+			k[3] = (byte)(k[-13] ^ SUB(k[-4]));
+			rcon = xtime(rcon);
+		} else {
+			k[0] = (byte)(k[-16] ^ k[-4]);
+			k[1] = (byte)(k[-15] ^ k[-3]);
+			k[2] = (byte)(k[-14] ^ k[-2]);
+			k[3] = (byte)(k[-13] ^ k[-1]);
+		}
+	}
+#ifndef __AVR__
+	for(i = 0; i < (AES_ROUNDS + 1) * 4; i++) {
+		k = &_roundKeys[i * 4];
+		_roundWords[i] = (uint32_t)k[0] | ((uint32_t)k[1] << 8) | ((uint32_t)k[2] << 16) | ((uint32_t)k[3] << 24);
+	}
+#endif
+}
+
+void DW1000Aes::encrypt(byte block[]) {
+#ifdef __AVR__
+	encryptCompact(block);
+#else
+	encryptTables(block);
+#endif
+}
+
+/*
+ * SubBytes and ShiftRows in one pass (byte i is row i % 4 of column i / 4),
+ * MixColumns with xtime.
+ */
+void DW1000Aes::encryptCompact(byte block[]) {
+	byte s[LEN_AES_BLOCK];
+	byte a0, a1, a2, a3, all;
+	const byte* k = _roundKeys;
+	int round, i;
+
+	for(i = 0; i < LEN_AES_BLOCK; i++) {
+		block[i] ^= k[i];
+	}
+	for(round = 1; round <= AES_ROUNDS; round++) {
+		k += LEN_AES_BLOCK;
+		for(i = 0; i < LEN_AES_BLOCK; i++) {
+			// row r of column c comes from column c + r
+			s[i] = SUB(block[(i + 4 * (i % 4)) % LEN_AES_BLOCK]);
+		}
+		if(round < AES_ROUNDS) {
+			for(i = 0; i < LEN_AES_BLOCK; i += 4) {
+				a0 = s[i];
+				a1 = s[i + 1];
+				a2 = s[i + 2];
+				a3 = s[i + 3];
+				all = (byte)(a0 ^ a1 ^ a2 ^ a3);
+				s[i] ^= (byte)(all ^ xtime((byte)(a0 ^ a1)));
+				s[i + 1] ^= (byte)(all ^ xtime((byte)(a1 ^ a2)));
+				s[i + 2] ^= (byte)(all ^ xtime((byte)(a2 ^ a3)));
+				s[i + 3] ^= (byte)(all ^ xtime((byte)(a3 ^ a0)));
+			}
+		}
+		for(i = 0; i < LEN_AES_BLOCK; i++) {
+			block[i] = (byte)(s[i] ^ k[i]);
+		}
+	}
+}
+
+#ifndef __AVR__
+/*
+ * T-tables: SubBytes and MixColumns of one byte in row r as a column word
+ * (row 0 in the low byte), Te[r] is Te[0] rotated by r bytes.
+ */
+static uint32_t te[4][256];
+static boolean teReady = false;
+
+static void buildTables() {
+	int i, r;
+	byte s;
+	uint32_t w;
+
+	for(i = 0; i < 256; i++) {
+		s = SBOX[i];
+		w = (uint32_t)xtime(s) | ((uint32_t)s << 8) | ((uint32_t)s << 16) | ((uint32_t)(xtime(s) ^ s) << 24);
+		for(r = 0; r < 4; r++) {
+			te[r][i] = w;
+			w = (w << 8) | (w >> 24);
+		}
+	}
+	teReady = true;
+}
+
+static inline uint32_t loadColumn(const byte b[]) {
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static inline void storeColumn(byte b[], uint32_t w) {
+	b[0] = (byte)w;
+	b[1] = (byte)(w >> 8);
+	b[2] = (byte)(w >> 16);
+	b[3] = (byte)(w >> 24);
+}
+
+void DW1000Aes::encryptTables(byte block[]) {
+	const uint32_t* k = _roundWords;
+	uint32_t c0, c1, c2, c3, t0, t1, t2, t3;
+	int round;
+
+	if(!teReady) {
+		buildTables();
+	}
+	c0 = loadColumn(&block[0]) ^ k[0];
+	c1 = loadColumn(&block[4]) ^ k[1];
+	c2 = loadColumn(&block[8]) ^ k[2];
+	c3 = loadColumn(&block[12]) ^ k[3];
+	for(round = 1; round < AES_ROUNDS; round++) {
+		k += 4;
+		t0 = te[0][c0 & 0xFF] ^ te[1][(c1 >> 8) & 0xFF] ^ te[2][(c2 >> 16) & 0xFF] ^ te[3][c3 >> 24] ^ k[0];
+		t1 = te[0][c1 & 0xFF] ^ te[1][(c2 >> 8) & 0xFF] ^ te[2][(c3 >> 16) & 0xFF] ^ te[3][c0 >> 24] ^ k[1];
+		t2 = te[0][c2 & 0xFF] ^ te[1][(c3 >> 8) & 0xFF] ^ te[2][(c0 >> 16) & 0xFF] ^ te[3][c1 >> 24] ^ k[2];
+		t3 = te[0][c3 & 0xFF] ^ te[1][(c0 >> 8) & 0xFF] ^ te[2][(c1 >> 16) & 0xFF] ^ te[3][c2 >> 24] ^ k[3];
+		c0 = t0;
+		c1 = t1;
+		c2 = t2;
+		c3 = t3;
+	}
+	// last round without MixColumns
+	k += 4;
+	t0 = (uint32_t)SBOX[c0 & 0xFF] | ((uint32_t)SBOX[(c1 >> 8) & 0xFF] << 8)
+		| ((uint32_t)SBOX[(c2 >> 16) & 0xFF] << 16) | ((uint32_t)SBOX[c3 >> 24] << 24);
+	t1 = (uint32_t)SBOX[c1 & 0xFF] | ((uint32_t)SBOX[(c2 >> 8) & 0xFF] << 8)
+		| ((uint32_t)SBOX[(c3 >> 16) & 0xFF] << 16) | ((uint32_t)SBOX[c0 >> 24] << 24);
+	t2 = (uint32_t)SBOX[c2 & 0xFF] | ((uint32_t)SBOX[(c3 >> 8) & 0xFF] << 8)
+		| ((uint32_t)SBOX[(c0 >> 16) & 0xFF] << 16) | ((uint32_t)SBOX[c1 >> 24] << 24);
+	t3 = (uint32_t)SBOX[c3 & 0xFF] | ((uint32_t)SBOX[(c0 >> 8) & 0xFF] << 8)
+		| ((uint32_t)SBOX[(c1 >> 16) & 0xFF] << 16) | ((uint32_t)SBOX[c2 >> 24] << 24);
+	storeColumn(&block[0], t0 ^ k[0]);
+	storeColumn(&block[4], t1 ^ k[1]);
+	storeColumn(&block[8], t2 ^ k[2]);
+	storeColumn(&block[12], t3 ^ k[3]);
+}
+#endif
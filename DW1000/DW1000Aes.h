@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * AES-128 encryption of single blocks, in place, for CCM* (see
+ * DW1000Ccm.h). Only the forward cipher is needed, so there is no inverse
+ * S-box. Two implementations:
+ *
+ *   compact  byte oriented rounds (xtime MixColumns), no tables in RAM,
+ *            the 256 byte S-box in flash on AVR
+ *   tables   32 bit T-tables (4 x 256 words built on first use), one
+ *            lookup per byte and round, not on AVR
+ *
+ * encrypt() takes the compact rounds on AVR and the tables elsewhere
+ * (Linux, host builds). The key schedule is expanded once in setKey().
+ */
+
+#ifndef _DW1000AES_H_INCLUDED
+#define _DW1000AES_H_INCLUDED
+
+#include "DW1000.h"
+
+#define LEN_AES_KEY 16
+#define LEN_AES_BLOCK 16
+#define AES_ROUNDS 10
+
+class DW1000Aes {
+public:
+	DW1000Aes();
+
+	// expand a 128 bit key
+	void setKey(const byte key[]);
+
+	// encrypt one block in place
+	void encrypt(byte block[]);
+	void encryptCompact(byte block[]);
+#ifndef __AVR__
+	void encryptTables(byte block[]);
+#endif
+
+private:
+	byte _roundKeys[(AES_ROUNDS + 1) * LEN_AES_BLOCK];
+#ifndef __AVR__
+	// round keys as little endian column words for the table rounds
+	uint32_t _roundWords[(AES_ROUNDS + 1) * 4];
+#endif
+};
+
+#endif
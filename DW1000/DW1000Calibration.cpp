@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000Calibration.h"
+
+/* ###########################################################################
+ * #### Construction and init ################################################
+ * ######################################################################### */
+
+DW1000Calibration::DW1000Calibration(DW1000* dw) {
+	int i, j;
+
+	_dw = dw;
+	for(i = 0; i < NUM_CAL_CHANNELS; i++) {
+		for(j = 0; j < NUM_CAL_PRFS; j++) {
+			_delay[i][j] = 2 * DW1000::ANTENNA_DELAY_DEFAULT;
+			_refTemp[i][j] = NO_TEMP;
+		}
+	}
+	_tempCoeff = TEMP_COEFF_DEFAULT;
+	_lastTemp = NO_TEMP;
+	_trueTimeOfFlight = 0;
+	_sumTimeOfFlight = 0;
+	_samples = 0;
+}
+
+/* ###########################################################################
+ * #### Calibration procedure ################################################
+ * ######################################################################### */
+
+/*
+ * Start a calibration run against a peer (with identical antenna delays)
+ * at a known distance. The current table entry is applied uncompensated,
+ * so the samples measure the error relative to it.
+ * @param distanceMillis
+ *		The true distance between both antennas in millimeters.
+ */
+void DW1000Calibration::beginCalibration(long distanceMillis) {
+	word delay;
+
+	_trueTimeOfFlight = distanceToTime(distanceMillis);
+	_sumTimeOfFlight = 0;
+	_samples = 0;
+	delay = getAntennaDelay(_dw->getChannel(), _dw->getPulseFrequency());
+	_dw->setAntennaDelay(delay / 2, delay - delay / 2);
+}
+
+/*
+ * Add the durations (in timestamp units) of one ranging exchange.
+ * @param round1
+ *		Initiator: poll sent until response received.
+ * @param reply1
+ *		Responder: poll received until response sent.
+ * @param round2
+ *		Responder: response sent until final received.
+ * @param reply2
+ *		Initiator: response received until final sent.
+ */
+void DW1000Calibration::addSample(int64_t round1, int64_t reply1, int64_t round2, int64_t reply2) {
+	_sumTimeOfFlight += computeTimeOfFlight(round1, reply1, round2, reply2);
+	_samples++;
+}
+
+int DW1000Calibration::getSampleCount() {
+	return _samples;
+}
+
+/*
+ * Derive the antenna delay from the collected samples, store it for the
+ * active channel and PRF together with the current temperature and apply it.
+ * Returns false if there were no samples or the result is out of range.
+ */
+boolean DW1000Calibration::finishCalibration() {
+	byte channel = _dw->getChannel();
+	byte prf = _dw->getPulseFrequency();
+	byte temp, vbat;
+	int64_t delay;
+
+	if(_samples == 0) {
+		return false;
+	}
+	// measured = true + delay of one node (TX and RX part) for identical nodes
+	delay = getAntennaDelay(channel, prf);
+	delay += _sumTimeOfFlight / _samples - _trueTimeOfFlight;
+	_samples = 0;
+	if(delay <= 0 || delay > 0xFFFF) {
+		return false;
+	}
+	_dw->readTempAndVoltage(&temp, &vbat);
+	setAntennaDelay(channel, prf, (word)delay, temp);
+	applyTemperature(temp);
+	return true;
+}
+
+/* ###########################################################################
+ * #### Calibration table ####################################################
+ * ######################################################################### */
+
+word DW1000Calibration::getAntennaDelay(byte channel, byte prf) {
+	int ch = channelIndex(channel);
+	int pf = prfIndex(prf);
+
+	if(ch < 0 || pf < 0) {
+		return 2 * DW1000::ANTENNA_DELAY_DEFAULT;
+	}
+	return _delay[ch][pf];
+}
+
+byte DW1000Calibration::getReferenceTemp(byte channel, byte prf) {
+	int ch = channelIndex(channel);
+	int pf = prfIndex(prf);
+
+	if(ch < 0 || pf < 0) {
+		return NO_TEMP;
+	}
+	return _refTemp[ch][pf];
+}
+
+/*
+ * Store a table entry, e.g. when restoring a previous calibration.
+ * @param delay
+ *		The total (TX plus RX) antenna delay in timestamp units.
+ * @param refTemp
+ *		The raw SAR temperature at calibration time, or NO_TEMP.
+ */
+void DW1000Calibration::setAntennaDelay(byte channel, byte prf, word delay, byte refTemp) {
+	int ch = channelIndex(channel);
+	int pf = prfIndex(prf);
+
+	if(ch < 0 || pf < 0) {
+		return; // TODO proper error handling: invalid channel or PRF
+	}
+	_delay[ch][pf] = delay;
+	_refTemp[ch][pf] = refTemp;
+}
+
+/* ###########################################################################
+ * #### Temperature compensation #############################################
+ * ######################################################################### */
+
+void DW1000Calibration::setTempCoefficient(int coeff) {
+	_tempCoeff = coeff;
+}
+
+/*
+ * Sample the temperature and re-apply the compensated antenna delays if it
+ * changed since the last time. Returns true if the delays were rewritten.
+ */
+boolean DW1000Calibration::update() {
+	byte temp, vbat;
+
+	_dw->readTempAndVoltage(&temp, &vbat);
+	if(temp == _lastTemp) {
+		return false;
+	}
+	applyTemperature(temp);
+	return true;
+}
+
+/*
+ * Write the delays of the active channel and PRF compensated for the given
+ * temperature. The total delay is split evenly between TX and RX.
+ * @param temp
+ *		The raw SAR temperature reading.
+ */
+void DW1000Calibration::applyTemperature(byte temp) {
+	byte channel = _dw->getChannel();
+	byte prf = _dw->getPulseFrequency();
+	byte refTemp = getReferenceTemp(channel, prf);
+	long delay = getAntennaDelay(channel, prf);
+
+	if(refTemp != NO_TEMP) {
+		delay += ((long)_tempCoeff * ((int)temp - (int)refTemp)) / 256;
+	}
+	if(delay < 0) {
+		delay = 0;
+	} else if(delay > 0xFFFF) {
+		delay = 0xFFFF;
+	}
+	_dw->setAntennaDelay((word)(delay / 2), (word)(delay - delay / 2));
+	_lastTemp = temp;
+}
+
+/* ###########################################################################
+ * #### Helper functions #####################################################
+ * ######################################################################### */
+
+int64_t DW1000Calibration::computeTimeOfFlight(int64_t round1, int64_t reply1, int64_t round2, int64_t reply2) {
+	int64_t sum = round1 + reply1 + round2 + reply2;
+
+	if(sum <= 0) {
+		return 0;
+	}
+	return (round1 * round2 - reply1 * reply2) / sum;
+}
+
+/*
+ * Light travels ~4.6917mm per timestamp unit.
+ */
+int64_t DW1000Calibration::distanceToTime(long distanceMillis) {
+	return ((int64_t)distanceMillis * 2131393LL) / 10000000LL;
+}
+
+int DW1000Calibration::channelIndex(byte channel) {
+	if(channel >= 1 && channel <= 5) {
+		return channel - 1;
+	} else if(channel == 7) {
+		return 5;
+	}
+	return -1;
+}
+
+int DW1000Calibration::prfIndex(byte prf) {
+	if(prf == DW1000::TX_PULSE_FREQ_16MHZ) {
+		return 0;
+	} else if(prf == DW1000::TX_PULSE_FREQ_64MHZ) {
+		return 1;
+	}
+	return -1;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Antenna delay calibration against a peer at a known distance and
+ * temperature compensation of the calibrated delays.
+ */
+
+#ifndef _DW1000CALIBRATION_H_INCLUDED
+#define _DW1000CALIBRATION_H_INCLUDED
+
+#include "DW1000.h"
+
+// supported channels (1, 2, 3, 4, 5, 7) and pulse frequencies (16, 64MHz)
+#define NUM_CAL_CHANNELS 6
+#define NUM_CAL_PRFS 2
+
+class DW1000Calibration {
+public:
+	// calibrate the radio driven by the given device
+	DW1000Calibration(DW1000* dw);
+
+	// calibration procedure, for the active channel and PRF of the device
+	void beginCalibration(long distanceMillis);
+	void addSample(int64_t round1, int64_t reply1, int64_t round2, int64_t reply2);
+	int getSampleCount();
+	boolean finishCalibration();
+
+	// per-channel/PRF calibration table (total TX+RX delay, raw SAR temp.)
+	word getAntennaDelay(byte channel, byte prf);
+	byte getReferenceTemp(byte channel, byte prf);
+	void setAntennaDelay(byte channel, byte prf, word delay, byte refTemp);
+
+	// temperature compensation
+	void setTempCoefficient(int coeff);
+	boolean update();
+	void applyTemperature(byte temp);
+
+	// time of flight from an asymmetric double-sided two-way ranging exchange
+	static int64_t computeTimeOfFlight(int64_t round1, int64_t reply1, int64_t round2, int64_t reply2);
+	// distance to time of flight, in timestamp units
+	static int64_t distanceToTime(long distanceMillis);
+
+	// default temperature coefficient, delay units per raw SAR temp. LSB (Q8)
+	static const int TEMP_COEFF_DEFAULT = 133;
+	// no reference temperature available, i.e. no compensation
+	static const byte NO_TEMP = 0x00;
+
+private:
+	DW1000* _dw;
+
+	// calibration table, 3 bytes per entry
+	word _delay[NUM_CAL_CHANNELS][NUM_CAL_PRFS];
+	byte _refTemp[NUM_CAL_CHANNELS][NUM_CAL_PRFS];
+	int _tempCoeff;
+	byte _lastTemp;
+
+	// calibration run in progress
+	int64_t _trueTimeOfFlight;
+	int64_t _sumTimeOfFlight;
+	int _samples;
+
+	int channelIndex(byte channel);
+	int prfIndex(byte prf);
+};
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Authenticated frames with AES-128 CCM* (see DW1000Ccm.h).
+ */
+
+#include "DW1000Ccm.h"
+
+DW1000Ccm::DW1000Ccm() {
+	_compact = false;
+	_blocks = 0;
+}
+
+void DW1000Ccm::setKey(const byte key[]) {
+	_aes.setKey(key);
+}
+
+/*
+ * The nonce of a frame.
+ * @param nonce
+ *		13 bytes.
+ * @param source
+ *		The extended (8 byte) address of the sender, most significant byte
+ *		first.
+ * @param counter
+ *		The frame counter of the sender.
+ * @param level
+ *		The security level of the frame.
+ */
+void DW1000Ccm::nonce(byte nonce[], const byte source[], unsigned long counter, byte level) {
+	memcpy(nonce, source, LEN_CCM_SOURCE);
+	nonce[8] = (byte)((counter >> 24) & 0xFF);
+	nonce[9] = (byte)((counter >> 16) & 0xFF);
+	nonce[10] = (byte)((counter >> 8) & 0xFF);
+	nonce[11] = (byte)(counter & 0xFF);
+	nonce[12] = level;
+}
+
+byte DW1000Ccm::micLength(byte level) {
+	return (level & 0x03) != 0 ? (byte)(2 << (level & 0x03)) : 0;
+}
+
+boolean DW1000Ccm::isEncrypted(byte level) {
+	return (level & 0x04) != 0;
+}
+
+/*
+ * Authenticate and encrypt a frame in place. Without encryption the MIC
+ * covers header and payload as authenticated data.
+ * @param frame
+ *		Header and plain payload, with room for the MIC (micLength()) after
+ *		the payload.
+ * @param headerLen
+ *		The length of the header.
+ * @param n
+ *		The length of the payload.
+ * @param nonce
+ *		The nonce of the frame (see nonce()).
+ * @param level
+ *		The security level (0-7).
+ * @return
+ *		The length of the sealed frame, -1 if the lengths are invalid.
+ */
+int DW1000Ccm::seal(byte frame[], int headerLen, int n, const byte nonce[], byte level) {
+	byte tag[LEN_CCM_MAX_MIC];
+	byte mic = micLength(level & 0x07);
+	boolean encrypted = isEncrypted(level);
+
+	if(headerLen < 0 || n < 0) {
+		return -1;
+	}
+	if(mic > 0) {
+		if(encrypted) {
+			authenticate(tag, frame, headerLen, n, nonce, mic);
+		} else {
+			authenticate(tag, frame, headerLen + n, 0, nonce, mic);
+		}
+	}
+	if(encrypted) {
+		crypt(&frame[headerLen], n, nonce, 1);
+	}
+	if(mic > 0) {
+		crypt(tag, mic, nonce, 0);
+		memcpy(&frame[headerLen + n], tag, mic);
+	}
+	return headerLen + n + mic;
+}
+
+/*
+ * Check and decrypt a received frame in place.
+ * @param frame
+ *		The frame (header, payload and MIC) as received.
+ * @param headerLen
+ *		The length of the header.
+ * @param n
+ *		The length of the frame.
+ * @param nonce
+ *		The nonce of the frame (see nonce()).
+ * @param level
+ *		The security level (0-7).
+ * @return
+ *		The length of the plain payload, -1 if the frame is too short or the
+ *		MIC does not match; the payload is cleared then.
+ */
+int DW1000Ccm::open(byte frame[], int headerLen, int n, const byte nonce[], byte level) {
+	byte tag[LEN_CCM_MAX_MIC];
+	byte expected[LEN_CCM_MAX_MIC];
+	byte mic = micLength(level & 0x07);
+	boolean encrypted = isEncrypted(level);
+	byte diff = 0;
+	int len = n - headerLen - mic;
+	int i;
+
+	if(headerLen < 0 || len < 0) {
+		return -1;
+	}
+	if(encrypted) {
+		crypt(&frame[headerLen], len, nonce, 1);
+	}
+	if(mic == 0) {
+		return len;
+	}
+	memcpy(tag, &frame[headerLen + len], mic);
+	crypt(tag, mic, nonce, 0);
+	if(encrypted) {
+		authenticate(expected, frame, headerLen, len, nonce, mic);
+	} else {
+		authenticate(expected, frame, headerLen + len, 0, nonce, mic);
+	}
+	// same time for all mismatches
+	for(i = 0; i < mic; i++) {
+		diff |= (byte)(tag[i] ^ expected[i]);
+	}
+	if(diff != 0) {
+		memset(&frame[headerLen], 0, len);
+		return -1;
+	}
+	return len;
+}
+
+/*
+ * Seal a frame and write it to the transmit buffer.
+ * @return
+ *		The length of the sealed frame, -1 if invalid (nothing written).
+ */
+int DW1000Ccm::send(DW1000* dw, byte frame[], int headerLen, int n, const byte nonce[], byte level) {
+	int len = seal(frame, headerLen, n, nonce, level);
+
+	if(len >= 0) {
+		dw->setData(frame, len);
+	}
+	return len;
+}
+
+/*
+ * Read the received frame and open it.
+ * @param n
+ *		The size of the frame buffer.
+ * @return
+ *		The length of the plain payload, -1 if the frame is rejected.
+ */
+int DW1000Ccm::receive(DW1000* dw, byte frame[], int headerLen, int n, const byte nonce[], byte level) {
+	int len = dw->getData(frame, n);
+
+	return open(frame, headerLen, len, nonce, level);
+}
+
+unsigned long DW1000Ccm::getBlockCount() {
+	return _blocks;
+}
+
+void DW1000Ccm::resetBlockCount() {
+	_blocks = 0;
+}
+
+void DW1000Ccm::setCompact(boolean compact) {
+	_compact = compact;
+}
+
+void DW1000Ccm::encryptBlock(byte block[]) {
+	if(_compact) {
+		_aes.encryptCompact(block);
+	} else {
+		_aes.encrypt(block);
+	}
+	_blocks++;
+}
+
+/*
+ * CBC-MAC over B0, the length of a and a (zero padded to full blocks) and
+ * m (zero padded), straight from the frame buffer.
+ * @param a
+ *		The length of the authenticated data at the start of the frame.
+ * @param m
+ *		The length of the message following it.
+ */
+void DW1000Ccm::authenticate(byte tag[], const byte frame[], int a, int m, const byte nonce[], byte mic) {
+	byte x[LEN_AES_BLOCK];
+	int pos, i;
+
+	// B0: flags (Adata, M, L = 2), nonce, l(m)
+	x[0] = (byte)((a > 0 ? 0x40 : 0x00) | (((mic - 2) / 2) << 3) | 0x01);
+	memcpy(&x[1], nonce, LEN_CCM_NONCE);
+	x[14] = (byte)((m >> 8) & 0xFF);
+	x[15] = (byte)(m & 0xFF);
+	encryptBlock(x);
+	if(a > 0) {
+		x[0] ^= (byte)((a >> 8) & 0xFF);
+		x[1] ^= (byte)(a & 0xFF);
+		pos = 2;
+		for(i = 0; i < a; i++) {
+			x[pos++] ^= frame[i];
+			if(pos == LEN_AES_BLOCK) {
+				encryptBlock(x);
+				pos = 0;
+			}
+		}
+		if(pos > 0) {
+			encryptBlock(x);
+		}
+	}
+	pos = 0;
+	for(i = 0; i < m; i++) {
+		x[pos++] ^= frame[a + i];
+		if(pos == LEN_AES_BLOCK) {
+			encryptBlock(x);
+			pos = 0;
+		}
+	}
+	if(pos > 0) {
+		encryptBlock(x);
+	}
+	memcpy(tag, x, mic);
+}
+
+/*
+ * Counter mode: XOR data with the key stream of blocks A_i (flags L = 2,
+ * nonce, counter i) from the given counter on; counter 0 is for the MIC.
+ */
+void DW1000Ccm::crypt(byte data[], int n, const byte nonce[], word counter) {
+	byte s[LEN_AES_BLOCK];
+	int i, j;
+
+	for(i = 0; i < n; i += LEN_AES_BLOCK) {
+		s[0] = 0x01;
+		memcpy(&s[1], nonce, LEN_CCM_NONCE);
+		s[14] = (byte)((counter >> 8) & 0xFF);
+		s[15] = (byte)(counter & 0xFF);
+		encryptBlock(s);
+		for(j = 0; j < LEN_AES_BLOCK && i + j < n; j++) {
+			data[i + j] ^= s[j];
+		}
+		counter++;
+	}
+}
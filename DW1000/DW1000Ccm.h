@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Authenticated frames with AES-128 CCM* as in IEEE 802.15.4 (annex B).
+ * A frame is a header, authenticated only, followed by a payload that is
+ * encrypted if the security level asks for it:
+ *
+ *   level  0      no security
+ *          1-3    MIC of 4, 8 or 16 bytes over header and payload
+ *          4      payload encrypted, no MIC
+ *          5-7    payload encrypted, MIC of 4, 8 or 16 bytes
+ *
+ * The MIC is appended to the payload. Everything works in place on the
+ * frame buffer, without copies: seal() turns header and plain payload
+ * into the frame to send, open() checks a received frame and restores the
+ * plain payload. The nonce is the 802.15.4 one, source address (8 bytes),
+ * frame counter and security level; a key must never see the same nonce
+ * twice, so the frame counter has to be incremented for each frame.
+ *
+ * Cost: a frame of a header bytes and m payload bytes takes
+ * 1 + (a + 2 + 15) / 16 + 2 * ((m + 15) / 16) + 1 AES blocks, e.g. 5 for a
+ * ranging frame with a 9 byte header and a 16 byte payload (see
+ * DW1000-gateway/DW1000-ccm-benchmark.cpp).
+ */
+
+#ifndef _DW1000CCM_H_INCLUDED
+#define _DW1000CCM_H_INCLUDED
+
+#include "DW1000.h"
+#include "DW1000Aes.h"
+
+#define LEN_CCM_NONCE 13
+#define LEN_CCM_SOURCE 8
+#define LEN_CCM_MAX_MIC 16
+
+class DW1000Ccm {
+public:
+	DW1000Ccm();
+
+	void setKey(const byte key[]);
+
+	// 802.15.4 nonce of a frame, source address most significant byte first
+	static void nonce(byte nonce[], const byte source[], unsigned long counter, byte level);
+	// MIC bytes of a security level and whether its payload is encrypted
+	static byte micLength(byte level);
+	static boolean isEncrypted(byte level);
+
+	// in place on a frame of headerLen + n bytes, room for the MIC after
+	// it; length of the sealed frame and of the plain payload, -1 if
+	// invalid or if the MIC does not match (payload cleared)
+	int seal(byte frame[], int headerLen, int n, const byte nonce[], byte level);
+	int open(byte frame[], int headerLen, int n, const byte nonce[], byte level);
+
+	// seal() and setData(), getData() and open(); for a frame counter
+	// carried in the frame, use getData(), nonce() and open()
+	int send(DW1000* dw, byte frame[], int headerLen, int n, const byte nonce[], byte level);
+	int receive(DW1000* dw, byte frame[], int headerLen, int n, const byte nonce[], byte level);
+
+	// AES blocks encrypted since the last reset, the cost of the frames
+	unsigned long getBlockCount();
+	void resetBlockCount();
+
+	// always take the compact AES rounds (the default on AVR), e.g. to
+	// measure them on a host
+	void setCompact(boolean compact);
+
+private:
+	DW1000Aes _aes;
+	boolean _compact;
+	unsigned long _blocks;
+
+	void encryptBlock(byte block[]);
+	void authenticate(byte tag[], const byte frame[], int a, int m, const byte nonce[], byte mic);
+	void crypt(byte data[], int n, const byte nonce[], word counter);
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000ClockOffset.h"
+
+/* ###########################################################################
+ * #### Construction and init ################################################
+ * ######################################################################### */
+
+DW1000ClockOffset::DW1000ClockOffset(DW1000* dw) {
+	_dw = dw;
+	clear();
+}
+
+void DW1000ClockOffset::clear() {
+	int i;
+
+	for(i = 0; i < DW1000_CLOCK_PEERS; i++) {
+		_peer[i] = NO_PEER;
+		_samples[i] = 0;
+	}
+	_useCounter = 0;
+}
+
+void DW1000ClockOffset::forget(word peer) {
+	int idx = findPeer(peer);
+
+	if(idx >= 0) {
+		_peer[idx] = NO_PEER;
+		_samples[idx] = 0;
+	}
+}
+
+/* ###########################################################################
+ * #### Estimation ###########################################################
+ * ######################################################################### */
+
+/*
+ * Read the carrier integrator of the frame just received from a peer and
+ * add it as a sample. The device's channel and data rate are assumed to
+ * match the frame's.
+ * @param peer
+ *		The (short) address of the transmitting peer.
+ */
+void DW1000ClockOffset::addCarrierIntegrator(word peer) {
+	addCarrierIntegrator(peer, _dw->readCarrierIntegrator());
+}
+
+void DW1000ClockOffset::addCarrierIntegrator(word peer, long carrierInt) {
+	int idx = insertPeer(peer);
+
+	addSample(idx, carrierIntegratorToPpb(carrierInt, _dw->getChannel(), _dw->getDataRate()));
+}
+
+/*
+ * Add a sample from two consecutive frames of a peer that carry the
+ * peer's transmit timestamp. Frames must be less than ~17s apart, pairs
+ * implying more than DW1000_CLOCK_MAX_PPM (corrupt or out of sequence
+ * timestamps) are ignored.
+ * @param remoteTx
+ *		The transmit timestamp reported by the peer.
+ * @param localRx
+ *		The local receive timestamp of the same frame.
+ */
+void DW1000ClockOffset::addTimestampPair(word peer, int64_t remoteTx, int64_t localRx) {
+	int idx = insertPeer(peer);
+	int64_t remoteDiff, localDiff, diff;
+
+	// the first frame only provides the reference for the next one
+	if(_lastLocal[idx] >= 0) {
+		remoteDiff = DW1000::timestampDiff(remoteTx, _lastRemote[idx]);
+		localDiff = DW1000::timestampDiff(localRx, _lastLocal[idx]);
+		diff = remoteDiff - localDiff;
+		if(localDiff > 0 && (diff < 0 ? -diff : diff) <= localDiff / 1000000 * DW1000_CLOCK_MAX_PPM) {
+			addSample(idx, (long)(diff * 1000000000LL / localDiff));
+		}
+	}
+	_lastRemote[idx] = remoteTx;
+	_lastLocal[idx] = localRx;
+}
+
+boolean DW1000ClockOffset::hasClockOffset(word peer) {
+	int idx = findPeer(peer);
+
+	return idx >= 0 && _samples[idx] > 0;
+}
+
+long DW1000ClockOffset::getClockOffset(word peer) {
+	int idx = findPeer(peer);
+
+	if(idx < 0 || _samples[idx] == 0) {
+		return 0;
+	}
+	return _offset[idx];
+}
+
+/* ###########################################################################
+ * #### Single-sided ranging #################################################
+ * ######################################################################### */
+
+/*
+ * Time of flight from a single-sided two-way ranging exchange with a peer,
+ * using the current offset estimate of that peer.
+ * @param round
+ *		Local: poll sent until response received.
+ * @param reply
+ *		Peer: poll received until response sent (in the peer's time base).
+ */
+int64_t DW1000ClockOffset::computeTimeOfFlight(word peer, int64_t round, int64_t reply) {
+	return correctSingleSided(round, reply, getClockOffset(peer));
+}
+
+/*
+ * The reply time is measured by the peer's clock, convert it to the local
+ * time base before subtracting it from the round trip time.
+ */
+int64_t DW1000ClockOffset::correctSingleSided(int64_t round, int64_t reply, long offsetPpb) {
+	return (round - reply + reply * offsetPpb / 1000000000LL) / 2;
+}
+
+/*
+ * One integrator LSB is 998.4MHz/2^28 (2^31 at 110kbps), channel center
+ * frequencies are 499.2MHz times 7, 8, 9, 8, 13 and 13 half-steps.
+ */
+long DW1000ClockOffset::carrierIntegratorToPpb(long carrierInt, byte channel, byte rate) {
+	int64_t value;
+	byte halfSteps;
+
+	switch(channel) {
+		case 1:
+			halfSteps = 7;
+			break;
+		case 2:
+		case 4:
+			halfSteps = 8;
+			break;
+		case 3:
+			halfSteps = 9;
+			break;
+		case 5:
+		case 7:
+			halfSteps = 13;
+			break;
+		default:
+			return 0; // TODO proper error handling: invalid channel
+	}
+	// a positive integrator value means the remote clock is slower
+	value = -(int64_t)carrierInt * 2000000000LL / halfSteps;
+	if(rate == DW1000::TX_RATE_110KBPS) {
+		return (long)(value / (1LL << 31));
+	}
+	return (long)(value / (1LL << 28));
+}
+
+/* ###########################################################################
+ * #### Helper functions #####################################################
+ * ######################################################################### */
+
+int DW1000ClockOffset::findPeer(word peer) {
+	int i;
+
+	for(i = 0; i < DW1000_CLOCK_PEERS; i++) {
+		if(_peer[i] == peer) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Find the table entry of a peer or reuse the least recently used one.
+ */
+int DW1000ClockOffset::insertPeer(word peer) {
+	int idx = findPeer(peer);
+	int i;
+
+	if(idx < 0) {
+		idx = 0;
+		for(i = 0; i < DW1000_CLOCK_PEERS; i++) {
+			if(_peer[i] == NO_PEER) {
+				idx = i;
+				break;
+			}
+			if((word)(_useCounter - _lastUse[i]) > (word)(_useCounter - _lastUse[idx])) {
+				idx = i;
+			}
+		}
+		_peer[idx] = peer;
+		_samples[idx] = 0;
+		_lastLocal[idx] = -1;
+	}
+	_lastUse[idx] = ++_useCounter;
+	return idx;
+}
+
+void DW1000ClockOffset::addSample(int idx, long offsetPpb) {
+	if(_samples[idx] == 0) {
+		_offset[idx] = offsetPpb;
+	} else {
+		_offset[idx] += (offsetPpb - _offset[idx]) / (1 << FILTER_SHIFT);
+	}
+	if(_samples[idx] < 0xFF) {
+		_samples[idx]++;
+	}
+}
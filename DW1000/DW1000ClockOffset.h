@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Per-peer clock offset estimation and single-sided ranging correction.
+ * Offsets are in parts per billion (ppb), positive if the remote clock
+ * runs faster than the local one.
+ */
+
+#ifndef _DW1000CLOCKOFFSET_H_INCLUDED
+#define _DW1000CLOCKOFFSET_H_INCLUDED
+
+#include "DW1000.h"
+
+// number of peers tracked at the same time
+#ifndef DW1000_CLOCK_PEERS
+#define DW1000_CLOCK_PEERS 4
+#endif
+
+// timestamp pairs implying a larger offset (ppm) are dropped as corrupt,
+// at most ~8000
+#ifndef DW1000_CLOCK_MAX_PPM
+#define DW1000_CLOCK_MAX_PPM 100
+#endif
+
+class DW1000ClockOffset {
+public:
+	// estimate offsets of frames received by the given device
+	DW1000ClockOffset(DW1000* dw);
+
+	// feed estimates from the last received frame of a peer
+	void addCarrierIntegrator(word peer);
+	void addCarrierIntegrator(word peer, long carrierInt);
+	void addTimestampPair(word peer, int64_t remoteTx, int64_t localRx);
+
+	// filtered estimate
+	boolean hasClockOffset(word peer);
+	long getClockOffset(word peer);
+	void forget(word peer);
+	void clear();
+
+	// single-sided two-way ranging, time of flight corrected for the peer
+	int64_t computeTimeOfFlight(word peer, int64_t round, int64_t reply);
+	static int64_t correctSingleSided(int64_t round, int64_t reply, long offsetPpb);
+
+	// carrier integrator to ppb, for the given channel and data rate
+	static long carrierIntegratorToPpb(long carrierInt, byte channel, byte rate);
+
+	// exponential filter weight of new samples (1/2^n)
+	static const byte FILTER_SHIFT = 2;
+	// unused table entry
+	static const word NO_PEER = 0xFFFF;
+
+private:
+	DW1000* _dw;
+
+	// fixed table of peers
+	word _peer[DW1000_CLOCK_PEERS];
+	long _offset[DW1000_CLOCK_PEERS];
+	byte _samples[DW1000_CLOCK_PEERS];
+	word _lastUse[DW1000_CLOCK_PEERS];
+	int64_t _lastRemote[DW1000_CLOCK_PEERS];
+	int64_t _lastLocal[DW1000_CLOCK_PEERS];
+	word _useCounter;
+
+	int findPeer(word peer);
+	int insertPeer(word peer);
+	void addSample(int idx, long offsetPpb);
+};
+
+#endif
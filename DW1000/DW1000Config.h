@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Compile-time feature selection. By default everything is compiled in;
+ * a build that knows its radio set-up can leave out the channel, PRF and
+ * setDefaultMode() tables it does not use, e.g. for channel 5 at 16MHz
+ * PRF with modes 2 and 4 only
+ *
+ *   -DDW1000_CHANNELS="DW1000_CHANNEL(5)" -DDW1000_PRFS=DW1000_PRF_16MHZ
+ *   -DDW1000_MODES="DW1000_MODE(2)|DW1000_MODE(4)"
+ *
+ * (or the same #defines here, for the Arduino IDE). Left out channels,
+ * PRFs and modes are invalid everywhere: setRFChannel(), setDefaultMode()
+ * and tuneReceiver() ignore them, solveReceiver() and getChannelImage()
+ * return false and DW1000ReceiverConfig<> does not compile with them.
+ *
+ * Subsystems (hopping, discovery, CCM*, statistics, ...) live in files of
+ * their own and, like unused DW1000 methods, are dropped by the linker
+ * (-ffunction-sections, -fdata-sections, --gc-sections as the Arduino IDE
+ * builds) unless the application calls them. DW1000-size/size-check.sh
+ * reports flash and RAM of some configurations.
+ */
+
+#ifndef _DW1000CONFIG_H_INCLUDED
+#define _DW1000CONFIG_H_INCLUDED
+
+#define DW1000_CHANNEL(n) (1 << (n))
+#define DW1000_PRF_16MHZ 0x02
+#define DW1000_PRF_64MHZ 0x04
+#define DW1000_MODE(n) (1UL << ((n) - 1))
+
+// channels (1-5, 7) compiled in
+#ifndef DW1000_CHANNELS
+#define DW1000_CHANNELS (DW1000_CHANNEL(1) | DW1000_CHANNEL(2) | DW1000_CHANNEL(3) \
+	| DW1000_CHANNEL(4) | DW1000_CHANNEL(5) | DW1000_CHANNEL(7))
+#endif
+
+// pulse repetition frequencies compiled in
+#ifndef DW1000_PRFS
+#define DW1000_PRFS (DW1000_PRF_16MHZ | DW1000_PRF_64MHZ)
+#endif
+
+// setDefaultMode() modes (1-16) compiled in, modes 9-16 need the 64MHz
+// PRF; 0 for none (configureReceiver() instead)
+#ifndef DW1000_MODES
+#define DW1000_MODES 0xFFFFUL
+#endif
+
+// DEBUG builds: bytes of the SPI capture buffer (debugBuffer) per device
+#ifndef DW1000_DEBUG_BUFFER
+#define DW1000_DEBUG_BUFFER 1024
+#endif
+
+#if ((DW1000_CHANNELS) & 0xBE) == 0 || ((DW1000_CHANNELS) & ~0xBE) != 0
+#error "DW1000_CHANNELS: at least one of the channels 1-5 and 7"
+#endif
+#if ((DW1000_PRFS) & 0x06) == 0 || ((DW1000_PRFS) & ~0x06) != 0
+#error "DW1000_PRFS: DW1000_PRF_16MHZ, DW1000_PRF_64MHZ or both"
+#endif
+#if DW1000_DEBUG_BUFFER < 1
+#error "DW1000_DEBUG_BUFFER: at least one byte"
+#endif
+
+// channel, PRF (TX_PULSE_FREQ_* value) and mode compiled in
+#define DW1000_HAS_CHANNEL(channel) \
+	((channel) >= 1 && (channel) <= 7 && (((DW1000_CHANNELS) >> (channel)) & 0x01))
+#define DW1000_HAS_PRF(prf) ((prf) >= 1 && (prf) <= 2 && (((DW1000_PRFS) >> (prf)) & 0x01))
+#define DW1000_HAS_MODE(mode) \
+	((mode) >= 1 && (mode) <= 16 && (((DW1000_MODES) >> ((mode) - 1)) & 0x01) \
+	&& DW1000_HAS_PRF((mode) <= 8 ? 1 : 2))
+
+// a PRF test that is constant if only one PRF is compiled in
+#define DW1000_IS_16MHZ(test) \
+	((DW1000_PRFS) == DW1000_PRF_16MHZ || ((DW1000_PRFS) != DW1000_PRF_64MHZ && (test)))
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * C++20 coroutine adapter for DW1000Operation, host only (compiles to
+ * nothing without coroutine support). A coroutine starts an operation and
+ * co_awaits it; DW1000Loop::poll() steps all awaited operations and
+ * resumes the coroutines whose operation finished:
+ *
+ *	DW1000Loop::Task exchange(DW1000Loop& loop, DW1000Operation& op) {
+ *		op.startRanging(poll, n, response, sizeof(response), 5000);
+ *		if(co_await loop.wait(op) == DW1000Operation::OP_DONE) { ... }
+ *	}
+ */
+
+#ifndef _DW1000COROUTINE_H_INCLUDED
+#define _DW1000COROUTINE_H_INCLUDED
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <vector>
+#include "DW1000Operation.h"
+
+class DW1000Loop {
+public:
+	// fire and forget coroutine, runs until its first co_await
+	struct Task {
+		struct promise_type {
+			Task get_return_object() { return Task(); }
+			std::suspend_never initial_suspend() { return std::suspend_never(); }
+			std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	// co_await yields the final state of the operation
+	class Awaiter {
+	public:
+		Awaiter(DW1000Loop* loop, DW1000Operation* op) : _loop(loop), _op(op) {}
+		bool await_ready() { return !_op->isBusy(); }
+		void await_suspend(std::coroutine_handle<> handle) {
+			_loop->_waiting.push_back(Waiting(_op, handle));
+		}
+		byte await_resume() { return _op->getState(); }
+
+	private:
+		DW1000Loop* _loop;
+		DW1000Operation* _op;
+	};
+
+	// await an operation that was started before
+	Awaiter wait(DW1000Operation& op) {
+		return Awaiter(this, &op);
+	}
+
+	/*
+	 * Step every awaited operation once (now in us), resume the coroutines
+	 * of finished ones. Returns the number of operations still in flight.
+	 */
+	size_t poll(unsigned long now) {
+		size_t i = 0;
+
+		while(i < _waiting.size()) {
+			if(_waiting[i].op->step(now) == DW1000Operation::OP_BUSY) {
+				i++;
+				continue;
+			}
+			std::coroutine_handle<> handle = _waiting[i].handle;
+			_waiting.erase(_waiting.begin() + i);
+			handle.resume();
+		}
+		return _waiting.size();
+	}
+
+	size_t getWaitingCount() {
+		return _waiting.size();
+	}
+
+private:
+	struct Waiting {
+		Waiting(DW1000Operation* o, std::coroutine_handle<> h) : op(o), handle(h) {}
+		DW1000Operation* op;
+		std::coroutine_handle<> handle;
+	};
+	std::vector<Waiting> _waiting;
+};
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * IEEE 802.15.4 CRC-16 (see DW1000Crc.h).
+ */
+
+#include "DW1000Crc.h"
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#endif
+
+// reflected polynomial 0x1021
+#define CRC_POLY 0x8408
+
+// CRC of a 4 bit value (low nibble), reflected
+#ifdef __AVR__
+static const uint16_t NIBBLE_TABLE[16] PROGMEM = {
+#else
+static const uint16_t NIBBLE_TABLE[16] = {
+#endif
+	0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+	0x8408, 0x9489, 0xA50A, 0xB58B, 0xC60C, 0xD68D, 0xE70E, 0xF78F
+};
+
+#ifdef __AVR__
+#define NIBBLE(i) pgm_read_word(&NIBBLE_TABLE[i])
+#else
+#define NIBBLE(i) NIBBLE_TABLE[i]
+#endif
+
+DW1000Crc::DW1000Crc() {
+	reset();
+}
+
+void DW1000Crc::reset() {
+	_crc = 0;
+}
+
+void DW1000Crc::update(const byte data[], int n) {
+	_crc = update(_crc, data, n);
+}
+
+word DW1000Crc::get() {
+	return _crc;
+}
+
+word DW1000Crc::compute(const byte data[], int n) {
+	return update(0, data, n);
+}
+
+void DW1000Crc::append(byte data[], int n) {
+	word crc = compute(data, n);
+
+	data[n] = (byte)(crc & 0xFF);
+	data[n + 1] = (byte)((crc >> 8) & 0xFF);
+}
+
+boolean DW1000Crc::check(const byte frame[], int n) {
+	return n >= LEN_FCS && compute(frame, n) == 0;
+}
+
+word DW1000Crc::update(word crc, const byte data[], int n) {
+#ifdef __AVR__
+	return updateNibble(crc, data, n);
+#else
+	return updateSlice8(crc, data, n);
+#endif
+}
+
+/*
+ * Two table lookups per byte, 32 bytes of flash.
+ */
+word DW1000Crc::updateNibble(word crc, const byte data[], int n) {
+	uint16_t c = (uint16_t)crc;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		c ^= data[i];
+		c = (c >> 4) ^ NIBBLE(c & 0x0F);
+		c = (c >> 4) ^ NIBBLE(c & 0x0F);
+	}
+	return c;
+}
+
+word DW1000Crc::updateBitwise(word crc, const byte data[], int n) {
+	uint16_t c = (uint16_t)crc;
+	int i, b;
+
+	for(i = 0; i < n; i++) {
+		c ^= data[i];
+		for(b = 0; b < 8; b++) {
+			c = (c & 1) != 0 ? (uint16_t)((c >> 1) ^ CRC_POLY) : (uint16_t)(c >> 1);
+		}
+	}
+	return c;
+}
+
+#ifndef __AVR__
+/*
+ * Slice-by-8: table k holds the CRC of a byte followed by k zero bytes, so
+ * 8 bytes take 8 independent lookups (the 16 bit CRC only touches the
+ * first two bytes of a block).
+ */
+static uint16_t sliceTable[8][256];
+static boolean sliceTableReady = false;
+
+static void buildSliceTable() {
+	int i, k;
+	uint16_t c;
+
+	for(i = 0; i < 256; i++) {
+		c = (uint16_t)i;
+		for(k = 0; k < 8; k++) {
+			c = (c & 1) != 0 ? (uint16_t)((c >> 1) ^ CRC_POLY) : (uint16_t)(c >> 1);
+		}
+		sliceTable[0][i] = c;
+	}
+	for(i = 0; i < 256; i++) {
+		for(k = 1; k < 8; k++) {
+			c = sliceTable[k - 1][i];
+			sliceTable[k][i] = (uint16_t)((c >> 8) ^ sliceTable[0][c & 0xFF]);
+		}
+	}
+	sliceTableReady = true;
+}
+
+word DW1000Crc::updateSlice8(word crc, const byte data[], int n) {
+	uint16_t c = (uint16_t)crc;
+	int i = 0;
+
+	if(!sliceTableReady) {
+		buildSliceTable();
+	}
+	for(; i + 8 <= n; i += 8) {
+		c = sliceTable[7][(data[i] ^ c) & 0xFF] ^ sliceTable[6][(data[i + 1] ^ (c >> 8)) & 0xFF] ^
+			sliceTable[5][data[i + 2]] ^ sliceTable[4][data[i + 3]] ^
+			sliceTable[3][data[i + 4]] ^ sliceTable[2][data[i + 5]] ^
+			sliceTable[1][data[i + 6]] ^ sliceTable[0][data[i + 7]];
+	}
+	for(; i < n; i++) {
+		c = (uint16_t)((c >> 8) ^ sliceTable[0][(c ^ data[i]) & 0xFF]);
+	}
+	return c;
+}
+#endif
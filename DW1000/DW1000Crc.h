@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * IEEE 802.15.4 frame check sequence (FCS) on the host: CRC-16 ITU-T,
+ * x^16 + x^12 + x^5 + 1, bits LSB first, initial value 0, no final XOR,
+ * sent LSB first after the payload (the CRC the DW1000 appends unless the
+ * frame check is suppressed). Over payload and FCS the CRC is 0.
+ *
+ * Table driven: on AVR a 16 entry table (4 bits per step) in flash, on
+ * other targets (Linux, host builds) slice-by-8 with 8 x 256 entries
+ * built on first use. An instance keeps a running CRC for data that
+ * arrives in pieces (e.g. a frame read or written in several transfers).
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _DW1000CRC_H_INCLUDED
+#define _DW1000CRC_H_INCLUDED
+
+#include "DW1000.h"
+
+#define LEN_FCS 2
+
+class DW1000Crc {
+public:
+	DW1000Crc();
+
+	// running CRC
+	void reset();
+	void update(const byte data[], int n);
+	word get();
+
+	// CRC of data, FCS appended at data[n] and data[n + 1], check of a
+	// frame of n bytes ending with its FCS
+	static word compute(const byte data[], int n);
+	static void append(byte data[], int n);
+	static boolean check(const byte frame[], int n);
+
+	// CRC continued over data, table driven (see above), 4 bit table, and
+	// bitwise (reference)
+	static word update(word crc, const byte data[], int n);
+	static word updateNibble(word crc, const byte data[], int n);
+	static word updateBitwise(word crc, const byte data[], int n);
+#ifndef __AVR__
+	static word updateSlice8(word crc, const byte data[], int n);
+#endif
+
+private:
+	word _crc;
+};
+
+#endif
@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000Discovery.h"
+#include "DW1000ReceiverConfig.h"
+
+/* ###########################################################################
+ * #### Coordinator ##########################################################
+ * ######################################################################### */
+
+/*
+ * @param network
+ *		The network id handed out with the assignments.
+ * @param mode
+ *		The operating mode of the nodes (see DW1000::setDefaultMode()).
+ * @param channel
+ *		The operating channel of the nodes.
+ * @param code
+ *		The preamble code of the nodes, 0 for the default of the channel.
+ */
+DW1000DiscoveryCoordinator::DW1000DiscoveryCoordinator(DW1000* dw, word network, byte mode, byte channel, byte code) {
+	_dw = dw;
+	_network = network;
+	_mode = mode;
+	_channel = channel;
+	_code = code;
+	_seq = 0;
+	_window = DISC_MIN_WINDOW;
+	_blinks = 0;
+	_collisions = 0;
+	_nodes = 0;
+	_confirmed = 0;
+	memset(_state, 0, sizeof(_state));
+}
+
+/*
+ * Read the frame just received (see isReceiveDone) and process it. Returns
+ * false for unknown frames.
+ */
+boolean DW1000DiscoveryCoordinator::processReceived() {
+	byte data[LEN_DISC_FRAME];
+	int n;
+
+	n = _dw->getData(data, LEN_DISC_FRAME);
+	if(n < 1) {
+		return false;
+	}
+	handleFrame(data, n);
+	return data[0] == DISC_BLINK || data[0] == DISC_CONFIRM;
+}
+
+void DW1000DiscoveryCoordinator::handleFrame(byte data[], int n) {
+	if(data[0] == DISC_BLINK && n >= LEN_DISC_BLINK) {
+		handleBlink(data);
+	} else if(data[0] == DISC_CONFIRM && n >= LEN_DISC_CONFIRM) {
+		handleConfirm(data);
+	}
+}
+
+/*
+ * A blink takes the next free slot of the table; a node already in the
+ * table lost its assignment or confirmation and gets the same one again.
+ * Blinks are dropped while the table is full (the beacon then announces
+ * no free slots) and if they answer another network's beacon.
+ */
+void DW1000DiscoveryCoordinator::handleBlink(byte data[]) {
+	int i;
+
+	if(!isOwnNetwork(&data[10])) {
+		return;
+	}
+	i = findNode(&data[1]);
+	if(_blinks < 0xFF) {
+		_blinks++;
+	}
+	if(i < 0) {
+		if(_nodes >= DW1000_DISCOVERY_NODES) {
+			return;
+		}
+		i = _nodes++;
+		memcpy(_eui[i], &data[1], LEN_DISC_EUI);
+	} else if(_state[i] == NODE_CONFIRMED) {
+		_confirmed--;
+	}
+	_state[i] = NODE_PENDING;
+}
+
+void DW1000DiscoveryCoordinator::handleConfirm(byte data[]) {
+	int i = (data[1] | ((word)data[2] << 8)) - DISC_FIRST_ADDRESS;
+
+	if(!isOwnNetwork(&data[11]) || i < 0 || i >= _nodes || memcmp(_eui[i], &data[3], LEN_DISC_EUI) != 0) {
+		return;
+	}
+	if(_state[i] == NODE_ASSIGNED) {
+		_state[i] = NODE_CONFIRMED;
+		_confirmed++;
+	}
+}
+
+void DW1000DiscoveryCoordinator::noteCollision() {
+	if(_collisions < 0xFF) {
+		_collisions++;
+	}
+}
+
+/*
+ * Beacon of the next superframe. The contention window doubles after a
+ * superframe with collisions and halves after an idle one. Assignments
+ * without a confirmation in the last superframe are sent again in this
+ * one; their nodes have joined and do not blink any more.
+ */
+int DW1000DiscoveryCoordinator::buildBeacon(byte data[]) {
+	int free = DW1000_DISCOVERY_NODES - _nodes;
+	int i;
+
+	for(i = 0; i < _nodes; i++) {
+		if(_state[i] == NODE_ASSIGNED) {
+			_state[i] = NODE_PENDING;
+		}
+	}
+
+	if(_collisions > 0) {
+		if(_window < DISC_MAX_WINDOW) {
+			_window <<= 1;
+		}
+	} else if(_blinks == 0 && _window > DISC_MIN_WINDOW) {
+		_window >>= 1;
+	}
+	_blinks = 0;
+	_collisions = 0;
+	data[0] = DISC_BEACON;
+	data[1] = (byte)(_network & 0xFF);
+	data[2] = (byte)((_network >> 8) & 0xFF);
+	data[3] = _seq++;
+	data[4] = _window;
+	data[5] = (byte)(free > 0xFF ? 0xFF : free);
+	return LEN_DISC_BEACON;
+}
+
+byte DW1000DiscoveryCoordinator::getWindow() {
+	return _window;
+}
+
+boolean DW1000DiscoveryCoordinator::hasAssignment() {
+	int i;
+
+	for(i = 0; i < _nodes; i++) {
+		if(_state[i] == NODE_PENDING) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * The next pending assignment, in table order.
+ * @param data
+ *		The array to write the frame into, LEN_DISC_ASSIGN bytes.
+ * Returns the frame length, or 0 if no assignment is pending.
+ */
+int DW1000DiscoveryCoordinator::getAssignment(byte data[]) {
+	word address;
+	int i;
+
+	for(i = 0; i < _nodes; i++) {
+		if(_state[i] == NODE_PENDING) {
+			break;
+		}
+	}
+	if(i == _nodes) {
+		return 0;
+	}
+	_state[i] = NODE_ASSIGNED;
+	address = DISC_FIRST_ADDRESS + i;
+	data[0] = DISC_ASSIGN;
+	memcpy(&data[1], _eui[i], LEN_DISC_EUI);
+	data[9] = (byte)(address & 0xFF);
+	data[10] = (byte)((address >> 8) & 0xFF);
+	data[11] = (byte)(_network & 0xFF);
+	data[12] = (byte)((_network >> 8) & 0xFF);
+	data[13] = (byte)i;
+	data[14] = (byte)DW1000_DISCOVERY_NODES;
+	data[15] = _mode;
+	data[16] = _channel;
+	data[17] = _code;
+	return LEN_DISC_ASSIGN;
+}
+
+int DW1000DiscoveryCoordinator::getNodeCount() {
+	return _nodes;
+}
+
+int DW1000DiscoveryCoordinator::getConfirmedCount() {
+	return _confirmed;
+}
+
+int DW1000DiscoveryCoordinator::findNode(const byte eui[]) {
+	int i;
+
+	for(i = 0; i < _nodes; i++) {
+		if(memcmp(_eui[i], eui, LEN_DISC_EUI) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+word DW1000DiscoveryCoordinator::getNodeAddress(int i) {
+	return DISC_FIRST_ADDRESS + i;
+}
+
+boolean DW1000DiscoveryCoordinator::isConfirmed(int i) {
+	return i >= 0 && i < _nodes && _state[i] == NODE_CONFIRMED;
+}
+
+boolean DW1000DiscoveryCoordinator::isOwnNetwork(byte data[]) {
+	return (data[0] | ((word)data[1] << 8)) == _network;
+}
+
+/* ###########################################################################
+ * #### Node #################################################################
+ * ######################################################################### */
+
+/*
+ * @param eui
+ *		The extended address of the node, 8 bytes.
+ * @param seed
+ *		Seed of the backoff, mixed with the EUI (e.g. an analog read).
+ */
+DW1000DiscoveryNode::DW1000DiscoveryNode(DW1000* dw, const byte eui[], unsigned long seed) {
+	int i;
+
+	_dw = dw;
+	memcpy(_eui, eui, LEN_DISC_EUI);
+	_random = seed;
+	for(i = 0; i < LEN_DISC_EUI; i++) {
+		_random = _random * 31 + eui[i];
+	}
+	if(_random == 0) {
+		_random = 1;
+	}
+	restart();
+}
+
+void DW1000DiscoveryNode::restart() {
+	_state = NODE_LISTEN;
+	_backoff = 0;
+	_wait = 0;
+	_nextSlot = 0;
+	_blinkSlot = -1;
+	_attempts = 0;
+	_confirm = false;
+	_address = 0xFFFF;
+	_network = DISC_NO_NETWORK;
+	_slot = 0;
+	_slots = 0;
+	_mode = DISC_DEFAULT_MODE;
+	_channel = DISC_DEFAULT_CHANNEL;
+	_code = 0;
+}
+
+boolean DW1000DiscoveryNode::applyDiscoveryProfile() {
+	if(!DW1000_HAS_MODE(DISC_DEFAULT_MODE) || !DW1000_VALID_CHANNEL(DISC_DEFAULT_CHANNEL)) {
+		return false;
+	}
+	_dw->beginBatch();
+	_dw->setDefaultMode(DISC_DEFAULT_MODE);
+	_dw->setRFChannel(DISC_DEFAULT_CHANNEL);
+	_dw->setPreambleCode(DW1000::defaultPreambleCode(DISC_DEFAULT_CHANNEL, _dw->getPulseFrequency()));
+	_dw->endBatch();
+	return true;
+}
+
+/*
+ * Read the frame just received (see isReceiveDone) and process it. Returns
+ * false for unknown frames.
+ */
+boolean DW1000DiscoveryNode::processReceived() {
+	byte data[LEN_DISC_FRAME];
+	int n;
+
+	n = _dw->getData(data, LEN_DISC_FRAME);
+	if(n < 1) {
+		return false;
+	}
+	handleFrame(data, n);
+	return data[0] == DISC_BEACON || data[0] == DISC_ASSIGN;
+}
+
+void DW1000DiscoveryNode::handleFrame(byte data[], int n) {
+	if(data[0] == DISC_BEACON && n >= LEN_DISC_BEACON) {
+		handleBeacon(data);
+	} else if(data[0] == DISC_ASSIGN && n >= LEN_DISC_ASSIGN) {
+		handleAssign(data);
+	}
+}
+
+/*
+ * A beacon while waiting for an assignment means the blink was lost, the
+ * backoff range doubles. A blink is scheduled uniformly over the next
+ * window * 2^backoff contention slots, i.e. possibly some superframes
+ * ahead. The first beacon with free slots fixes the network, beacons of
+ * other coordinators are ignored from then on.
+ */
+void DW1000DiscoveryNode::handleBeacon(byte data[]) {
+	word network = data[1] | ((word)data[2] << 8);
+	byte window = data[4];
+	unsigned long r;
+
+	if(_network != DISC_NO_NETWORK && network != _network) {
+		return;
+	}
+	_blinkSlot = -1;
+	if(_state == NODE_JOINED || window == 0 || data[5] == 0) {
+		return;
+	}
+	_network = network;
+	if(_state == NODE_WAIT_ASSIGN) {
+		if(_backoff < DISC_MAX_BACKOFF) {
+			_backoff++;
+		}
+		_state = NODE_LISTEN;
+		_wait = 0;
+	}
+	if(_wait == 0) {
+		r = nextRandom() % ((unsigned long)window << _backoff);
+		_wait = (byte)(r / window + 1);
+		_nextSlot = (byte)(r % window);
+	}
+	_wait--;
+	if(_wait == 0) {
+		// the window may have narrowed since
+		_blinkSlot = _nextSlot % window;
+	}
+}
+
+/*
+ * An assignment is only taken from the network the node blinked to.
+ */
+void DW1000DiscoveryNode::handleAssign(byte data[]) {
+	if(memcmp(&data[1], _eui, LEN_DISC_EUI) != 0 || (data[11] | ((word)data[12] << 8)) != _network) {
+		return;
+	}
+	_address = data[9] | ((word)data[10] << 8);
+	_slot = data[13];
+	_slots = data[14];
+	_mode = data[15];
+	_channel = data[16];
+	_code = data[17];
+	_state = NODE_JOINED;
+	_backoff = 0;
+	_wait = 0;
+	_blinkSlot = -1;
+	// confirmed again if the coordinator repeats it (lost confirmation)
+	_confirm = true;
+}
+
+int DW1000DiscoveryNode::getBlinkSlot() {
+	return _blinkSlot;
+}
+
+int DW1000DiscoveryNode::buildBlink(byte data[]) {
+	if(_attempts < 0xFF) {
+		_attempts++;
+	}
+	data[0] = DISC_BLINK;
+	memcpy(&data[1], _eui, LEN_DISC_EUI);
+	data[9] = _attempts;
+	data[10] = (byte)(_network & 0xFF);
+	data[11] = (byte)((_network >> 8) & 0xFF);
+	_state = NODE_WAIT_ASSIGN;
+	_blinkSlot = -1;
+	return LEN_DISC_BLINK;
+}
+
+boolean DW1000DiscoveryNode::isJoined() {
+	return _state == NODE_JOINED;
+}
+
+boolean DW1000DiscoveryNode::hasConfirm() {
+	return _confirm;
+}
+
+int DW1000DiscoveryNode::buildConfirm(byte data[]) {
+	_confirm = false;
+	data[0] = DISC_CONFIRM;
+	data[1] = (byte)(_address & 0xFF);
+	data[2] = (byte)((_address >> 8) & 0xFF);
+	memcpy(&data[3], _eui, LEN_DISC_EUI);
+	data[11] = (byte)(_network & 0xFF);
+	data[12] = (byte)((_network >> 8) & 0xFF);
+	return LEN_DISC_CONFIRM;
+}
+
+/*
+ * Switch the device to the assigned operating profile in one batch.
+ * Returns false if not joined or if the profile is invalid.
+ */
+boolean DW1000DiscoveryNode::applyProfile() {
+	byte code = _code;
+
+	if(_state != NODE_JOINED || !DW1000_HAS_MODE(_mode) || !DW1000_VALID_CHANNEL(_channel)) {
+		return false;
+	}
+	_dw->beginBatch();
+	_dw->setDefaultMode(_mode);
+	_dw->setRFChannel(_channel);
+	if(code == 0) {
+		code = DW1000::defaultPreambleCode(_channel, _dw->getPulseFrequency());
+	}
+	_dw->setPreambleCode(code);
+	_dw->endBatch();
+	return true;
+}
+
+word DW1000DiscoveryNode::getAddress() {
+	return _address;
+}
+
+word DW1000DiscoveryNode::getNetwork() {
+	return _network;
+}
+
+byte DW1000DiscoveryNode::getSlot() {
+	return _slot;
+}
+
+byte DW1000DiscoveryNode::getSlotCount() {
+	return _slots;
+}
+
+byte DW1000DiscoveryNode::getMode() {
+	return _mode;
+}
+
+byte DW1000DiscoveryNode::getChannel() {
+	return _channel;
+}
+
+byte DW1000DiscoveryNode::getPreambleCode() {
+	return _code;
+}
+
+byte DW1000DiscoveryNode::getAttempts() {
+	return _attempts;
+}
+
+byte DW1000DiscoveryNode::getState() {
+	return _state;
+}
+
+// xorshift32
+unsigned long DW1000DiscoveryNode::nextRandom() {
+	uint32_t x = (uint32_t)_random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	_random = x;
+	return x;
+}
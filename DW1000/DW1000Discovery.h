@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Network discovery and auto-configuration. New nodes need nothing but
+ * their extended address (EUI): they listen on the discovery profile
+ * (DISC_DEFAULT_MODE, DISC_DEFAULT_CHANNEL) for the beacon of a
+ * coordinator, blink in a random contention slot after it and receive a
+ * short address, a TDMA slot and the operating profile (a setDefaultMode()
+ * mode, channel and preamble code) in the assignment phase of the same
+ * superframe. They confirm there and switch to the operating profile.
+ *
+ *   superframe  beacon | contention slots (window) | assignments and
+ *               confirms | TDMA slots of the joined nodes
+ *
+ * Nodes without an assignment back off binary exponentially over the
+ * following superframes; the coordinator widens the window after
+ * collisions and narrows it when it stays idle. Assignments that are not
+ * confirmed within their superframe are repeated in the next one, a
+ * joined node answers each of them with a confirmation. A node follows
+ * the network of the first beacon it acts on; all messages carry the
+ * network id, frames of other networks are ignored on both sides. All
+ * messages have a fixed size and the node table a fixed capacity
+ * (DW1000_DISCOVERY_NODES). Like DW1000TDoA the classes build and parse
+ * frames, transmitting them at the right time is up to the caller.
+ */
+
+#ifndef _DW1000DISCOVERY_H_INCLUDED
+#define _DW1000DISCOVERY_H_INCLUDED
+
+#include "DW1000.h"
+
+// nodes of a coordinator, i.e. TDMA slots
+#ifndef DW1000_DISCOVERY_NODES
+#define DW1000_DISCOVERY_NODES 16
+#endif
+
+// profile of nodes that have not joined yet
+#define DISC_DEFAULT_MODE 2
+#define DISC_DEFAULT_CHANNEL 5
+// contention slots per superframe, max. backoff exponent of the nodes
+#define DISC_MIN_WINDOW 2
+#define DISC_MAX_WINDOW 8
+#define DISC_MAX_BACKOFF 4
+// address of the coordinator, first node address
+#define DISC_COORDINATOR 0x0000
+#define DISC_FIRST_ADDRESS 0x0001
+// network id of a node that follows no coordinator yet (not a valid id)
+#define DISC_NO_NETWORK 0xFFFF
+
+#define LEN_DISC_EUI 8
+// beacon: type, network id, sequence number, window, free slots
+#define DISC_BEACON 0x60
+#define LEN_DISC_BEACON 6
+// blink: type, EUI, attempt, network id
+#define DISC_BLINK 0x61
+#define LEN_DISC_BLINK 12
+// assignment: type, EUI, address, network id, slot, slot count, mode,
+// channel, preamble code
+#define DISC_ASSIGN 0x62
+#define LEN_DISC_ASSIGN 18
+// confirmation: type, address, EUI, network id
+#define DISC_CONFIRM 0x63
+#define LEN_DISC_CONFIRM 13
+
+// the longest message, for receive buffers
+#define LEN_DISC_FRAME LEN_DISC_ASSIGN
+
+class DW1000DiscoveryCoordinator {
+public:
+	// coordinator of the given network, handing out the operating profile
+	DW1000DiscoveryCoordinator(DW1000* dw, word network, byte mode, byte channel, byte code);
+
+	// receive path: blinks and confirmations
+	boolean processReceived();
+	void handleFrame(byte data[], int n);
+	// a contention slot with a preamble but no good frame
+	void noteCollision();
+
+	// start of a superframe, adapts the window to the last one
+	int buildBeacon(byte data[]);
+	byte getWindow();
+
+	// assignments due in this superframe, at most one per contention slot
+	boolean hasAssignment();
+	int getAssignment(byte data[]);
+
+	// node table
+	int getNodeCount();
+	int getConfirmedCount();
+	int findNode(const byte eui[]);
+	word getNodeAddress(int i);
+	boolean isConfirmed(int i);
+
+	// table states
+	static const byte NODE_PENDING = 1;
+	static const byte NODE_ASSIGNED = 2;
+	static const byte NODE_CONFIRMED = 3;
+
+private:
+	DW1000* _dw;
+	word _network;
+	byte _mode;
+	byte _channel;
+	byte _code;
+	byte _seq;
+	byte _window;
+	// blinks and collisions since the last beacon
+	byte _blinks;
+	byte _collisions;
+
+	byte _eui[DW1000_DISCOVERY_NODES][LEN_DISC_EUI];
+	byte _state[DW1000_DISCOVERY_NODES];
+	int _nodes;
+	int _confirmed;
+
+	boolean isOwnNetwork(byte data[]);
+	void handleBlink(byte data[]);
+	void handleConfirm(byte data[]);
+};
+
+class DW1000DiscoveryNode {
+public:
+	// node with the given EUI, seed of its backoff
+	DW1000DiscoveryNode(DW1000* dw, const byte eui[], unsigned long seed);
+
+	// back to discovery, e.g. after losing the network
+	void restart();
+	// the discovery profile, false if it is not compiled in (DW1000Config.h)
+	boolean applyDiscoveryProfile();
+
+	// receive path: beacons and assignments
+	boolean processReceived();
+	void handleFrame(byte data[], int n);
+
+	// contention slot to blink in during this superframe, -1 for none
+	int getBlinkSlot();
+	int buildBlink(byte data[]);
+
+	// joined: confirm once, then switch to the operating profile
+	boolean isJoined();
+	boolean hasConfirm();
+	int buildConfirm(byte data[]);
+	boolean applyProfile();
+
+	// assignment; the network is known from the first beacon followed
+	word getAddress();
+	word getNetwork();
+	byte getSlot();
+	byte getSlotCount();
+	byte getMode();
+	byte getChannel();
+	byte getPreambleCode();
+	// blinks sent until joined
+	byte getAttempts();
+
+	// states
+	static const byte NODE_LISTEN = 0;
+	static const byte NODE_WAIT_ASSIGN = 1;
+	static const byte NODE_JOINED = 2;
+	byte getState();
+
+private:
+	DW1000* _dw;
+	byte _eui[LEN_DISC_EUI];
+	byte _state;
+	unsigned long _random;
+	// backoff exponent, superframes until the scheduled blink (0 if none
+	// is scheduled) and its contention slot
+	byte _backoff;
+	byte _wait;
+	byte _nextSlot;
+	int _blinkSlot;
+	byte _attempts;
+	boolean _confirm;
+
+	word _address;
+	word _network;
+	byte _slot;
+	byte _slots;
+	byte _mode;
+	byte _channel;
+	byte _code;
+
+	void handleBeacon(byte data[]);
+	void handleAssign(byte data[]);
+	unsigned long nextRandom();
+};
+
+#endif
@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Compact binary log of RX events (see DW1000EventLog.h).
+ */
+
+#include <math.h>
+#include "DW1000EventLog.h"
+
+// 40 bit timestamps, deltas from 2^35 on take the KEY form (5 bytes)
+#define TIME_MASK 0xFFFFFFFFFFLL
+#define MAX_DELTA 0x800000000LL
+
+// power correction (user manual, sec. 4.7.1), 16MHz and 64MHz PRF
+#define POWER_A_PRF_16MHZ 113.77f
+#define POWER_A_PRF_64MHZ 121.74f
+
+/* ###########################################################################
+ * #### Encoder ##############################################################
+ * ######################################################################### */
+
+DW1000EventLog::DW1000EventLog(byte buffer[], unsigned int size) {
+	_buffer = buffer;
+	_size = size;
+	_head = 0;
+	_tail = 0;
+	_count = 0;
+	_seq = 0;
+	_lastTime = 0;
+	_lastSource = 0;
+	_sinceKey = 0;
+	_needKey = true;
+	_logged = 0;
+	_dropped = 0;
+}
+
+/*
+ * Encodes a record into the ring. The event's seq is ignored, records are
+ * numbered by the log.
+ * @param event
+ *		The event (timestamp, source, frame sequence number and levels).
+ * @return
+ *		False if the ring had no room, the record is dropped then.
+ */
+boolean DW1000EventLog::log(const DW1000Event* event) {
+	byte raw[LEN_EVENTLOG_RECORD];
+	byte encoded[LEN_EVENTLOG_ENCODED];
+	int64_t time = event->time & TIME_MASK;
+	int64_t delta = (time - _lastTime) & TIME_MASK;
+	int n = 2, m, code, i;
+	boolean key = _needKey || _sinceKey >= EVENTLOG_KEY_INTERVAL || delta >= MAX_DELTA;
+	boolean sameSource = !key && event->source == _lastSource;
+
+	raw[0] = (key ? EVENTLOG_KEY : 0) | (sameSource ? EVENTLOG_SAME_SOURCE : 0);
+	raw[1] = _seq;
+	if(key) {
+		for(i = 0; i < LEN_STAMP; i++) {
+			raw[n++] = (byte)(time >> (8 * i));
+		}
+	} else {
+		while(delta >= 0x80) {
+			raw[n++] = (byte)(delta | 0x80);
+			delta >>= 7;
+		}
+		raw[n++] = (byte)delta;
+	}
+	if(!sameSource) {
+		raw[n++] = (byte)(event->source & 0xFF);
+		raw[n++] = (byte)(event->source >> 8);
+	}
+	raw[n++] = event->frameSeq;
+	raw[n++] = event->rxLevel;
+	raw[n++] = event->fpLevel;
+	raw[n] = crc8(raw, n);
+	n++;
+
+	// COBS: each code byte tells the distance to the next zero
+	code = 0;
+	m = 1;
+	for(i = 0; i < n; i++) {
+		if(raw[i] == 0) {
+			encoded[code] = (byte)(m - code);
+			code = m++;
+		} else {
+			encoded[m++] = raw[i];
+		}
+	}
+	encoded[code] = (byte)(m - code);
+	encoded[m++] = 0x00;
+
+	_seq++;
+	if(_size - _count < (unsigned int)m) {
+		// the decoder sees the sequence gap and waits for a KEY record
+		_needKey = true;
+		_dropped++;
+		return false;
+	}
+	for(i = 0; i < m; i++) {
+		_buffer[_head] = encoded[i];
+		_head = (_head + 1) % _size;
+	}
+	_count += m;
+	_lastTime = time;
+	_lastSource = event->source;
+	_sinceKey = key ? 1 : _sinceKey + 1;
+	_needKey = false;
+	_logged++;
+	return true;
+}
+
+/*
+ * Logs the frame just received, with its RX timestamp and power levels.
+ * @param dw
+ *		The device that received the frame.
+ * @param source
+ *		The source address, from the frame.
+ * @param frameSeq
+ *		The sequence number, from the frame.
+ */
+boolean DW1000EventLog::logReceive(DW1000* dw, word source, byte frameSeq) {
+	byte rxtime[LEN_RX_TIME];
+	byte fqual[LEN_RX_FQUAL];
+	byte finfo[LEN_RX_FINFO];
+	DW1000Event event;
+	word pacc;
+
+	dw->readRegister<DW1000Reg::RxTime>(rxtime);
+	dw->readRegister<DW1000Reg::RxFqual>(fqual);
+	dw->readRegister<DW1000Reg::RxFinfo>(finfo);
+	pacc = DW1000Reg::RXPACC::get(finfo);
+	event.time = DW1000::toTimestamp(rxtime);
+	event.source = source;
+	event.frameSeq = frameSeq;
+	event.rxLevel = toLevel(receivePower(fqual[6] | ((word)fqual[7] << 8), pacc, dw->getPulseFrequency()));
+	event.fpLevel = toLevel(firstPathPower(rxtime[FP_AMPL1_SUB] | ((word)rxtime[FP_AMPL1_SUB + 1] << 8),
+		fqual[2] | ((word)fqual[3] << 8), fqual[4] | ((word)fqual[5] << 8), pacc, dw->getPulseFrequency()));
+	return log(&event);
+}
+
+unsigned int DW1000EventLog::available() {
+	return _count;
+}
+
+/*
+ * Takes up to n bytes off the ring.
+ * @return
+ *		The number of bytes copied.
+ */
+int DW1000EventLog::read(byte data[], int n) {
+	int i;
+
+	if((unsigned int)n > _count) {
+		n = (int)_count;
+	}
+	for(i = 0; i < n; i++) {
+		data[i] = _buffer[_tail];
+		_tail = (_tail + 1) % _size;
+	}
+	_count -= n;
+	return n;
+}
+
+unsigned long DW1000EventLog::getLoggedCount() {
+	return _logged;
+}
+
+unsigned long DW1000EventLog::getDroppedCount() {
+	return _dropped;
+}
+
+byte DW1000EventLog::toLevel(float dBm) {
+	float level = -2.0f * dBm + 0.5f;
+
+	if(level <= 0.0f) {
+		return 0;
+	}
+	if(level >= 255.0f) {
+		return 255;
+	}
+	return (byte)level;
+}
+
+float DW1000EventLog::fromLevel(byte level) {
+	return -0.5f * level;
+}
+
+float DW1000EventLog::receivePower(word cirPower, word preambleCount, byte prf) {
+	float a = (prf == DW1000::TX_PULSE_FREQ_16MHZ ? POWER_A_PRF_16MHZ : POWER_A_PRF_64MHZ);
+	float n = preambleCount;
+
+	if(cirPower == 0 || preambleCount == 0) {
+		return -255.0f;
+	}
+	return 10.0f * log10f((float)cirPower * 131072.0f / (n * n)) - a;
+}
+
+float DW1000EventLog::firstPathPower(word ampl1, word ampl2, word ampl3, word preambleCount, byte prf) {
+	float a = (prf == DW1000::TX_PULSE_FREQ_16MHZ ? POWER_A_PRF_16MHZ : POWER_A_PRF_64MHZ);
+	float f1 = ampl1, f2 = ampl2, f3 = ampl3, n = preambleCount;
+
+	if(preambleCount == 0 || (ampl1 == 0 && ampl2 == 0 && ampl3 == 0)) {
+		return -255.0f;
+	}
+	return 10.0f * log10f((f1 * f1 + f2 * f2 + f3 * f3) / (n * n)) - a;
+}
+
+/*
+ * CRC-8, polynomial x^8 + x^2 + x + 1, bitwise (a record is short).
+ */
+byte DW1000EventLog::crc8(const byte data[], int n) {
+	byte crc = 0;
+	int i, b;
+
+	for(i = 0; i < n; i++) {
+		crc ^= data[i];
+		for(b = 0; b < 8; b++) {
+			crc = (crc & 0x80) != 0 ? (byte)((crc << 1) ^ 0x07) : (byte)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+/* ###########################################################################
+ * #### Streaming decoder ####################################################
+ * ######################################################################### */
+
+DW1000EventDecoder::DW1000EventDecoder(EventHandler handler, void* context) {
+	_handler = handler;
+	_context = context;
+	reset();
+	_events = 0;
+	_lost = 0;
+	_errors = 0;
+	_skipped = 0;
+}
+
+/*
+ * Forgets the stream state, e.g. after reopening the link. The next record
+ * decoded is a KEY record.
+ */
+void DW1000EventDecoder::reset() {
+	_length = 0;
+	_overflow = false;
+	_synced = false;
+	_started = false;
+	_seq = 0;
+	_lastTime = 0;
+	_lastSource = 0;
+}
+
+/*
+ * Collects bytes up to the next delimiter and decodes the record. A frame
+ * longer than a record (e.g. a lost delimiter) is dropped as a whole.
+ */
+void DW1000EventDecoder::feed(const byte data[], int n) {
+	int i;
+
+	for(i = 0; i < n; i++) {
+		if(data[i] == 0x00) {
+			if(_overflow) {
+				_errors++;
+			} else if(_length > 0) {
+				decodeFrame();
+			}
+			_length = 0;
+			_overflow = false;
+		} else if(_length < LEN_EVENTLOG_ENCODED) {
+			_frame[_length++] = data[i];
+		} else {
+			_overflow = true;
+		}
+	}
+}
+
+void DW1000EventDecoder::decodeFrame() {
+	byte raw[LEN_EVENTLOG_ENCODED];
+	DW1000Event event;
+	int n = 0, i = 0, k, code, shift;
+	int64_t delta;
+
+	// COBS
+	while(i < _length) {
+		code = _frame[i++];
+		for(k = 1; k < code; k++) {
+			if(i >= _length) {
+				_errors++;
+				_synced = false;
+				return;
+			}
+			raw[n++] = _frame[i++];
+		}
+		if(code < 0xFF && i < _length) {
+			raw[n++] = 0x00;
+		}
+	}
+	if(n < 6 || DW1000EventLog::crc8(raw, n - 1) != raw[n - 1]) {
+		_errors++;
+		_synced = false;
+		return;
+	}
+	n--;
+
+	// sequence gap: records lost on the device or on the link
+	event.seq = raw[1];
+	if(_started && event.seq != (byte)(_seq + 1)) {
+		_lost += (byte)(event.seq - _seq - 1);
+		_synced = false;
+	}
+	_started = true;
+	_seq = event.seq;
+	if((raw[0] & EVENTLOG_KEY) == 0 && !_synced) {
+		_skipped++;
+		return;
+	}
+
+	i = 2;
+	if((raw[0] & EVENTLOG_KEY) != 0) {
+		event.time = 0;
+		for(k = 0; k < LEN_STAMP; k++) {
+			event.time |= (int64_t)raw[i++] << (8 * k);
+		}
+	} else {
+		delta = 0;
+		shift = 0;
+		do {
+			if(i >= n || shift > 35) {
+				_errors++;
+				_synced = false;
+				return;
+			}
+			delta |= (int64_t)(raw[i] & 0x7F) << shift;
+			shift += 7;
+		} while((raw[i++] & 0x80) != 0);
+		event.time = (_lastTime + delta) & TIME_MASK;
+	}
+	if((raw[0] & EVENTLOG_SAME_SOURCE) != 0) {
+		event.source = _lastSource;
+	} else {
+		if(i + 2 > n) {
+			_errors++;
+			_synced = false;
+			return;
+		}
+		event.source = raw[i] | ((word)raw[i + 1] << 8);
+		i += 2;
+	}
+	if(i + 3 != n) {
+		_errors++;
+		_synced = false;
+		return;
+	}
+	event.frameSeq = raw[i];
+	event.rxLevel = raw[i + 1];
+	event.fpLevel = raw[i + 2];
+
+	_synced = true;
+	_lastTime = event.time;
+	_lastSource = event.source;
+	_events++;
+	if(_handler != NULL) {
+		(*_handler)(_context, &event);
+	}
+}
+
+unsigned long DW1000EventDecoder::getEventCount() {
+	return _events;
+}
+
+unsigned long DW1000EventDecoder::getLostCount() {
+	return _lost;
+}
+
+unsigned long DW1000EventDecoder::getErrorCount() {
+	return _errors;
+}
+
+unsigned long DW1000EventDecoder::getSkippedCount() {
+	return _skipped;
+}
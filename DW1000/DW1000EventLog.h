@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Compact binary log of RX events for a slow link to the gateway (e.g. a
+ * serial port), instead of printing text. A record carries a log sequence
+ * number, the 40 bit RX timestamp, the source address, the frame sequence
+ * number and the received and first path power:
+ *
+ *   flags     KEY (absolute timestamp), SAME_SOURCE (source omitted)
+ *   seq       log sequence number, gaps tell lost records
+ *   time      KEY: 5 bytes, else the delta to the previous record (mod
+ *             2^40), variable length (7 bits per byte, LSB first)
+ *   source    2 bytes, unless the same as in the previous record
+ *   frameSeq  1 byte
+ *   levels    received and first path power, 1 byte each (-0.5dBm steps)
+ *   crc       CRC-8 of the above
+ *
+ * Each record is COBS encoded and ends with a 0x00 byte, so the decoder
+ * finds the record boundaries again after lost or corrupted bytes. After a
+ * loss it waits for the next KEY record, which the encoder sends every
+ * EVENTLOG_KEY_INTERVAL records and after records were dropped. A typical
+ * record takes 12 to 14 bytes on the link.
+ *
+ * The encoder writes into a fixed ring that is drained by the caller (e.g.
+ * as much as Serial.availableForWrite() allows per loop), both from the
+ * loop, not from an interrupt handler. DW1000EventDecoder is the streaming
+ * decoder for the gateway.
+ */
+
+#ifndef _DW1000EVENTLOG_H_INCLUDED
+#define _DW1000EVENTLOG_H_INCLUDED
+
+#include "DW1000.h"
+
+// records between KEY records
+#ifndef EVENTLOG_KEY_INTERVAL
+#define EVENTLOG_KEY_INTERVAL 32
+#endif
+
+// record flags
+#define EVENTLOG_KEY 0x01
+#define EVENTLOG_SAME_SOURCE 0x02
+
+// longest record, raw and encoded (COBS byte and delimiter)
+#define LEN_EVENTLOG_RECORD 13
+#define LEN_EVENTLOG_ENCODED (LEN_EVENTLOG_RECORD + 2)
+
+struct DW1000Event {
+	byte seq;
+	int64_t time;
+	word source;
+	byte frameSeq;
+	// received and first path power in -0.5dBm steps (e.g. 190 = -95dBm)
+	byte rxLevel;
+	byte fpLevel;
+};
+
+class DW1000EventLog {
+public:
+	// encoder into the given ring
+	DW1000EventLog(byte buffer[], unsigned int size);
+
+	// appends a record, returns false if the ring is full (the record is
+	// dropped, the next one is a KEY record)
+	boolean log(const DW1000Event* event);
+	// the frame just received (three register reads: timestamp and first
+	// path amplitude, quality, preamble count)
+	boolean logReceive(DW1000* dw, word source, byte frameSeq);
+
+	// drain the ring: bytes ready, and up to n of them copied to data
+	unsigned int available();
+	int read(byte data[], int n);
+
+	// records logged and dropped since construction
+	unsigned long getLoggedCount();
+	unsigned long getDroppedCount();
+
+	// power level byte of a power in dBm
+	static byte toLevel(float dBm);
+	static float fromLevel(byte level);
+	// received and first path power (user manual, sec. 4.7) from the raw
+	// values of RX_TIME, RX_FQUAL and RX_FINFO
+	static float receivePower(word cirPower, word preambleCount, byte prf);
+	static float firstPathPower(word ampl1, word ampl2, word ampl3, word preambleCount, byte prf);
+
+	static byte crc8(const byte data[], int n);
+
+private:
+	byte* _buffer;
+	unsigned int _size;
+	unsigned int _head;
+	unsigned int _tail;
+	unsigned int _count;
+	byte _seq;
+	int64_t _lastTime;
+	word _lastSource;
+	int _sinceKey;
+	boolean _needKey;
+	unsigned long _logged;
+	unsigned long _dropped;
+};
+
+class DW1000EventDecoder {
+public:
+	typedef void (*EventHandler)(void* context, const DW1000Event* event);
+
+	// streaming decoder calling the handler per decoded record
+	DW1000EventDecoder(EventHandler handler, void* context);
+	void reset();
+
+	// bytes as received, in chunks of any size
+	void feed(const byte data[], int n);
+
+	// decoded records, records missing (sequence gaps), corrupted records
+	// and intact records skipped while waiting for a KEY record
+	unsigned long getEventCount();
+	unsigned long getLostCount();
+	unsigned long getErrorCount();
+	unsigned long getSkippedCount();
+
+private:
+	EventHandler _handler;
+	void* _context;
+	byte _frame[LEN_EVENTLOG_ENCODED];
+	int _length;
+	boolean _overflow;
+	boolean _synced;
+	boolean _started;
+	byte _seq;
+	int64_t _lastTime;
+	word _lastSource;
+	unsigned long _events;
+	unsigned long _lost;
+	unsigned long _errors;
+	unsigned long _skipped;
+
+	void decodeFrame();
+};
+
+#endif
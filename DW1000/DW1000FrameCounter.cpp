@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000FrameCounter.h"
+
+DW1000FrameCounter::DW1000FrameCounter(DW1000* dw) {
+	_dw = dw;
+	_running = false;
+	reset();
+}
+
+/*
+ * Enable the receiver. Auto re-enable keeps it on after bad frames, good
+ * frames and timeouts re-enable it in poll().
+ */
+void DW1000FrameCounter::start() {
+	_dw->setReceiverAutoReenable(true);
+	_dw->clearReceiveStatus();
+	restart();
+	_running = true;
+}
+
+void DW1000FrameCounter::stop() {
+	_dw->setReceiverAutoReenable(false);
+	_dw->cancelReceive();
+	_running = false;
+}
+
+void DW1000FrameCounter::reset() {
+	_good = 0;
+	_bad = 0;
+	_timeouts = 0;
+	_first = 0;
+	_last = 0;
+}
+
+boolean DW1000FrameCounter::poll(unsigned long now) {
+	byte status[LEN_SYS_STATUS];
+
+	if(!_running) {
+		return false;
+	}
+	_dw->readSystemEventStatus(status);
+	if(DW1000Reg::RXDFR::get(status) && DW1000Reg::RXFCG::get(status)) {
+		if(_good == 0) {
+			_first = now;
+		}
+		_last = now;
+		_good++;
+		_dw->clearReceiveStatus();
+		restart();
+		return true;
+	}
+	if(DW1000Reg::RXPHE::get(status) || DW1000Reg::RXFCE::get(status) || DW1000Reg::RXRFSL::get(status)) {
+		// receiver already re-enabled by the device
+		_bad++;
+		_dw->clearReceiveStatus();
+		return true;
+	}
+	if(DW1000Reg::RXRFTO::get(status) || DW1000Reg::RXPTO::get(status) || DW1000Reg::RXSFDTO::get(status)) {
+		_timeouts++;
+		_dw->clearReceiveStatus();
+		restart();
+	}
+	return false;
+}
+
+unsigned long DW1000FrameCounter::getGoodCount() {
+	return _good;
+}
+
+unsigned long DW1000FrameCounter::getBadCount() {
+	return _bad;
+}
+
+unsigned long DW1000FrameCounter::getTimeoutCount() {
+	return _timeouts;
+}
+
+float DW1000FrameCounter::getErrorRate() {
+	if(_good + _bad == 0) {
+		return 0.0f;
+	}
+	return (float)_bad / (float)(_good + _bad);
+}
+
+float DW1000FrameCounter::getErrorRate(unsigned long sent) {
+	if(sent == 0) {
+		return 0.0f;
+	}
+	if(_good >= sent) {
+		return 0.0f;
+	}
+	return (float)(sent - _good) / (float)sent;
+}
+
+float DW1000FrameCounter::getFrameRate() {
+	if(_good < 2 || _last == _first) {
+		return 0.0f;
+	}
+	return (float)(_good - 1) * 1000000.0f / (float)(_last - _first);
+}
+
+void DW1000FrameCounter::restart() {
+	_dw->newReceive();
+	_dw->startReceive();
+}
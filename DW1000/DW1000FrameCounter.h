@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Receive side of the RF throughput tests: counts good and bad frames from
+ * SYS_STATUS while another device sends continuous frames (see
+ * DW1000::startContinuousFrame()), for the packet error rate and the
+ * reached frame rate of a setDefaultMode() profile. Polled from the loop
+ * like DW1000Operation, one status read per poll().
+ */
+
+#ifndef _DW1000FRAMECOUNTER_H_INCLUDED
+#define _DW1000FRAMECOUNTER_H_INCLUDED
+
+#include "DW1000.h"
+
+class DW1000FrameCounter {
+public:
+	// counter on the given device
+	DW1000FrameCounter(DW1000* dw);
+
+	// receiver on (and back on after each frame), counts are kept
+	void start();
+	void stop();
+	void reset();
+
+	// with the current time in us (e.g. micros()), returns true if a frame
+	// (good or bad) was counted
+	boolean poll(unsigned long now);
+
+	// counts since the last reset()
+	unsigned long getGoodCount();
+	unsigned long getBadCount();
+	unsigned long getTimeoutCount();
+
+	// bad frames per received frame, or per sent frame (lost frames are
+	// errors too) if the number of sent frames is known
+	float getErrorRate();
+	float getErrorRate(unsigned long sent);
+
+	// good frames per second between the first and the last good frame
+	float getFrameRate();
+
+private:
+	DW1000* _dw;
+	boolean _running;
+	unsigned long _good;
+	unsigned long _bad;
+	unsigned long _timeouts;
+	unsigned long _first;
+	unsigned long _last;
+
+	void restart();
+};
+
+#endif
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000Hopping.h"
+
+DW1000Hopping::DW1000Hopping(DW1000* dw) {
+	byte all[HOP_CHANNELS];
+	int i, n = 0;
+
+	_dw = dw;
+	for(i = 0; i < HOP_CHANNELS; i++) {
+		// the channels compiled in (DW1000_CHANNELS)
+		byte channel = (i == HOP_CHANNELS - 1) ? 7 : (byte)(i + 1);
+		if(DW1000_HAS_CHANNEL(channel)) {
+			all[n++] = channel;
+		}
+		_codes[i] = 0;
+		_preambles[i] = 0;
+		_frames[i] = 0;
+		_errors[i] = 0;
+	}
+	_retuneWrites = 0;
+	_retuneTime = 0;
+	_settleTime = 0;
+	_settled = false;
+	_phase = PHASE_IDLE;
+	_dwell = 0;
+	_start = 0;
+	_scanPosition = 0;
+	setSequence(all, n);
+	prepare();
+}
+
+/*
+ * Build the register images of all channels. The next retune writes the
+ * whole image, as the current register contents are not known.
+ */
+void DW1000Hopping::prepare() {
+	int i;
+
+	for(i = 0; i < HOP_CHANNELS; i++) {
+		byte channel = (i == HOP_CHANNELS - 1) ? 7 : (byte)(i + 1);
+		if(!_dw->getChannelImage(channel, _codes[i], &_images[i])) {
+			_images[i].channel = 0;
+		}
+	}
+	_current = -1;
+}
+
+/*
+ * Preamble code of a channel, used from the next prepare() on.
+ * @param code
+ *		Code valid for the channel and PRF, or 0 for
+ *		DW1000::defaultPreambleCode().
+ */
+boolean DW1000Hopping::setPreambleCode(byte channel, byte code) {
+	int index = channelIndex(channel);
+
+	if(index < 0 || code > 24) {
+		return false;
+	}
+	_codes[index] = code;
+	return true;
+}
+
+DW1000ChannelImage* DW1000Hopping::getImage(byte channel) {
+	int index = channelIndex(channel);
+
+	return index < 0 ? NULL : &_images[index];
+}
+
+boolean DW1000Hopping::setSequence(byte channels[], int n) {
+	int i;
+
+	if(n < 1 || n > HOP_MAX_SEQUENCE) {
+		return false;
+	}
+	for(i = 0; i < n; i++) {
+		if(channelIndex(channels[i]) < 0) {
+			return false;
+		}
+	}
+	memcpy(_sequence, channels, n);
+	_length = n;
+	_position = -1;
+	return true;
+}
+
+int DW1000Hopping::getSequenceLength() {
+	return _length;
+}
+
+/*
+ * Idle the device, clear CPLOCK and write the channel image (only the
+ * bytes that differ from the current one), all in one batch.
+ */
+boolean DW1000Hopping::retune(byte channel) {
+	byte status[LEN_SYS_STATUS];
+	int index = channelIndex(channel);
+#ifndef DEBUG
+	unsigned long start = micros();
+#endif
+
+	if(index < 0 || _images[index].channel == 0) {
+		return false;
+	}
+	_dw->beginBatch();
+	_dw->idle();
+	// CPLOCK is latched, cleared to see the lock on the new frequency
+	memset(status, 0, LEN_SYS_STATUS);
+	DW1000Reg::CPLOCK::set(status, true);
+	_dw->writeFields<DW1000Reg::CPLOCK>(status);
+	_retuneWrites = 2 + _dw->writeChannelImage(&_images[index], _current < 0 ? NULL : &_images[_current]);
+	_dw->endBatch();
+	_current = index;
+	_settled = false;
+#ifndef DEBUG
+	_retuneTime = micros() - start;
+#endif
+	return true;
+}
+
+/*
+ * Retune to the next channel of the sequence, returns the channel or 0 on
+ * error.
+ */
+byte DW1000Hopping::hop() {
+	_position = (_position + 1) % _length;
+	if(!retune(_sequence[_position])) {
+		return 0;
+	}
+	return _sequence[_position];
+}
+
+byte DW1000Hopping::getChannel() {
+	return _current < 0 ? 0 : _images[_current].channel;
+}
+
+boolean DW1000Hopping::isSettled() {
+	byte status[LEN_SYS_STATUS];
+
+	if(!_settled) {
+		_dw->readSystemEventStatus(status);
+		_settled = DW1000Reg::CPLOCK::get(status);
+	}
+	return _settled;
+}
+
+/*
+ * Wait until the PLL is locked after a retune, returns false on timeout.
+ * Does not wait in DEBUG mode.
+ */
+boolean DW1000Hopping::waitSettled() {
+#ifndef DEBUG
+	unsigned long start = micros();
+
+	while(!isSettled() && micros() - start < DW1000::PLL_LOCK_TIMEOUT);
+	_settleTime = micros() - start;
+#endif
+	return isSettled();
+}
+
+int DW1000Hopping::getRetuneWrites() {
+	return _retuneWrites;
+}
+
+unsigned long DW1000Hopping::getRetuneTime() {
+	return _retuneTime;
+}
+
+unsigned long DW1000Hopping::getSettleTime() {
+	return _settleTime;
+}
+
+/*
+ * Start a scan of the sequence with the counts of the last scan cleared.
+ * Each channel is retuned, given until the PLL locks (at most
+ * DW1000::PLL_LOCK_TIMEOUT) and then received on for dwell us; the
+ * receiver is enabled again after every frame, error and RX timeout.
+ */
+void DW1000Hopping::startScan(unsigned long dwell, unsigned long now) {
+	int i;
+
+	for(i = 0; i < HOP_CHANNELS; i++) {
+		_preambles[i] = 0;
+		_frames[i] = 0;
+		_errors[i] = 0;
+	}
+	_dwell = dwell;
+	_scanPosition = 0;
+	scanChannel(now);
+}
+
+boolean DW1000Hopping::poll(unsigned long now) {
+	byte status[LEN_SYS_STATUS];
+
+	if(_phase == PHASE_IDLE) {
+		return false;
+	}
+	_dw->readSystemEventStatus(status);
+	if(_phase == PHASE_SETTLE) {
+		_settled = DW1000Reg::CPLOCK::get(status);
+		if(!_settled && now - _start < DW1000::PLL_LOCK_TIMEOUT) {
+			return true;
+		}
+		_settleTime = now - _start;
+		_start = now;
+		_phase = PHASE_LISTEN;
+		_dw->newReceive();
+		restartReceive();
+		return true;
+	}
+	listen(status);
+	if(now - _start >= _dwell) {
+		_scanPosition++;
+		if(_scanPosition >= _length) {
+			stopScan();
+			return false;
+		}
+		scanChannel(now);
+	}
+	return true;
+}
+
+void DW1000Hopping::stopScan() {
+	if(_phase != PHASE_IDLE) {
+		_dw->idle();
+		_phase = PHASE_IDLE;
+	}
+}
+
+boolean DW1000Hopping::isScanning() {
+	return _phase != PHASE_IDLE;
+}
+
+word DW1000Hopping::getPreambleCount(byte channel) {
+	int index = channelIndex(channel);
+
+	return index < 0 ? 0 : _preambles[index];
+}
+
+word DW1000Hopping::getFrameCount(byte channel) {
+	int index = channelIndex(channel);
+
+	return index < 0 ? 0 : _frames[index];
+}
+
+word DW1000Hopping::getErrorCount(byte channel) {
+	int index = channelIndex(channel);
+
+	return index < 0 ? 0 : _errors[index];
+}
+
+/*
+ * Anything UWB seen on the channel, a preamble is enough (e.g. frames of
+ * another data rate or a non-matching preamble code).
+ */
+boolean DW1000Hopping::isActive(byte channel) {
+	return getPreambleCount(channel) > 0 || getFrameCount(channel) > 0 || getErrorCount(channel) > 0;
+}
+
+byte DW1000Hopping::getBusiestChannel() {
+	int i, best = -1;
+
+	for(i = 0; i < HOP_CHANNELS; i++) {
+		if(_frames[i] == 0 && _preambles[i] == 0) {
+			continue;
+		}
+		if(best < 0 || _frames[i] > _frames[best]
+				|| (_frames[i] == _frames[best] && _preambles[i] > _preambles[best])) {
+			best = i;
+		}
+	}
+	return best < 0 ? 0 : _images[best].channel;
+}
+
+/*
+ * Index of a channel in the image table, -1 for channel 6 and invalid
+ * channels.
+ */
+int DW1000Hopping::channelIndex(byte channel) {
+	if(channel >= 1 && channel <= 5) {
+		return channel - 1;
+	}
+	return channel == 7 ? HOP_CHANNELS - 1 : -1;
+}
+
+void DW1000Hopping::scanChannel(unsigned long now) {
+	retune(_sequence[_scanPosition]);
+	_start = now;
+	_phase = PHASE_SETTLE;
+}
+
+/*
+ * Count the RX events of one status read. Preamble detection is cleared
+ * on its own so that it counts once per frame.
+ */
+void DW1000Hopping::listen(byte status[]) {
+	int index = _current;
+	byte clear[LEN_SYS_STATUS];
+
+	if(DW1000Reg::RXPRD::get(status)) {
+		_preambles[index]++;
+	}
+	if(DW1000Reg::RXDFR::get(status) && DW1000Reg::RXFCG::get(status)) {
+		_frames[index]++;
+		restartReceive();
+	} else if(DW1000Reg::RXPHE::get(status) || DW1000Reg::RXFCE::get(status)
+			|| DW1000Reg::RXRFSL::get(status)) {
+		_errors[index]++;
+		restartReceive();
+	} else if(DW1000Reg::RXRFTO::get(status) || DW1000Reg::RXPTO::get(status)
+			|| DW1000Reg::RXSFDTO::get(status)) {
+		restartReceive();
+	} else if(DW1000Reg::RXPRD::get(status)) {
+		memset(clear, 0, LEN_SYS_STATUS);
+		DW1000Reg::RXPRD::set(clear, true);
+		_dw->writeFields<DW1000Reg::RXPRD>(clear);
+	}
+}
+
+/*
+ * Clear all latched RX events, preamble and SFD detection included, in
+ * one write and enable the receiver again.
+ */
+void DW1000Hopping::restartReceive() {
+	byte clear[LEN_SYS_STATUS];
+
+	memset(clear, 0, LEN_SYS_STATUS);
+	DW1000Reg::RXPRD::set(clear, true);
+	DW1000Reg::RXSFDD::set(clear, true);
+	DW1000Reg::LDEDONE::set(clear, true);
+	DW1000Reg::RXPHE::set(clear, true);
+	DW1000Reg::RXDFR::set(clear, true);
+	DW1000Reg::RXFCG::set(clear, true);
+	DW1000Reg::RXFCE::set(clear, true);
+	DW1000Reg::RXRFSL::set(clear, true);
+	DW1000Reg::RXRFTO::set(clear, true);
+	DW1000Reg::LDEERR::set(clear, true);
+	DW1000Reg::RXPTO::set(clear, true);
+	DW1000Reg::RXSFDTO::set(clear, true);
+	_dw->writeFields<DW1000Fields<DW1000Reg::RXPRD, DW1000Reg::RXSFDTO> >(clear);
+	_dw->startReceive();
+}
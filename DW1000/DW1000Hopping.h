@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Channel hopping and scanning over channels 1-5 and 7. The register
+ * images of all channels are built once (DW1000::getChannelImage()), a
+ * retune writes only what differs from the current channel in one batch
+ * and waits for the PLL to lock again (CPLOCK). Hops follow a configurable
+ * sequence; a scan dwells a bounded RX window on each channel of the
+ * sequence and counts preambles, frames and errors per channel. Polled
+ * from the loop like DW1000Operation, one status read per poll().
+ */
+
+#ifndef _DW1000HOPPING_H_INCLUDED
+#define _DW1000HOPPING_H_INCLUDED
+
+#include "DW1000.h"
+
+// channels 1-5 and 7, longest hop sequence
+#define HOP_CHANNELS 6
+#define HOP_MAX_SEQUENCE 16
+
+class DW1000Hopping {
+public:
+	// hopping on the given device, sequence of all channels
+	DW1000Hopping(DW1000* dw);
+
+	// build the channel images for the current PRF, data rate and power
+	// mode, again after changing one of them or calling setRFChannel()
+	void prepare();
+	// preamble code of a channel (0 for the default), takes effect on prepare()
+	boolean setPreambleCode(byte channel, byte code);
+	DW1000ChannelImage* getImage(byte channel);
+
+	// hop sequence, channels may repeat
+	boolean setSequence(byte channels[], int n);
+	int getSequenceLength();
+
+	// retune to a channel or to the next one of the sequence (0 on error)
+	boolean retune(byte channel);
+	byte hop();
+	byte getChannel();
+
+	// PLL locked since the last retune, waitSettled() blocks at most
+	// DW1000::PLL_LOCK_TIMEOUT
+	boolean isSettled();
+	boolean waitSettled();
+
+	// latency of the last retune: SPI transactions, time spent writing and
+	// time until the PLL lock was seen (us, 0 in DEBUG mode)
+	int getRetuneWrites();
+	unsigned long getRetuneTime();
+	unsigned long getSettleTime();
+
+	// scan the sequence with an RX window of dwell us per channel, advance
+	// with the current time in us (e.g. micros()), poll() returns true
+	// while the scan is running
+	void startScan(unsigned long dwell, unsigned long now);
+	boolean poll(unsigned long now);
+	void stopScan();
+	boolean isScanning();
+
+	// scan results per channel
+	word getPreambleCount(byte channel);
+	word getFrameCount(byte channel);
+	word getErrorCount(byte channel);
+	boolean isActive(byte channel);
+	// channel with the most frames (then preambles), 0 if none was active
+	byte getBusiestChannel();
+
+	static int channelIndex(byte channel);
+
+private:
+	DW1000* _dw;
+	DW1000ChannelImage _images[HOP_CHANNELS];
+	byte _codes[HOP_CHANNELS];
+	// image last written, -1 if unknown
+	int _current;
+
+	byte _sequence[HOP_MAX_SEQUENCE];
+	int _length;
+	int _position;
+
+	int _retuneWrites;
+	unsigned long _retuneTime;
+	unsigned long _settleTime;
+	boolean _settled;
+
+	// scan state, start of the current phase (us), results
+	byte _phase;
+	unsigned long _dwell;
+	unsigned long _start;
+	int _scanPosition;
+	word _preambles[HOP_CHANNELS];
+	word _frames[HOP_CHANNELS];
+	word _errors[HOP_CHANNELS];
+
+	void scanChannel(unsigned long now);
+	void listen(byte status[]);
+	void restartReceive();
+
+	// scan phases
+	static const byte PHASE_IDLE = 0;
+	static const byte PHASE_SETTLE = 1;
+	static const byte PHASE_LISTEN = 2;
+};
+
+#endif
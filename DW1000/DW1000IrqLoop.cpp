@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * IRQ event loop of the Linux backend (see DW1000IrqLoop.h).
+ */
+
+#ifdef DW1000_LINUX
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "DW1000IrqLoop.h"
+
+// events read per read() call
+#define IRQ_READ_EVENTS 16
+
+DW1000IrqLoop::DW1000IrqLoop() {
+	_count = 0;
+	_edges = 0;
+	_lost = 0;
+}
+
+DW1000IrqLoop::~DW1000IrqLoop() {
+	close();
+}
+
+/*
+ * Requests a GPIO line as input with rising edge events.
+ * @param chip
+ *		The GPIO chip, e.g. "/dev/gpiochip0".
+ * @param offset
+ *		The line on the chip (the IRQ pin of a radio).
+ * @param handler
+ *		Called for each edge.
+ * @param context
+ *		Passed to the handler.
+ */
+int DW1000IrqLoop::addLine(const char* chip, unsigned int offset, IrqHandler handler, void* context) {
+	struct gpio_v2_line_request request;
+	int fd, r;
+
+	fd = ::open(chip, O_RDWR);
+	if(fd < 0) {
+		return NO_LINE;
+	}
+	memset(&request, 0, sizeof(request));
+	request.offsets[0] = offset;
+	request.num_lines = 1;
+	strncpy(request.consumer, "dw1000-irq", sizeof(request.consumer) - 1);
+	request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING;
+	r = ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &request);
+	::close(fd);
+	if(r < 0 || request.fd <= 0) {
+		return NO_LINE;
+	}
+	r = addLineFd(request.fd, handler, context);
+	if(r == NO_LINE) {
+		::close(request.fd);
+	}
+	return r;
+}
+
+int DW1000IrqLoop::addLineFd(int fd, IrqHandler handler, void* context) {
+	if(_count >= DW1000_IRQ_MAX_LINES || fd < 0) {
+		return NO_LINE;
+	}
+	_fd[_count] = fd;
+	_handler[_count] = handler;
+	_context[_count] = context;
+	_seqno[_count] = 0;
+	return _count++;
+}
+
+void DW1000IrqLoop::close() {
+	int i;
+
+	for(i = 0; i < _count; i++) {
+		::close(_fd[i]);
+	}
+	_count = 0;
+}
+
+/*
+ * Waits for edges on all lines and calls their handlers, one poll() and
+ * per ready line one read() of up to IRQ_READ_EVENTS edges.
+ * @param timeout
+ *		The time to wait in ms, 0 to only handle pending edges, -1 to wait
+ *		without limit.
+ * @return
+ *		The number of edges handled, -1 on an error.
+ */
+int DW1000IrqLoop::run(int timeout) {
+	struct pollfd fds[DW1000_IRQ_MAX_LINES];
+	int i, r, n, edges = 0;
+
+	for(i = 0; i < _count; i++) {
+		fds[i].fd = _fd[i];
+		fds[i].events = POLLIN;
+		fds[i].revents = 0;
+	}
+	r = poll(fds, _count, timeout);
+	if(r < 0) {
+		return errno == EINTR ? 0 : -1;
+	}
+	for(i = 0; i < _count; i++) {
+		if((fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0 && (fds[i].revents & POLLIN) == 0) {
+			return -1;
+		}
+		if((fds[i].revents & POLLIN) != 0) {
+			n = handleLine(i);
+			if(n < 0) {
+				return -1;
+			}
+			edges += n;
+		}
+	}
+	return edges;
+}
+
+unsigned long DW1000IrqLoop::getEdgeCount() {
+	return _edges;
+}
+
+unsigned long DW1000IrqLoop::getLostCount() {
+	return _lost;
+}
+
+/*
+ * Reads the pending edges of a line, gaps in the line sequence numbers
+ * are edges the kernel could not buffer.
+ */
+int DW1000IrqLoop::handleLine(int i) {
+	struct gpio_v2_line_event events[IRQ_READ_EVENTS];
+	ssize_t r;
+	int k, n;
+
+	r = read(_fd[i], events, sizeof(events));
+	if(r < 0) {
+		return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+	}
+	n = (int)(r / sizeof(events[0]));
+	for(k = 0; k < n; k++) {
+		if(_seqno[i] != 0 && events[k].line_seqno > _seqno[i] + 1) {
+			_lost += events[k].line_seqno - _seqno[i] - 1;
+		}
+		_seqno[i] = events[k].line_seqno;
+		_edges++;
+		if(_handler[i] != NULL) {
+			(*_handler[i])(_context[i], i, events[k].timestamp_ns);
+		}
+	}
+	return n;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * IRQ event loop of the Linux backend (build with -DDW1000_LINUX): waits
+ * for rising edges on the IRQ lines of the radios through the GPIO
+ * character device (v2 uAPI, one line request per radio) and calls the
+ * handler of each line, in the calling thread. The IRQ pin stays high
+ * until the events are cleared, so the handler should lead to a service of
+ * the radio (e.g. DW1000Radios::setInterruptPending() and poll()).
+ */
+
+#ifndef _DW1000IRQLOOP_H_INCLUDED
+#define _DW1000IRQLOOP_H_INCLUDED
+
+#include "DW1000.h"
+
+#ifndef DW1000_IRQ_MAX_LINES
+#define DW1000_IRQ_MAX_LINES 4
+#endif
+
+class DW1000IrqLoop {
+public:
+	// called per edge with the line index and the kernel timestamp (ns)
+	typedef void (*IrqHandler)(void* context, int line, uint64_t timestamp);
+
+	DW1000IrqLoop();
+	~DW1000IrqLoop();
+
+	// rising edges of a line of a GPIO chip (e.g. "/dev/gpiochip0"), returns
+	// the line index or NO_LINE
+	int addLine(const char* chip, unsigned int offset, IrqHandler handler, void* context);
+	// an already requested line (edge events readable from fd, e.g. a pipe
+	// in tests), the loop takes over the fd
+	int addLineFd(int fd, IrqHandler handler, void* context);
+	void close();
+
+	// wait up to timeout ms (-1 without limit) for edges, returns the number
+	// of edges handled or -1 on an error
+	int run(int timeout);
+
+	// edges handled, and edges the kernel dropped (event buffer overrun)
+	unsigned long getEdgeCount();
+	unsigned long getLostCount();
+
+	static const int NO_LINE = -1;
+
+private:
+	int _fd[DW1000_IRQ_MAX_LINES];
+	IrqHandler _handler[DW1000_IRQ_MAX_LINES];
+	void* _context[DW1000_IRQ_MAX_LINES];
+	unsigned long _seqno[DW1000_IRQ_MAX_LINES];
+	int _count;
+	unsigned long _edges;
+	unsigned long _lost;
+
+	int handleLine(int i);
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Linux userspace backend (see DW1000Linux.h).
+ */
+
+#ifdef DW1000_LINUX
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include "DW1000.h"
+
+/* ###########################################################################
+ * #### Arduino timing #######################################################
+ * ######################################################################### */
+
+static uint64_t monotonicMicros() {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+unsigned long micros() {
+	return (unsigned long)monotonicMicros();
+}
+
+unsigned long millis() {
+	return (unsigned long)(monotonicMicros() / 1000);
+}
+
+void delay(unsigned long ms) {
+	struct timespec t;
+
+	t.tv_sec = ms / 1000;
+	t.tv_nsec = (ms % 1000) * 1000000L;
+	while(nanosleep(&t, &t) != 0);
+}
+
+void delayMicroseconds(unsigned int us) {
+	struct timespec t;
+
+	t.tv_sec = us / 1000000;
+	t.tv_nsec = (us % 1000000) * 1000L;
+	while(nanosleep(&t, &t) != 0);
+}
+
+/* ###########################################################################
+ * #### spidev access ########################################################
+ * ######################################################################### */
+
+DW1000Spidev::DW1000Spidev() {
+	_fd = -1;
+	_clock = 0;
+	_batchDepth = 0;
+	_error = false;
+	_count = 0;
+	_length = 0;
+	_ioctls = 0;
+	_transactions = 0;
+	_ioctl = &DW1000Spidev::systemIoctl;
+	_ioctlContext = NULL;
+}
+
+DW1000Spidev::~DW1000Spidev() {
+	close();
+}
+
+/*
+ * Opens a spidev device in SPI mode 0 with 8 bit words.
+ * @param device
+ *		The device, e.g. "/dev/spidev0.0".
+ * @return
+ *		Whether the device could be opened and set up.
+ */
+boolean DW1000Spidev::open(const char* device) {
+	byte mode = SPI_MODE_0;
+	byte bits = 8;
+
+	close();
+	_fd = ::open(device, O_RDWR);
+	if(_fd < 0) {
+		return false;
+	}
+	if((*_ioctl)(_ioctlContext, _fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+			(*_ioctl)(_ioctlContext, _fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) {
+		close();
+		return false;
+	}
+	_ioctls = 0;
+	_transactions = 0;
+	return true;
+}
+
+void DW1000Spidev::close() {
+	if(_fd >= 0) {
+		flush();
+		::close(_fd);
+		_fd = -1;
+	}
+	_count = 0;
+	_length = 0;
+	_batchDepth = 0;
+}
+
+boolean DW1000Spidev::isOpen() {
+	return _fd >= 0;
+}
+
+/*
+ * SPI clock of the following transfers (set per transfer, so devices on
+ * the same bus may use different clocks).
+ */
+void DW1000Spidev::setClock(unsigned long clock) {
+	_clock = clock;
+}
+
+/*
+ * One SPI transaction. Reads go down at once, together with the writes
+ * queued before them, writes are queued during a batch.
+ * @param header
+ *		The SPI header (1 to 3 bytes).
+ * @param tx
+ *		The bytes to write, or NULL for a read.
+ * @param rx
+ *		The bytes read, or NULL for a write.
+ * @param n
+ *		The payload length.
+ */
+boolean DW1000Spidev::transfer(const byte header[], int headerLen, const byte tx[], byte rx[], int n) {
+	if(!queue(header, headerLen, tx, rx, n)) {
+		if(rx != NULL) {
+			memset(rx, 0, n);
+		}
+		return false;
+	}
+	if(rx != NULL || _batchDepth == 0) {
+		if(!flush()) {
+			if(rx != NULL) {
+				memset(rx, 0, n);
+			}
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Holds chip select low for the given time (at most 65535us), e.g. to wake
+ * the device up.
+ */
+boolean DW1000Spidev::select(unsigned int us) {
+	struct spi_ioc_transfer t;
+
+	if(!flush() || _fd < 0) {
+		return false;
+	}
+	memset(&t, 0, sizeof(t));
+	t.delay_usecs = (us > 0xFFFF ? 0xFFFF : us);
+	t.speed_hz = _clock;
+	t.bits_per_word = 8;
+	_ioctls++;
+	return (*_ioctl)(_ioctlContext, _fd, SPI_IOC_MESSAGE(1), &t) >= 0;
+}
+
+void DW1000Spidev::beginBatch() {
+	_batchDepth++;
+}
+
+/*
+ * Ends a batch, the outermost one sends the queued writes.
+ * @return
+ *		False if an ioctl of the batch failed.
+ */
+boolean DW1000Spidev::endBatch() {
+	boolean ok;
+
+	if(_batchDepth > 0) {
+		_batchDepth--;
+	}
+	if(_batchDepth > 0) {
+		return true;
+	}
+	ok = flush() && !_error;
+	_error = false;
+	return ok;
+}
+
+/*
+ * Sends the queued transactions as one SPI_IOC_MESSAGE.
+ */
+boolean DW1000Spidev::flush() {
+	int count = _count;
+
+	if(count == 0) {
+		return true;
+	}
+	_count = 0;
+	_length = 0;
+	if(_fd < 0) {
+		_error = true;
+		return false;
+	}
+	// chip select is released at the end of the message anyway
+	_transfers[count - 1].cs_change = 0;
+	_ioctls++;
+	if((*_ioctl)(_ioctlContext, _fd, SPI_IOC_MESSAGE(count), _transfers) < 0) {
+		_error = true;
+		return false;
+	}
+	return true;
+}
+
+unsigned long DW1000Spidev::getIoctlCount() {
+	return _ioctls;
+}
+
+unsigned long DW1000Spidev::getTransactionCount() {
+	return _transactions;
+}
+
+void DW1000Spidev::setIoctl(IoctlFunction function, void* context) {
+	_ioctl = function;
+	_ioctlContext = context;
+}
+
+/*
+ * Appends a transaction to the pending message, header and written bytes
+ * are copied (the caller's buffers may be gone before the batch ends).
+ */
+boolean DW1000Spidev::queue(const byte header[], int headerLen, const byte tx[], byte rx[], int n) {
+	int transfers = (n > 0 ? 2 : 1);
+	int bytes = headerLen + (tx != NULL ? n : 0);
+
+	if(_count + transfers > DW1000_SPIDEV_MAX_TRANSFERS || _length + bytes > DW1000_SPIDEV_BATCH_BYTES) {
+		if(!flush()) {
+			return false;
+		}
+		if(bytes > DW1000_SPIDEV_BATCH_BYTES) {
+			return false;
+		}
+	}
+	// chip select released between transactions of one message
+	if(_count > 0) {
+		_transfers[_count - 1].cs_change = 1;
+	}
+	memcpy(&_buffer[_length], header, headerLen);
+	add(&_buffer[_length], NULL, headerLen);
+	_length += headerLen;
+	if(n > 0) {
+		if(tx != NULL) {
+			memcpy(&_buffer[_length], tx, n);
+			add(&_buffer[_length], rx, n);
+			_length += n;
+		} else {
+			add(NULL, rx, n);
+		}
+	}
+	_transactions++;
+	return true;
+}
+
+void DW1000Spidev::add(const byte tx[], byte rx[], int n) {
+	struct spi_ioc_transfer* t = &_transfers[_count++];
+
+	memset(t, 0, sizeof(*t));
+	t->tx_buf = (unsigned long)tx;
+	t->rx_buf = (unsigned long)rx;
+	t->len = n;
+	t->speed_hz = _clock;
+	t->bits_per_word = 8;
+}
+
+int DW1000Spidev::systemIoctl(void* /* context */, int fd, unsigned long request, void* arg) {
+	return ioctl(fd, request, arg);
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Linux userspace backend (build with -DDW1000_LINUX), e.g. for a gateway
+ * with the radio on a spidev bus. Provides the few Arduino functions the
+ * library uses (types, micros(), delays) and DW1000Spidev, the SPI access:
+ * a transaction is the header and the payload as two transfers of one
+ * SPI_IOC_MESSAGE, with chip select held in between. Between beginBatch()
+ * and endBatch() writes are queued and go down with the next read or at
+ * the end of the batch, as one ioctl (chip select toggled between the
+ * transactions), e.g. the register writes of DW1000::setRFChannel().
+ */
+
+#ifndef _DW1000LINUX_H_INCLUDED
+#define _DW1000LINUX_H_INCLUDED
+
+#include <stdint.h>
+#include <linux/spi/spidev.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+
+// Arduino timing, from CLOCK_MONOTONIC
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// IRQs are served from the event loop (DW1000IrqLoop), not concurrently
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+// default spidev bus, the chip select of a DW1000 selects the device
+#ifndef DW1000_SPIDEV_BUS
+#define DW1000_SPIDEV_BUS 0
+#endif
+
+// limits of one batch: transfers (two per transaction) and bytes (spidev
+// rejects messages above its bufsiz, 4096 by default)
+#ifndef DW1000_SPIDEV_MAX_TRANSFERS
+#define DW1000_SPIDEV_MAX_TRANSFERS 32
+#endif
+#ifndef DW1000_SPIDEV_BATCH_BYTES
+#define DW1000_SPIDEV_BATCH_BYTES 4096
+#endif
+
+class DW1000Spidev {
+public:
+	// ioctl() on the device, replaceable by a mock that records the batches
+	typedef int (*IoctlFunction)(void* context, int fd, unsigned long request, void* arg);
+
+	DW1000Spidev();
+	~DW1000Spidev();
+
+	// e.g. "/dev/spidev0.0", mode 0, MSB first
+	boolean open(const char* device);
+	void close();
+	boolean isOpen();
+	void setClock(unsigned long clock);
+
+	// one transaction, tx or rx (not both) may be NULL, returns false on an
+	// ioctl error
+	boolean transfer(const byte header[], int headerLen, const byte tx[], byte rx[], int n);
+	// chip select low for the given time, without a transaction
+	boolean select(unsigned int us);
+
+	// queue writes until endBatch(), nested batches go down with the outer one
+	void beginBatch();
+	boolean endBatch();
+	boolean flush();
+
+	// ioctl calls and transactions since open()
+	unsigned long getIoctlCount();
+	unsigned long getTransactionCount();
+
+	void setIoctl(IoctlFunction function, void* context);
+
+private:
+	int _fd;
+	unsigned long _clock;
+	int _batchDepth;
+	boolean _error;
+	struct spi_ioc_transfer _transfers[DW1000_SPIDEV_MAX_TRANSFERS];
+	int _count;
+	byte _buffer[DW1000_SPIDEV_BATCH_BYTES];
+	int _length;
+	unsigned long _ioctls;
+	unsigned long _transactions;
+	IoctlFunction _ioctl;
+	void* _ioctlContext;
+
+	boolean queue(const byte header[], int headerLen, const byte tx[], byte rx[], int n);
+	void add(const byte tx[], byte rx[], int n);
+	static int systemIoctl(void* context, int fd, unsigned long request, void* arg);
+};
+
+#endif
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000Operation.h"
+
+/* ###########################################################################
+ * #### Construction and init ################################################
+ * ######################################################################### */
+
+DW1000Operation::DW1000Operation(DW1000* dw) {
+	_dw = dw;
+	_type = TYPE_NONE;
+	_phase = PHASE_START;
+	_state = OP_IDLE;
+	_data = NULL;
+	_length = 0;
+	_response = NULL;
+	_maxLength = 0;
+	_start = 0;
+	_timeout = 0;
+	_txTime = 0;
+	_rxTime = 0;
+}
+
+/* ###########################################################################
+ * #### Starting operations ##################################################
+ * ######################################################################### */
+
+boolean DW1000Operation::startTransmit(byte data[], int n) {
+	if(!begin(TYPE_TRANSMIT)) {
+		return false;
+	}
+	_data = data;
+	_length = n;
+	return true;
+}
+
+/*
+ * Receive one frame.
+ * @param data
+ *		The array to read the payload into.
+ * @param n
+ *		The size of the array, longer frames are truncated.
+ * @param timeout
+ *		Give up after this many us, or 0 to wait forever.
+ */
+boolean DW1000Operation::startReceive(byte data[], int n, unsigned long timeout) {
+	if(!begin(TYPE_RECEIVE)) {
+		return false;
+	}
+	_response = data;
+	_maxLength = n;
+	_timeout = timeout;
+	return true;
+}
+
+/*
+ * Send a frame and receive the response (the receiver is turned on right
+ * after sending, WAIT4RESP), e.g. poll and response of a ranging exchange.
+ * The timeout counts from the end of the transmission.
+ */
+boolean DW1000Operation::startRanging(byte data[], int n, byte response[], int maxN, unsigned long timeout) {
+	if(!begin(TYPE_RANGING)) {
+		return false;
+	}
+	_data = data;
+	_length = n;
+	_response = response;
+	_maxLength = maxN;
+	_timeout = timeout;
+	return true;
+}
+
+/*
+ * Same as DW1000::initialize(), with the waits (device start-up, LDE
+ * loading) spread over steps.
+ */
+boolean DW1000Operation::startInitialize() {
+	return begin(TYPE_INITIALIZE);
+}
+
+/*
+ * Abort the operation in flight, the device is put to idle.
+ */
+void DW1000Operation::cancel() {
+	if(_state != OP_BUSY) {
+		return;
+	}
+	if(_type != TYPE_INITIALIZE && _phase != PHASE_START) {
+		_dw->idle();
+	}
+	finish(OP_IDLE);
+}
+
+/* ###########################################################################
+ * #### Stepping #############################################################
+ * ######################################################################### */
+
+byte DW1000Operation::step(unsigned long now) {
+	if(_state != OP_BUSY) {
+		return _state;
+	}
+	switch(_phase) {
+		case PHASE_START:
+			startPhase(now);
+			break;
+		case PHASE_WAIT_TX:
+			waitTransmit(now);
+			break;
+		case PHASE_WAIT_RX:
+			waitReceive(now);
+			break;
+		default:
+			stepInitialize(now);
+			break;
+	}
+	return _state;
+}
+
+byte DW1000Operation::getState() {
+	return _state;
+}
+
+boolean DW1000Operation::isBusy() {
+	return _state == OP_BUSY;
+}
+
+/*
+ * Issue the commands starting the operation.
+ */
+void DW1000Operation::startPhase(unsigned long now) {
+	_start = now;
+	switch(_type) {
+		case TYPE_TRANSMIT:
+		case TYPE_RANGING:
+			// newTransmit() clears TX_FCTRL, same settings as the receiver
+			_dw->newTransmit();
+			_dw->transmitRate(_dw->getDataRate());
+			_dw->pulseFrequency(_dw->getPulseFrequency());
+			_dw->preambleLength(_dw->getPreambleLength());
+			if(_type == TYPE_RANGING) {
+				_dw->waitForResponse(true);
+			}
+			_dw->setData(_data, _length);
+			_dw->startTransmit();
+			_phase = PHASE_WAIT_TX;
+			break;
+		case TYPE_RECEIVE:
+			_dw->newReceive();
+			_dw->startReceive();
+			_phase = PHASE_WAIT_RX;
+			break;
+		case TYPE_INITIALIZE:
+			_dw->setSpiClock(DW1000::SPI_CLOCK_SLOW);
+			_phase = PHASE_CHECK_ID;
+			break;
+	}
+}
+
+/*
+ * One status read per step until the frame is sent.
+ */
+void DW1000Operation::waitTransmit(unsigned long now) {
+	byte status[LEN_SYS_STATUS];
+	byte stamp[LEN_STAMP];
+
+	_dw->readSystemEventStatus(status);
+	if(!DW1000Reg::TXFRS::get(status)) {
+		return;
+	}
+	_dw->readTransmitTimestamp(stamp);
+	_txTime = DW1000::toTimestamp(stamp);
+	_dw->clearTransmitStatus();
+	if(_type == TYPE_RANGING) {
+		_start = now;
+		_phase = PHASE_WAIT_RX;
+	} else {
+		finish(OP_DONE);
+	}
+}
+
+/*
+ * One status read per step until a frame arrived or the timeout passed,
+ * either the one of the operation or one of the device.
+ */
+void DW1000Operation::waitReceive(unsigned long now) {
+	byte status[LEN_SYS_STATUS];
+	byte stamp[LEN_STAMP];
+
+	_dw->readSystemEventStatus(status);
+	if(DW1000Reg::RXDFR::get(status)) {
+		if(DW1000Reg::RXFCG::get(status)) {
+			_length = _dw->getData(_response, _maxLength);
+			_dw->readReceiveTimestamp(stamp);
+			_rxTime = DW1000::toTimestamp(stamp);
+			_dw->clearReceiveStatus();
+			finish(OP_DONE);
+		} else {
+			_dw->clearReceiveStatus();
+			finish(OP_FAILED);
+		}
+	} else if(DW1000Reg::RXFCE::get(status) || DW1000Reg::RXRFSL::get(status)) {
+		_dw->clearReceiveStatus();
+		finish(OP_FAILED);
+	} else if(DW1000Reg::RXRFTO::get(status) || DW1000Reg::RXPTO::get(status) || DW1000Reg::RXSFDTO::get(status)) {
+		// device timeout (setReceiveTimeout(), setPreambleDetectTimeout())
+		_dw->clearReceiveStatus();
+		finish(OP_TIMEOUT);
+	} else if(_timeout > 0 && now - _start >= _timeout) {
+		_dw->idle();
+		finish(OP_TIMEOUT);
+	}
+}
+
+void DW1000Operation::stepInitialize(unsigned long now) {
+	switch(_phase) {
+		case PHASE_CHECK_ID:
+			// the device may still be starting up
+			if(_dw->checkDeviceIdentifier()) {
+				_phase = PHASE_OTP;
+			} else if(now - _start >= DW1000::WAKE_TIMEOUT) {
+				finish(OP_FAILED);
+			}
+			break;
+		case PHASE_OTP:
+			_dw->loadOTPCalibration();
+			_dw->startLDELoad();
+			_start = now;
+			_phase = PHASE_LDE;
+			break;
+		case PHASE_LDE:
+			if(now - _start >= DW1000::LDE_LOAD_TIME) {
+				_dw->finishLDELoad();
+				_dw->setPreambleCode(_dw->getPreambleCode());
+				_phase = PHASE_CLOCK;
+			}
+			break;
+		case PHASE_CLOCK:
+			_dw->initSpiClock();
+			finish(OP_DONE);
+			break;
+	}
+}
+
+/* ###########################################################################
+ * #### Results ##############################################################
+ * ######################################################################### */
+
+int DW1000Operation::getLength() {
+	return _length;
+}
+
+int64_t DW1000Operation::getTransmitTimestamp() {
+	return _txTime;
+}
+
+int64_t DW1000Operation::getReceiveTimestamp() {
+	return _rxTime;
+}
+
+/*
+ * Time from sending to receiving the response of a ranging exchange.
+ */
+int64_t DW1000Operation::getRoundTime() {
+	return DW1000::timestampDiff(_rxTime, _txTime);
+}
+
+/* ###########################################################################
+ * #### Helper functions #####################################################
+ * ######################################################################### */
+
+boolean DW1000Operation::begin(byte type) {
+	if(_state == OP_BUSY) {
+		return false;
+	}
+	_type = type;
+	_phase = PHASE_START;
+	_state = OP_BUSY;
+	_timeout = 0;
+	return true;
+}
+
+void DW1000Operation::finish(byte state) {
+	_state = state;
+	_phase = PHASE_START;
+}
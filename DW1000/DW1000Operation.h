@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Non-blocking operations (transmit, receive, ranging exchange and
+ * initialization) as resumable state machines. An operation is started
+ * once and then advanced with step() from the application loop; a step
+ * does a few SPI transactions at most and never waits, so several radios
+ * can be in flight while the loop does other work. See DW1000Coroutine.h
+ * for a C++20 coroutine adapter on the host.
+ */
+
+#ifndef _DW1000OPERATION_H_INCLUDED
+#define _DW1000OPERATION_H_INCLUDED
+
+#include "DW1000.h"
+
+class DW1000Operation {
+public:
+	// operations of the given device
+	DW1000Operation(DW1000* dw);
+
+	// start an operation, returns false if another one is in flight
+	boolean startTransmit(byte data[], int n);
+	boolean startReceive(byte data[], int n, unsigned long timeout);
+	boolean startRanging(byte data[], int n, byte response[], int maxN, unsigned long timeout);
+	boolean startInitialize();
+	void cancel();
+
+	// advance with the current time in us (e.g. micros()), returns the state
+	byte step(unsigned long now);
+	byte getState();
+	boolean isBusy();
+
+	// results: received length, timestamps of the last TX/RX, ranging round time
+	int getLength();
+	int64_t getTransmitTimestamp();
+	int64_t getReceiveTimestamp();
+	int64_t getRoundTime();
+
+	// states
+	static const byte OP_IDLE = 0;
+	static const byte OP_BUSY = 1;
+	static const byte OP_DONE = 2;
+	static const byte OP_FAILED = 3;
+	static const byte OP_TIMEOUT = 4;
+
+private:
+	DW1000* _dw;
+	byte _type;
+	byte _phase;
+	byte _state;
+
+	// frame to send, buffer to receive into
+	byte* _data;
+	int _length;
+	byte* _response;
+	int _maxLength;
+
+	// start of the current wait (us), RX timeout (us, 0 for none)
+	unsigned long _start;
+	unsigned long _timeout;
+
+	int64_t _txTime;
+	int64_t _rxTime;
+
+	boolean begin(byte type);
+	void startPhase(unsigned long now);
+	void waitTransmit(unsigned long now);
+	void waitReceive(unsigned long now);
+	void stepInitialize(unsigned long now);
+	void finish(byte state);
+
+	// operation types
+	static const byte TYPE_NONE = 0;
+	static const byte TYPE_TRANSMIT = 1;
+	static const byte TYPE_RECEIVE = 2;
+	static const byte TYPE_RANGING = 3;
+	static const byte TYPE_INITIALIZE = 4;
+
+	// phases
+	static const byte PHASE_START = 0;
+	static const byte PHASE_WAIT_TX = 1;
+	static const byte PHASE_WAIT_RX = 2;
+	static const byte PHASE_CHECK_ID = 3;
+	static const byte PHASE_OTP = 4;
+	static const byte PHASE_LDE = 5;
+	static const byte PHASE_CLOCK = 6;
+};
+
+#endif
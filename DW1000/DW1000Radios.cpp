@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000Radios.h"
+
+/* ###########################################################################
+ * #### Construction and init ################################################
+ * ######################################################################### */
+
+DW1000Radios::DW1000Radios() {
+	_count = 0;
+	_next = 0;
+	_owner = NO_RADIO;
+	_useInterrupts = false;
+	_pending = 0;
+}
+
+/*
+ * Add a radio, its DW1000 instance shares the SPI bus with the others
+ * (see DW1000 constructor).
+ */
+int DW1000Radios::addRadio(DW1000* dw) {
+	if(_count >= DW1000_MAX_RADIOS) {
+		return NO_RADIO;
+	}
+	_radios[_count] = dw;
+	_events[_count] = 0;
+	return _count++;
+}
+
+int DW1000Radios::getRadioCount() {
+	return _count;
+}
+
+DW1000* DW1000Radios::getRadio(int i) {
+	return _radios[i];
+}
+
+/* ###########################################################################
+ * #### Interrupts and arbitration ###########################################
+ * ######################################################################### */
+
+void DW1000Radios::useInterrupts(boolean val) {
+	_useInterrupts = val;
+}
+
+/*
+ * Flag a radio for service, safe to call from its IRQ handler (no SPI
+ * access there, the bus may be in use). Unknown radios are ignored.
+ */
+void DW1000Radios::setInterruptPending(int i) {
+	if(i < 0 || i >= _count) {
+		return;
+	}
+	_pending = _pending | (byte)(1 << i);
+}
+
+/*
+ * Reserve the bus for one radio, e.g. to read a frame and its timestamp
+ * without another radio being serviced in between.
+ * Returns false if another radio holds the bus.
+ */
+boolean DW1000Radios::lock(int i) {
+	if(_owner != NO_RADIO && _owner != i) {
+		return false;
+	}
+	_owner = i;
+	return true;
+}
+
+void DW1000Radios::unlock(int i) {
+	if(_owner == i) {
+		_owner = NO_RADIO;
+	}
+}
+
+boolean DW1000Radios::isLocked() {
+	return _owner != NO_RADIO;
+}
+
+/* ###########################################################################
+ * #### Service ##############################################################
+ * ######################################################################### */
+
+/*
+ * Read the status of the next radio (round robin) and decode its events.
+ * Polling mode reads one radio per call. IRQ mode skips radios without a
+ * pending interrupt. Nothing is done while the bus is locked.
+ * Returns the index of the serviced radio if it has events, else NO_RADIO.
+ */
+int DW1000Radios::poll() {
+	byte status[LEN_SYS_STATUS];
+	int i, k;
+
+	if(_owner != NO_RADIO || DW1000::isSpiBusy()) {
+		return NO_RADIO;
+	}
+	for(k = 0; k < _count; k++) {
+		i = (_next + k) % _count;
+		if(_useInterrupts && !takePending(i)) {
+			continue;
+		}
+		_radios[i]->readSystemEventStatus(status);
+		_events[i] = decodeEvents(status);
+		_next = (i + 1) % _count;
+		if(_events[i] != 0) {
+			return i;
+		}
+		if(!_useInterrupts) {
+			break;
+		}
+	}
+	return NO_RADIO;
+}
+
+/*
+ * Events of a radio as of its last service. They stay set on the device
+ * until its status is cleared (e.g. clearReceiveStatus()).
+ */
+byte DW1000Radios::getEvents(int i) {
+	return _events[i];
+}
+
+/* ###########################################################################
+ * #### Helper functions #####################################################
+ * ######################################################################### */
+
+boolean DW1000Radios::takePending(int i) {
+	byte mask = (byte)(1 << i);
+	boolean pending;
+
+#ifndef DEBUG
+	noInterrupts();
+#endif
+	pending = (_pending & mask) != 0;
+	_pending = _pending & ~mask;
+#ifndef DEBUG
+	interrupts();
+#endif
+	return pending;
+}
+
+byte DW1000Radios::decodeEvents(byte status[]) {
+	byte events = 0;
+
+	if(DW1000Reg::TXFRS::get(status)) {
+		events |= EVENT_TX_DONE;
+	}
+	if(DW1000Reg::RXDFR::get(status) && DW1000Reg::RXFCG::get(status)) {
+		events |= EVENT_RX_DONE;
+	}
+	if(DW1000Reg::RXFCE::get(status) || DW1000Reg::RXRFSL::get(status) ||
+			DW1000Reg::LDEERR::get(status)) {
+		events |= EVENT_RX_ERROR;
+	}
+	if(DW1000Reg::RXRFTO::get(status) || DW1000Reg::RXPTO::get(status) ||
+			DW1000Reg::RXSFDTO::get(status)) {
+		events |= EVENT_RX_TIMEOUT;
+	}
+	return events;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Several DW1000 devices on one SPI bus (e.g. anchors with antenna
+ * diversity or parallel channels). Status polling and IRQ service are
+ * interleaved round robin, one SPI transaction per radio and call, so
+ * each radio is serviced while the others are busy receiving or sending.
+ */
+
+#ifndef _DW1000RADIOS_H_INCLUDED
+#define _DW1000RADIOS_H_INCLUDED
+
+#include "DW1000.h"
+
+// number of radios on the bus, at most 8 (pending IRQs are a byte mask)
+#ifndef DW1000_MAX_RADIOS
+#define DW1000_MAX_RADIOS 4
+#endif
+
+class DW1000Radios {
+public:
+	DW1000Radios();
+
+	// radios on the shared bus, returns the index or NO_RADIO if full
+	int addRadio(DW1000* dw);
+	int getRadioCount();
+	DW1000* getRadio(int i);
+
+	// IRQ mode: only radios flagged by their IRQ handler are serviced
+	void useInterrupts(boolean val);
+	void setInterruptPending(int i);
+
+	// exclusive bus access for a sequence of transactions on one radio
+	boolean lock(int i);
+	void unlock(int i);
+	boolean isLocked();
+
+	// service the next radio, returns its index if it has events
+	int poll();
+	byte getEvents(int i);
+
+	// events, from SYS_STATUS
+	static const byte EVENT_TX_DONE = 0x01;
+	static const byte EVENT_RX_DONE = 0x02;
+	static const byte EVENT_RX_ERROR = 0x04;
+	static const byte EVENT_RX_TIMEOUT = 0x08;
+
+	static const int NO_RADIO = -1;
+
+private:
+	DW1000_CHECK(DW1000_MAX_RADIOS >= 1 && DW1000_MAX_RADIOS <= 8, too_many_radios_for_pending_mask);
+
+	DW1000* _radios[DW1000_MAX_RADIOS];
+	byte _events[DW1000_MAX_RADIOS];
+	int _count;
+	int _next;
+	int _owner;
+	boolean _useInterrupts;
+	volatile byte _pending;
+
+	boolean takePending(int i);
+	static byte decodeEvents(byte status[]);
+};
+
+#endif
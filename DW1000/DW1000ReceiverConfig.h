@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Rules of the receiver configuration (user manual, tables 6, 24-31 and
+ * 61) as macros, so that they work in constant expressions as well as at
+ * run time (DW1000::solveReceiver()). Arguments are the TX_RATE_*,
+ * TX_PULSE_FREQ_* and TX_PREAMBLE_LEN_* values of DW1000:
+ *
+ *   data rate   0 (110kbps), 1 (850kbps), 2 (6.8Mbps)
+ *   PRF         1 (16MHz), 2 (64MHz)
+ *   preamble    64 symbols only at 6.8Mbps, at least 1024 at 110kbps
+ *   PAC         8 up to 128 symbols, 16 up to 512, 32 at 1024, 64 above
+ *   code        two per channel at 16MHz, four at 64MHz (no DPS codes)
+ *
+ * DW1000ReceiverConfig<> checks a constant configuration at compile time,
+ * e.g.
+ *
+ *   DW1000ReceiverConfig<DW1000::TX_RATE_6800KBPS, DW1000::TX_PULSE_FREQ_16MHZ,
+ *       DW1000::TX_PREAMBLE_LEN_128, 5>::apply(dw);
+ *
+ * does not compile with TX_PREAMBLE_LEN_128 at TX_RATE_110KBPS or with
+ * preamble code 9 at 16MHz PRF.
+ */
+
+#ifndef _DW1000RECEIVERCONFIG_H_INCLUDED
+#define _DW1000RECEIVERCONFIG_H_INCLUDED
+
+#include "DW1000.h"
+
+#define DW1000_VALID_RATE(rate) ((rate) <= 2)
+// channels and PRFs not compiled in (see DW1000Config.h) are invalid
+#define DW1000_VALID_PRF(prf) DW1000_HAS_PRF(prf)
+#define DW1000_VALID_CHANNEL(channel) DW1000_HAS_CHANNEL(channel)
+
+// preamble symbols of a TX_PREAMBLE_LEN_* value, 0 if invalid
+#define DW1000_PREAMBLE_SYMBOLS(len) \
+	((len) == 0x01 ? 64 : (len) == 0x05 ? 128 : (len) == 0x09 ? 256 : (len) == 0x0D ? 512 : \
+	(len) == 0x02 ? 1024 : (len) == 0x06 ? 1536 : (len) == 0x0A ? 2048 : (len) == 0x03 ? 4096 : 0)
+#define DW1000_VALID_PREAMBLE(rate, symbols) \
+	((symbols) != 0 && ((symbols) > 64 || (rate) == 2) && ((symbols) >= 1024 || (rate) != 0))
+
+// preamble acquisition chunk size in symbols
+#define DW1000_PAC_SIZE(symbols) \
+	((symbols) <= 128 ? 8 : (symbols) <= 512 ? 16 : (symbols) <= 1024 ? 32 : 64)
+
+// lowest preamble code of a channel and PRF, codes in range are valid
+#define DW1000_FIRST_CODE(channel, prf) \
+	((prf) == 2 ? ((channel) == 4 || (channel) == 7 ? 17 : 9) : \
+	(channel) == 1 ? 1 : (channel) == 3 ? 5 : (channel) == 4 || (channel) == 7 ? 7 : 3)
+#define DW1000_VALID_CODE(channel, prf, code) \
+	((code) >= DW1000_FIRST_CODE(channel, prf) && \
+	(code) < DW1000_FIRST_CODE(channel, prf) + ((prf) == 2 ? 4 : 2))
+
+template<byte RATE, byte PRF, byte PREAMBLE, byte CHANNEL, byte CODE = 0>
+struct DW1000ReceiverConfig {
+	static const int symbols = DW1000_PREAMBLE_SYMBOLS(PREAMBLE);
+	static const byte pac = DW1000_PAC_SIZE(symbols);
+	static const byte code = CODE != 0 ? CODE : DW1000_FIRST_CODE(CHANNEL, PRF);
+
+	DW1000_CHECK(DW1000_VALID_RATE(RATE), invalid_data_rate);
+	DW1000_CHECK(DW1000_VALID_PRF(PRF), invalid_pulse_frequency);
+	DW1000_CHECK(DW1000_VALID_PREAMBLE(RATE, symbols), invalid_preamble_length_for_data_rate);
+	DW1000_CHECK(DW1000_VALID_CHANNEL(CHANNEL), invalid_channel);
+	DW1000_CHECK(DW1000_VALID_CODE(CHANNEL, PRF, code), invalid_preamble_code_for_channel_and_prf);
+
+	static void solve(DW1000ReceiverSetup* setup) {
+		DW1000::solveReceiver(RATE, PRF, PREAMBLE, CHANNEL, code, setup);
+	}
+
+	static void apply(DW1000* dw) {
+		DW1000ReceiverSetup setup;
+
+		solve(&setup);
+		dw->writeReceiverSetup(&setup);
+	}
+};
+
+#endif
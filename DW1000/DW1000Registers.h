@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Compile-time register map. A register is a type carrying its address,
+ * sub-address and length, a field is a type carrying its register, bit
+ * offset and width. Byte index, shift and masks of a field are constants,
+ * so get() and set() on a register image (e.g. the SYS_CFG copy kept by
+ * DW1000) are masked operations on the one or two bytes the field covers.
+ * DW1000Fields<> joins fields of one register into the byte range that
+ * DW1000::writeFields() writes in a single SPI transaction.
+ */
+
+#ifndef _DW1000REGISTERS_H_INCLUDED
+#define _DW1000REGISTERS_H_INCLUDED
+
+// compile-time check (as a typedef, also works without static_assert)
+#define DW1000_CHECK(cond, name) typedef char name[(cond) ? 1 : -1]
+
+template<byte ADDRESS, word SUB, int LENGTH>
+struct DW1000Register {
+	static const byte address = ADDRESS;
+	static const word sub = SUB;
+	static const int length = LENGTH;
+};
+
+template<class REGISTER, int OFFSET, int WIDTH = 1>
+struct DW1000Field {
+	typedef REGISTER Register;
+	// covered bytes of the register image
+	static const int index = OFFSET / 8;
+	static const int shift = OFFSET % 8;
+	static const int span = (OFFSET % 8 + WIDTH + 7) / 8;
+	static const byte maskLo = (byte)((((1UL << WIDTH) - 1) << (OFFSET % 8)) & 0xFF);
+	static const byte maskHi = (byte)(((((1UL << WIDTH) - 1) << (OFFSET % 8)) >> 8) & 0xFF);
+
+	DW1000_CHECK(OFFSET + WIDTH <= REGISTER::length * 8, field_exceeds_register);
+	DW1000_CHECK(OFFSET % 8 + WIDTH <= 16, field_exceeds_two_bytes);
+
+	static inline void set(byte data[], word value) {
+		data[index] = (byte)((data[index] & ~maskLo) | ((value << shift) & maskLo));
+		if(span > 1) {
+			data[index + 1] = (byte)((data[index + 1] & ~maskHi) | ((value >> (8 - shift)) & maskHi));
+		}
+	}
+
+	static inline word get(const byte data[]) {
+		word value = (data[index] & maskLo) >> shift;
+		if(span > 1) {
+			value |= (word)(data[index + 1] & maskHi) << (8 - shift);
+		}
+		return value;
+	}
+};
+
+// same register, checked at compile time
+template<class A, class B> struct DW1000SameRegister { static const boolean value = false; };
+template<class A> struct DW1000SameRegister<A, A> { static const boolean value = true; };
+
+template<class A, class B>
+struct DW1000Fields {
+	typedef typename A::Register Register;
+	static const int index = A::index < B::index ? A::index : B::index;
+	static const int span = (A::index + A::span > B::index + B::span ?
+		A::index + A::span : B::index + B::span) - index;
+
+	DW1000_CHECK((DW1000SameRegister<typename A::Register, typename B::Register>::value), fields_of_different_registers);
+};
+
+/*
+ * Registers and fields used on the TX/RX path, in the names of the
+ * DW1000 user manual.
+ */
+namespace DW1000Reg {
+	// SYS_CFG, general device configuration
+	typedef DW1000Register<SYS_CFG, NO_SUB, LEN_SYS_CFG> SysCfg;
+	typedef DW1000Field<SysCfg, FFEN_BIT> FFEN;
+	typedef DW1000Field<SysCfg, DIS_DRXB_BIT> DIS_DRXB;
+	typedef DW1000Field<SysCfg, PHR_MODE_LSB, 2> PHR_MODE;
+	typedef DW1000Field<SysCfg, DIS_STXP_BIT> DIS_STXP;
+	typedef DW1000Field<SysCfg, RXWTOE_BIT> RXWTOE;
+	typedef DW1000Field<SysCfg, RXAUTR_BIT> RXAUTR;
+
+	// SYS_CTRL, transmit and receive control
+	typedef DW1000Register<SYS_CTRL, NO_SUB, LEN_SYS_CTRL> SysCtrl;
+	typedef DW1000Field<SysCtrl, SFCST_BIT> SFCST;
+	typedef DW1000Field<SysCtrl, TXSTRT_BIT> TXSTRT;
+	typedef DW1000Field<SysCtrl, TXDLYS_BIT> TXDLYS;
+	typedef DW1000Field<SysCtrl, TRXOFF_BIT> TRXOFF;
+	typedef DW1000Field<SysCtrl, WAIT4RESP_BIT> WAIT4RESP;
+	typedef DW1000Field<SysCtrl, RXENAB_BIT> RXENAB;
+	typedef DW1000Field<SysCtrl, RXDLYS_BIT> RXDLYS;
+
+	// SYS_STATUS, system event status (write 1 to clear)
+	typedef DW1000Register<SYS_STATUS, NO_SUB, LEN_SYS_STATUS> SysStatus;
+	typedef DW1000Field<SysStatus, CPLOCK_BIT> CPLOCK;
+	typedef DW1000Field<SysStatus, TXFRB_BIT> TXFRB;
+	typedef DW1000Field<SysStatus, TXPRS_BIT> TXPRS;
+	typedef DW1000Field<SysStatus, TXPHS_BIT> TXPHS;
+	typedef DW1000Field<SysStatus, TXFRS_BIT> TXFRS;
+	typedef DW1000Field<SysStatus, TXFRB_BIT, 4> TX_EVENTS;
+	typedef DW1000Field<SysStatus, RXPRD_BIT> RXPRD;
+	typedef DW1000Field<SysStatus, RXSFDD_BIT> RXSFDD;
+	typedef DW1000Field<SysStatus, RXPHE_BIT> RXPHE;
+	typedef DW1000Field<SysStatus, LDEDONE_BIT> LDEDONE;
+	typedef DW1000Field<SysStatus, RXDFR_BIT> RXDFR;
+	typedef DW1000Field<SysStatus, RXFCG_BIT> RXFCG;
+	typedef DW1000Field<SysStatus, RXFCE_BIT> RXFCE;
+	typedef DW1000Field<SysStatus, RXRFSL_BIT> RXRFSL;
+	typedef DW1000Field<SysStatus, RXRFTO_BIT> RXRFTO;
+	typedef DW1000Field<SysStatus, LDEERR_BIT> LDEERR;
+	typedef DW1000Field<SysStatus, RXPTO_BIT> RXPTO;
+	typedef DW1000Field<SysStatus, RXSFDTO_BIT> RXSFDTO;
+	// bytes of all latched RX events, LDEDONE to RXSFDTO
+	typedef DW1000Fields<LDEDONE, RXSFDTO> RX_EVENTS;
+
+	// TX_FCTRL, transmit frame control
+	typedef DW1000Register<TX_FCTRL, NO_SUB, LEN_TX_FCTRL> TxFctrl;
+	typedef DW1000Field<TxFctrl, 0, 10> TFLEN;		// TFLEN and TFLE (extended length)
+	typedef DW1000Field<TxFctrl, 13, 2> TXBR;
+	typedef DW1000Field<TxFctrl, 16, 2> TXPRF;
+	typedef DW1000Field<TxFctrl, 18, 4> TXPSR_PE;
+	typedef DW1000Field<TxFctrl, TR_BIT> TR;
+
+	// RX_FINFO, RX_FQUAL, RX_TIME, received frame information and quality
+	typedef DW1000Register<RX_FINFO, NO_SUB, LEN_RX_FINFO> RxFinfo;
+	typedef DW1000Field<RxFinfo, RXPACC_SHIFT, 12> RXPACC;
+	typedef DW1000Register<RX_FQUAL, NO_SUB, LEN_RX_FQUAL> RxFqual;
+	typedef DW1000Register<RX_TIME, NO_SUB, LEN_RX_TIME> RxTime;
+}
+
+#endif
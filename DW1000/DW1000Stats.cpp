@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Event counters and latency histograms of a DW1000 (see DW1000Stats.h).
+ */
+
+#include "DW1000Stats.h"
+
+DW1000Stats::DW1000Stats() {
+	_dw = NULL;
+#ifdef DEBUG
+	_now = 0;
+#endif
+	reset();
+}
+
+/*
+ * Follow all transfers of the device. Events already latched on the device
+ * are counted with the first status read.
+ * @param dw
+ *		The device.
+ */
+void DW1000Stats::attach(DW1000* dw) {
+	detach();
+	_dw = dw;
+	_dw->setTransferHandler(&DW1000Stats::handleTransfer, this);
+}
+
+void DW1000Stats::detach() {
+	if(_dw != NULL) {
+		_dw->setTransferHandler(NULL, NULL);
+		_dw = NULL;
+	}
+}
+
+/*
+ * Copy all counters.
+ * @param reset
+ *		Clear the counters after copying, so that consecutive snapshots
+ *		cover consecutive periods. Pending operations are kept.
+ */
+void DW1000Stats::snapshot(DW1000StatsSnapshot* snapshot, boolean reset) {
+	_stats.time = now() - _reset;
+	memcpy(snapshot, &_stats, sizeof(DW1000StatsSnapshot));
+	if(reset) {
+		memset(&_stats, 0, sizeof(DW1000StatsSnapshot));
+		_reset = now();
+	}
+}
+
+/*
+ * Clear all counters and forget pending operations and latched events.
+ */
+void DW1000Stats::reset() {
+	memset(&_stats, 0, sizeof(DW1000StatsSnapshot));
+	_reset = now();
+	_latched = 0;
+	_txPending = false;
+	_rxDone = false;
+	_rxPending = false;
+	_txStart = 0;
+	_rxDoneTime = 0;
+	_rxStart = 0;
+}
+
+unsigned long DW1000Stats::getEventCount(byte bit) {
+	return bit < STATS_EVENTS ? _stats.events[bit] : 0;
+}
+
+unsigned long DW1000Stats::getFrameCount() {
+	return _stats.events[RXFCG_BIT];
+}
+
+unsigned long DW1000Stats::getReceiveErrorCount() {
+	return _stats.events[RXPHE_BIT] + _stats.events[RXFCE_BIT]
+		+ _stats.events[RXRFSL_BIT] + _stats.events[LDEERR_BIT];
+}
+
+unsigned long DW1000Stats::getLatencyCount(byte operation) {
+	unsigned long count = 0;
+	byte i;
+
+	if(operation >= STATS_OPERATIONS) {
+		return 0;
+	}
+	for(i = 0; i < STATS_BUCKETS; i++) {
+		count += _stats.latency[operation][i];
+	}
+	return count;
+}
+
+unsigned long DW1000Stats::getLatencyBucket(byte operation, byte bucket) {
+	if(operation >= STATS_OPERATIONS || bucket >= STATS_BUCKETS) {
+		return 0;
+	}
+	return _stats.latency[operation][bucket];
+}
+
+unsigned long DW1000Stats::getLatencyPercentile(byte operation, byte percent) {
+	unsigned long count = getLatencyCount(operation);
+	unsigned long target, sum = 0;
+	byte i;
+
+	if(count == 0) {
+		return 0;
+	}
+	// rank of the percentile, rounded up, without overflow
+	target = count / 100 * percent + ((count % 100) * percent + 99) / 100;
+	if(target == 0) {
+		target = 1;
+	}
+	for(i = 0; i < STATS_BUCKETS - 1; i++) {
+		sum += _stats.latency[operation][i];
+		if(sum >= target) {
+			return (1UL << i) - 1;
+		}
+	}
+	return 0xFFFFFFFFUL;
+}
+
+/*
+ * Histogram bucket of a value: the number of its significant bits, i.e.
+ * bucket b holds values below 2^b, the last bucket all larger ones.
+ */
+byte DW1000Stats::bucketOf(unsigned long us) {
+	byte bucket = 0;
+
+	while(us > 0 && bucket < STATS_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+#ifdef DEBUG
+void DW1000Stats::setTime(unsigned long now) {
+	_now = now;
+}
+#endif
+
+unsigned long DW1000Stats::now() {
+#ifndef DEBUG
+	return micros();
+#else
+	return _now;
+#endif
+}
+
+void DW1000Stats::handleTransfer(void* context, boolean /* write */, byte header[], int headerLen, byte data[], int n) {
+	// the direction is part of the header
+	((DW1000Stats*)context)->record(header, headerLen, data, n);
+}
+
+void DW1000Stats::record(byte header[], int headerLen, byte data[], int n) {
+	byte reg = header[0] & 0x3F;
+	word sub = 0;
+	unsigned long value = 0, mask = 0;
+	int i;
+
+	_stats.transfers++;
+	if(reg != SYS_STATUS && reg != SYS_CTRL) {
+		return;
+	}
+	// sub-address (READ_SUB/WRITE_SUB), extended in a third byte
+	if(headerLen > 1) {
+		sub = header[1] & 0x7F;
+		if(headerLen > 2) {
+			sub |= (word)header[2] << 7;
+		}
+	}
+	// the covered bytes of the low 32 bits
+	for(i = 0; i < n && sub + i < 4; i++) {
+		value |= (unsigned long)data[i] << ((sub + i) * 8);
+		mask |= 0xFFUL << ((sub + i) * 8);
+	}
+	if(mask == 0) {
+		return;
+	}
+	if(reg == SYS_STATUS) {
+		if(header[0] & 0x80) {
+			// write 1 to clear
+			_latched &= ~value;
+		} else {
+			readStatus(value, mask, now());
+		}
+	} else if(header[0] & 0x80) {
+		writeControl(value, now());
+	}
+}
+
+void DW1000Stats::readStatus(unsigned long status, unsigned long mask, unsigned long t) {
+	unsigned long rising = status & mask & ~_latched;
+	const unsigned long frame = (1UL << RXDFR_BIT) | (1UL << RXPHE_BIT) | (1UL << RXRFSL_BIT);
+	const unsigned long timeout = (1UL << RXRFTO_BIT) | (1UL << RXPTO_BIT) | (1UL << RXSFDTO_BIT);
+	byte i;
+
+	_latched = (_latched & ~mask) | (status & mask);
+	if(rising == 0) {
+		return;
+	}
+	for(i = 0; i < STATS_EVENTS; i++) {
+		if(rising & (1UL << i)) {
+			_stats.events[i]++;
+		}
+	}
+	if(_txPending && (rising & (1UL << TXFRS_BIT))) {
+		addLatency(TX_DONE, t - _txStart);
+		_txPending = false;
+	}
+	if(_rxPending && (rising & frame)) {
+		addLatency(RX_WAIT, t - _rxStart);
+		_rxPending = false;
+	} else if(rising & timeout) {
+		_rxPending = false;
+	}
+	if(rising & (1UL << RXFCG_BIT)) {
+		_rxDone = true;
+		_rxDoneTime = t;
+	}
+}
+
+void DW1000Stats::writeControl(unsigned long control, unsigned long t) {
+	if(control & (1UL << TRXOFF_BIT)) {
+		_txPending = false;
+		_rxPending = false;
+	}
+	if(control & (1UL << TXSTRT_BIT)) {
+		if(_rxDone) {
+			addLatency(RX_TO_TX, t - _rxDoneTime);
+			_rxDone = false;
+		}
+		_txPending = true;
+		_txStart = t;
+	}
+	if(control & (1UL << RXENAB_BIT)) {
+		// receiving again, no response to the last frame
+		_rxDone = false;
+		_rxPending = true;
+		_rxStart = t;
+	}
+}
+
+void DW1000Stats::addLatency(byte operation, unsigned long us) {
+	_stats.latency[operation][bucketOf(us)]++;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Always-on statistics of a DW1000, in fixed memory. Attached to the
+ * transfer hook, the SYS_STATUS reads and clears and the SYS_CTRL writes
+ * of the library are followed without extra SPI traffic:
+ *
+ *   events   one counter per SYS_STATUS event (low 32 bits), counted when
+ *            a status read shows it set after it was seen clear
+ *   latency  log2 histograms (bucket b holds values below 2^b us, the last
+ *            one all above) of the TX done time (TXSTRT to TXFRS), the
+ *            RX to TX turnaround (good frame to TXSTRT) and the RX wait
+ *            (RXENAB to a received frame, good or bad)
+ *
+ * Latencies are measured to the status read that shows the event, so they
+ * include the polling delay. A snapshot copies all counters, e.g. for a
+ * health report of a field unit, and may reset them.
+ */
+
+#ifndef _DW1000STATS_H_INCLUDED
+#define _DW1000STATS_H_INCLUDED
+
+#include "DW1000.h"
+
+// counted SYS_STATUS events, latency histograms and their buckets
+#define STATS_EVENTS 32
+#define STATS_OPERATIONS 3
+#define STATS_BUCKETS 16
+
+// all counters, see DW1000Stats::snapshot()
+struct DW1000StatsSnapshot {
+	unsigned long events[STATS_EVENTS];
+	unsigned long latency[STATS_OPERATIONS][STATS_BUCKETS];
+	// transfers and time (us) since the last reset
+	unsigned long transfers;
+	unsigned long time;
+};
+
+class DW1000Stats {
+public:
+	DW1000Stats();
+
+	// follow the transfers of a device, the device's transfer hook is taken
+	// over until detach()
+	void attach(DW1000* dw);
+	void detach();
+
+	// copy all counters, and clear them if reset is set
+	void snapshot(DW1000StatsSnapshot* snapshot, boolean reset);
+	void reset();
+
+	// SYS_STATUS event counts by bit (e.g. RXFCE_BIT)
+	unsigned long getEventCount(byte bit);
+	// good frames and frames lost to PHR, CRC, Reed Solomon or LDE errors
+	unsigned long getFrameCount();
+	unsigned long getReceiveErrorCount();
+
+	// latency histograms
+	unsigned long getLatencyCount(byte operation);
+	unsigned long getLatencyBucket(byte operation, byte bucket);
+	// upper bound (us) of the bucket holding the given percentile (0-100);
+	// 0 for bucket 0 (latencies of 0us) as well as without values, see
+	// getLatencyCount()
+	unsigned long getLatencyPercentile(byte operation, byte percent);
+	static byte bucketOf(unsigned long us);
+
+#ifdef DEBUG
+	// host side time source (us) instead of micros()
+	void setTime(unsigned long now);
+#endif
+
+	// follow one transfer, for chaining with another transfer hook
+	void record(byte header[], int headerLen, byte data[], int n);
+
+	// operations
+	static const byte TX_DONE = 0;
+	static const byte RX_TO_TX = 1;
+	static const byte RX_WAIT = 2;
+
+private:
+	DW1000* _dw;
+	DW1000StatsSnapshot _stats;
+	unsigned long _reset;
+	// status bits seen set and not cleared since
+	unsigned long _latched;
+	// start of the pending operations (TXSTRT, good frame, RXENAB)
+	boolean _txPending;
+	boolean _rxDone;
+	boolean _rxPending;
+	unsigned long _txStart;
+	unsigned long _rxDoneTime;
+	unsigned long _rxStart;
+#ifdef DEBUG
+	unsigned long _now;
+#endif
+
+	unsigned long now();
+	void readStatus(unsigned long status, unsigned long mask, unsigned long t);
+	void writeControl(unsigned long control, unsigned long t);
+	void addLatency(byte operation, unsigned long us);
+	static void handleTransfer(void* context, boolean write, byte header[], int headerLen, byte data[], int n);
+};
+
+#endif
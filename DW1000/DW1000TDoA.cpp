@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "DW1000TDoA.h"
+
+/* ###########################################################################
+ * #### Construction and init ################################################
+ * ######################################################################### */
+
+DW1000TDoA::DW1000TDoA(DW1000* dw, word anchor, word reference) {
+	_dw = dw;
+	_anchor = anchor;
+	_reference = reference;
+	_referenceTof = 0;
+
+	// the reference anchor is its own time base
+	_synchronized = (anchor == reference);
+	_skew = 0;
+	_havePoint = false;
+	_syncLocal = 0;
+	_syncRef = 0;
+	_haveSync = false;
+	_lastSyncSeq = 0;
+	_lastSyncRx = 0;
+
+	_report[0] = TDOA_REPORT;
+	_report[1] = (byte)(anchor & 0xFF);
+	_report[2] = (byte)((anchor >> 8) & 0xFF);
+	_report[3] = 0;
+	_pending = 0;
+	_dropped = 0;
+}
+
+/*
+ * Sync beacons arrive this much later than they were sent, i.e. the
+ * distance to the reference anchor in timestamp units.
+ */
+void DW1000TDoA::setReferenceTimeOfFlight(int64_t tof) {
+	_referenceTof = tof;
+}
+
+/* ###########################################################################
+ * #### Receive path #########################################################
+ * ######################################################################### */
+
+/*
+ * Read the frame just received (see isReceiveDone) and its RX timestamp
+ * from the device and process it. Returns false for unknown frames.
+ */
+boolean DW1000TDoA::processReceived() {
+	byte data[LEN_TDOA_SYNC];
+	byte stamp[LEN_STAMP];
+	int n;
+
+	n = _dw->getData(data, LEN_TDOA_SYNC);
+	if(n < LEN_TDOA_BLINK) {
+		return false;
+	}
+	_dw->readReceiveTimestamp(stamp);
+	handleFrame(data, n, DW1000::toTimestamp(stamp));
+	return data[0] == TDOA_BLINK || data[0] == TDOA_SYNC;
+}
+
+/*
+ * Process a received frame.
+ * @param data
+ *		The frame payload.
+ * @param n
+ *		The payload length.
+ * @param rxTime
+ *		The local RX timestamp of the frame.
+ */
+void DW1000TDoA::handleFrame(byte data[], int n, int64_t rxTime) {
+	if(data[0] == TDOA_BLINK && n >= LEN_TDOA_BLINK) {
+		handleBlink(data, rxTime);
+	} else if(data[0] == TDOA_SYNC && n >= LEN_TDOA_SYNC) {
+		handleSync(data, rxTime);
+	}
+}
+
+/*
+ * A sync beacon carries the TX time of the previous one (the TX time of a
+ * frame is only known after sending it). Pairing it with the local RX time
+ * of the previous beacon yields a point of the clock model, the rate offset
+ * between consecutive points is filtered. Beacons must be less than ~1s
+ * apart to keep the fixed-point arithmetic in range.
+ */
+void DW1000TDoA::handleSync(byte data[], int64_t rxTime) {
+	word anchor = data[2] | ((word)data[3] << 8);
+	byte seq = data[1];
+	int64_t refTime, localDiff, refDiff, skew;
+
+	if(anchor != _reference || _anchor == _reference) {
+		return;
+	}
+	if(_haveSync && (byte)(_lastSyncSeq + 1) == seq) {
+		refTime = (DW1000::toTimestamp(&data[4]) + _referenceTof) % DW1000::TIME_OVERFLOW;
+		if(_havePoint) {
+			localDiff = DW1000::timestampDiff(_lastSyncRx, _syncLocal);
+			refDiff = DW1000::timestampDiff(refTime, _syncRef);
+			if(localDiff > 0) {
+				skew = (refDiff - localDiff) * (1LL << 40) / localDiff;
+				if(_synchronized) {
+					_skew += (skew - _skew) / (1 << SKEW_FILTER_SHIFT);
+				} else {
+					_skew = skew;
+					_synchronized = true;
+				}
+			}
+		}
+		_syncLocal = _lastSyncRx;
+		_syncRef = refTime;
+		_havePoint = true;
+	}
+	_haveSync = true;
+	_lastSyncSeq = seq;
+	_lastSyncRx = rxTime;
+}
+
+void DW1000TDoA::handleBlink(byte data[], int64_t rxTime) {
+	byte* record;
+
+	if(!_synchronized || _pending >= DW1000_TDOA_BATCH) {
+		_dropped++;
+		return;
+	}
+	record = &_report[LEN_TDOA_REPORT_HEADER + _pending * LEN_TDOA_RECORD];
+	// tag address and sequence number
+	record[0] = data[2];
+	record[1] = data[3];
+	record[2] = data[1];
+	DW1000::timestampToBytes(toReferenceTime(rxTime), &record[3]);
+	_pending++;
+}
+
+/* ###########################################################################
+ * #### Clock model ##########################################################
+ * ######################################################################### */
+
+boolean DW1000TDoA::isSynchronized() {
+	return _synchronized;
+}
+
+/*
+ * Offset (ppb) of the reference clock relative to the local one.
+ */
+long DW1000TDoA::getClockOffset() {
+	return (long)(_skew * 1000000000LL / (1LL << 40));
+}
+
+/*
+ * Map a local timestamp to the time base of the reference anchor, linear
+ * from the last sync point using the filtered clock offset. The elapsed
+ * time (up to 2^40 ticks) is scaled in two 20 bit halves, which stays in
+ * range for any offset below ~8000ppm however long ago the sync was.
+ */
+int64_t DW1000TDoA::toReferenceTime(int64_t localTime) {
+	int64_t elapsed, high, low;
+
+	if(_anchor == _reference) {
+		return localTime;
+	}
+	elapsed = DW1000::timestampDiff(localTime, _syncLocal);
+	high = elapsed >> 20;
+	low = elapsed & 0xFFFFF;
+	elapsed += (high * _skew + low * _skew / (1LL << 20)) / (1LL << 20);
+	return (_syncRef + elapsed) % DW1000::TIME_OVERFLOW;
+}
+
+/* ###########################################################################
+ * #### Reports ##############################################################
+ * ######################################################################### */
+
+/*
+ * A report is due once the batch is full. Further blinks are dropped
+ * until it is fetched.
+ */
+boolean DW1000TDoA::hasReport() {
+	return _pending >= DW1000_TDOA_BATCH;
+}
+
+/*
+ * Copy the pending records as a report and start a new batch.
+ * @param data
+ *		The array to write the report into, LEN_TDOA_REPORT bytes.
+ * Returns the report length, or 0 if there are no pending records.
+ */
+int DW1000TDoA::getReport(byte data[]) {
+	int n;
+
+	if(_pending == 0) {
+		return 0;
+	}
+	_report[3] = (byte)_pending;
+	n = LEN_TDOA_REPORT_HEADER + _pending * LEN_TDOA_RECORD;
+	memcpy(data, _report, n);
+	_pending = 0;
+	return n;
+}
+
+int DW1000TDoA::getPendingCount() {
+	return _pending;
+}
+
+word DW1000TDoA::getDroppedCount() {
+	return _dropped;
+}
+
+/* ###########################################################################
+ * #### Frame formats ########################################################
+ * ######################################################################### */
+
+int DW1000TDoA::buildBlink(byte data[], word tag, byte seq) {
+	data[0] = TDOA_BLINK;
+	data[1] = seq;
+	data[2] = (byte)(tag & 0xFF);
+	data[3] = (byte)((tag >> 8) & 0xFF);
+	return LEN_TDOA_BLINK;
+}
+
+/*
+ * Sync beacon of the reference anchor.
+ * @param lastTxTime
+ *		The TX timestamp of the previous beacon (sequence number seq - 1).
+ */
+int DW1000TDoA::buildSync(byte data[], word anchor, byte seq, int64_t lastTxTime) {
+	data[0] = TDOA_SYNC;
+	data[1] = seq;
+	data[2] = (byte)(anchor & 0xFF);
+	data[3] = (byte)((anchor >> 8) & 0xFF);
+	DW1000::timestampToBytes(lastTxTime, &data[4]);
+	return LEN_TDOA_SYNC;
+}
+
+word DW1000TDoA::getReportAnchor(byte report[]) {
+	return report[1] | ((word)report[2] << 8);
+}
+
+int DW1000TDoA::getReportCount(byte report[]) {
+	return report[3];
+}
+
+void DW1000TDoA::getReportRecord(byte report[], int i, word* tag, byte* seq, int64_t* time) {
+	byte* record = &report[LEN_TDOA_REPORT_HEADER + i * LEN_TDOA_RECORD];
+
+	*tag = record[0] | ((word)record[1] << 8);
+	*seq = record[2];
+	*time = DW1000::toTimestamp(&record[3]);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Anchor side of time difference of arrival (TDoA) positioning. Anchors
+ * passively timestamp tag blinks, follow the clock of a reference anchor
+ * through its sync beacons and batch the blink arrival times (in the time
+ * base of the reference anchor) into compact reports for the gateway.
+ */
+
+#ifndef _DW1000TDOA_H_INCLUDED
+#define _DW1000TDOA_H_INCLUDED
+
+#include "DW1000.h"
+
+// blink records per report
+#ifndef DW1000_TDOA_BATCH
+#define DW1000_TDOA_BATCH 12
+#endif
+
+// blink: frame control (802.15.4 blink), sequence number, tag address
+#define TDOA_BLINK 0xC5
+#define LEN_TDOA_BLINK 4
+// sync: type, sequence number, anchor address, TX time of previous sync
+#define TDOA_SYNC 0x5A
+#define LEN_TDOA_SYNC 9
+// report: type, anchor address, record count, records (tag, seq, time)
+#define TDOA_REPORT 0x5B
+#define LEN_TDOA_REPORT_HEADER 4
+#define LEN_TDOA_RECORD 8
+#define LEN_TDOA_REPORT (LEN_TDOA_REPORT_HEADER + DW1000_TDOA_BATCH * LEN_TDOA_RECORD)
+
+class DW1000TDoA {
+public:
+	// exponential filter weight of new skew samples (1/2^n)
+	static const byte SKEW_FILTER_SHIFT = 2;
+
+	// anchor with the given address, synchronized to the reference anchor
+	DW1000TDoA(DW1000* dw, word anchor, word reference);
+
+	// time of flight from the reference anchor (known positions)
+	void setReferenceTimeOfFlight(int64_t tof);
+
+	// receive path
+	boolean processReceived();
+	void handleFrame(byte data[], int n, int64_t rxTime);
+
+	// clock model of the reference anchor
+	boolean isSynchronized();
+	long getClockOffset();
+	int64_t toReferenceTime(int64_t localTime);
+
+	// batched reports
+	boolean hasReport();
+	int getReport(byte data[]);
+	int getPendingCount();
+	word getDroppedCount();
+
+	// frame formats
+	static int buildBlink(byte data[], word tag, byte seq);
+	static int buildSync(byte data[], word anchor, byte seq, int64_t lastTxTime);
+	static word getReportAnchor(byte report[]);
+	static int getReportCount(byte report[]);
+	static void getReportRecord(byte report[], int i, word* tag, byte* seq, int64_t* time);
+
+private:
+	DW1000* _dw;
+	word _anchor;
+	word _reference;
+	int64_t _referenceTof;
+
+	// reference clock: rate offset (units of 2^-40) and the last sync point
+	int64_t _skew;
+	boolean _synchronized;
+	boolean _havePoint;
+	int64_t _syncLocal;
+	int64_t _syncRef;
+	// last received sync, paired once the next one reports its TX time
+	boolean _haveSync;
+	byte _lastSyncSeq;
+	int64_t _lastSyncRx;
+
+	byte _report[LEN_TDOA_REPORT];
+	int _pending;
+	word _dropped;
+
+	void handleSync(byte data[], int64_t rxTime);
+	void handleBlink(byte data[], int64_t rxTime);
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Recorder of the SPI traffic of a DW1000 (see DW1000Trace.h).
+ */
+
+#include "DW1000Trace.h"
+
+DW1000Trace::DW1000Trace(byte buffer[], unsigned int size) {
+	_dw = NULL;
+	_buffer = buffer;
+	_size = size;
+#ifdef DEBUG
+	_now = 0;
+#endif
+	clear();
+}
+
+/*
+ * Records all following transfers of the device. Times are relative, the
+ * first record is timed from this call.
+ * @param dw
+ *		The device.
+ */
+void DW1000Trace::attach(DW1000* dw) {
+	detach();
+	_dw = dw;
+	_last = now();
+	_dw->setTransferHandler(&DW1000Trace::handleTransfer, this);
+}
+
+void DW1000Trace::detach() {
+	if(_dw != NULL) {
+		_dw->setTransferHandler(NULL, NULL);
+		_dw = NULL;
+	}
+}
+
+void DW1000Trace::clear() {
+	_length = 0;
+	_records = 0;
+	_dropped = 0;
+	_last = now();
+}
+
+byte* DW1000Trace::getBuffer() {
+	return _buffer;
+}
+
+unsigned int DW1000Trace::getLength() {
+	return _length;
+}
+
+unsigned long DW1000Trace::getRecordCount() {
+	return _records;
+}
+
+unsigned long DW1000Trace::getDroppedCount() {
+	return _dropped;
+}
+
+#ifdef DEBUG
+void DW1000Trace::setTime(unsigned long now) {
+	_now = now;
+}
+#endif
+
+unsigned long DW1000Trace::now() {
+#ifndef DEBUG
+	return micros();
+#else
+	return _now;
+#endif
+}
+
+void DW1000Trace::handleTransfer(void* context, boolean /* write */, byte header[], int headerLen, byte data[], int n) {
+	// the direction is part of the header
+	((DW1000Trace*)context)->record(header, headerLen, data, n);
+}
+
+void DW1000Trace::record(byte header[], int headerLen, byte data[], int n) {
+	byte head[LEN_TRACE_RECORD_HEADER];
+	unsigned long t = now();
+	int len;
+
+	// keep the trace consistent, nothing after the first dropped record
+	if(_dropped > 0) {
+		_dropped++;
+		return;
+	}
+	memcpy(head, header, headerLen);
+	len = headerLen;
+	len += putVarint(&head[len], t - _last);
+	len += putVarint(&head[len], (unsigned long)n);
+	if(_length + len + n > _size) {
+		_dropped++;
+		return;
+	}
+	memcpy(&_buffer[_length], head, len);
+	memcpy(&_buffer[_length + len], data, n);
+	_length += len + n;
+	_records++;
+	_last = t;
+}
+
+/*
+ * Appends an unsigned value, 7 bits per byte with the high bit set on all
+ * but the last byte.
+ * @return
+ *		The number of bytes written (1 to 5).
+ */
+int DW1000Trace::putVarint(byte buffer[], unsigned long value) {
+	int n = 0;
+
+	while(value >= 0x80) {
+		buffer[n++] = (byte)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[n++] = (byte)value;
+	return n;
+}
+
+/*
+ * Decodes one record of a trace.
+ * @param trace
+ *		The trace, as recorded.
+ * @param length
+ *		The length of the trace.
+ * @param offset
+ *		The offset of the record (0 for the first).
+ * @param record
+ *		The decoded record, its data points into the trace.
+ * @return
+ *		The offset of the next record, or 0 if there is no (complete) record
+ *		at the offset.
+ */
+unsigned int DW1000Trace::decode(const byte trace[], unsigned int length, unsigned int offset, DW1000TraceRecord* record) {
+	unsigned long value[2];
+	unsigned int i = offset;
+	int v, shift;
+
+	if(i >= length) {
+		return 0;
+	}
+	// header: write bit (0x80), sub-address bit (0x40) and extended
+	// sub-address bit (0x80 of the second byte), see DW1000::readBytes()
+	record->header[0] = trace[i++];
+	record->headerLen = 1;
+	record->write = (record->header[0] & 0x80) != 0;
+	if((record->header[0] & 0x40) != 0) {
+		if(i >= length) {
+			return 0;
+		}
+		record->header[record->headerLen++] = trace[i++];
+		if((record->header[1] & 0x80) != 0) {
+			if(i >= length) {
+				return 0;
+			}
+			record->header[record->headerLen++] = trace[i++];
+		}
+	}
+	// time and length
+	for(v = 0; v < 2; v++) {
+		value[v] = 0;
+		shift = 0;
+		do {
+			if(i >= length || shift > 28) {
+				return 0;
+			}
+			value[v] |= (unsigned long)(trace[i] & 0x7F) << shift;
+			shift += 7;
+		} while((trace[i++] & 0x80) != 0);
+	}
+	record->time = value[0];
+	record->length = (int)value[1];
+	if(value[1] > length - i) {
+		return 0;
+	}
+	record->data = &trace[i];
+	return i + record->length;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 by Thomas Trojer <thomas@trojer.net>
+ * Decawave DW1000 library for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Recorder of the SPI traffic of a DW1000 into a compact binary trace,
+ * e.g. to replay a session offline (see DW1000-replay). One record per
+ * transaction, in a caller provided buffer:
+ *
+ *   header   1 to 3 bytes, the SPI header as sent (read/write bit, register,
+ *            sub-address), its own length is encoded in it
+ *   time     us since the previous record (since attach() for the first),
+ *            variable length (7 bits per byte, LSB first)
+ *   length   payload length, variable length as above
+ *   payload  the bytes written, or the bytes read
+ *
+ * A status poll takes 8 bytes, a full trace stays consistent: once a record
+ * does not fit, it and all following records are dropped.
+ */
+
+#ifndef _DW1000TRACE_H_INCLUDED
+#define _DW1000TRACE_H_INCLUDED
+
+#include "DW1000.h"
+
+// longest record header: SPI header, time and length
+#define LEN_TRACE_RECORD_HEADER 11
+
+// one decoded record, data points into the trace
+struct DW1000TraceRecord {
+	boolean write;
+	byte header[3];
+	int headerLen;
+	unsigned long time;
+	int length;
+	const byte* data;
+};
+
+class DW1000Trace {
+public:
+	// recorder into the given buffer
+	DW1000Trace(byte buffer[], unsigned int size);
+
+	// start recording all transfers of a device (one device per trace),
+	// the device's transfer hook is taken over until detach()
+	void attach(DW1000* dw);
+	void detach();
+	void clear();
+
+	// recorded trace
+	byte* getBuffer();
+	unsigned int getLength();
+	unsigned long getRecordCount();
+	unsigned long getDroppedCount();
+
+#ifdef DEBUG
+	// host side time source (us) instead of micros()
+	void setTime(unsigned long now);
+#endif
+
+	// decode the record at offset, returns the offset of the next record or
+	// 0 at the end of the trace (or on a truncated record)
+	static unsigned int decode(const byte trace[], unsigned int length, unsigned int offset, DW1000TraceRecord* record);
+
+	// record one transfer, for chaining with another transfer hook
+	void record(byte header[], int headerLen, byte data[], int n);
+
+private:
+	DW1000* _dw;
+	byte* _buffer;
+	unsigned int _size;
+	unsigned int _length;
+	unsigned long _records;
+	unsigned long _dropped;
+	unsigned long _last;
+#ifdef DEBUG
+	unsigned long _now;
+#endif
+
+	unsigned long now();
+	static void handleTransfer(void* context, boolean write, byte header[], int headerLen, byte data[], int n);
+	static int putVarint(byte buffer[], unsigned long value);
+};
+
+#endif